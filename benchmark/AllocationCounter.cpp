@@ -0,0 +1,161 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<bool> counting_enabled {false};
+std::atomic<uint64_t> allocations {0};
+std::atomic<uint64_t> deallocations {0};
+std::atomic<uint64_t> bytes {0};
+
+//=============================================================================
+//=============================================================================
+inline void countAllocation(std::size_t size) noexcept
+{
+    if (counting_enabled.load(std::memory_order_relaxed))
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+inline void countDeallocation(void *ptr) noexcept
+{
+    if (ptr != nullptr && counting_enabled.load(std::memory_order_relaxed))
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+auto allocate(std::size_t size) -> void *
+{
+    countAllocation(size);
+
+    // malloc(0) may return nullptr, operator new must not
+    if (auto *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+} // namespace
+
+namespace hdbpp_benchmark
+{
+//=============================================================================
+//=============================================================================
+void enableAllocationCounting(bool enable) noexcept
+{
+    counting_enabled.store(enable, std::memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+auto allocationCountingEnabled() noexcept -> bool
+{
+    return counting_enabled.load(std::memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+void resetAllocationStats() noexcept
+{
+    allocations.store(0, std::memory_order_relaxed);
+    deallocations.store(0, std::memory_order_relaxed);
+    bytes.store(0, std::memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+auto allocationStats() noexcept -> AllocationStats
+{
+    AllocationStats stats;
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.deallocations = deallocations.load(std::memory_order_relaxed);
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+} // namespace hdbpp_benchmark
+
+// Replacements for the global allocation operators, every form of new and delete
+// must be replaced so the counts remain balanced.
+
+auto operator new(std::size_t size) -> void *
+{
+    return allocate(size);
+}
+
+auto operator new[](std::size_t size) -> void *
+{
+    return allocate(size);
+}
+
+auto operator new(std::size_t size, const std::nothrow_t & /*unused*/) noexcept -> void *
+{
+    countAllocation(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+auto operator new[](std::size_t size, const std::nothrow_t & /*unused*/) noexcept -> void *
+{
+    countAllocation(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    countDeallocation(ptr);
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    countDeallocation(ptr);
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t /*unused*/) noexcept
+{
+    countDeallocation(ptr);
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t /*unused*/) noexcept
+{
+    countDeallocation(ptr);
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t & /*unused*/) noexcept
+{
+    countDeallocation(ptr);
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t & /*unused*/) noexcept
+{
+    countDeallocation(ptr);
+    std::free(ptr);
+}
@@ -0,0 +1,63 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _ALLOCATION_COUNTER_HPP
+#define _ALLOCATION_COUNTER_HPP
+
+#include <cstdint>
+
+namespace hdbpp_benchmark
+{
+// Counts heap allocations made through the global operator new/delete. Linking
+// AllocationCounter.cpp into a target replaces the global operators for that target
+// only, the library itself is untouched. Counting is disabled by default and must be
+// enabled at runtime, when disabled the cost is a single relaxed atomic load.
+struct AllocationStats
+{
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    uint64_t bytes = 0;
+};
+
+void enableAllocationCounting(bool enable) noexcept;
+auto allocationCountingEnabled() noexcept -> bool;
+
+void resetAllocationStats() noexcept;
+auto allocationStats() noexcept -> AllocationStats;
+
+// Resets and enables counting for the lifetime of the object, typically wrapped
+// around the timed section of a benchmark
+class AllocationScope
+{
+public:
+    AllocationScope() noexcept
+    {
+        resetAllocationStats();
+        enableAllocationCounting(true);
+    }
+
+    ~AllocationScope() { enableAllocationCounting(false); }
+
+    AllocationScope(const AllocationScope &) = delete;
+    auto operator=(const AllocationScope &) -> AllocationScope & = delete;
+
+    auto stats() const noexcept -> AllocationStats { return allocationStats(); }
+};
+
+} // namespace hdbpp_benchmark
+#endif // _ALLOCATION_COUNTER_HPP
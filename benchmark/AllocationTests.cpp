@@ -0,0 +1,233 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "AllocationCounter.hpp"
+#include "BenchmarkHelpers.hpp"
+#include "DbConnection.hpp"
+#include "HdbppTxDataEvent.hpp"
+#include "NullConnection.hpp"
+#include "QueryBuilder.hpp"
+#include "TestHelpers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <memory>
+
+// These benchmarks count the heap allocations (and bytes allocated) per event at each
+// layer of the insert path. The counts are reported as the allocs_per_event and
+// bytes_per_event counters, and act as a regression signal for allocation work on the
+// hot path. Only the code inside the timed loop is counted.
+
+namespace
+{
+//=============================================================================
+//=============================================================================
+void reportAllocations(benchmark::State &state, const hdbpp_benchmark::AllocationStats &stats, int64_t events)
+{
+    hdbpp_benchmark::reportPerEvent(state, "allocs_per_event", stats.allocations, events);
+    hdbpp_benchmark::reportPerEvent(state, "bytes_per_event", stats.bytes, events);
+}
+} // namespace
+
+//=============================================================================
+//=============================================================================
+template<Tango::CmdArgType Type, Tango::AttrDataFormat Format, int Size = 1>
+void bmAllocQueryBuilderString(benchmark::State &state)
+{
+    // TEST - Allocations made building the insert string for a single event from
+    // data that is already in memory
+    using T = typename hdbpp_test::data_gen::TangoTypeTraits<Type>::type;
+
+    hdbpp_internal::LogConfigurator::initLogging("test");
+    hdbpp_internal::AttributeTraits traits {Tango::READ_WRITE, Format, Type};
+
+    auto value_r = hdbpp_test::data_gen::generateSpectrumData<Type>(false, Size);
+    auto value_w = hdbpp_test::data_gen::generateSpectrumData<Type>(false, Size);
+    hdbpp_internal::DataSpan<T> span_r(*value_r);
+    hdbpp_internal::DataSpan<T> span_w(*value_w);
+
+    hdbpp_benchmark::AllocationScope scope;
+
+    for (auto _ : state)
+    {
+        auto query =
+            hdbpp_internal::pqxx_conn::QueryBuilder::storeDataEventString<T>("1", "0", "0", span_r, span_w, traits);
+
+        benchmark::DoNotOptimize(query);
+    }
+
+    reportAllocations(state, scope.stats(), state.iterations());
+}
+
+//=============================================================================
+//=============================================================================
+template<Tango::CmdArgType Type, Tango::AttrDataFormat Format, int Size = 1>
+void bmAllocTxDataEvent(benchmark::State &state)
+{
+    // TEST - Allocations made taking a single event from a Tango DeviceAttribute through
+    // HdbppTxDataEvent to a buffered sql string. This is the library cost of insert_event()
+    // less the database round trip
+    hdbpp_internal::LogConfigurator::initLogging("test");
+    hdbpp_internal::AttributeTraits traits {Tango::READ_WRITE, Format, Type};
+
+    auto attr = hdbpp_test::data_gen::createDeviceAttribute(traits, Size);
+    hdbpp_benchmark::RecordingConnection conn;
+    hdbpp_benchmark::storeTestAttribute(conn, traits);
+    Tango::TimeVal tv {};
+
+    int64_t events = 0;
+    hdbpp_benchmark::AllocationScope scope;
+
+    for (auto _ : state)
+    {
+        conn.createTx<hdbpp_internal::HdbppTxDataEvent>()
+            .withName(hdbpp_test::attr_name::TestAttrFQDName)
+            .withTraits(traits)
+            .withAttribute(&attr)
+            .withMaxDims(Size, 0)
+            .withEventTime(tv)
+            .withQuality(Tango::ATTR_VALID)
+            .store();
+
+        // keep the sql buffer from growing over the whole run, the buffer is
+        // flushed in batches in the real library. The recording connection's flush
+        // is not library code, so its allocations are not counted
+        if (++events % 1000 == 0)
+        {
+            hdbpp_benchmark::enableAllocationCounting(false);
+            conn.flush();
+            hdbpp_benchmark::enableAllocationCounting(true);
+        }
+    }
+
+    reportAllocations(state, scope.stats(), state.iterations());
+}
+
+//=============================================================================
+//=============================================================================
+template<Tango::CmdArgType Type, Tango::AttrDataFormat Format, int Size = 1>
+void bmAllocDbConnectionBuffered(benchmark::State &state)
+{
+    // TEST - Allocations made by DbConnection storing events in buffered mode, each
+    // iteration buffers 1000 events and then flushes them to the database, so this
+    // includes the allocations made by pqxx and libpq
+    const int events_per_flush = 1000;
+    using T = typename hdbpp_test::data_gen::TangoTypeTraits<Type>::type;
+
+    hdbpp_internal::LogConfigurator::initLogging("test");
+    hdbpp_benchmark::clearTables();
+
+    hdbpp_internal::AttributeTraits traits {Tango::READ_WRITE, Format, Type};
+    hdbpp_internal::pqxx_conn::DbConnection conn(
+        hdbpp_internal::pqxx_conn::DbConnection::DbStoreMethod::PreparedStatement);
+
+    conn.connect(hdbpp_test::psql_connection::postgres_db::HdbppConnectionString);
+    hdbpp_benchmark::storeTestAttribute(conn, traits);
+
+    auto value_r = hdbpp_test::data_gen::generateSpectrumData<Type>(false, Size);
+    auto value_w = hdbpp_test::data_gen::generateSpectrumData<Type>(false, Size);
+    hdbpp_internal::DataSpan<T> span_r(*value_r);
+    hdbpp_internal::DataSpan<T> span_w(*value_w);
+
+    conn.buffer(true);
+
+    hdbpp_benchmark::AllocationScope scope;
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < events_per_flush; i++)
+            conn.storeDataEvent<T>(
+                hdbpp_test::attr_name::TestAttrFinalName, i, Tango::ATTR_VALID, span_r, span_w, traits);
+
+        conn.flush();
+    }
+
+    reportAllocations(state, scope.stats(), state.iterations() * events_per_flush);
+
+    conn.buffer(false);
+    conn.disconnect();
+}
+
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_BOOLEAN, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_SHORT, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_LONG, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_LONG64, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_FLOAT, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_DOUBLE, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_UCHAR, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_USHORT, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_ULONG, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_ULONG64, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_STRING, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_STATE, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_ENUM, Tango::SCALAR);
+
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_BOOLEAN, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_SHORT, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_LONG, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_LONG64, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_FLOAT, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_DOUBLE, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_UCHAR, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_USHORT, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_ULONG, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_ULONG64, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_STRING, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_STATE, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocQueryBuilderString, Tango::DEV_ENUM, Tango::SPECTRUM, 512);
+
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_BOOLEAN, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_SHORT, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_LONG, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_LONG64, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_FLOAT, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_DOUBLE, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_UCHAR, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_USHORT, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_ULONG, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_ULONG64, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_STRING, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_STATE, Tango::SCALAR);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_ENUM, Tango::SCALAR);
+
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_BOOLEAN, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_SHORT, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_LONG, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_LONG64, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_FLOAT, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_DOUBLE, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_UCHAR, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_USHORT, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_ULONG, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_ULONG64, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_STRING, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_STATE, Tango::SPECTRUM, 512);
+BENCHMARK_TEMPLATE(bmAllocTxDataEvent, Tango::DEV_ENUM, Tango::SPECTRUM, 512);
+
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_DOUBLE, Tango::SCALAR)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_LONG, Tango::SCALAR)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_STRING, Tango::SCALAR)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_BOOLEAN, Tango::SCALAR)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_DOUBLE, Tango::SPECTRUM, 512)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_LONG, Tango::SPECTRUM, 512)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_STRING, Tango::SPECTRUM, 512)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(bmAllocDbConnectionBuffered, Tango::DEV_BOOLEAN, Tango::SPECTRUM, 512)
+    ->Unit(benchmark::kMillisecond);
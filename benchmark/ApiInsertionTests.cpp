@@ -0,0 +1,361 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "BenchmarkHelpers.hpp"
+#include "EventGenerator.hpp"
+#include "HdbppTimescaleDbApi.hpp"
+#include "LatencyHistogram.hpp"
+#include "TestHelpers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// End to end benchmarks of the public api, driven with generated Tango::EventData
+// objects covering every implemented type/format/write type, as an archiver would
+// drive the library. These require the benchmark database to be available. The
+// latency of each api call is recorded and reported as percentile counters.
+
+namespace
+{
+// a realistic mix of event quality, most events are valid
+const double AlarmRatio = 0.01;
+const double WarningRatio = 0.02;
+const double InvalidRatio = 0.01;
+
+//=============================================================================
+//=============================================================================
+auto createApi(const std::vector<std::string> &extra_config = {}) -> std::unique_ptr<hdbpp::HdbppTimescaleDbApi>
+{
+    std::vector<std::string> config {
+        "connect_string=" + hdbpp_test::psql_connection::postgres_db::HdbppConnectionString, "logging_level=error"};
+
+    config.insert(config.end(), extra_config.begin(), extra_config.end());
+
+    return std::make_unique<hdbpp::HdbppTimescaleDbApi>("benchmark", config);
+}
+
+//=============================================================================
+//=============================================================================
+auto createConfig(int attributes_per_traits, int array_size, int error_percent) -> hdbpp_benchmark::EventGeneratorConfig
+{
+    hdbpp_benchmark::EventGeneratorConfig config;
+    config.attributes_per_traits = attributes_per_traits;
+    config.array_size = array_size;
+    config.error_ratio = error_percent / 100.0;
+    config.alarm_ratio = AlarmRatio;
+    config.warning_ratio = WarningRatio;
+    config.invalid_ratio = InvalidRatio;
+    return config;
+}
+} // namespace
+
+//=============================================================================
+//=============================================================================
+void bmApiInsertEvent(benchmark::State &state)
+{
+    // TEST - Throughput and latency of insert_event(), one event per call,
+    // rotating through an attribute of every implemented type
+    hdbpp_benchmark::clearTables();
+
+    auto array_size = static_cast<int>(state.range(0));
+    auto error_percent = static_cast<int>(state.range(1));
+
+    hdbpp_benchmark::EventGenerator generator(createConfig(1, array_size, error_percent));
+    auto api = createApi();
+    generator.addAttributes(*api);
+
+    hdbpp_internal::LatencyHistogram latency;
+
+    for (auto _ : state)
+    {
+        auto event = generator.next();
+
+        auto start = std::chrono::steady_clock::now();
+        api->insert_event(std::get<0>(event), std::get<1>(event));
+        auto end = std::chrono::steady_clock::now();
+
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    hdbpp_benchmark::reportLatency(state, "event", latency);
+}
+
+//=============================================================================
+//=============================================================================
+void bmApiInsertEvents(benchmark::State &state)
+{
+    // TEST - Throughput and latency of insert_events(), where each call stores a
+    // batch of events in a single round trip, serialised by the given number of threads
+    hdbpp_benchmark::clearTables();
+
+    auto batch_size = static_cast<int>(state.range(0));
+    auto array_size = static_cast<int>(state.range(1));
+    auto error_percent = static_cast<int>(state.range(2));
+    auto insert_threads = static_cast<int>(state.range(3));
+
+    // the batch may not contain the same event twice, so ensure there are
+    // enough distinct attributes to fill it
+    auto traits_count = static_cast<int>(hdbpp_test::utils::getTraitsImplemented().size());
+    auto attributes_per_traits = (batch_size + traits_count - 1) / traits_count;
+
+    hdbpp_benchmark::EventGenerator generator(createConfig(attributes_per_traits, array_size, error_percent));
+    auto api = createApi(
+        std::vector<std::string> {"insert_threads=" + std::to_string(insert_threads), "parallel_batch_size=1"});
+    generator.addAttributes(*api);
+
+    hdbpp_internal::LatencyHistogram latency;
+
+    for (auto _ : state)
+    {
+        // building the batch is not part of the measurement
+        state.PauseTiming();
+        auto events = generator.nextBatch(batch_size);
+        state.ResumeTiming();
+
+        auto start = std::chrono::steady_clock::now();
+        api->insert_events(move(events));
+        auto end = std::chrono::steady_clock::now();
+
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    hdbpp_benchmark::reportLatency(state, "batch", latency);
+}
+
+//=============================================================================
+//=============================================================================
+void bmApiInsertEventConcurrent(benchmark::State &state)
+{
+    // TEST - Throughput and latency of insert_event() in thread safe mode, called by
+    // several producer threads sharing one api, as a multi threaded archiver would.
+    // The events of the producers are stored together in groups by the storage engine
+    static std::unique_ptr<hdbpp::HdbppTimescaleDbApi> api;
+    static std::vector<std::unique_ptr<hdbpp_benchmark::EventGenerator>> generators;
+    static std::vector<hdbpp_internal::LatencyHistogram> latencies;
+
+    auto array_size = static_cast<int>(state.range(0));
+
+    // the first thread sets up for all of them, the others wait for it at the
+    // start of the loop
+    if (state.thread_index() == 0)
+    {
+        hdbpp_benchmark::clearTables();
+        api = createApi(std::vector<std::string> {"thread_safe=true"});
+        generators.clear();
+
+        // each producer has its own attributes, so no two events clash
+        for (auto i = 0; i < state.threads(); i++)
+        {
+            auto config = createConfig(1, array_size, 0);
+            config.domain = "benchmark-" + std::to_string(i);
+            config.seed += i;
+
+            generators.push_back(std::make_unique<hdbpp_benchmark::EventGenerator>(config));
+            generators.back()->addAttributes(*api);
+        }
+
+        latencies.assign(state.threads(), hdbpp_internal::LatencyHistogram());
+    }
+
+    hdbpp_benchmark::EventGenerator *generator = nullptr;
+    hdbpp_internal::LatencyHistogram *latency = nullptr;
+
+    for (auto _ : state)
+    {
+        if (generator == nullptr)
+        {
+            generator = generators[state.thread_index()].get();
+            latency = &latencies[state.thread_index()];
+        }
+
+        auto event = generator->next();
+
+        auto start = std::chrono::steady_clock::now();
+        api->insert_event(std::get<0>(event), std::get<1>(event));
+        auto end = std::chrono::steady_clock::now();
+
+        latency->record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+
+    // every thread has left the loop, so the first can report for them all and tear down,
+    // counters are summed across the threads so only it reports
+    if (state.thread_index() == 0)
+    {
+        hdbpp_internal::LatencyHistogram total;
+
+        for (auto &thread_latency : latencies)
+            total.merge(thread_latency);
+
+        hdbpp_benchmark::reportLatency(state, "event", total);
+
+        api.reset();
+        generators.clear();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void bmApiInsertEventsPipelined(benchmark::State &state)
+{
+    // TEST - Throughput and latency of insert_events() when the batch is sent to the
+    // database in pipelined sub batches, overlapping serialisation with the commit of
+    // the batch before. A pipeline batch size of 0 flushes the whole batch at the end,
+    // over the same event loop, for comparison
+    hdbpp_benchmark::clearTables();
+
+    auto batch_size = static_cast<int>(state.range(0));
+    auto array_size = static_cast<int>(state.range(1));
+    auto pipeline_batch_size = static_cast<int>(state.range(2));
+    auto pipeline_depth = static_cast<int>(state.range(3));
+
+    auto traits_count = static_cast<int>(hdbpp_test::utils::getTraitsImplemented().size());
+    auto attributes_per_traits = (batch_size + traits_count - 1) / traits_count;
+
+    hdbpp_benchmark::EventGenerator generator(createConfig(attributes_per_traits, array_size, 0));
+    auto api = createApi(std::vector<std::string> {"io_connections=" + std::to_string(pipeline_depth),
+        "pipeline_batch_size=" + std::to_string(pipeline_batch_size),
+        "pipeline_depth=" + std::to_string(pipeline_depth)});
+    generator.addAttributes(*api);
+
+    hdbpp_internal::LatencyHistogram latency;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto events = generator.nextBatch(batch_size);
+        state.ResumeTiming();
+
+        auto start = std::chrono::steady_clock::now();
+        api->insert_events(move(events));
+        auto end = std::chrono::steady_clock::now();
+
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    hdbpp_benchmark::reportLatency(state, "batch", latency);
+}
+
+//=============================================================================
+//=============================================================================
+void bmApiStoreArray(benchmark::State &state)
+{
+    // TEST - Throughput and latency of the typed store api, storing a batch of double
+    // spectrum events directly from memory. Compare with bmApiInsertEvents, which
+    // decodes the same events from Tango::EventData
+    hdbpp_benchmark::clearTables();
+
+    auto batch_size = static_cast<int>(state.range(0));
+    auto array_size = static_cast<std::size_t>(state.range(1));
+
+    auto api = createApi();
+    std::vector<hdbpp::HdbAttributeHandle> handles;
+
+    for (auto i = 0; i < batch_size; i++)
+    {
+        auto name = "tango://" + hdbpp_test::attr_name::TestAttrTangoHost + "/benchmark/typed/double/attr-" +
+            std::to_string(i);
+
+        api->add_attribute(name, Tango::DEV_DOUBLE, Tango::SPECTRUM, Tango::READ);
+        handles.push_back(api->attribute_handle(name));
+    }
+
+    std::vector<double> values(array_size, 1.0);
+    hdbpp_internal::LatencyHistogram latency;
+
+    // each batch must have a distinct event time
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    auto time_us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+
+    for (auto _ : state)
+    {
+        time_us++;
+
+        auto start = std::chrono::steady_clock::now();
+        api->begin_batch();
+
+        for (auto handle : handles)
+            api->store_data<double>(handle,
+                time_us,
+                Tango::ATTR_VALID,
+                hdbpp_internal::DataSpan<double>(values),
+                hdbpp_internal::DataSpan<double>(),
+                false);
+
+        api->end_batch();
+        auto end = std::chrono::steady_clock::now();
+
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    hdbpp_benchmark::reportLatency(state, "batch", latency);
+}
+
+// args: array size, error percentage
+BENCHMARK(bmApiInsertEvent)
+    ->Args({16, 0})
+    ->Args({16, 5})
+    ->Args({1024, 0})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// args: batch size, array size, error percentage, insert threads
+BENCHMARK(bmApiInsertEvents)
+    ->Args({10, 16, 0, 1})
+    ->Args({100, 16, 0, 1})
+    ->Args({100, 16, 5, 1})
+    ->Args({1000, 16, 0, 1})
+    ->Args({100, 1024, 0, 1})
+    ->Args({10000, 1024, 0, 1})
+    ->Args({10000, 1024, 0, 4})
+    ->Args({10000, 1024, 0, 16})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// args: array size
+BENCHMARK(bmApiInsertEventConcurrent)
+    ->Arg(16)
+    ->ThreadRange(1, 32)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// args: batch size, array size, pipeline batch size, pipeline depth
+BENCHMARK(bmApiInsertEventsPipelined)
+    ->Args({10000, 16, 0, 2})
+    ->Args({10000, 16, 1000, 2})
+    ->Args({10000, 16, 1000, 4})
+    ->Args({10000, 1024, 0, 2})
+    ->Args({10000, 1024, 1000, 2})
+    ->Args({10000, 1024, 1000, 4})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// args: batch size, array size
+BENCHMARK(bmApiStoreArray)
+    ->Args({100, 16})
+    ->Args({1000, 16})
+    ->Args({100, 1024})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
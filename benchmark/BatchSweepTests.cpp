@@ -0,0 +1,204 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "BenchmarkHelpers.hpp"
+#include "DbConnection.hpp"
+#include "LatencyHistogram.hpp"
+#include "LatencyProxy.hpp"
+#include "TestHelpers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+// A sweep over the ways DbConnection can store data, to help choose the batch size
+// for an archiver and to catch tail latency regressions. Each benchmark iteration
+// stores one batch of events, spread round robin over a number of attributes, and the
+// time taken for the whole batch (including the flush when buffered) is recorded.
+// The p50/p99/p999 batch latencies are reported alongside the throughput. A non zero
+// latency argument routes the connection through a LatencyProxy, to show how each
+// mode behaves when the database is not on the local machine.
+
+using hdbpp_internal::pqxx_conn::DbConnection;
+
+namespace
+{
+// how events are sent to the database
+enum SweepMode
+{
+    // one transaction per event, via sql strings
+    UnbufferedString = 0,
+
+    // one transaction per event, via prepared statements
+    UnbufferedPrepared = 1,
+
+    // buffered, all events in a batch are sent in a single transaction on flush
+    Buffered = 2
+};
+
+//=============================================================================
+//=============================================================================
+void sweepArgs(benchmark::internal::Benchmark *b)
+{
+    b->ArgNames({"mode", "batch", "attrs", "array", "latency_us"});
+
+    for (auto mode : {UnbufferedString, UnbufferedPrepared, Buffered})
+        for (auto batch_size : {1, 10, 100, 1000, 10000})
+            for (auto attributes : {1, 100})
+                for (auto array_size : {1, 128})
+                    b->Args({mode, batch_size, attributes, array_size, 0});
+}
+
+//=============================================================================
+//=============================================================================
+void remoteSweepArgs(benchmark::internal::Benchmark *b)
+{
+    // a smaller matrix, since each round trip is now expensive
+    b->ArgNames({"mode", "batch", "attrs", "array", "latency_us"});
+
+    for (auto latency : {1000, 5000})
+        for (auto mode : {UnbufferedString, UnbufferedPrepared, Buffered})
+            for (auto batch_size : {1, 100, 1000})
+                b->Args({mode, batch_size, 100, 1, latency});
+}
+
+//=============================================================================
+//=============================================================================
+auto sweepAttributeName(int index) -> std::string
+{
+    return "tango://" + hdbpp_test::attr_name::TestAttrTangoHost + "/benchmark/sweep/member/attr-" +
+        std::to_string(index);
+}
+} // namespace
+
+//=============================================================================
+//=============================================================================
+void runBatchSweep(benchmark::State &state)
+{
+    hdbpp_internal::LogConfigurator::initLogging("test");
+    hdbpp_benchmark::clearTables();
+
+    auto mode = static_cast<SweepMode>(state.range(0));
+    auto batch_size = static_cast<int>(state.range(1));
+    auto attributes = static_cast<int>(state.range(2));
+    auto array_size = static_cast<int>(state.range(3));
+    auto link_latency = std::chrono::microseconds(state.range(4));
+
+    hdbpp_internal::AttributeTraits traits {
+        Tango::READ, array_size > 1 ? Tango::SPECTRUM : Tango::SCALAR, Tango::DEV_DOUBLE};
+
+    DbConnection conn(
+        mode == UnbufferedPrepared ? DbConnection::DbStoreMethod::PreparedStatement : DbConnection::DbStoreMethod::InsertString);
+
+    auto connect_string = hdbpp_test::psql_connection::postgres_db::HdbppConnectionString;
+    std::unique_ptr<hdbpp_benchmark::LatencyProxy> proxy;
+
+    if (link_latency.count() > 0)
+    {
+        hdbpp_benchmark::LatencyProxyConfig proxy_config;
+        proxy_config.latency = link_latency;
+        proxy = hdbpp_benchmark::LatencyProxy::forConnectString(connect_string, proxy_config);
+        connect_string = proxy->routeConnectString(connect_string);
+    }
+
+    conn.connect(connect_string);
+
+    std::vector<std::string> names;
+
+    for (int i = 0; i < attributes; i++)
+    {
+        names.push_back(sweepAttributeName(i));
+
+        conn.storeAttribute(names.back(),
+            hdbpp_test::attr_name::TestAttrCs,
+            "benchmark",
+            "sweep",
+            "member",
+            "attr-" + std::to_string(i),
+            0,
+            traits);
+    }
+
+    // the data is generated once, only the store is measured
+    auto value = hdbpp_test::data_gen::generateSpectrumData<Tango::DEV_DOUBLE>(false, array_size);
+    hdbpp_internal::DataSpan<double> value_r(*value);
+    hdbpp_internal::DataSpan<double> value_w;
+
+    // every event needs a unique time per attribute, so advance a simulated
+    // clock by a microsecond for every event
+    struct timeval tv
+    {};
+
+    gettimeofday(&tv, nullptr);
+    double event_time = tv.tv_sec + tv.tv_usec / 1.0e6;
+
+    conn.buffer(mode == Buffered);
+    hdbpp_internal::LatencyHistogram latency;
+
+    for (auto _ : state)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < batch_size; i++)
+        {
+            event_time += 1.0e-6;
+            conn.storeDataEvent(names[i % attributes], event_time, Tango::ATTR_VALID, value_r, value_w, traits);
+        }
+
+        if (mode == Buffered)
+            conn.flush();
+
+        auto end = std::chrono::steady_clock::now();
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    conn.buffer(false);
+    conn.disconnect();
+
+    state.SetItemsProcessed(state.iterations() * batch_size);
+    hdbpp_benchmark::reportLatency(state, "flush", latency);
+}
+
+//=============================================================================
+//=============================================================================
+void bmDbBatchSweep(benchmark::State &state)
+{
+    // TEST - Store batches of double events with the given store mode, batch size,
+    // attribute count and array size (1 is a scalar)
+    runBatchSweep(state);
+}
+
+//=============================================================================
+//=============================================================================
+void bmDbBatchSweepAsyncCommit(benchmark::State &state)
+{
+    // TEST - As bmDbBatchSweep, but with synchronous_commit disabled on the server, to
+    // show how much of the per transaction cost is waiting on the wal flush. Requires
+    // the ephemeral database
+    hdbpp_benchmark::ServerSettingsScope settings(state, {{"synchronous_commit", "off"}});
+
+    if (settings.applied())
+        runBatchSweep(state);
+}
+
+BENCHMARK(bmDbBatchSweep)->Apply(sweepArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(bmDbBatchSweep)->Apply(remoteSweepArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(bmDbBatchSweepAsyncCommit)->Apply(remoteSweepArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,140 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "BenchmarkHelpers.hpp"
+
+#include "PostgresFixture.hpp"
+#include "QueryBuilder.hpp"
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+namespace hdbpp_benchmark
+{
+namespace
+{
+    //=============================================================================
+    //=============================================================================
+    auto ephemeralDatabase() -> std::unique_ptr<hdbpp_test::postgres_fixture::EphemeralPostgres> &
+    {
+        static auto server = hdbpp_test::postgres_fixture::useEphemeralDatabase();
+        return server;
+    }
+} // namespace
+
+//=============================================================================
+//=============================================================================
+void ensureDatabase()
+{
+    ephemeralDatabase();
+}
+
+//=============================================================================
+//=============================================================================
+void clearTables()
+{
+    ensureDatabase();
+
+    auto conn = make_unique<pqxx::connection>(hdbpp_test::psql_connection::postgres_db::HdbppConnectionString);
+
+    auto traits_array = hdbpp_test::utils::getTraits();
+
+    {
+        auto query = string("TRUNCATE ");
+
+        pqxx::work tx {*conn};
+
+        for (auto &traits : traits_array)
+        {
+            query += hdbpp_internal::pqxx_conn::QueryBuilder::tableName(traits);
+            query += ",";
+        }
+
+        query += hdbpp_internal::pqxx_conn::schema::ErrTableName + ",";
+        query += hdbpp_internal::pqxx_conn::schema::ParamTableName + ",";
+        query += hdbpp_internal::pqxx_conn::schema::HistoryEventTableName + ",";
+        query += hdbpp_internal::pqxx_conn::schema::HistoryTableName + ",";
+        query += hdbpp_internal::pqxx_conn::schema::ConfTableName + " RESTART IDENTITY";
+
+        tx.exec(query);
+        tx.commit();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+ServerSettingsScope::ServerSettingsScope(benchmark::State &state, const std::map<std::string, std::string> &settings)
+{
+    ensureDatabase();
+    auto &server = ephemeralDatabase();
+
+    if (!server)
+    {
+        state.SkipWithError(("Server settings require the ephemeral database, set " +
+            hdbpp_test::postgres_fixture::EnableEnvVar)
+                                .c_str());
+        return;
+    }
+
+    for (auto &setting : settings)
+        _previous[setting.first] = server->setting(setting.first);
+
+    server->applySettings(settings);
+    _applied = true;
+}
+
+//=============================================================================
+//=============================================================================
+ServerSettingsScope::~ServerSettingsScope()
+{
+    if (!_applied)
+        return;
+
+    try
+    {
+        ephemeralDatabase()->applySettings(_previous);
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << "Unable to restore server settings: " << e.what() << std::endl;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void reportPerEvent(benchmark::State &state, const std::string &name, uint64_t total, int64_t events)
+{
+    state.counters[name] = benchmark::Counter(events > 0 ? static_cast<double>(total) / events : 0.0);
+}
+
+//=============================================================================
+//=============================================================================
+void reportLatency(benchmark::State &state, const std::string &prefix, const hdbpp_internal::LatencyHistogram &histogram)
+{
+    auto to_us = [](uint64_t ns) { return benchmark::Counter(static_cast<double>(ns) / 1000.0); };
+
+    state.counters[prefix + "_p50_us"] = to_us(histogram.percentile(50.0));
+    state.counters[prefix + "_p99_us"] = to_us(histogram.percentile(99.0));
+    state.counters[prefix + "_p999_us"] = to_us(histogram.percentile(99.9));
+    state.counters[prefix + "_max_us"] = to_us(histogram.max());
+}
+
+} // namespace hdbpp_benchmark
@@ -0,0 +1,83 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _BENCHMARK_HELPERS_HPP
+#define _BENCHMARK_HELPERS_HPP
+
+#include "AttributeTraits.hpp"
+#include "LatencyHistogram.hpp"
+#include "TestHelpers.hpp"
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace hdbpp_benchmark
+{
+// start the ephemeral benchmark database when enabled (see PostgresFixture.hpp), this
+// is done once, on first use, and the server remains until the benchmarks exit
+void ensureDatabase();
+
+// truncate all the hdb++ tables in the benchmark database, calls ensureDatabase() first
+void clearTables();
+
+// change server settings (i.e. synchronous_commit) for a benchmark, until the returned
+// scope is destroyed, when the settings revert to their previous values. This requires
+// the ephemeral database, without it the benchmark is skipped with an error and
+// false is returned from applied()
+class ServerSettingsScope
+{
+public:
+    ServerSettingsScope(benchmark::State &state, const std::map<std::string, std::string> &settings);
+    ~ServerSettingsScope();
+
+    ServerSettingsScope(const ServerSettingsScope &) = delete;
+    auto operator=(const ServerSettingsScope &) -> ServerSettingsScope & = delete;
+
+    auto applied() const noexcept -> bool { return _applied; }
+
+private:
+    std::map<std::string, std::string> _previous;
+    bool _applied = false;
+};
+
+// add the standard test attribute to the given connection with the given traits,
+// works with the DbConnection and the benchmark connections
+template<typename Conn>
+void storeTestAttribute(Conn &conn, const hdbpp_internal::AttributeTraits &traits)
+{
+    conn.storeAttribute(hdbpp_test::attr_name::TestAttrFinalName,
+        hdbpp_test::attr_name::TestAttrCs,
+        hdbpp_test::attr_name::TestAttrDomain,
+        hdbpp_test::attr_name::TestAttrFamily,
+        hdbpp_test::attr_name::TestAttrMember,
+        hdbpp_test::attr_name::TestAttrName,
+        0,
+        traits);
+}
+
+// report the given totals as per event counters on the benchmark
+void reportPerEvent(benchmark::State &state, const std::string &name, uint64_t total, int64_t events);
+
+// report the p50/p99/p999 and max of a histogram of nanosecond latencies as counters
+// on the benchmark, in microseconds, each counter name is prefixed with prefix
+void reportLatency(benchmark::State &state, const std::string &prefix, const hdbpp_internal::LatencyHistogram &histogram);
+
+} // namespace hdbpp_benchmark
+#endif // _BENCHMARK_HELPERS_HPP
@@ -17,6 +17,7 @@
    You should have received a copy of the Lesser GNU General Public License
    along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include "BenchmarkHelpers.hpp"
 #include "DbConnection.hpp"
 #include "HdbppDefines.hpp"
 #include "QueryBuilder.hpp"
@@ -25,36 +26,6 @@
 #include <benchmark/benchmark.h>
 #include <memory>
 
-//=============================================================================
-//=============================================================================
-void clearTables()
-{
-    auto conn = make_unique<pqxx::connection>(hdbpp_test::psql_connection::postgres_db::HdbppConnectionString);
-
-    auto traits_array = hdbpp_test::utils::getTraits();
-
-    {
-        auto query = string("TRUNCATE ");
-
-        pqxx::work tx {*conn};
-
-        for (auto &traits : traits_array)
-        {
-            query += hdbpp_internal::pqxx_conn::QueryBuilder::tableName(traits);
-            query += ",";
-        }
-
-        query += hdbpp_internal::pqxx_conn::schema::ErrTableName + ",";
-        query += hdbpp_internal::pqxx_conn::schema::ParamTableName + ",";
-        query += hdbpp_internal::pqxx_conn::schema::HistoryEventTableName + ",";
-        query += hdbpp_internal::pqxx_conn::schema::HistoryTableName + ",";
-        query += hdbpp_internal::pqxx_conn::schema::ConfTableName + " RESTART IDENTITY";
-
-        tx.exec(query);
-        tx.commit();
-    }
-}
-
 //=============================================================================
 //=============================================================================
 template<Tango::CmdArgType Type, Tango::AttrDataFormat Format, int Size = 0>
@@ -117,7 +88,7 @@ void bmDbMultipleSQLInsert(benchmark::State &state)
     // TEST - Test the write speed when pushing a single event at a time
     // to the database. This version inserts via strings
     hdbpp_internal::LogConfigurator::initLogging("test");
-    clearTables();
+    hdbpp_benchmark::clearTables();
 
     hdbpp_internal::AttributeTraits traits {Tango::READ, Format, Type};
 
@@ -202,7 +173,7 @@ void bmDbMultiplePreparedStatementInsert(benchmark::State &state)
     // TEST - Test the write speed when pushing a single event at a time
     // to the database. This version inserts via prepared statements
     hdbpp_internal::LogConfigurator::initLogging("test");
-    clearTables();
+    hdbpp_benchmark::clearTables();
 
     hdbpp_internal::AttributeTraits traits {Tango::READ, Format, Type};
 
@@ -306,7 +277,7 @@ void bmDbBatchedInsert(benchmark::State &state)
     // TEST - Test the write speed when pushing a multiple events at once to
     // the db
     hdbpp_internal::LogConfigurator::initLogging("test");
-    clearTables();
+    hdbpp_benchmark::clearTables();
 
     hdbpp_internal::AttributeTraits traits {Tango::READ, Format, Type};
 
@@ -395,7 +366,7 @@ void bmDbSingleSQLInsert(benchmark::State &state)
 {
     // TEST - Test the write speed when pushing a single event via sql
     hdbpp_internal::LogConfigurator::initLogging("test");
-    clearTables();
+    hdbpp_benchmark::clearTables();
 
     hdbpp_internal::AttributeTraits traits {Tango::READ, Format, Type};
 
@@ -477,7 +448,7 @@ void bmDbSinglePreparedStatementInsert(benchmark::State &state)
 {
     // TEST - Test the write speed when pushing a single event via sql
     hdbpp_internal::LogConfigurator::initLogging("test");
-    clearTables();
+    hdbpp_benchmark::clearTables();
 
     hdbpp_internal::AttributeTraits traits {Tango::READ, Format, Type};
 
@@ -0,0 +1,173 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "EventGenerator.hpp"
+
+#include "TestHelpers.hpp"
+
+#include <cassert>
+#include <sys/time.h>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+namespace hdbpp_benchmark
+{
+//=============================================================================
+//=============================================================================
+EventGenerator::EventGenerator(const EventGeneratorConfig &config) : _config(config), _gen(config.seed)
+{
+    if (_config.traits.empty())
+        _config.traits = hdbpp_test::utils::getTraitsImplemented();
+
+    for (auto &traits : _config.traits)
+    {
+        for (int i = 0; i < _config.attributes_per_traits; i++)
+        {
+            GeneratedAttribute attr;
+            attr.traits = traits;
+
+            // give each attribute a unique, valid, name. The family and member
+            // describe the traits to help when browsing the database afterwards
+            attr.fqdn_attr_name = "tango://" + hdbpp_test::attr_name::TestAttrTangoHost + "/" + _config.domain +
+                "/type-" + to_string(static_cast<int>(traits.type())) + "/format-" +
+                to_string(static_cast<int>(traits.formatType())) + "-write-" +
+                to_string(static_cast<int>(traits.writeType())) + "/attr-" + to_string(i);
+
+            attr.data_type.attr_name = attr.fqdn_attr_name;
+            attr.data_type.max_dim_x = traits.isScalar() ? 1 : _config.array_size;
+            attr.data_type.max_dim_y = 0;
+            attr.data_type.data_type = static_cast<int>(traits.type());
+            attr.data_type.data_format = traits.formatType();
+            attr.data_type.write_type = static_cast<int>(traits.writeType());
+
+            string event = "archive";
+            Tango::DevErrorList no_errors;
+
+            // the event takes ownership of the DeviceAttribute
+            attr.data_event = make_unique<Tango::EventData>(nullptr,
+                attr.fqdn_attr_name,
+                event,
+                new Tango::DeviceAttribute(hdbpp_test::data_gen::createDeviceAttribute(traits, _config.array_size)),
+                no_errors);
+
+            // error events still carry an (empty) attribute, the library reads the quality from it
+            Tango::DevErrorList errors;
+            errors.length(1);
+            errors[0].reason = CORBA::string_dup("API_AttributeFailed");
+            errors[0].desc = CORBA::string_dup("Generated error event: the device failed to read the attribute");
+            errors[0].origin = CORBA::string_dup("EventGenerator");
+
+            auto error_attr = new Tango::DeviceAttribute();
+            error_attr->quality = Tango::ATTR_INVALID;
+            attr.error_event = make_unique<Tango::EventData>(nullptr, attr.fqdn_attr_name, event, error_attr, errors);
+            attr.error_event->err = true;
+
+            _attributes.push_back(move(attr));
+        }
+    }
+
+    // start the clock at the current time
+    struct timeval tv
+    {};
+
+    gettimeofday(&tv, nullptr);
+    _event_time.tv_sec = tv.tv_sec;
+    _event_time.tv_usec = tv.tv_usec;
+    _event_time.tv_nsec = 0;
+}
+
+//=============================================================================
+//=============================================================================
+void EventGenerator::addAttributes(hdbpp::AbstractDB &db) const
+{
+    for (auto &attr : _attributes)
+    {
+        db.add_attribute(attr.fqdn_attr_name,
+            static_cast<int>(attr.traits.type()),
+            static_cast<int>(attr.traits.formatType()),
+            static_cast<int>(attr.traits.writeType()));
+    }
+}
+
+//=============================================================================
+//=============================================================================
+auto EventGenerator::next() -> Event
+{
+    auto &attr = _attributes[_next_attribute];
+    _next_attribute = (_next_attribute + 1) % _attributes.size();
+
+    if (_config.error_ratio > 0.0 && _dist(_gen) < _config.error_ratio)
+        return make_tuple(attr.error_event.get(), attr.data_type);
+
+    auto *value = attr.data_event->attr_value;
+    value->time = nextEventTime();
+    value->quality = pickQuality();
+    return make_tuple(attr.data_event.get(), attr.data_type);
+}
+
+//=============================================================================
+//=============================================================================
+auto EventGenerator::nextBatch(size_t size) -> vector<Event>
+{
+    assert(size <= _attributes.size());
+
+    vector<Event> events;
+    events.reserve(size);
+
+    for (size_t i = 0; i < size; i++)
+        events.push_back(next());
+
+    return events;
+}
+
+//=============================================================================
+//=============================================================================
+auto EventGenerator::pickQuality() -> Tango::AttrQuality
+{
+    if (_config.alarm_ratio <= 0.0 && _config.warning_ratio <= 0.0 && _config.invalid_ratio <= 0.0)
+        return Tango::ATTR_VALID;
+
+    auto pick = _dist(_gen);
+
+    if (pick < _config.alarm_ratio)
+        return Tango::ATTR_ALARM;
+
+    if (pick < _config.alarm_ratio + _config.warning_ratio)
+        return Tango::ATTR_WARNING;
+
+    if (pick < _config.alarm_ratio + _config.warning_ratio + _config.invalid_ratio)
+        return Tango::ATTR_INVALID;
+
+    return Tango::ATTR_VALID;
+}
+
+//=============================================================================
+//=============================================================================
+auto EventGenerator::nextEventTime() -> Tango::TimeVal
+{
+    if (++_event_time.tv_usec >= 1000000)
+    {
+        _event_time.tv_usec = 0;
+        _event_time.tv_sec++;
+    }
+
+    return _event_time;
+}
+
+} // namespace hdbpp_benchmark
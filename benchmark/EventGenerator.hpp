@@ -0,0 +1,117 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _EVENT_GENERATOR_HPP
+#define _EVENT_GENERATOR_HPP
+
+#include "AttributeTraits.hpp"
+
+#include <hdb++/AbstractDB.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <tango.h>
+#include <tuple>
+#include <vector>
+
+namespace hdbpp_benchmark
+{
+// Configuration for the EventGenerator. The quality ratios are applied to the
+// data events only, any event not picked as alarm, warning or invalid is valid.
+struct EventGeneratorConfig
+{
+    // the attribute types to generate events for, each traits gets attributes_per_traits
+    // distinct attributes. Defaults to every type/format/write type the library implements
+    std::vector<hdbpp_internal::AttributeTraits> traits;
+    int attributes_per_traits = 1;
+
+    // number of elements in each spectrum, for both read and write data
+    int array_size = 16;
+
+    // fraction of events that are error events, 0.0 - 1.0
+    double error_ratio = 0.0;
+
+    // fraction of data events with the given quality, 0.0 - 1.0
+    double alarm_ratio = 0.0;
+    double warning_ratio = 0.0;
+    double invalid_ratio = 0.0;
+
+    // seed for the event selection, so runs are repeatable
+    unsigned int seed = 42;
+
+    // the domain of the generated attribute names, generators sharing a database at
+    // the same time must use different domains
+    std::string domain = "benchmark";
+};
+
+// Builds realistic Tango::EventData objects, backed by DeviceAttributes, for the
+// configured attributes, so the public api (insert_event/insert_events) can be
+// benchmarked as an archiver would drive it. All the event data is generated
+// up front, so the cost of generating data is not included in the timings. The
+// events are reused, next() simply picks an attribute (round robin), decides between
+// data or error, sets the quality and stamps a unique, increasing event time.
+class EventGenerator
+{
+public:
+    using Event = std::tuple<Tango::EventData *, hdbpp::HdbEventDataType>;
+
+    EventGenerator(const EventGeneratorConfig &config);
+
+    // add every generated attribute to the given database
+    void addAttributes(hdbpp::AbstractDB &db) const;
+
+    // get the next event, the event remains owned by the generator and is
+    // valid until the same attribute is picked again
+    auto next() -> Event;
+
+    // get a batch of events, suitable for insert_events(). The batch must not be
+    // larger than the number of attributes, since events are reused
+    auto nextBatch(std::size_t size) -> std::vector<Event>;
+
+    // number of distinct attributes the generator produces events for
+    auto attributeCount() const noexcept -> std::size_t { return _attributes.size(); }
+
+private:
+    struct GeneratedAttribute
+    {
+        std::string fqdn_attr_name;
+        hdbpp_internal::AttributeTraits traits;
+        hdbpp::HdbEventDataType data_type;
+
+        // one event carrying data, and one carrying an error
+        std::unique_ptr<Tango::EventData> data_event;
+        std::unique_ptr<Tango::EventData> error_event;
+    };
+
+    auto pickQuality() -> Tango::AttrQuality;
+    auto nextEventTime() -> Tango::TimeVal;
+
+    EventGeneratorConfig _config;
+    std::vector<GeneratedAttribute> _attributes;
+    std::size_t _next_attribute = 0;
+
+    // simulated clock, advanced by a microsecond per event so every event has a
+    // unique time, regardless of how quickly they are generated
+    Tango::TimeVal _event_time {};
+
+    std::mt19937 _gen;
+    std::uniform_real_distribution<double> _dist {0.0, 1.0};
+};
+
+} // namespace hdbpp_benchmark
+#endif // _EVENT_GENERATOR_HPP
@@ -0,0 +1,547 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "LatencyProxy.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+using Clock = std::chrono::steady_clock;
+
+namespace hdbpp_benchmark
+{
+namespace
+{
+    // how often blocked threads check if the proxy is shutting down
+    const int PollTimeoutMs = 100;
+    const size_t ChunkSize = 64 * 1024;
+
+    //=============================================================================
+    //=============================================================================
+    void setNoDelay(int fd)
+    {
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto connectTo(const string &host, int port) -> int
+    {
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo *results = nullptr;
+        auto port_str = to_string(port);
+
+        if (getaddrinfo(host.c_str(), port_str.c_str(), &hints, &results) != 0)
+            throw runtime_error("LatencyProxy: unable to resolve upstream host: " + host);
+
+        int fd = -1;
+
+        for (auto *addr = results; addr != nullptr; addr = addr->ai_next)
+        {
+            fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+
+            if (fd < 0)
+                continue;
+
+            if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0)
+                break;
+
+            close(fd);
+            fd = -1;
+        }
+
+        freeaddrinfo(results);
+
+        if (fd < 0)
+            throw runtime_error("LatencyProxy: unable to connect to upstream: " + host + ":" + port_str);
+
+        setNoDelay(fd);
+        return fd;
+    }
+} // namespace
+
+// Forwards one direction of a proxied connection. The reader thread timestamps each
+// chunk of data with the time it may be delivered, and the writer thread sends it
+// on once that time is reached.
+class Link
+{
+public:
+    Link(int src_fd, int dst_fd, const LatencyProxyConfig &config, unsigned int seed, const atomic<bool> &running) :
+        _src_fd(src_fd),
+        _dst_fd(dst_fd),
+        _config(config),
+        _gen(seed),
+        _running(running),
+        _reader([this]() { readLoop(); }),
+        _writer([this]() { writeLoop(); })
+    {}
+
+    ~Link()
+    {
+        _stop = true;
+        _cv.notify_all();
+        _reader.join();
+        _writer.join();
+    }
+
+    auto finished() const noexcept -> bool { return _finished; }
+
+private:
+    struct Chunk
+    {
+        Clock::time_point deliver;
+        vector<char> data;
+    };
+
+    auto stopping() const noexcept -> bool { return _stop || !_running; }
+    void readLoop();
+    void writeLoop();
+    auto deliveryTime(size_t bytes) -> Clock::time_point;
+
+    int _src_fd;
+    int _dst_fd;
+    LatencyProxyConfig _config;
+    mt19937 _gen;
+    const atomic<bool> &_running;
+
+    // time the simulated link is next free to send, for the bandwidth cap
+    Clock::time_point _link_free;
+    Clock::time_point _last_deliver;
+
+    mutex _lock;
+    condition_variable _cv;
+    deque<Chunk> _queue;
+    bool _eof = false;
+
+    atomic<bool> _stop {false};
+    atomic<bool> _finished {false};
+
+    thread _reader;
+    thread _writer;
+};
+
+//=============================================================================
+//=============================================================================
+auto Link::deliveryTime(size_t bytes) -> Clock::time_point
+{
+    auto now = Clock::now();
+
+    if (_config.bandwidth > 0)
+    {
+        // the chunk can not start sending until the previous one has finished
+        auto start = max(now, _link_free);
+        _link_free = start + chrono::microseconds(bytes * 1000000 / _config.bandwidth);
+        now = _link_free;
+    }
+
+    auto deliver = now + _config.latency;
+
+    if (_config.jitter.count() > 0)
+    {
+        uniform_int_distribution<int64_t> dist(0, _config.jitter.count());
+        deliver += chrono::microseconds(dist(_gen));
+    }
+
+    // a tcp stream is never reordered, so jitter can only delay data further
+    _last_deliver = max(deliver, _last_deliver);
+    return _last_deliver;
+}
+
+//=============================================================================
+//=============================================================================
+void Link::readLoop()
+{
+    vector<char> buffer(ChunkSize);
+
+    while (!stopping())
+    {
+        pollfd pfd {_src_fd, POLLIN, 0};
+        auto ready = poll(&pfd, 1, PollTimeoutMs);
+
+        if (ready == 0 || (ready < 0 && errno == EINTR))
+            continue;
+
+        auto bytes = ready < 0 ? -1 : recv(_src_fd, buffer.data(), buffer.size(), 0);
+
+        if (bytes < 0 && errno == EINTR)
+            continue;
+
+        lock_guard<mutex> lock(_lock);
+
+        if (bytes <= 0)
+        {
+            _eof = true;
+            _cv.notify_all();
+            return;
+        }
+
+        _queue.push_back(Chunk {deliveryTime(bytes), vector<char>(buffer.begin(), buffer.begin() + bytes)});
+        _cv.notify_all();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void Link::writeLoop()
+{
+    unique_lock<mutex> lock(_lock);
+
+    while (!stopping())
+    {
+        if (_queue.empty())
+        {
+            if (_eof)
+            {
+                // pass on the close, so the peer sees the same stream
+                shutdown(_dst_fd, SHUT_WR);
+                break;
+            }
+
+            _cv.wait_for(lock, chrono::milliseconds(PollTimeoutMs));
+            continue;
+        }
+
+        if (Clock::now() < _queue.front().deliver)
+        {
+            _cv.wait_until(lock, _queue.front().deliver);
+            continue;
+        }
+
+        auto chunk = move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+
+        size_t sent = 0;
+
+        while (sent < chunk.data.size())
+        {
+            auto bytes = send(_dst_fd, chunk.data.data() + sent, chunk.data.size() - sent, MSG_NOSIGNAL);
+
+            if (bytes < 0 && errno == EINTR)
+                continue;
+
+            if (bytes <= 0)
+            {
+                // the peer has gone, nothing more can be delivered
+                _finished = true;
+                return;
+            }
+
+            sent += bytes;
+        }
+
+        lock.lock();
+    }
+
+    _finished = true;
+}
+
+// A single proxied connection, the client and upstream sockets, with a link in each direction
+struct LatencyProxy::Connection
+{
+    Connection(int client, int upstream, const LatencyProxyConfig &config, unsigned int seed, const atomic<bool> &running) :
+        client_fd(client),
+        upstream_fd(upstream),
+        to_upstream(make_unique<Link>(client, upstream, config, seed, running)),
+        to_client(make_unique<Link>(upstream, client, config, seed + 1, running))
+    {}
+
+    ~Connection()
+    {
+        // stop the links before closing the sockets they use
+        to_upstream.reset();
+        to_client.reset();
+        close(client_fd);
+        close(upstream_fd);
+    }
+
+    auto finished() const noexcept -> bool { return to_upstream->finished() && to_client->finished(); }
+
+    int client_fd;
+    int upstream_fd;
+    unique_ptr<Link> to_upstream;
+    unique_ptr<Link> to_client;
+};
+
+//=============================================================================
+//=============================================================================
+LatencyProxy::LatencyProxy(const string &upstream_host, int upstream_port, const LatencyProxyConfig &config) :
+    _upstream_host(upstream_host), _upstream_port(upstream_port), _config(config)
+{
+    _listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (_listen_fd < 0)
+        throw runtime_error("LatencyProxy: unable to create listen socket: " + string(strerror(errno)));
+
+    int reuse = 1;
+    setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // bind to an ephemeral port on the loopback interface only
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    socklen_t len = sizeof(addr);
+
+    if (bind(_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(_listen_fd, 16) != 0 ||
+        getsockname(_listen_fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+    {
+        close(_listen_fd);
+        throw runtime_error("LatencyProxy: unable to listen: " + string(strerror(errno)));
+    }
+
+    _port = ntohs(addr.sin_port);
+    _accept_thread = thread([this]() { acceptLoop(); });
+}
+
+//=============================================================================
+//=============================================================================
+LatencyProxy::~LatencyProxy()
+{
+    _running = false;
+    _accept_thread.join();
+    reapConnections(true);
+    close(_listen_fd);
+}
+
+//=============================================================================
+//=============================================================================
+auto LatencyProxy::forConnectString(const string &connect_string, const LatencyProxyConfig &config)
+    -> unique_ptr<LatencyProxy>
+{
+    // default to the libpq defaults (for a tcp connection)
+    auto host = connect_string::value(connect_string, "host");
+    auto port = connect_string::value(connect_string, "port");
+
+    return make_unique<LatencyProxy>(host.empty() ? "localhost" : host, port.empty() ? 5432 : stoi(port), config);
+}
+
+//=============================================================================
+//=============================================================================
+auto LatencyProxy::routeConnectString(const string &connect_string) const -> string
+{
+    auto routed = connect_string::withValue(connect_string, "host", "127.0.0.1");
+
+    // hostaddr takes precedence over host in libpq, so it must point at the proxy as well
+    if (!connect_string::value(routed, "hostaddr").empty())
+        routed = connect_string::withValue(routed, "hostaddr", "127.0.0.1");
+
+    return connect_string::withValue(routed, "port", to_string(_port));
+}
+
+//=============================================================================
+//=============================================================================
+void LatencyProxy::acceptLoop()
+{
+    unsigned int seed = _config.seed;
+
+    while (_running)
+    {
+        pollfd pfd {_listen_fd, POLLIN, 0};
+
+        if (poll(&pfd, 1, PollTimeoutMs) <= 0)
+            continue;
+
+        auto client_fd = accept(_listen_fd, nullptr, nullptr);
+
+        if (client_fd < 0)
+            continue;
+
+        setNoDelay(client_fd);
+
+        int upstream_fd = -1;
+
+        try
+        {
+            upstream_fd = connectTo(_upstream_host, _upstream_port);
+        }
+        catch (const runtime_error &)
+        {
+            // the client will see the connection close, as it would if the
+            // database was not there
+            close(client_fd);
+            continue;
+        }
+
+        reapConnections(false);
+
+        lock_guard<mutex> lock(_connections_lock);
+        _connections.push_back(make_unique<Connection>(client_fd, upstream_fd, _config, seed, _running));
+        seed += 2;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void LatencyProxy::reapConnections(bool all)
+{
+    lock_guard<mutex> lock(_connections_lock);
+
+    _connections.erase(remove_if(_connections.begin(),
+                           _connections.end(),
+                           [all](const unique_ptr<Connection> &conn) { return all || conn->finished(); }),
+        _connections.end());
+}
+
+namespace connect_string
+{
+    namespace
+    {
+        struct Parameter
+        {
+            string keyword;
+            string value;
+        };
+
+        //=============================================================================
+        //=============================================================================
+        auto parse(const string &connect_string) -> vector<Parameter>
+        {
+            vector<Parameter> params;
+            size_t pos = 0;
+
+            auto skip_space = [&]() {
+                while (pos < connect_string.size() && isspace(connect_string[pos]))
+                    pos++;
+            };
+
+            while (true)
+            {
+                skip_space();
+
+                if (pos >= connect_string.size())
+                    break;
+
+                Parameter param;
+
+                while (pos < connect_string.size() && connect_string[pos] != '=' && !isspace(connect_string[pos]))
+                    param.keyword += connect_string[pos++];
+
+                skip_space();
+
+                if (pos >= connect_string.size() || connect_string[pos] != '=')
+                    throw runtime_error("Invalid connection string, missing \"=\" after: " + param.keyword);
+
+                pos++;
+                skip_space();
+
+                // values may be single quoted, with backslash escapes
+                if (pos < connect_string.size() && connect_string[pos] == '\'')
+                {
+                    pos++;
+
+                    while (pos < connect_string.size() && connect_string[pos] != '\'')
+                    {
+                        if (connect_string[pos] == '\\' && pos + 1 < connect_string.size())
+                            pos++;
+
+                        param.value += connect_string[pos++];
+                    }
+
+                    pos++;
+                }
+                else
+                {
+                    while (pos < connect_string.size() && !isspace(connect_string[pos]))
+                        param.value += connect_string[pos++];
+                }
+
+                params.push_back(param);
+            }
+
+            return params;
+        }
+
+        //=============================================================================
+        //=============================================================================
+        auto quote(const string &value) -> string
+        {
+            if (!value.empty() && value.find_first_of(" \t'\\") == string::npos)
+                return value;
+
+            string quoted = "'";
+
+            for (auto c : value)
+            {
+                if (c == '\'' || c == '\\')
+                    quoted += '\\';
+
+                quoted += c;
+            }
+
+            return quoted + "'";
+        }
+    } // namespace
+
+    //=============================================================================
+    //=============================================================================
+    auto value(const string &connect_string, const string &keyword) -> string
+    {
+        for (auto &param : parse(connect_string))
+            if (param.keyword == keyword)
+                return param.value;
+
+        return "";
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto withValue(const string &connect_string, const string &keyword, const string &value) -> string
+    {
+        auto params = parse(connect_string);
+        auto found = false;
+
+        for (auto &param : params)
+        {
+            if (param.keyword == keyword)
+            {
+                param.value = value;
+                found = true;
+            }
+        }
+
+        if (!found)
+            params.push_back(Parameter {keyword, value});
+
+        string result;
+
+        for (auto &param : params)
+            result += (result.empty() ? "" : " ") + param.keyword + "=" + quote(param.value);
+
+        return result;
+    }
+} // namespace connect_string
+} // namespace hdbpp_benchmark
@@ -0,0 +1,109 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _LATENCY_PROXY_HPP
+#define _LATENCY_PROXY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hdbpp_benchmark
+{
+// Network conditions applied by the LatencyProxy, in each direction
+struct LatencyProxyConfig
+{
+    // one way delay added to every chunk of data, so the round trip time
+    // seen by the client is increased by twice this value
+    std::chrono::microseconds latency {0};
+
+    // a random delay, uniformly distributed between 0 and jitter, added to the
+    // latency. Data is never reordered, as it could not be on a tcp stream
+    std::chrono::microseconds jitter {0};
+
+    // maximum bytes per second in each direction, 0 is unlimited
+    uint64_t bandwidth = 0;
+
+    unsigned int seed = 42;
+};
+
+// A small in-process tcp proxy that adds latency, jitter and a bandwidth cap to the
+// traffic between the library and the database. The benchmark database is usually
+// on localhost, where round trips are nearly free, routing the connection through
+// this proxy makes the cost of round trips (per event commits, prepared statement
+// checks etc) visible, as it would be to an archiver a few milliseconds from its
+// database. The proxy listens on an ephemeral port on the loopback interface, and
+// forwards each connection to the upstream host/port. It is intended for
+// benchmarks only.
+class LatencyProxy
+{
+public:
+    LatencyProxy(const std::string &upstream_host, int upstream_port, const LatencyProxyConfig &config);
+    ~LatencyProxy();
+
+    LatencyProxy(const LatencyProxy &) = delete;
+    auto operator=(const LatencyProxy &) -> LatencyProxy & = delete;
+
+    // create a proxy to the host/port given in a libpq connection string
+    static auto forConnectString(const std::string &connect_string, const LatencyProxyConfig &config)
+        -> std::unique_ptr<LatencyProxy>;
+
+    // the port the proxy is listening on
+    auto port() const noexcept -> int { return _port; }
+
+    // rewrite the host and port of a libpq connection string so it connects via this proxy
+    auto routeConnectString(const std::string &connect_string) const -> std::string;
+
+private:
+    struct Connection;
+
+    void acceptLoop();
+    void reapConnections(bool all);
+
+    std::string _upstream_host;
+    int _upstream_port;
+    LatencyProxyConfig _config;
+
+    int _listen_fd = -1;
+    int _port = 0;
+
+    std::atomic<bool> _running {true};
+    std::thread _accept_thread;
+
+    std::mutex _connections_lock;
+    std::vector<std::unique_ptr<Connection>> _connections;
+};
+
+// Parse/modify libpq keyword/value connection strings, i.e. "user=postgres host=localhost port=5432"
+namespace connect_string
+{
+    // get the value of the given keyword, or an empty string if it is not set
+    auto value(const std::string &connect_string, const std::string &keyword) -> std::string;
+
+    // set the value of the given keyword, adding it when not present
+    auto withValue(const std::string &connect_string, const std::string &keyword, const std::string &value)
+        -> std::string;
+} // namespace connect_string
+
+} // namespace hdbpp_benchmark
+#endif // _LATENCY_PROXY_HPP
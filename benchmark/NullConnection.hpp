@@ -0,0 +1,289 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _NULL_CONNECTION_HPP
+#define _NULL_CONNECTION_HPP
+
+#include "AttributeTraits.hpp"
+#include "ConnectionBase.hpp"
+#include "DataSpan.hpp"
+#include "HdbppTxFactory.hpp"
+#include "QueryBuilder.hpp"
+#include "StageTimer.hpp"
+
+#include <benchmark/benchmark.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hdbpp_benchmark
+{
+// A connection that implements the full storage API used by the transaction classes,
+// but does nothing with the data it is given (other than ensure the compiler can not
+// optimise the call away). Driving the transaction classes with this connection
+// measures the cost of validation and extraction only. Every attribute is reported
+// as archived, with the traits given at construction.
+class NullConnection : public hdbpp_internal::ConnectionBase,
+                       public hdbpp_internal::HdbppTxFactory<NullConnection>
+{
+public:
+    NullConnection(const hdbpp_internal::AttributeTraits &traits = {}) : _traits(traits) {}
+
+    // connection API
+    void connect(const std::string & /* connect_string */) override { _connected = true; }
+    void disconnect() override { _connected = false; }
+    auto isOpen() const noexcept -> bool override { return _connected; }
+    auto isClosed() const noexcept -> bool override { return !isOpen(); }
+
+    // the stages are not timed
+    auto stageTimers() const noexcept -> hdbpp_internal::StageTimers * { return nullptr; }
+
+    void buffer(bool /* enable */) {}
+    void flush() {}
+
+    // storage API
+    void storeAttribute(const std::string & /* full_attr_name */,
+        const std::string & /* control_system */,
+        const std::string & /* att_domain */,
+        const std::string & /* att_family */,
+        const std::string & /* att_member */,
+        const std::string & /* att_name */,
+        unsigned int /* ttl */,
+        const hdbpp_internal::AttributeTraits & /* traits */)
+    {}
+
+    void storeHistoryEvent(const std::string & /* full_attr_name */, const std::string & /* event */) {}
+
+    void storeParameterEvent(const std::string & /* full_attr_name */,
+        double /* event_time */,
+        const std::string & /* label */,
+        const std::vector<std::string> & /* enum_labels */,
+        const std::string & /* unit */,
+        const std::string & /* standard_unit */,
+        const std::string & /* display_unit */,
+        const std::string & /* format */,
+        const std::string & /* archive_rel_change */,
+        const std::string & /* archive_abs_change */,
+        const std::string & /* archive_period */,
+        const std::string & /* description */)
+    {}
+
+    template<typename T>
+    void storeDataEvent(const std::string & /* full_attr_name */,
+        double /* event_time */,
+        int /* quality */,
+        const hdbpp_internal::DataSpan<T> &value_r,
+        const hdbpp_internal::DataSpan<T> &value_w,
+        const hdbpp_internal::AttributeTraits & /* traits */)
+    {
+        auto size_r = value_r.size();
+        auto size_w = value_w.size();
+        benchmark::DoNotOptimize(size_r);
+        benchmark::DoNotOptimize(size_w);
+    }
+
+    void storeDataEventError(const std::string & /* full_attr_name */,
+        double /* event_time */,
+        int /* quality */,
+        const std::string & /* error_msg */,
+        const hdbpp_internal::AttributeTraits & /* traits */)
+    {}
+
+    void storeAttributeTtl(const std::string & /* full_attr_name */, unsigned int /* ttl */) {}
+
+    // fetch API
+    auto fetchLastHistoryEvent(const std::string & /* full_attr_name */) -> std::string { return {}; }
+    auto fetchAttributeArchived(const std::string & /* full_attr_name */) -> bool { return true; }
+
+    auto fetchAttributeTraits(const std::string & /* full_attr_name */) -> hdbpp_internal::AttributeTraits
+    {
+        return _traits;
+    }
+
+private:
+    hdbpp_internal::AttributeTraits _traits;
+    bool _connected = true;
+};
+
+// A connection that implements the full storage API, serialising each request
+// into sql in the same way DbConnection does when buffering (via the QueryBuilder
+// string functions), and recording the result. Attributes, history events and
+// error messages are tracked in memory, so the transaction classes behave as they
+// would against a database. Driving the transaction classes with this connection
+// measures the cost of extraction and serialisation, without the database.
+class RecordingConnection : public hdbpp_internal::ConnectionBase,
+                            public hdbpp_internal::HdbppTxFactory<RecordingConnection>
+{
+public:
+    // connection API
+    void connect(const std::string & /* connect_string */) override { _connected = true; }
+    void disconnect() override { _connected = false; }
+    auto isOpen() const noexcept -> bool override { return _connected; }
+    auto isClosed() const noexcept -> bool override { return !isOpen(); }
+
+    // the stages are not timed
+    auto stageTimers() const noexcept -> hdbpp_internal::StageTimers * { return nullptr; }
+
+    void buffer(bool /* enable */) {}
+
+    void flush()
+    {
+        _sql.clear();
+        _bytes = 0;
+    }
+
+    // storage API
+    void storeAttribute(const std::string &full_attr_name,
+        const std::string & /* control_system */,
+        const std::string & /* att_domain */,
+        const std::string & /* att_family */,
+        const std::string & /* att_member */,
+        const std::string & /* att_name */,
+        unsigned int ttl,
+        const hdbpp_internal::AttributeTraits &traits)
+    {
+        auto id = static_cast<int>(_attributes.size()) + 1;
+        _attributes[full_attr_name] = Attribute {id, ttl, traits, {}};
+        record("INSERT INTO " + hdbpp_internal::pqxx_conn::schema::ConfTableName + " VALUES ('" + full_attr_name + "')");
+    }
+
+    void storeHistoryEvent(const std::string &full_attr_name, const std::string &event)
+    {
+        _attributes[full_attr_name].last_event = event;
+        record("INSERT INTO " + hdbpp_internal::pqxx_conn::schema::HistoryTableName + " VALUES ('" + event + "')");
+    }
+
+    void storeParameterEvent(const std::string &full_attr_name,
+        double event_time,
+        const std::string &label,
+        const std::vector<std::string> &enum_labels,
+        const std::string &unit,
+        const std::string &standard_unit,
+        const std::string &display_unit,
+        const std::string &format,
+        const std::string &archive_rel_change,
+        const std::string &archive_abs_change,
+        const std::string &archive_period,
+        const std::string &description)
+    {
+        record(hdbpp_internal::pqxx_conn::QueryBuilder::storeParameterEventString(id(full_attr_name),
+            pqxx::to_string(event_time),
+            label,
+            enum_labels,
+            unit,
+            standard_unit,
+            display_unit,
+            format,
+            archive_rel_change,
+            archive_abs_change,
+            archive_period,
+            description));
+    }
+
+    template<typename T>
+    void storeDataEvent(const std::string &full_attr_name,
+        double event_time,
+        int quality,
+        const hdbpp_internal::DataSpan<T> &value_r,
+        const hdbpp_internal::DataSpan<T> &value_w,
+        const hdbpp_internal::AttributeTraits &traits)
+    {
+        record(hdbpp_internal::pqxx_conn::QueryBuilder::storeDataEventString<T>(
+            id(full_attr_name), pqxx::to_string(event_time), pqxx::to_string(quality), value_r, value_w, traits));
+    }
+
+    void storeDataEventError(const std::string &full_attr_name,
+        double event_time,
+        int quality,
+        const std::string &error_msg,
+        const hdbpp_internal::AttributeTraits &traits)
+    {
+        auto error = _errors.find(error_msg);
+
+        if (error == _errors.end())
+            error = _errors.emplace(error_msg, static_cast<int>(_errors.size()) + 1).first;
+
+        record(hdbpp_internal::pqxx_conn::QueryBuilder::storeDataEventErrorString(id(full_attr_name),
+            pqxx::to_string(event_time),
+            pqxx::to_string(quality),
+            pqxx::to_string(error->second),
+            traits));
+    }
+
+    void storeAttributeTtl(const std::string &full_attr_name, unsigned int ttl)
+    {
+        _attributes[full_attr_name].ttl = ttl;
+        record("UPDATE " + hdbpp_internal::pqxx_conn::schema::ConfTableName + " SET ttl=" + pqxx::to_string(ttl));
+    }
+
+    // fetch API
+    auto fetchLastHistoryEvent(const std::string &full_attr_name) -> std::string
+    {
+        auto attr = _attributes.find(full_attr_name);
+        return attr == _attributes.end() ? std::string() : attr->second.last_event;
+    }
+
+    auto fetchAttributeArchived(const std::string &full_attr_name) -> bool
+    {
+        return _attributes.find(full_attr_name) != _attributes.end();
+    }
+
+    auto fetchAttributeTraits(const std::string &full_attr_name) -> hdbpp_internal::AttributeTraits
+    {
+        auto attr = _attributes.find(full_attr_name);
+        return attr == _attributes.end() ? hdbpp_internal::AttributeTraits() : attr->second.traits;
+    }
+
+    // access to the recorded sql, this is cleared on flush()
+    auto sql() const noexcept -> const std::vector<std::string> & { return _sql; }
+
+    // total number of bytes of sql recorded since the last flush()
+    auto bytes() const noexcept -> std::size_t { return _bytes; }
+
+private:
+    struct Attribute
+    {
+        int id;
+        unsigned int ttl;
+        hdbpp_internal::AttributeTraits traits;
+        std::string last_event;
+    };
+
+    auto id(const std::string &full_attr_name) -> std::string
+    {
+        // unknown attributes are given id 0, the tx classes do not check this
+        auto attr = _attributes.find(full_attr_name);
+        return pqxx::to_string(attr == _attributes.end() ? 0 : attr->second.id);
+    }
+
+    void record(std::string query)
+    {
+        query += ";";
+        _bytes += query.size();
+        _sql.push_back(std::move(query));
+    }
+
+    std::map<std::string, Attribute> _attributes;
+    std::map<std::string, int> _errors;
+    std::vector<std::string> _sql;
+    std::size_t _bytes = 0;
+    bool _connected = true;
+};
+
+} // namespace hdbpp_benchmark
+#endif // _NULL_CONNECTION_HPP
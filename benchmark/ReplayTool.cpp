@@ -0,0 +1,253 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "EventCapture.hpp"
+#include "HdbppTimescaleDbApi.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+namespace
+{
+struct ReplayOptions
+{
+    string capture_file;
+    string connect_string;
+
+    // 1.0 is the original speed, 0 replays as fast as possible
+    double speed = 1.0;
+
+    // by default the event times are moved to the time of the replay
+    bool original_times = false;
+
+    // skip the add_attribute calls, when replaying into a populated database
+    bool skip_add = false;
+};
+
+struct ReplayStats
+{
+    LatencyHistogram latency;
+    uint64_t failures = 0;
+    uint64_t events = 0;
+};
+
+//=============================================================================
+//=============================================================================
+void usage(const char *name)
+{
+    cout << "Usage: " << name << " [options] <capture file> <connect string>\n"
+         << "Replays a capture file made with the capture_file configuration parameter\n"
+         << "into the given database.\n\n"
+         << "Options:\n"
+         << "  --speed N          replay at N times the original speed (default 1)\n"
+         << "  --max              replay as fast as possible, same as --speed 0\n"
+         << "  --original-times   keep the captured event times, rather than moving them to now\n"
+         << "  --skip-add         do not replay add_attribute calls\n";
+}
+
+//=============================================================================
+//=============================================================================
+auto parseOptions(int argc, char **argv, ReplayOptions &options) -> bool
+{
+    vector<string> positional;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+
+        if (arg == "--speed" && i + 1 < argc)
+            options.speed = stod(argv[++i]);
+        else if (arg == "--max")
+            options.speed = 0.0;
+        else if (arg == "--original-times")
+            options.original_times = true;
+        else if (arg == "--skip-add")
+            options.skip_add = true;
+        else if (arg.compare(0, 2, "--") == 0)
+            return false;
+        else
+            positional.push_back(arg);
+    }
+
+    if (positional.size() != 2 || options.speed < 0.0)
+        return false;
+
+    options.capture_file = positional[0];
+    options.connect_string = positional[1];
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+auto recordName(capture::CaptureRecordType type) -> string
+{
+    switch (type)
+    {
+        case capture::CaptureRecordType::AddAttribute: return "add_attribute";
+        case capture::CaptureRecordType::InsertEvent: return "insert_event";
+        case capture::CaptureRecordType::InsertEvents: return "insert_events";
+        case capture::CaptureRecordType::ParamEvent: return "insert_param_event";
+        case capture::CaptureRecordType::HistoryEvent: return "insert_history_event";
+        case capture::CaptureRecordType::UpdateTtl: return "update_ttl";
+    }
+
+    return "unknown";
+}
+
+//=============================================================================
+//=============================================================================
+void replay(hdbpp::HdbppTimescaleDbApi &db, CaptureRecord &record)
+{
+    switch (record.type)
+    {
+        case capture::CaptureRecordType::AddAttribute:
+            db.add_attribute(record.attr_name, record.data_type, record.data_format, record.write_type);
+            break;
+
+        case capture::CaptureRecordType::InsertEvent:
+            db.insert_event(record.events[0].get(), record.event_types[0]);
+            break;
+
+        case capture::CaptureRecordType::InsertEvents: db.insert_events(record.eventTuples()); break;
+
+        case capture::CaptureRecordType::ParamEvent:
+            db.insert_param_event(record.param_event.get(), hdbpp::HdbEventDataType());
+            break;
+
+        case capture::CaptureRecordType::HistoryEvent:
+            db.insert_history_event(record.attr_name, record.history_event);
+            break;
+
+        case capture::CaptureRecordType::UpdateTtl: db.update_ttl(record.attr_name, record.ttl); break;
+    }
+}
+} // namespace
+
+//=============================================================================
+//=============================================================================
+int main(int argc, char **argv)
+{
+    ReplayOptions options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        EventCaptureReader reader(options.capture_file);
+
+        if (!options.original_times)
+        {
+            struct timeval tv
+            {};
+
+            gettimeofday(&tv, nullptr);
+            reader.shiftEventTimes(tv.tv_sec + tv.tv_usec / 1.0e6 - reader.startTime());
+        }
+
+        hdbpp::HdbppTimescaleDbApi db("replay-tool", {"connect_string=" + options.connect_string, "logging_level=error"});
+
+        map<capture::CaptureRecordType, ReplayStats> stats;
+        CaptureRecord record;
+        uint64_t records = 0;
+        auto start = chrono::steady_clock::now();
+
+        while (reader.next(record))
+        {
+            if (options.skip_add && record.type == capture::CaptureRecordType::AddAttribute)
+                continue;
+
+            // hold each call back until its place in the original timeline
+            if (options.speed > 0.0)
+            {
+                auto due = start +
+                    chrono::duration_cast<chrono::steady_clock::duration>(
+                        chrono::duration<double, nano>(record.offset.count() / options.speed));
+
+                this_thread::sleep_until(due);
+            }
+
+            auto &type_stats = stats[record.type];
+            auto call_start = chrono::steady_clock::now();
+
+            try
+            {
+                replay(db, record);
+            }
+            catch (Tango::DevFailed &)
+            {
+                type_stats.failures++;
+            }
+
+            type_stats.latency.record(static_cast<uint64_t>(
+                chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - call_start).count()));
+
+            type_stats.events += record.type == capture::CaptureRecordType::InsertEvents ? record.events.size() : 1;
+            records++;
+        }
+
+        auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "Replayed " << records << " calls in " << elapsed << " seconds\n\n";
+
+        printf("%-22s %10s %10s %10s %10s %10s %10s %10s\n",
+            "call",
+            "calls",
+            "events",
+            "failures",
+            "p50_us",
+            "p99_us",
+            "p999_us",
+            "max_us");
+
+        for (auto &entry : stats)
+        {
+            auto &latency = entry.second.latency;
+
+            printf("%-22s %10lu %10lu %10lu %10.1f %10.1f %10.1f %10.1f\n",
+                recordName(entry.first).c_str(),
+                static_cast<unsigned long>(latency.count()),
+                static_cast<unsigned long>(entry.second.events),
+                static_cast<unsigned long>(entry.second.failures),
+                latency.percentile(50.0) / 1000.0,
+                latency.percentile(99.0) / 1000.0,
+                latency.percentile(99.9) / 1000.0,
+                latency.max() / 1000.0);
+        }
+    }
+    catch (Tango::DevFailed &e)
+    {
+        cerr << "Replay failed: " << string(e.errors[0].desc) << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "BenchmarkHelpers.hpp"
+#include "HdbppTxDataEvent.hpp"
+#include "HdbppTxDataEventError.hpp"
+#include "HdbppTxParameterEvent.hpp"
+#include "NullConnection.hpp"
+#include "TestHelpers.hpp"
+
+#include <benchmark/benchmark.h>
+
+// These benchmarks drive the transaction layer with the NullConnection and RecordingConnection,
+// so they measure the library CPU cost of storing an event without a database. The Null
+// variants measure validation and extraction only, the Recording variants add serialisation
+// to sql. The array size is given as the benchmark argument.
+
+//=============================================================================
+//=============================================================================
+static void arraySizeArgs(benchmark::internal::Benchmark *b)
+{
+    for (auto size : {1, 16, 128, 1024, 8192})
+        b->Arg(size);
+}
+
+//=============================================================================
+//=============================================================================
+template<Tango::CmdArgType Type>
+static auto bytesPerEvent(const hdbpp_internal::AttributeTraits &traits, int size) -> int64_t
+{
+    // for strings this is only an approximation (the size of the std::string objects)
+    using T = typename hdbpp_test::data_gen::TangoTypeTraits<Type>::type;
+    auto parts = (traits.hasReadData() ? 1 : 0) + (traits.hasWriteData() ? 1 : 0);
+    return static_cast<int64_t>(sizeof(T)) * parts * (traits.isScalar() ? 1 : size);
+}
+
+//=============================================================================
+//=============================================================================
+static auto recordedBytes(const hdbpp_benchmark::NullConnection &) -> int64_t
+{
+    return 0;
+}
+
+//=============================================================================
+//=============================================================================
+static auto recordedBytes(const hdbpp_benchmark::RecordingConnection &conn) -> int64_t
+{
+    return static_cast<int64_t>(conn.bytes());
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Conn, Tango::CmdArgType Type, Tango::AttrDataFormat Format>
+void bmTxDataEvent(benchmark::State &state)
+{
+    // TEST - Throughput of a single data event, from a Tango DeviceAttribute, through
+    // HdbppTxDataEvent, to the connection
+    hdbpp_internal::LogConfigurator::initLogging("test");
+
+    auto size = static_cast<int>(state.range(0));
+    hdbpp_internal::AttributeTraits traits {Tango::READ_WRITE, Format, Type};
+
+    auto attr = hdbpp_test::data_gen::createDeviceAttribute(traits, size);
+    Conn conn;
+    hdbpp_benchmark::storeTestAttribute(conn, traits);
+
+    Tango::TimeVal tv {};
+    int64_t events = 0;
+    int64_t sql_bytes = 0;
+
+    for (auto _ : state)
+    {
+        conn.template createTx<hdbpp_internal::HdbppTxDataEvent>()
+            .withName(hdbpp_test::attr_name::TestAttrFQDName)
+            .withTraits(traits)
+            .withAttribute(&attr)
+            .withMaxDims(size, 0)
+            .withEventTime(tv)
+            .withQuality(Tango::ATTR_VALID)
+            .store();
+
+        // flush in batches, as the library does, this stops the recording
+        // connection growing over the whole run
+        if (++events % 1000 == 0)
+        {
+            sql_bytes += recordedBytes(conn);
+            conn.flush();
+        }
+    }
+
+    sql_bytes += recordedBytes(conn);
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * bytesPerEvent<Type>(traits, size));
+    hdbpp_benchmark::reportPerEvent(state, "sql_bytes_per_event", sql_bytes, state.iterations());
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Conn>
+void bmTxDataEventError(benchmark::State &state)
+{
+    // TEST - Throughput of a single error event through HdbppTxDataEventError
+    hdbpp_internal::LogConfigurator::initLogging("test");
+    hdbpp_internal::AttributeTraits traits {Tango::READ, Tango::SCALAR, Tango::DEV_DOUBLE};
+
+    Conn conn;
+    hdbpp_benchmark::storeTestAttribute(conn, traits);
+
+    Tango::TimeVal tv {};
+    int64_t events = 0;
+
+    for (auto _ : state)
+    {
+        conn.template createTx<hdbpp_internal::HdbppTxDataEventError>()
+            .withName(hdbpp_test::attr_name::TestAttrFQDName)
+            .withTraits(traits)
+            .withError("An error message that repeats, as most errors do")
+            .withEventTime(tv)
+            .withQuality(Tango::ATTR_VALID)
+            .store();
+
+        if (++events % 1000 == 0)
+            conn.flush();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Conn>
+void bmTxParameterEvent(benchmark::State &state)
+{
+    // TEST - Throughput of a single parameter event through HdbppTxParameterEvent
+    hdbpp_internal::LogConfigurator::initLogging("test");
+    hdbpp_internal::AttributeTraits traits {Tango::READ, Tango::SCALAR, Tango::DEV_DOUBLE};
+
+    Conn conn;
+    hdbpp_benchmark::storeTestAttribute(conn, traits);
+
+    Tango::AttributeInfoEx info;
+    info.label = hdbpp_test::attr_info::AttrInfoLabel;
+    info.enum_labels = hdbpp_test::attr_info::AttrInfoEnumLabels;
+    info.unit = hdbpp_test::attr_info::AttrInfoUnit;
+    info.standard_unit = hdbpp_test::attr_info::AttrInfoStandardUnit;
+    info.display_unit = hdbpp_test::attr_info::AttrInfoDisplayUnit;
+    info.format = hdbpp_test::attr_info::AttrInfoFormat;
+    info.description = hdbpp_test::attr_info::AttrInfoDescription;
+    info.events.arch_event.archive_rel_change = hdbpp_test::attr_info::AttrInfoRel;
+    info.events.arch_event.archive_abs_change = hdbpp_test::attr_info::AttrInfoAbs;
+    info.events.arch_event.archive_period = hdbpp_test::attr_info::AttrInfoPeriod;
+
+    Tango::TimeVal tv {};
+    int64_t events = 0;
+
+    for (auto _ : state)
+    {
+        conn.template createTx<hdbpp_internal::HdbppTxParameterEvent>()
+            .withName(hdbpp_test::attr_name::TestAttrFQDName)
+            .withAttrInfo(info)
+            .withEventTime(tv)
+            .store();
+
+        if (++events % 1000 == 0)
+            conn.flush();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+using hdbpp_benchmark::NullConnection;
+using hdbpp_benchmark::RecordingConnection;
+
+BENCHMARK_TEMPLATE(bmTxDataEvent, NullConnection, Tango::DEV_DOUBLE, Tango::SCALAR)->Arg(1);
+BENCHMARK_TEMPLATE(bmTxDataEvent, NullConnection, Tango::DEV_STRING, Tango::SCALAR)->Arg(1);
+BENCHMARK_TEMPLATE(bmTxDataEvent, NullConnection, Tango::DEV_STATE, Tango::SCALAR)->Arg(1);
+BENCHMARK_TEMPLATE(bmTxDataEvent, NullConnection, Tango::DEV_BOOLEAN, Tango::SPECTRUM)->Apply(arraySizeArgs);
+BENCHMARK_TEMPLATE(bmTxDataEvent, NullConnection, Tango::DEV_LONG, Tango::SPECTRUM)->Apply(arraySizeArgs);
+BENCHMARK_TEMPLATE(bmTxDataEvent, NullConnection, Tango::DEV_DOUBLE, Tango::SPECTRUM)->Apply(arraySizeArgs);
+BENCHMARK_TEMPLATE(bmTxDataEvent, NullConnection, Tango::DEV_STRING, Tango::SPECTRUM)->Apply(arraySizeArgs);
+
+BENCHMARK_TEMPLATE(bmTxDataEvent, RecordingConnection, Tango::DEV_DOUBLE, Tango::SCALAR)->Arg(1);
+BENCHMARK_TEMPLATE(bmTxDataEvent, RecordingConnection, Tango::DEV_STRING, Tango::SCALAR)->Arg(1);
+BENCHMARK_TEMPLATE(bmTxDataEvent, RecordingConnection, Tango::DEV_STATE, Tango::SCALAR)->Arg(1);
+BENCHMARK_TEMPLATE(bmTxDataEvent, RecordingConnection, Tango::DEV_BOOLEAN, Tango::SPECTRUM)->Apply(arraySizeArgs);
+BENCHMARK_TEMPLATE(bmTxDataEvent, RecordingConnection, Tango::DEV_LONG, Tango::SPECTRUM)->Apply(arraySizeArgs);
+BENCHMARK_TEMPLATE(bmTxDataEvent, RecordingConnection, Tango::DEV_DOUBLE, Tango::SPECTRUM)->Apply(arraySizeArgs);
+BENCHMARK_TEMPLATE(bmTxDataEvent, RecordingConnection, Tango::DEV_STRING, Tango::SPECTRUM)->Apply(arraySizeArgs);
+
+BENCHMARK_TEMPLATE(bmTxDataEventError, NullConnection);
+BENCHMARK_TEMPLATE(bmTxDataEventError, RecordingConnection);
+
+BENCHMARK_TEMPLATE(bmTxParameterEvent, NullConnection);
+BENCHMARK_TEMPLATE(bmTxParameterEvent, RecordingConnection);
@@ -21,7 +21,13 @@
 #define _HDBPP_TIMESCALE_CLIENT_HPP
 
 #include "hdb++/AbstractDB.h"
+#include "hdb++/HdbAttributeHandle.h"
+#include "hdb++/HdbEventStatus.h"
+#include "hdb++/HdbStats.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
@@ -41,9 +47,74 @@ public:
     void insert_event(Tango::EventData *event, const HdbEventDataType &data_type) override;
 
     // Insert multiple attribute archive events. Any attributes that do not exist will
-    // cause an exception. On failure the fall back is to insert events individually
+    // cause an exception. On failure the fall back is to insert events individually.
+    // With the pipeline (pipeline_batch_size) batches are sent, and commit, while the call
+    // is still running, so when an event fails after a batch was sent, the events of that
+    // batch stay stored, and the exception says how many
     void insert_events(std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events) override;
 
+    // Insert multiple attribute archive events, returning the status of each event (ok,
+    // unknown attribute, conversion error or database error) in the same order. Failed
+    // events can then be retried or dropped without re-sending the batch. Only a failure
+    // of the connection itself raises an exception
+    std::vector<HdbEventStatus> insert_events_status(
+        std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events);
+
+    // Asynchronous inserts queue the events to be stored and return at once, so a Tango
+    // event callback need not wait for the database. The events are copied, so they may be
+    // released as soon as the call returns. Once the events are committed (or have failed)
+    // the future is given their statuses, as returned by insert_events_status(), or the
+    // callback is run, from the library's storage thread, so it should not block, and must
+    // not call the synchronous inserts, which raise an exception there. Events still queued
+    // are stored before the client is destroyed. Only supported in thread safe mode (the
+    // thread_safe config parameter), otherwise an exception is raised
+    std::future<HdbEventStatus> insert_event_async(Tango::EventData *event, const HdbEventDataType &data_type);
+
+    std::future<std::vector<HdbEventStatus>> insert_events_async(
+        std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events);
+
+    void insert_events_async(
+        std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events, HdbInsertCallback callback);
+
+    // Resolve an attribute that has already been added to the database to a handle for the
+    // typed store API below. The name and attribute traits are looked up once here, rather
+    // than for every event. Resolving an attribute that is not archived raises an exception
+    HdbAttributeHandle attribute_handle(const std::string &name);
+
+    // The typed store API stores values directly from the caller's memory, bypassing the
+    // Tango::EventData and DeviceAttribute decoding entirely, for data sources that already
+    // hold plain values. T must match the attribute type: bool, int16_t (DEV_SHORT and
+    // DEV_ENUM), int32_t, int64_t, float, double, uint8_t, uint16_t, uint32_t, uint64_t,
+    // std::string or Tango::DevState. The time is in microseconds since the epoch, and the
+    // quality is a Tango::AttrQuality. The write value is ignored for read only attributes,
+    // and when it is not given the event is stored without one (NULL), rather than a default
+    // set point. These calls are not recorded by the event capture
+    template<typename T>
+    void store_scalar(HdbAttributeHandle handle, int64_t time_us, int quality, const T &value_r);
+
+    template<typename T>
+    void store_scalar(HdbAttributeHandle handle, int64_t time_us, int quality, const T &value_r, const T &value_w);
+
+    // Store a spectrum or image event, the values are not copied. A size of zero stores no
+    // data for that part of the event
+    template<typename T>
+    void store_array(HdbAttributeHandle handle,
+        int64_t time_us,
+        int quality,
+        const T *value_r,
+        std::size_t size_r,
+        const T *value_w = nullptr,
+        std::size_t size_w = 0);
+
+    // Store an error event for the attribute
+    void store_error(HdbAttributeHandle handle, int64_t time_us, int quality, const std::string &error_msg);
+
+    // Typed stores made between begin_batch() and end_batch() are buffered, then sent to
+    // the database together by end_batch(), in the same way as insert_events(). If a store
+    // raises an exception, end_batch() must still be called to close the batch
+    void begin_batch();
+    void end_batch();
+
     // Inserts the attribute configuration data (Tango Attribute Configuration event data)
     // into the database. The attribute must be configured to be stored in HDB++,
     // otherwise an exception will be thrown.
@@ -64,6 +135,21 @@ public:
     // Check what hdbpp features this library supports.
     bool supported(HdbppFeatures feature) override;
 
+    // Turn the timing of the event storage stages (extract, cache_lookup, query_build,
+    // execute and commit) on or off. Can also be enabled with the stage_timing config parameter.
+    void enable_stage_timing(bool enable);
+
+    // Get the timing of each event storage stage since timing was enabled, or last reset
+    std::vector<HdbStageTiming> stage_timings();
+
+    // Clear the stage timings
+    void reset_stage_timings();
+
+    // Get the runtime counters and gauges: events stored and failed per type, batch sizes,
+    // flush durations, buffer depth, cache hits and misses, reconnects and retries.
+    // They can also be written to a Prometheus text file with the metrics_file config parameter.
+    HdbStats stats();
+
 private:
     std::unique_ptr<AbstractDB> _db;
 };
@@ -0,0 +1,66 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _HDBPP_TIMESCALE_EVENT_STATUS_H
+#define _HDBPP_TIMESCALE_EVENT_STATUS_H
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <vector>
+
+namespace hdbpp
+{
+// The result of storing a single event from a batch, see insert_events_status()
+enum class HdbEventStatus : uint8_t
+{
+    // the event was stored
+    Ok = 0,
+
+    // the attribute has not been added to the database, so the event was not stored
+    UnknownAttribute,
+
+    // the event could not be converted for storage, for example its data could not be
+    // extracted as the attribute type, so the event was not stored
+    ConversionError,
+
+    // the database rejected the event, or failed while looking up the data it needs
+    DbError
+};
+
+// the name of the status, eg "UnknownAttribute"
+inline auto hdbEventStatusName(HdbEventStatus status) -> const char *
+{
+    switch (status)
+    {
+        case HdbEventStatus::Ok: return "Ok";
+        case HdbEventStatus::UnknownAttribute: return "UnknownAttribute";
+        case HdbEventStatus::ConversionError: return "ConversionError";
+        case HdbEventStatus::DbError: return "DbError";
+    }
+
+    return "Unknown";
+}
+
+// Told the result of an asynchronous insert once the events are committed: the status of
+// each event, or when storing the events failed as a whole, the exception raised
+using HdbInsertCallback = std::function<void(const std::vector<HdbEventStatus> &statuses, std::exception_ptr error)>;
+
+} // namespace hdbpp
+#endif // _HDBPP_TIMESCALE_EVENT_STATUS_H
@@ -0,0 +1,114 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _HDBPP_TIMESCALE_STATS_H
+#define _HDBPP_TIMESCALE_STATS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hdbpp
+{
+// The timing of a single stage of the event storage path, see stage_timings(). The
+// stages are: extract, cache_lookup, query_build, execute and commit
+struct HdbStageTiming
+{
+    std::string stage;
+    uint64_t count = 0;
+    double mean_us = 0.0;
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+    double p999_us = 0.0;
+    double max_us = 0.0;
+};
+
+// Hit and miss counts for one of the id caches, a miss goes to the database
+struct HdbCacheStats
+{
+    std::string name;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// The load from a single attribute, see top_attributes in HdbStats. The event count is
+// an estimate, it may be over counted by up to max_overcount. The bytes and errors are
+// counted from when the attribute was last seen to be one of the busiest, so may be
+// under counted
+struct HdbAttributeLoad
+{
+    std::string name;
+    int att_conf_id = 0;
+    uint64_t events = 0;
+    uint64_t max_overcount = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+};
+
+// Runtime counters and gauges for a connection, see stats(). The counters are totals
+// since the library was started
+struct HdbStats
+{
+    // data and error events stored or failed, keyed by the Tango type name, eg DEV_DOUBLE
+    std::map<std::string, uint64_t> events_stored;
+    std::map<std::string, uint64_t> events_failed;
+
+    // the number of events stored that were error events
+    uint64_t error_events_stored = 0;
+
+    // buffered batches (insert_events) flushed to the database
+    uint64_t batches = 0;
+    uint64_t batch_events = 0;
+    uint64_t batch_size_p50 = 0;
+    uint64_t batch_size_max = 0;
+
+    // time taken to flush a batch to the database
+    double flush_mean_us = 0.0;
+    double flush_p50_us = 0.0;
+    double flush_p99_us = 0.0;
+    double flush_max_us = 0.0;
+
+    // events currently buffered, waiting for a flush
+    uint64_t buffer_depth = 0;
+
+    // the batch size and flush interval currently chosen by the batch controller, and the
+    // number of times it has increased and decreased them. Zero when it is disabled
+    uint64_t adaptive_batch_size = 0;
+    uint64_t adaptive_flush_interval_us = 0;
+    uint64_t adaptive_increases = 0;
+    uint64_t adaptive_decreases = 0;
+
+    std::vector<HdbCacheStats> caches;
+
+    // connections made after the first, and transactions retried after a broken connection
+    uint64_t reconnects = 0;
+    uint64_t retries = 0;
+
+    // set while the connection is lost, and the times the circuit breaker has opened to fail
+    // calls fast while the database is down
+    bool connection_lost = false;
+    uint64_t circuit_opens = 0;
+
+    // the attributes storing the most events, busiest first, only filled
+    // when attribute profiling is enabled
+    std::vector<HdbAttributeLoad> top_attributes;
+};
+
+} // namespace hdbpp
+#endif // _HDBPP_TIMESCALE_STATS_H
@@ -0,0 +1,224 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "AttributeProfiler.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+//=============================================================================
+//=============================================================================
+void AttributeProfiler::configure(size_t capacity, size_t top_n)
+{
+    lock_guard<mutex> guard(_lock);
+
+    _capacity = capacity;
+    _top_n = top_n;
+    _counters.clear();
+    _heap.clear();
+    _index.clear();
+
+    _counters.reserve(capacity);
+    _heap.reserve(capacity);
+    _index.reserve(capacity);
+
+    _enabled.store(capacity > 0, memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+void AttributeProfiler::record(int att_conf_id, const string &name, uint64_t bytes, bool error)
+{
+    lock_guard<mutex> guard(_lock);
+
+    if (_capacity == 0)
+        return;
+
+    auto iter = _index.find(att_conf_id);
+
+    if (iter != _index.end())
+    {
+        auto &load = _counters[iter->second].load;
+        load.events++;
+        load.bytes += bytes;
+        load.errors += error ? 1 : 0;
+
+        siftDown(_counters[iter->second].heap_position);
+        return;
+    }
+
+    if (_counters.size() < _capacity)
+    {
+        // a free counter, the new count of 1 is the lowest, so it is sifted to the top
+        Counter counter;
+        counter.load.name = name;
+        counter.load.att_conf_id = att_conf_id;
+        counter.load.events = 1;
+        counter.load.bytes = bytes;
+        counter.load.errors = error ? 1 : 0;
+        counter.heap_position = _heap.size();
+
+        _index[att_conf_id] = _counters.size();
+        _heap.push_back(_counters.size());
+        _counters.push_back(move(counter));
+
+        siftUp(_heap.size() - 1);
+        return;
+    }
+
+    // take over the counter with the lowest count, its count may all belong
+    // to this attribute, so it is kept as the possible over count
+    auto index = _heap[0];
+    auto &load = _counters[index].load;
+
+    _index.erase(load.att_conf_id);
+    _index[att_conf_id] = index;
+
+    load.name = name;
+    load.att_conf_id = att_conf_id;
+    load.max_overcount = load.events;
+    load.events++;
+    load.bytes = bytes;
+    load.errors = error ? 1 : 0;
+
+    siftDown(0);
+}
+
+//=============================================================================
+//=============================================================================
+auto AttributeProfiler::top() const -> vector<hdbpp::HdbAttributeLoad>
+{
+    vector<hdbpp::HdbAttributeLoad> loads;
+    size_t top_n = 0;
+
+    {
+        lock_guard<mutex> guard(_lock);
+        loads.reserve(_counters.size());
+
+        for (const auto &counter : _counters)
+            loads.push_back(counter.load);
+
+        top_n = min(_top_n, loads.size());
+    }
+
+    partial_sort(loads.begin(),
+        loads.begin() + top_n,
+        loads.end(),
+        [](const hdbpp::HdbAttributeLoad &first, const hdbpp::HdbAttributeLoad &second) {
+            return first.events > second.events;
+        });
+
+    loads.resize(top_n);
+    return loads;
+}
+
+//=============================================================================
+//=============================================================================
+void AttributeProfiler::reset()
+{
+    lock_guard<mutex> guard(_lock);
+    _counters.clear();
+    _heap.clear();
+    _index.clear();
+}
+
+//=============================================================================
+//=============================================================================
+void AttributeProfiler::log(const vector<hdbpp::HdbAttributeLoad> &loads)
+{
+    spdlog::info("Busiest attributes by events stored:");
+
+    for (const auto &load : loads)
+    {
+        spdlog::info("    {} (id: {}): events: {} (max over count: {}), bytes: {}, errors: {}",
+            load.name,
+            load.att_conf_id,
+            load.events,
+            load.max_overcount,
+            load.bytes,
+            load.errors);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void AttributeProfiler::siftUp(size_t position)
+{
+    while (position > 0)
+    {
+        auto parent = (position - 1) / 2;
+
+        if (count(parent) <= count(position))
+            break;
+
+        swap(parent, position);
+        position = parent;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void AttributeProfiler::siftDown(size_t position)
+{
+    while (true)
+    {
+        auto smallest = position;
+        auto left = 2 * position + 1;
+        auto right = left + 1;
+
+        if (left < _heap.size() && count(left) < count(smallest))
+            smallest = left;
+
+        if (right < _heap.size() && count(right) < count(smallest))
+            smallest = right;
+
+        if (smallest == position)
+            break;
+
+        swap(smallest, position);
+        position = smallest;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void AttributeProfiler::swap(size_t first, size_t second)
+{
+    std::swap(_heap[first], _heap[second]);
+    _counters[_heap[first]].heap_position = first;
+    _counters[_heap[second]].heap_position = second;
+}
+
+//=============================================================================
+//=============================================================================
+AttributeProfileLogger::AttributeProfileLogger(
+    chrono::seconds interval, function<vector<hdbpp::HdbAttributeLoad>()> top) :
+    _task(interval, [top]() { AttributeProfiler::log(top()); })
+{}
+
+//=============================================================================
+//=============================================================================
+AttributeProfileLogger::~AttributeProfileLogger() = default;
+
+} // namespace hdbpp_internal
@@ -0,0 +1,109 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _ATTRIBUTE_PROFILER_HPP
+#define _ATTRIBUTE_PROFILER_HPP
+
+#include "PeriodicTask.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <hdb++/HdbStats.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// Finds the attributes generating the most events, using the Space-Saving heavy hitters
+// algorithm. Only a fixed number of counters are kept, however many attributes are
+// archived. When an attribute without a counter arrives, it takes over the counter with
+// the lowest count, inheriting that count as its possible over count. Any attribute
+// with more than 1/capacity of the events is guaranteed to hold a counter.
+//
+// The counters are kept in a min heap, so an event costs a hash lookup and (at most)
+// a log(capacity) sift. Recording and reading are behind a lock, so top() can be
+// called from any thread.
+class AttributeProfiler
+{
+public:
+    // a capacity of zero disables the profiler
+    void configure(std::size_t capacity, std::size_t top_n);
+
+    auto enabled() const noexcept -> bool { return _enabled.load(std::memory_order_relaxed); }
+
+    // record an event of the given size for an attribute, error is set for an error event
+    void record(int att_conf_id, const std::string &name, uint64_t bytes, bool error);
+
+    // the top_n attributes by events, busiest first
+    auto top() const -> std::vector<hdbpp::HdbAttributeLoad>;
+
+    // clear all counters
+    void reset();
+
+    // write a report of the given attribute loads to the log
+    static void log(const std::vector<hdbpp::HdbAttributeLoad> &loads);
+
+private:
+    struct Counter
+    {
+        hdbpp::HdbAttributeLoad load;
+        std::size_t heap_position = 0;
+    };
+
+    void siftUp(std::size_t position);
+    void siftDown(std::size_t position);
+    void swap(std::size_t first, std::size_t second);
+
+    auto count(std::size_t position) const -> uint64_t { return _counters[_heap[position]].load.events; }
+
+    std::atomic<bool> _enabled {false};
+    std::size_t _capacity = 0;
+    std::size_t _top_n = 0;
+
+    mutable std::mutex _lock;
+
+    // the counters, a min heap of indexes into them by event count, and
+    // the counter index for each att_conf_id
+    std::vector<Counter> _counters;
+    std::vector<std::size_t> _heap;
+    std::unordered_map<int, std::size_t> _index;
+};
+
+// Periodically writes the busiest attributes to the log at info level, from a
+// background thread
+class AttributeProfileLogger
+{
+public:
+    AttributeProfileLogger(std::chrono::seconds interval, std::function<std::vector<hdbpp::HdbAttributeLoad>()> top);
+    ~AttributeProfileLogger();
+
+    AttributeProfileLogger(const AttributeProfileLogger &) = delete;
+    auto operator=(const AttributeProfileLogger &) -> AttributeProfileLogger & = delete;
+
+private:
+    PeriodicTask _task;
+};
+
+} // namespace hdbpp_internal
+#endif // _ATTRIBUTE_PROFILER_HPP
@@ -0,0 +1,100 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "BatchController.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+constexpr double BatchController::DecreaseFactor;
+
+//=============================================================================
+//=============================================================================
+void BatchController::configure(chrono::microseconds target_latency,
+    size_t min_batch_size,
+    size_t max_batch_size,
+    chrono::milliseconds max_flush_interval)
+{
+    _target_latency = target_latency;
+    _min_batch_size = max<size_t>(min_batch_size, 1);
+    _max_batch_size = max(max_batch_size, _min_batch_size);
+    _max_flush_interval = max_flush_interval;
+    _min_flush_interval = _max_flush_interval / 100;
+
+    // the additive steps reach the maximum from the minimum in around a hundred batches
+    _batch_step = max<size_t>((_max_batch_size - _min_batch_size) / 100, 1);
+    _flush_interval_step = max(_min_flush_interval, chrono::microseconds(1));
+
+    _batch_size = _max_batch_size;
+    _flush_interval = _max_flush_interval;
+    _increases = 0;
+    _decreases = 0;
+}
+
+//=============================================================================
+//=============================================================================
+auto BatchController::record(size_t batch_size, chrono::nanoseconds latency, bool failed) -> bool
+{
+    if (!enabled())
+        return false;
+
+    if (failed || latency > _target_latency)
+    {
+        // the batch was cut before the last decrease, so has already been accounted for
+        if (batch_size > _batch_size)
+            return false;
+
+        auto previous_size = _batch_size;
+        auto previous_interval = _flush_interval;
+
+        _batch_size = max(static_cast<size_t>(static_cast<double>(_batch_size) * DecreaseFactor), _min_batch_size);
+
+        _flush_interval = max(chrono::duration_cast<chrono::microseconds>(_flush_interval * DecreaseFactor),
+            _min_flush_interval);
+
+        if (_batch_size == previous_size && _flush_interval == previous_interval)
+            return false;
+
+        _decreases++;
+
+        spdlog::info("Batch of {} queries {} after {}us, reducing the batch size to {} and flush interval to {}us",
+            batch_size,
+            failed ? "failed" : "completed",
+            chrono::duration_cast<chrono::microseconds>(latency).count(),
+            _batch_size,
+            _flush_interval.count());
+
+        return true;
+    }
+
+    if (_batch_size == _max_batch_size && _flush_interval == _max_flush_interval)
+        return false;
+
+    _batch_size = min(_batch_size + _batch_step, _max_batch_size);
+    _flush_interval = min(_flush_interval + _flush_interval_step, _max_flush_interval);
+    _increases++;
+    return true;
+}
+
+} // namespace hdbpp_internal
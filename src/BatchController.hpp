@@ -0,0 +1,84 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _BATCH_CONTROLLER_HPP
+#define _BATCH_CONTROLLER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace hdbpp_internal
+{
+// Sizes the batches cut from the connection buffer to keep each flush under a latency
+// target. A fixed batch size is too large while the database stalls (chunk creation,
+// autovacuum) and too small when it is idle, so the size and flush interval adapt
+// AIMD style: each batch stored under the target grows them by a step, while a slow or
+// failed batch halves them. Batches cut before the last decrease are too large to say
+// anything new, so they are not allowed to decrease again, which stops the batches in
+// flight during a single stall collapsing the size to the minimum.
+//
+// Owned by a single DbConnection, so it is not thread safe.
+class BatchController
+{
+public:
+    // the multiplicative decrease applied to a slow or failed batch
+    static constexpr double DecreaseFactor = 0.5;
+
+    // a zero latency target disables the controller. The batch size and flush interval
+    // start at their maximum, and the minimum flush interval is a hundredth of the max
+    void configure(std::chrono::microseconds target_latency,
+        std::size_t min_batch_size,
+        std::size_t max_batch_size,
+        std::chrono::milliseconds max_flush_interval);
+
+    auto enabled() const noexcept -> bool { return _target_latency.count() > 0; }
+    auto targetLatency() const noexcept -> std::chrono::microseconds { return _target_latency; }
+
+    // the current decisions, a batch is cut once it holds batchSize() queries, or its
+    // first query has waited flushInterval()
+    auto batchSize() const noexcept -> std::size_t { return _batch_size; }
+    auto flushInterval() const noexcept -> std::chrono::microseconds { return _flush_interval; }
+
+    // record a stored batch of the given size, and how long it took. Returns true when
+    // the decisions changed
+    auto record(std::size_t batch_size, std::chrono::nanoseconds latency, bool failed) -> bool;
+
+    // the number of increases and decreases made
+    auto increases() const noexcept -> uint64_t { return _increases; }
+    auto decreases() const noexcept -> uint64_t { return _decreases; }
+
+private:
+    std::chrono::microseconds _target_latency {0};
+    std::size_t _min_batch_size = 1;
+    std::size_t _max_batch_size = 1;
+    std::size_t _batch_step = 1;
+    std::chrono::microseconds _min_flush_interval {0};
+    std::chrono::microseconds _max_flush_interval {0};
+    std::chrono::microseconds _flush_interval_step {0};
+
+    std::size_t _batch_size = 1;
+    std::chrono::microseconds _flush_interval {0};
+
+    uint64_t _increases = 0;
+    uint64_t _decreases = 0;
+};
+
+} // namespace hdbpp_internal
+#endif // _BATCH_CONTROLLER_HPP
@@ -0,0 +1,146 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _BUFFER_POOL_HPP
+#define _BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// A small free list of vectors for a single type. It is used to recycle the buffers
+// event data is extracted into, so a busy subscriber is not constantly allocating
+// and freeing vectors for each event. Each thread has its own pool (see threadPool()),
+// so no locking is required.
+template<typename T>
+class BufferPool
+{
+public:
+    // the maximum number of free buffers held by a pool, an event only
+    // needs two at once (read and write), so this is plenty
+    static constexpr std::size_t MaxFreeBuffers = 4;
+
+    // buffers larger than this are freed rather than kept, so a single large
+    // image does not pin its memory to the thread for ever
+    static constexpr std::size_t MaxBufferBytes = 1024 * 1024;
+
+    // RAII handle to a buffer taken from the pool, the buffer is returned
+    // to the pool when the handle is destroyed
+    class Buffer
+    {
+    public:
+        // an empty handle, not backed by a pool until assigned one
+        Buffer() = default;
+
+        Buffer(BufferPool<T> *pool, std::vector<T> &&buffer) : _pool(pool), _buffer(std::move(buffer)) {}
+        Buffer(Buffer &&other) noexcept : _pool(other._pool), _buffer(std::move(other._buffer))
+        {
+            other._pool = nullptr;
+        }
+
+        Buffer(const Buffer &) = delete;
+        auto operator=(const Buffer &) -> Buffer & = delete;
+
+        auto operator=(Buffer &&other) noexcept -> Buffer &
+        {
+            if (this != &other)
+            {
+                if (_pool != nullptr)
+                    _pool->release(std::move(_buffer));
+
+                _pool = other._pool;
+                _buffer = std::move(other._buffer);
+                other._pool = nullptr;
+            }
+
+            return *this;
+        }
+
+        ~Buffer()
+        {
+            if (_pool != nullptr)
+                _pool->release(std::move(_buffer));
+        }
+
+        auto get() noexcept -> std::vector<T> & { return _buffer; }
+
+    private:
+        BufferPool<T> *_pool = nullptr;
+        std::vector<T> _buffer;
+    };
+
+    // get an empty buffer with at least the requested capacity reserved
+    auto acquire(std::size_t capacity) -> Buffer;
+
+    // the number of free buffers currently held
+    auto size() const noexcept -> std::size_t { return _free.size(); }
+
+    // the pool for the calling thread
+    static auto threadPool() -> BufferPool<T> &
+    {
+        static thread_local BufferPool<T> pool;
+        return pool;
+    }
+
+private:
+    void release(std::vector<T> &&buffer);
+
+    std::vector<std::vector<T>> _free;
+};
+
+template<typename T>
+constexpr std::size_t BufferPool<T>::MaxFreeBuffers;
+
+template<typename T>
+constexpr std::size_t BufferPool<T>::MaxBufferBytes;
+
+//=============================================================================
+//=============================================================================
+template<typename T>
+auto BufferPool<T>::acquire(std::size_t capacity) -> Buffer
+{
+    std::vector<T> buffer;
+
+    if (!_free.empty())
+    {
+        buffer = std::move(_free.back());
+        _free.pop_back();
+    }
+
+    buffer.reserve(capacity);
+    return Buffer(this, std::move(buffer));
+}
+
+//=============================================================================
+//=============================================================================
+template<typename T>
+void BufferPool<T>::release(std::vector<T> &&buffer)
+{
+    // clear keeps the capacity, so the next user need not allocate
+    if (_free.size() < MaxFreeBuffers && buffer.capacity() * sizeof(T) <= MaxBufferBytes)
+    {
+        buffer.clear();
+        _free.push_back(std::move(buffer));
+    }
+}
+
+} // namespace hdbpp_internal
+#endif // _BUFFER_POOL_HPP
@@ -0,0 +1,102 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "CircuitBreaker.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+//=============================================================================
+//=============================================================================
+CircuitBreaker::CircuitBreaker() : _random(random_device {}()) {}
+
+//=============================================================================
+//=============================================================================
+void CircuitBreaker::configure(
+    size_t failure_threshold, chrono::milliseconds base_backoff, chrono::milliseconds max_backoff)
+{
+    _failure_threshold = max<size_t>(failure_threshold, 1);
+    _base_backoff = max(base_backoff, chrono::milliseconds(1));
+    _max_backoff = max(max_backoff, _base_backoff);
+    success();
+}
+
+//=============================================================================
+//=============================================================================
+auto CircuitBreaker::allow(Clock::time_point now) -> bool
+{
+    if (_state != State::Open)
+        return true;
+
+    if (now < _retry_at)
+        return false;
+
+    _state = State::HalfOpen;
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+void CircuitBreaker::success() noexcept
+{
+    _state = State::Closed;
+    _failures = 0;
+    _backoff = _base_backoff;
+}
+
+//=============================================================================
+//=============================================================================
+void CircuitBreaker::failure(Clock::time_point now)
+{
+    _failures++;
+
+    if (_state != State::HalfOpen && _failures < _failure_threshold)
+        return;
+
+    // equal jitter, wait between half and all of the backoff
+    uniform_int_distribution<chrono::milliseconds::rep> jitter(0, _backoff.count() / 2);
+    auto wait = _backoff - chrono::milliseconds(jitter(_random));
+
+    _state = State::Open;
+    _retry_at = now + wait;
+    _opens++;
+
+    spdlog::warn("The database is unavailable after {} failed attempts, failing fast for the next {}ms",
+        _failures,
+        wait.count());
+
+    _backoff = min(_backoff * 2, _max_backoff);
+}
+
+//=============================================================================
+//=============================================================================
+auto CircuitBreaker::retryIn(Clock::time_point now) const -> chrono::milliseconds
+{
+    if (_state != State::Open || now >= _retry_at)
+        return chrono::milliseconds(0);
+
+    return chrono::duration_cast<chrono::milliseconds>(_retry_at - now);
+}
+
+} // namespace hdbpp_internal
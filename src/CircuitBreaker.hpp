@@ -0,0 +1,93 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _CIRCUIT_BREAKER_HPP
+#define _CIRCUIT_BREAKER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+namespace hdbpp_internal
+{
+// Guards the attempts to reach the database once the connection is lost. While closed
+// every attempt is allowed. After failure_threshold failures in a row the breaker opens,
+// and every attempt fails fast until a backoff has passed, rather than blocking the
+// caller on network timeouts while the database is known to be down. The breaker is
+// then half open, allowing a single attempt: success closes it, failure opens it again
+// with the backoff doubled, up to the maximum. Each backoff is jittered between half and
+// all of its value, so several clients do not all retry at once.
+//
+// Owned by a single DbConnection, so it is not thread safe.
+class CircuitBreaker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class State
+    {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    CircuitBreaker();
+
+    // a zero failure_threshold is treated as one. Closes the breaker
+    void configure(
+        std::size_t failure_threshold, std::chrono::milliseconds base_backoff, std::chrono::milliseconds max_backoff);
+
+    // returns true when an attempt may be made. An open breaker becomes half open once its
+    // backoff has passed
+    auto allow(Clock::time_point now = Clock::now()) -> bool;
+
+    // record the result of an attempt
+    void success() noexcept;
+    void failure(Clock::time_point now = Clock::now());
+
+    auto state() const noexcept -> State { return _state; }
+    auto isOpen() const noexcept -> bool { return _state == State::Open; }
+
+    // the time until an open breaker allows an attempt, zero otherwise
+    auto retryIn(Clock::time_point now = Clock::now()) const -> std::chrono::milliseconds;
+
+    // the failures in a row, and the number of times the breaker has opened
+    auto failures() const noexcept -> std::size_t { return _failures; }
+    auto opens() const noexcept -> uint64_t { return _opens; }
+
+private:
+    std::size_t _failure_threshold = 3;
+    std::chrono::milliseconds _base_backoff {100};
+    std::chrono::milliseconds _max_backoff {30000};
+
+    State _state = State::Closed;
+    std::size_t _failures = 0;
+    uint64_t _opens = 0;
+
+    // the backoff for the next time the breaker opens, and when the open breaker allows
+    // an attempt
+    std::chrono::milliseconds _backoff {100};
+    Clock::time_point _retry_at;
+
+    std::mt19937 _random;
+};
+
+} // namespace hdbpp_internal
+#endif // _CIRCUIT_BREAKER_HPP
@@ -21,8 +21,11 @@
 #define _COLUMN_CACHE_HPP
 
 #include "LibUtils.hpp"
+#include "Metrics.hpp"
 #include "PqxxExtension.hpp"
+#include "Probes.hpp"
 #include "QueryBuilder.hpp"
+#include "StageTimer.hpp"
 
 #include <cassert>
 #include <iostream>
@@ -37,10 +40,14 @@ namespace pqxx_conn
     class ColumnCache
     {
     public:
+        // the optional metrics count the cache hits and misses, and the optional stage timers
+        // time the lookups, both must outlive the cache
         ColumnCache(std::shared_ptr<pqxx::connection> conn,
             std::string table_name,
             std::string column_name,
-            std::string reference);
+            std::string reference,
+            CacheMetrics *metrics = nullptr,
+            StageTimers *stage_timers = nullptr);
 
         // query if the reference has a value, if its not cached it will be
         // loaded from the database
@@ -52,6 +59,11 @@ namespace pqxx_conn
         // the value
         auto value(const TRef &reference) -> TValue;
 
+        // look up a value that is already cached, without going to the database. The cache
+        // is not modified, so this is safe to call from several threads at once, provided
+        // nothing is changing the cache at the same time
+        auto cachedValue(const TRef &reference, TValue &value) const -> bool;
+
         // cache a value in the internal maps
         void cacheValue(const TValue &value, const TRef &reference);
 
@@ -64,6 +76,9 @@ namespace pqxx_conn
         void print(std::ostream &os) const noexcept;
 
     private:
+        // count a lookup of the loaded values as a hit or miss, when there are metrics
+        void countLookup(bool hit) const noexcept;
+
         // the database connection passed on construction
         std::shared_ptr<pqxx::connection> _conn;
 
@@ -72,6 +87,12 @@ namespace pqxx_conn
         std::string _column_name;
         std::string _reference;
 
+        // hit and miss counters, may be null
+        CacheMetrics *_metrics;
+
+        // times the lookups, may be null
+        StageTimers *_stage_timers;
+
         // prepared query names for this cache, used to lookup
         // prepared statements
         std::string _fetch_all_query_name;
@@ -88,11 +109,15 @@ namespace pqxx_conn
     ColumnCache<TValue, TRef>::ColumnCache(std::shared_ptr<pqxx::connection> conn,
         std::string table_name,
         std::string column_name,
-        std::string reference) :
+        std::string reference,
+        CacheMetrics *metrics,
+        StageTimers *stage_timers) :
         _conn(std::move(conn)),
         _table_name(std::move(table_name)),
         _column_name(std::move(column_name)),
-        _reference(std::move(reference))
+        _reference(std::move(reference)),
+        _metrics(metrics),
+        _stage_timers(stage_timers)
     {
         assert(_conn != nullptr);
         assert(!_table_name.empty());
@@ -160,14 +185,19 @@ namespace pqxx_conn
     auto ColumnCache<TValue, TRef>::valueExists(const TRef &reference) -> bool
     {
         assert(_conn != nullptr);
+        ScopedStageTimer timer(_stage_timers, Stage::CacheLookup);
 
         // search for the value in loaded values, if we get a hit then there is no
         // need to go to the database
         auto value_iter = _values.find(reference);
 
+        countLookup(value_iter != _values.end());
+
         // not found, search the database
         if (value_iter == _values.end())
         {
+            HDBPP_PROBE1(cache_miss, _table_name.c_str());
+
             try
             {
                 // the value is not loaded, so next step is to check the database
@@ -249,6 +279,38 @@ namespace pqxx_conn
         return _values.at(reference);
     }
 
+    //=============================================================================
+    //=============================================================================
+    template<typename TValue, typename TRef>
+    auto ColumnCache<TValue, TRef>::cachedValue(const TRef &reference, TValue &value) const -> bool
+    {
+        ScopedStageTimer timer(_stage_timers, Stage::CacheLookup);
+
+        auto value_iter = _values.find(reference);
+
+        countLookup(value_iter != _values.end());
+
+        if (value_iter == _values.end())
+            return false;
+
+        value = value_iter->second;
+        return true;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    template<typename TValue, typename TRef>
+    void ColumnCache<TValue, TRef>::countLookup(bool hit) const noexcept
+    {
+        if (_metrics == nullptr)
+            return;
+
+        if (hit)
+            _metrics->hits.fetch_add(1, std::memory_order_relaxed);
+        else
+            _metrics->misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
     //=============================================================================
     //=============================================================================
     template<typename TValue, typename TRef>
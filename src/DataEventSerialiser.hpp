@@ -0,0 +1,121 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _DATA_EVENT_SERIALISER_HPP
+#define _DATA_EVENT_SERIALISER_HPP
+
+#include "AttributeTraits.hpp"
+#include "DataSpan.hpp"
+#include "DbConnection.hpp"
+#include "HdbppTxFactory.hpp"
+#include "QueryBuilder.hpp"
+#include "StageTimer.hpp"
+
+#include <cassert>
+#include <exception>
+#include <string>
+
+namespace hdbpp_internal
+{
+namespace pqxx_conn
+{
+    // Stands in for the DbConnection under HdbppTxDataEvent, so a data event can be
+    // extracted and serialised to an insert query away from the connection. Only the
+    // attribute ids the connection has already cached are read, so one serialiser per
+    // thread can run in parallel, as long as the connection is not storing events at
+    // the same time. The queries are then handed to the connection with bufferDataEvent().
+    class DataEventSerialiser : public HdbppTxFactory<DataEventSerialiser>
+    {
+    public:
+        // the outcome of serialising a single event
+        struct Result
+        {
+            // false when the attribute id is not cached yet, the event must then be
+            // stored via the connection, which can look the id up
+            bool resolved = false;
+
+            // set if the event could not be serialised, to be rethrown by the caller
+            std::exception_ptr error;
+
+            std::string query;
+            std::string full_attr_name;
+            int conf_id = 0;
+            int type = 0;
+            std::size_t bytes = 0;
+        };
+
+        explicit DataEventSerialiser(const DbConnection &conn) : _conn(conn) {}
+
+        // set where the next event is serialised to
+        void target(Result *result) noexcept { _result = result; }
+
+        // the api used by HdbppTxDataEvent
+        auto isClosed() const noexcept -> bool { return _conn.isClosed(); }
+        auto stageTimers() const noexcept -> StageTimers * { return _conn.stageTimers(); }
+
+        template<typename T>
+        void storeDataEvent(const std::string &full_attr_name,
+            double event_time,
+            int quality,
+            const DataSpan<T> &value_r,
+            const DataSpan<T> &value_w,
+            const AttributeTraits &traits);
+
+    private:
+        const DbConnection &_conn;
+        Result *_result = nullptr;
+    };
+
+    //=============================================================================
+    //=============================================================================
+    template<typename T>
+    void DataEventSerialiser::storeDataEvent(const std::string &full_attr_name,
+        double event_time,
+        int quality,
+        const DataSpan<T> &value_r,
+        const DataSpan<T> &value_w,
+        const AttributeTraits &traits)
+    {
+        assert(_result != nullptr);
+
+        if (!_conn.cachedAttributeId(full_attr_name, _result->conf_id))
+            return;
+
+        {
+            ScopedStageTimer timer(_conn.stageTimers(), Stage::QueryBuild);
+
+            // the same query the connection buffers for the event
+            _result->query = QueryBuilder::storeDataEventString<T>(pqxx::to_string(_result->conf_id),
+                pqxx::to_string(event_time),
+                pqxx::to_string(quality),
+                value_r,
+                value_w,
+                traits);
+
+            _result->query += ";";
+        }
+
+        _result->full_attr_name = full_attr_name;
+        _result->type = traits.type();
+        _result->bytes = store_data_utils::dataBytes(value_r) + store_data_utils::dataBytes(value_w);
+        _result->resolved = true;
+    }
+} // namespace pqxx_conn
+} // namespace hdbpp_internal
+#endif // _DATA_EVENT_SERIALISER_HPP
@@ -0,0 +1,116 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _DATA_SPAN_HPP
+#define _DATA_SPAN_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// A DataSpan is a non-owning, read only view over a contiguous block of event
+// data. It allows the data held by Tango (or any other container) to be passed
+// down to the serialisation routines without copying it first. The caller must
+// ensure the viewed memory outlives the span.
+template<typename T>
+class DataSpan
+{
+public:
+    using value_type = T;
+    using const_iterator = const T *;
+
+    DataSpan() = default;
+    DataSpan(const T *data, std::size_t size) : _data(data), _size(size) {}
+    DataSpan(const std::vector<T> &value) : _data(value.data()), _size(value.size()) {}
+
+    auto data() const noexcept -> const T * { return _data; }
+    auto size() const noexcept -> std::size_t { return _size; }
+    auto empty() const noexcept -> bool { return _size == 0; }
+
+    auto begin() const noexcept -> const_iterator { return _data; }
+    auto end() const noexcept -> const_iterator { return _data + _size; }
+
+    auto operator[](std::size_t index) const -> const T &
+    {
+        assert(index < _size);
+        return _data[index];
+    }
+
+private:
+    const T *_data = nullptr;
+    std::size_t _size = 0;
+};
+
+// A vector<bool> is a bitfield rather than a contiguous array of bools, so the bool
+// span can view either a real array of bools (i.e. the Tango sequence) or a
+// vector<bool>. Elements are returned by value, since there is no bool to reference
+// inside a bitfield.
+template<>
+class DataSpan<bool>
+{
+public:
+    using value_type = bool;
+
+    // simple index based iterator, works for both storage types
+    class const_iterator
+    {
+    public:
+        const_iterator(const DataSpan<bool> *span, std::size_t index) : _span(span), _index(index) {}
+
+        auto operator*() const -> bool { return (*_span)[_index]; }
+        auto operator++() -> const_iterator &
+        {
+            ++_index;
+            return *this;
+        }
+
+        auto operator==(const const_iterator &other) const -> bool { return _index == other._index; }
+        auto operator!=(const const_iterator &other) const -> bool { return _index != other._index; }
+
+    private:
+        const DataSpan<bool> *_span;
+        std::size_t _index;
+    };
+
+    DataSpan() = default;
+    DataSpan(const bool *data, std::size_t size) : _data(data), _size(size) {}
+    DataSpan(const std::vector<bool> &value) : _bits(&value), _size(value.size()) {}
+
+    auto size() const noexcept -> std::size_t { return _size; }
+    auto empty() const noexcept -> bool { return _size == 0; }
+
+    auto begin() const noexcept -> const_iterator { return {this, 0}; }
+    auto end() const noexcept -> const_iterator { return {this, _size}; }
+
+    auto operator[](std::size_t index) const -> bool
+    {
+        assert(index < _size);
+        return _bits != nullptr ? (*_bits)[index] : _data[index];
+    }
+
+private:
+    const bool *_data = nullptr;
+    const std::vector<bool> *_bits = nullptr;
+    std::size_t _size = 0;
+};
+
+} // namespace hdbpp_internal
+#endif // _DATA_SPAN_HPP
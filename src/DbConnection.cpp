@@ -31,6 +31,52 @@ namespace hdbpp_internal
 {
 namespace pqxx_conn
 {
+    namespace
+    {
+        // the tango types the library stores, as used by the statement warm up
+        const vector<Tango::CmdArgType> SupportedTypes {Tango::DEV_BOOLEAN,
+            Tango::DEV_SHORT,
+            Tango::DEV_LONG,
+            Tango::DEV_LONG64,
+            Tango::DEV_FLOAT,
+            Tango::DEV_DOUBLE,
+            Tango::DEV_UCHAR,
+            Tango::DEV_USHORT,
+            Tango::DEV_ULONG,
+            Tango::DEV_ULONG64,
+            Tango::DEV_STRING,
+            Tango::DEV_STATE,
+            Tango::DEV_ENUM};
+
+        //=============================================================================
+        //=============================================================================
+        template<typename Func>
+        auto withDataType(int type, Func &&func) -> bool
+        {
+            // maps the tango type to the type its data is stored as, this matches the
+            // types used by HdbppTxDataEvent
+            switch (type)
+            {
+                case Tango::DEV_BOOLEAN: func(bool {}); break;
+                case Tango::DEV_SHORT: func(int16_t {}); break;
+                case Tango::DEV_LONG: func(int32_t {}); break;
+                case Tango::DEV_LONG64: func(int64_t {}); break;
+                case Tango::DEV_FLOAT: func(float {}); break;
+                case Tango::DEV_DOUBLE: func(double {}); break;
+                case Tango::DEV_UCHAR: func(uint8_t {}); break;
+                case Tango::DEV_USHORT: func(uint16_t {}); break;
+                case Tango::DEV_ULONG: func(uint32_t {}); break;
+                case Tango::DEV_ULONG64: func(uint64_t {}); break;
+                case Tango::DEV_STRING: func(string {}); break;
+                case Tango::DEV_STATE: func(Tango::DevState {}); break;
+                case Tango::DEV_ENUM: func(int16_t {}); break;
+                default: return false;
+            }
+
+            return true;
+        }
+    } // namespace
+
     //=============================================================================
     //=============================================================================
     DbConnection::DbConnection(DbStoreMethod db_store_method) : _db_store_method(db_store_method) {}
@@ -48,9 +94,19 @@ namespace pqxx_conn
             if (_conn && _conn->is_open())
                 _conn->disconnect();
 
+            if (_conn)
+            {
+                HDBPP_PROBE(reconnect);
+                _metrics.reconnect();
+            }
+
             // the connection is wrapped as a shared pointer to help manage its
-            // lifetime between objects
+            // lifetime between objects. None of the statements are prepared on it yet
             _conn = make_shared<pqxx::connection>(connect_string);
+            _connection_string = connect_string;
+            _prepared_statements.clear();
+            _rewarm_statements = false;
+            _connection_lost = false;
 
             // mark the connected flag as true to cache this state
             _connected = true;
@@ -69,14 +125,28 @@ namespace pqxx_conn
 
         // now create and connect the cache objects to the database connection, this
         // will destroy any existing cache objects managed by the unique pointers
-        _conf_id_cache = make_unique<ColumnCache<int, std::string>>(
-            _conn, schema::ConfTableName, schema::ConfColId, schema::ConfColName);
-
-        _error_desc_id_cache = make_unique<ColumnCache<int, std::string>>(
-            _conn, schema::ErrTableName, schema::ErrColId, schema::ErrColErrorDesc);
-
-        _event_id_cache = make_unique<ColumnCache<int, std::string>>(
-            _conn, schema::HistoryEventTableName, schema::HistoryEventColEventId, schema::HistoryEventColEvent);
+        _conf_id_cache = make_unique<ColumnCache<int, std::string>>(_conn,
+            schema::ConfTableName,
+            schema::ConfColId,
+            schema::ConfColName,
+            &_metrics.conf_id_cache,
+            &_stage_timers);
+
+        _error_desc_id_cache = make_unique<ColumnCache<int, std::string>>(_conn,
+            schema::ErrTableName,
+            schema::ErrColId,
+            schema::ErrColErrorDesc,
+            &_metrics.error_desc_id_cache,
+            &_stage_timers);
+
+        _event_id_cache = make_unique<ColumnCache<int, std::string>>(_conn,
+            schema::HistoryEventTableName,
+            schema::HistoryEventColEventId,
+            schema::HistoryEventColEvent,
+            &_metrics.event_id_cache,
+            &_stage_timers);
+
+        warmStatements();
     }
 
     //=============================================================================
@@ -94,6 +164,7 @@ namespace pqxx_conn
 
         // disconnect as requested, this will stop access to all functions
         _conn->disconnect();
+        _prepared_statements.clear();
 
         // stop attempts to use the connection
         _connected = false;
@@ -143,14 +214,10 @@ namespace pqxx_conn
         try
         {
             // create and perform a pqxx transaction
-            auto conf_id = pqxx::perform([&, this]() {
+            auto conf_id = perform(StoreAttribute, [&, this]() {
                 pqxx::work tx {(*_conn), StoreAttribute};
 
-                if (!tx.prepared(StoreAttribute).exists())
-                {
-                    tx.conn().prepare(StoreAttribute, QueryBuilder::storeAttributeStatement());
-                    spdlog::trace("Created prepared statement for: {}", StoreAttribute);
-                }
+                prepareStatement(StoreAttribute, QueryBuilder::storeAttributeStatement());
 
                 // execute the statement with the expectation that we get a row back
                 auto row = tx.exec_prepared1(StoreAttribute,
@@ -223,14 +290,10 @@ namespace pqxx_conn
         try
         {
             // create and perform a pqxx transaction
-            pqxx::perform([&full_attr_name, &event, this]() {
+            perform(StoreHistoryEvent, [&full_attr_name, &event, this]() {
                 pqxx::work tx {(*_conn), StoreHistoryEvent};
 
-                if (!tx.prepared(StoreHistoryEvent).exists())
-                {
-                    tx.conn().prepare(StoreHistoryEvent, QueryBuilder::storeHistoryEventStatement());
-                    spdlog::trace("Created prepared statement for: {}", StoreHistoryEvent);
-                }
+                prepareStatement(StoreHistoryEvent, QueryBuilder::storeHistoryEventStatement());
 
                 // expect no result, this is an insert only query
                 tx.exec_prepared0(StoreHistoryEvent, _conf_id_cache->value(full_attr_name), event);
@@ -306,7 +369,7 @@ namespace pqxx_conn
         try
         {
             // create and perform a pqxx transaction
-            pqxx::perform([&, this]() {
+            perform(StoreParameterEvent, [&, this]() {
                 pqxx::work tx {(*_conn), StoreParameterEvent};
 
                 if (_db_store_method == DbStoreMethod::InsertString)
@@ -330,11 +393,7 @@ namespace pqxx_conn
                 }
                 else
                 {
-                    if (!tx.prepared(StoreParameterEvent).exists())
-                    {
-                        tx.conn().prepare(StoreParameterEvent, QueryBuilder::storeParameterEventStatement());
-                        spdlog::trace("Created prepared statement for: {}", StoreParameterEvent);
-                    }
+                    prepareStatement(StoreParameterEvent, QueryBuilder::storeParameterEventStatement());
 
                     // a string needs quoting to be stored via this method, so it does not cause
                     // an error in the prepared statement
@@ -389,13 +448,18 @@ namespace pqxx_conn
         assert(_error_desc_id_cache != nullptr);
         assert(_event_id_cache != nullptr);
 
-        spdlog::trace("Storing error message event for attribute {}. Quality: {}. Error message: \"{}\"",
+        HDBPP_LOG_TRACE("Storing error message event for attribute {}. Quality: {}. Error message: \"{}\"",
             full_attr_name,
             quality,
             error_msg);
 
         checkConnection(LOCATION_INFO);
-        checkAttributeExists(full_attr_name, LOCATION_INFO);
+
+        if (!checkAttributeExists(full_attr_name, LOCATION_INFO))
+        {
+            _metrics.eventFailed(traits.type());
+            return;
+        }
 
         // first ensure the error message has an id in the database, otherwise
         // we can not store data against it
@@ -416,6 +480,9 @@ namespace pqxx_conn
             Tango::Except::throw_exception("Consistency Error", msg, LOCATION_INFO);
         }
 
+        if (_attribute_profiler.enabled())
+            _attribute_profiler.record(_conf_id_cache->value(full_attr_name), full_attr_name, error_msg.size(), true);
+
         if (_enable_buffering)
         {
             auto query = QueryBuilder::storeDataEventErrorString(pqxx::to_string(_conf_id_cache->value(full_attr_name)),
@@ -425,23 +492,20 @@ namespace pqxx_conn
                 traits);
 
             query += ";";
-            _sql_buffer.push_back(query);
+            bufferQuery(move(query), traits.type(), true);
         }
         else
         {
             try
             {
                 // create and perform a pqxx transaction
-                pqxx::perform([&, this]() {
+                perform(StoreDataEventError, [&, this]() {
                     pqxx::work tx {(*_conn), StoreDataEventError};
 
-                    if (!tx.prepared(_query_builder.storeDataEventErrorName(traits)).exists())
+                    if (!isPrepared(_query_builder.storeDataEventErrorName(traits)))
                     {
-                        tx.conn().prepare(_query_builder.storeDataEventErrorName(traits),
+                        prepareStatement(_query_builder.storeDataEventErrorName(traits),
                             _query_builder.storeDataEventErrorStatement(traits));
-
-                        spdlog::trace(
-                            "Created prepared statement for: {}", _query_builder.storeDataEventErrorName(traits));
                     }
 
                     // no result expected
@@ -453,9 +517,14 @@ namespace pqxx_conn
 
                     tx.commit();
                 });
+
+                _metrics.eventStored(traits.type());
+                _metrics.errorEventStored();
             }
             catch (const pqxx::pqxx_exception &ex)
             {
+                _metrics.eventFailed(traits.type());
+
                 handlePqxxError(
                     "The attribute [" + full_attr_name + "] error message [" + error_msg + "] was not saved.",
                     ex.base().what(),
@@ -481,14 +550,10 @@ namespace pqxx_conn
         try
         {
             // create and perform a pqxx transaction
-            pqxx::perform([&, this]() {
+            perform(StoreTtl, [&, this]() {
                 pqxx::work tx {(*_conn), StoreTtl};
 
-                if (!tx.prepared(StoreTtl).exists())
-                {
-                    tx.conn().prepare(StoreTtl, QueryBuilder::storeTtlStatement());
-                    spdlog::trace("Created prepared statement for: {}", StoreTtl);
-                }
+                prepareStatement(StoreTtl, QueryBuilder::storeTtlStatement());
 
                 // no result expected
                 tx.exec_prepared0(StoreTtl, ttl, _conf_id_cache->value(full_attr_name));
@@ -525,12 +590,11 @@ namespace pqxx_conn
         try
         {
             // create and perform a pqxx transaction
-            last_event = pqxx::perform([&full_attr_name, this]() {
+            last_event = perform(FetchLastHistoryEvent, [&full_attr_name, this]() {
                 // declare the work transaction for this event
                 pqxx::work tx {(*_conn), FetchLastHistoryEvent};
 
-                if (!tx.prepared(FetchLastHistoryEvent).exists())
-                    tx.conn().prepare(FetchLastHistoryEvent, QueryBuilder::fetchLastHistoryEventStatement());
+                prepareStatement(FetchLastHistoryEvent, QueryBuilder::fetchLastHistoryEventStatement());
 
                 // unless this is the first time this attribute event history has
                 // been queried, then we expect something back
@@ -595,12 +659,11 @@ namespace pqxx_conn
         try
         {
             // create and perform a pqxx transaction
-            traits = pqxx::perform([&full_attr_name, this]() {
+            traits = perform(FetchAttributeTraits, [&full_attr_name, this]() {
                 // declare the work transaction for this event
                 pqxx::work tx {(*_conn), FetchAttributeTraits};
 
-                if (!tx.prepared(FetchAttributeTraits).exists())
-                    tx.conn().prepare(FetchAttributeTraits, QueryBuilder::fetchAttributeTraitsStatement());
+                prepareStatement(FetchAttributeTraits, QueryBuilder::fetchAttributeTraitsStatement());
 
                 // always expect a result, the type info for the attribute
                 auto row = tx.exec_prepared1(FetchAttributeTraits, full_attr_name);
@@ -624,56 +687,453 @@ namespace pqxx_conn
 
     //=============================================================================
     //=============================================================================
-    void DbConnection::flush()
+    void DbConnection::prepareStatement(const string &name, const string &statement, bool now)
     {
-        spdlog::debug("Flushing buffer of size: {}", _sql_buffer.size());
+        if (!isPrepared(name))
+        {
+            _conn->prepare(name, statement);
+            spdlog::trace("Created prepared statement for: {}", name);
+        }
+
+        // pqxx otherwise prepares the statement on the server when first used
+        if (now)
+            _conn->prepare_now(name);
+
+        _prepared_statements.insert(name);
+    }
 
-        if (_sql_buffer.empty())
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::warmStatements()
+    {
+        if (_statement_warmup == StatementWarmup::None)
+            return;
+
+        auto start = chrono::steady_clock::now();
+        vector<AttributeTraits> traits_list;
+
+        try
+        {
+            if (_statement_warmup == StatementWarmup::All)
+            {
+                // no image formats, an image attribute can not be added so never stores an event
+                for (auto type : SupportedTypes)
+                    for (auto format : {Tango::SCALAR, Tango::SPECTRUM})
+                        for (auto write_type : {Tango::READ, Tango::WRITE, Tango::READ_WRITE, Tango::READ_WITH_WRITE})
+                            traits_list.emplace_back(write_type, format, type);
+            }
+            else
+            {
+                pqxx::work tx {(*_conn), FetchAllTraits};
+
+                for (const auto &row : tx.exec(QueryBuilder::fetchAllTraitsStatement()))
+                {
+                    traits_list.emplace_back(static_cast<Tango::AttrWriteType>(row.at(2).as<int>()),
+                        static_cast<Tango::AttrDataFormat>(row.at(1).as<int>()),
+                        static_cast<Tango::CmdArgType>(row.at(0).as<int>()));
+                }
+
+                tx.commit();
+            }
+
+            for (const auto &traits : traits_list)
+                prepareDataEventStatements(traits);
+        }
+        catch (const pqxx::pqxx_exception &ex)
+        {
+            spdlog::warn("Failed to warm up the prepared statements, they will be prepared on first use. Error: \"{}\"",
+                ex.base().what());
+
+            return;
+        }
+
+        spdlog::info("Prepared the statements for {} attribute traits in {}ms",
+            traits_list.size(),
+            chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::prepareDataEventStatements(const AttributeTraits &traits)
+    {
+        // an unsupported type has no statements, e.g. DEV_ENCODED
+        auto supported = withDataType(traits.type(), [&traits, this](auto value) {
+            using T = decltype(value);
+
+            // arrays of strings are always stored via a query string, see storeDataEvent()
+            if (!(traits.isArray() && traits.type() == Tango::DEV_STRING))
+            {
+                prepareStatement(
+                    _query_builder.storeDataEventName(traits), _query_builder.storeDataEventStatement<T>(traits), true);
+            }
+        });
+
+        if (supported)
+        {
+            prepareStatement(_query_builder.storeDataEventErrorName(traits),
+                _query_builder.storeDataEventErrorStatement(traits),
+                true);
+        }
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::executeOnEventLoop(const string &query)
+    {
+        checkEventLoopResult(_event_loop->execute(query, _event_loop_timeout));
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::checkEventLoopResult(const PqEventLoop::Result &result)
+    {
+        switch (result.status)
+        {
+            case PqEventLoop::Result::Status::Ok: return;
+
+            // the database rejected the query, and the implicit transaction rolled back
+            case PqEventLoop::Result::Status::Error: throw pqxx::sql_error(result.error);
+
+            // the query was sent, so may have committed, running it again could store the
+            // events twice. The event loop resets a lost connection itself
+            case PqEventLoop::Result::Status::ConnectionLost:
+            case PqEventLoop::Result::Status::TimedOut:
+            case PqEventLoop::Result::Status::Cancelled: throw pqxx::in_doubt_error(result.error);
+
+            // the query never left the queue, so it did not run, and is retried as any other
+            // failed batch
+            case PqEventLoop::Result::Status::NotSent: throw pqxx::failure(result.error);
+        }
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::flush(vector<size_t> *failed)
+    {
+        HDBPP_LOG_DEBUG("Flushing buffer of size: {}", bufferSize());
+
+        if (_sql_buffer.empty() && _batches.empty())
         {
             spdlog::warn("Nothing to flush from the buffer, returning");
             return;
         }
 
+        // when no batches were cut, the whole buffer is stored here as a single batch
+        if (_batches.empty())
+        {
+            auto batch = takeBuffer();
+            _buffer_offset = 0;
+            storeBatch(batch, failed);
+            return;
+        }
+
+        // otherwise the rest of the buffer follows the batches already cut, and each is
+        // then stored, or settled when already sent, in order. A failed batch does not stop
+        // the others being stored, the first error is raised once they all have been
+        if (!_sql_buffer.empty())
+            cutBatch();
+
+        exception_ptr error;
+
+        for (auto &batch : _batches)
+        {
+            try
+            {
+                storeBatch(batch, failed);
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = current_exception();
+            }
+        }
+
+        _batches.clear();
+        _buffer_offset = 0;
+
+        if (error)
+            rethrow_exception(error);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto DbConnection::discardBuffer() -> size_t
+    {
+        size_t committed = 0;
+
+        for (auto &batch : _batches)
+        {
+            // a batch sent ahead is already running, so all that can be done is wait for it
+            auto stored = batch.sent.valid() && batch.sent.get().result.ok();
+
+            for (auto &type : batch.types)
+                countEvent(type, stored);
+
+            if (stored)
+                committed += batch.queries.size();
+        }
+
+        for (auto &type : _sql_buffer_types)
+            countEvent(type, false);
+
+        if (bufferSize() > 0)
+            spdlog::warn("Discarded {} buffered queries, {} of them already committed", bufferSize(), committed);
+
+        _batches.clear();
+        _sql_buffer.clear();
+        _sql_buffer_types.clear();
+        _buffer_offset = 0;
+        _metrics.bufferDepth(0);
+        _enable_buffering = false;
+        return committed;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto DbConnection::takeBuffer() -> SqlBatch
+    {
+        SqlBatch batch;
+        batch.queries = move(_sql_buffer);
+        batch.types = move(_sql_buffer_types);
+        batch.offset = _buffer_offset;
+        batch.start = chrono::steady_clock::now();
+
+        _sql_buffer.clear();
+        _sql_buffer_types.clear();
+        _buffer_offset += batch.queries.size();
+        _metrics.bufferDepth(0);
+        return batch;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::cutBatch()
+    {
+        // with an event loop the batch is sent at once, otherwise the flush stores it as a
+        // transaction of its own
+        if (_event_loop)
+            sendBatch();
+        else
+            _batches.push_back(takeBuffer());
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::sendBatch()
+    {
+        // bound the batches in flight, waiting on the oldest until there is room
+        for (auto &batch : _batches)
+        {
+            if (_event_loop->inFlight() < _pipeline_depth)
+                break;
+
+            if (batch.sent.valid())
+                batch.sent.wait();
+        }
+
+        auto batch = takeBuffer();
+        string full_query;
+
+        {
+            ScopedStageTimer timer(&_stage_timers, Stage::QueryBuild);
+
+            for (auto const &query : batch.queries)
+                full_query += query;
+        }
+
+        auto sent = make_shared<promise<SqlBatch::Sent>>();
+        batch.sent = sent->get_future();
+
+        _event_loop->submit(move(full_query), _event_loop_timeout, [sent](const PqEventLoop::Result &result) {
+            sent->set_value(SqlBatch::Sent {result, chrono::steady_clock::now()});
+        });
+
+        HDBPP_LOG_DEBUG("Sent batch of {} queries, {} batches cut", batch.queries.size(), _batches.size() + 1);
+        _batches.push_back(move(batch));
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::storeBatch(SqlBatch &batch, vector<size_t> *failed)
+    {
+        auto queries = batch.queries.size();
+        HDBPP_PROBE1(flush_start, queries);
+
+        // a batch sent ahead is timed from when it was sent until it completed, any other
+        // from now until it is stored
+        if (!batch.sent.valid())
+            batch.start = chrono::steady_clock::now();
+
+        chrono::steady_clock::time_point completed;
+
+        // record the flush
+        auto flushed = [&batch, this]() {
+            _metrics.flushed(batch.queries.size(),
+                static_cast<uint64_t>(
+                    chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - batch.start).count()));
+        };
+
+        // feed the time the batch took back to the controller, and publish any new decisions
+        auto adapt = [&batch, &completed, this](bool batch_failed) {
+            if (completed == chrono::steady_clock::time_point {})
+                completed = chrono::steady_clock::now();
+
+            if (_batch_controller.record(batch.queries.size(), completed - batch.start, batch_failed))
+                publishBatchDecisions();
+        };
+
         try
         {
-            pqxx::perform([&, this]() {
-                pqxx::work tx {(*_conn), StoreDataEvents};
+            auto store = [&, this]() {
+                completed = chrono::steady_clock::time_point {};
+
+                // a batch sent ahead by the pipeline is already running, so only its result
+                // is waited on
+                if (batch.sent.valid())
+                {
+                    ScopedStageTimer timer(&_stage_timers, Stage::Commit);
+                    auto sent = batch.sent.get();
+                    completed = sent.completed;
+                    checkEventLoopResult(sent.result);
+                    return;
+                }
 
                 string full_query;
 
-                for (auto const &query : _sql_buffer)
-                    full_query += query;
+                {
+                    ScopedStageTimer timer(&_stage_timers, Stage::QueryBuild);
+
+                    for (auto const &query : batch.queries)
+                        full_query += query;
+                }
 
-                tx.exec0(full_query);
+                // the event loop runs the batch as a single implicit transaction, which is
+                // committed along with the last statement
+                if (_event_loop)
+                {
+                    ScopedStageTimer timer(&_stage_timers, Stage::Execute);
+                    executeOnEventLoop(full_query);
+                    return;
+                }
+
+                pqxx::work tx {(*_conn), StoreDataEvents};
+
+                {
+                    ScopedStageTimer timer(&_stage_timers, Stage::Execute);
+                    tx.exec0(full_query);
+                }
 
                 // commit the result
+                ScopedStageTimer timer(&_stage_timers, Stage::Commit);
                 tx.commit();
-            });
+            };
+
+            // the slow query log reports the whole batch, with a row per buffered event. The
+            // event loop has connections of its own, which it resets itself, so a batch run on
+            // it is kept out of perform(), which guards and reconnects the pqxx connection
+            if (batch.sent.valid() || _event_loop)
+            {
+                SlowQueryLog::Scope slow_query_scope(_slow_query_log, StoreDataEvents, queries, nullptr);
+
+                try
+                {
+                    store();
+                }
+                catch (...)
+                {
+                    slow_query_scope.dismiss();
+                    throw;
+                }
+            }
+            else
+                perform(StoreDataEvents, store, queries);
+
+            adapt(false);
+
+            for (auto &type : batch.types)
+                countEvent(type, true);
+        }
+        catch (const pqxx::in_doubt_error &ex)
+        {
+            // the events can not be counted as stored, since they may not have been
+            adapt(true);
+
+            for (auto &type : batch.types)
+                countEvent(type, false);
+
+            flushed();
+            HDBPP_PROBE2(flush_end, queries, 0);
+
+            // the batch may have committed, so it is neither run again nor run query by query,
+            // either could store its events twice, or report stored events as failed
+            string msg {"Unable to tell if a batch of " + std::to_string(queries) +
+                " events was stored, the connection was lost or the query timed out. Exception: "};
+
+            msg += ex.what();
+
+            spdlog::error("Throwing connection error with message: \"{}\"", msg);
+            Tango::Except::throw_exception("Connection Error", msg, LOCATION_INFO);
         }
         catch (const pqxx::pqxx_exception &ex)
         {
-            
+            adapt(true);
+
+            // when reporting failed queries, a lost connection is the only error that is
+            // thrown, there is no point trying each query in turn
+            if (failed != nullptr && dynamic_cast<const pqxx::broken_connection *>(&ex.base()) != nullptr)
+            {
+                for (auto &type : batch.types)
+                    countEvent(type, false);
+
+                flushed();
+                HDBPP_PROBE2(flush_end, queries, 0);
+
+                string msg {"Lost the connection to the database while flushing the buffer. Exception: "};
+                msg += ex.base().what();
+
+                spdlog::error("Throwing connection error with message: \"{}\"", msg);
+                Tango::Except::throw_exception("Connection Error", msg, LOCATION_INFO);
+            }
+
             spdlog::error("Error: An unexpected error occurred when trying to run a multiple event transaction.");
             spdlog::error("Caught error at: {} Error: \"{}\"", LOCATION_INFO, ex.base().what());
             spdlog::info("Trying to run multiple event transaction in single bunches.");
             
             string full_msg = "";
             bool single_error = false;
+            size_t failed_queries = 0;
 
-            for (auto const &query : _sql_buffer)
+            for (size_t i = 0; i < batch.queries.size(); i++)
             {
+                auto const &query = batch.queries[i];
+
                 try
                 {
-                    pqxx::perform([&, this]() {
+                    perform(StoreDataEvents, [&, this]() {
                         pqxx::work tx {(*_conn), StoreDataEvents};
                         
                         tx.exec0(query);
                         tx.commit();
                     });
+
+                    countEvent(batch.types[i], true);
                 }
                 catch (const pqxx::pqxx_exception &ex)
                 {
+                    countEvent(batch.types[i], false);
                     single_error = true;
+                    failed_queries++;
+
+                    // the caller is given the failed queries, so skip building the message,
+                    // which can be expensive when many events are failing. The index is
+                    // into every query buffered since the last flush
+                    if (failed != nullptr)
+                    {
+                        failed->push_back(batch.offset + i);
+                        HDBPP_LOG_DEBUG("Single query failed with error: \"{}\"", ex.base().what());
+                        continue;
+                    }
+
                     spdlog::error("Error: An unexpected error occurred when trying to run the single query: \"{}\"", query);
                     spdlog::error("Caught error at: {} Error: \"{}\"", LOCATION_INFO, ex.base().what());
                     full_msg += "Could not run query:" + query + "\n";
@@ -681,16 +1141,106 @@ namespace pqxx_conn
             }
             
             // we may try the events individually in future
-            _sql_buffer.clear();
+            flushed();
+            HDBPP_PROBE2(flush_end, queries, single_error ? 0 : 1);
             
-            if(single_error)
+            if (failed != nullptr && failed_queries > 0)
+                spdlog::error("Error: {} of {} buffered queries failed to store", failed_queries, queries);
+
+            if(single_error && failed == nullptr)
             {
                 spdlog::error("Throwing storage error with message: \"{}\"", full_msg);
                 Tango::Except::throw_exception("Storage Error", full_msg, LOCATION_INFO);
             }
+
+            return;
         }
 
-        _sql_buffer.clear();
+        flushed();
+        HDBPP_PROBE2(flush_end, queries, 1);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::countEvent(const pair<int, bool> &type, bool stored)
+    {
+        if (stored)
+        {
+            _metrics.eventStored(type.first);
+
+            if (type.second)
+                _metrics.errorEventStored();
+        }
+        else
+            _metrics.eventFailed(type.first);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto DbConnection::stats() const -> hdbpp::HdbStats
+    {
+        hdbpp::HdbStats stats;
+        _metrics.fill(stats);
+
+        if (_attribute_profiler.enabled())
+            stats.top_attributes = _attribute_profiler.top();
+
+        return stats;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::bufferDataEvent(
+        string &&query, int conf_id, const string &full_attr_name, size_t bytes, int type)
+    {
+        assert(_enable_buffering);
+
+        if (_attribute_profiler.enabled())
+            _attribute_profiler.record(conf_id, full_attr_name, bytes, false);
+
+        bufferQuery(move(query), type);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::bufferQuery(string &&query, int type, bool error_event)
+    {
+        _sql_buffer.push_back(move(query));
+        _sql_buffer_types.emplace_back(type, error_event);
+        _metrics.bufferDepth(_sql_buffer.size());
+
+        // the controller cuts a batch once it is large enough, or its first query has waited
+        // long enough. Otherwise the pipeline sends each full batch ahead of the flush, so the
+        // next is serialised while it runs
+        if (_batch_controller.enabled())
+        {
+            auto now = chrono::steady_clock::now();
+
+            if (_sql_buffer.size() == 1)
+                _buffer_start = now;
+
+            if (_sql_buffer.size() >= _batch_controller.batchSize() ||
+                now - _buffer_start >= _batch_controller.flushInterval())
+                cutBatch();
+        }
+        else if (_pipeline_batch_size > 0 && _event_loop && _sql_buffer.size() >= _pipeline_batch_size)
+            sendBatch();
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::publishBatchDecisions()
+    {
+        if (!_batch_controller.enabled())
+        {
+            _metrics.batchDecisions(0, 0, 0, 0);
+            return;
+        }
+
+        _metrics.batchDecisions(_batch_controller.batchSize(),
+            static_cast<uint64_t>(_batch_controller.flushInterval().count()),
+            _batch_controller.increases(),
+            _batch_controller.decreases());
     }
 
     //=============================================================================
@@ -703,14 +1253,10 @@ namespace pqxx_conn
         {
             // since it does not exist, we must add it before storing history
             // events based on it
-            auto event_id = pqxx::perform([&full_attr_name, &event, this]() {
+            auto event_id = perform(StoreHistoryString, [&full_attr_name, &event, this]() {
                 pqxx::work tx {(*_conn), StoreHistoryString};
 
-                if (!tx.prepared(StoreHistoryString).exists())
-                {
-                    tx.conn().prepare(StoreHistoryString, QueryBuilder::storeHistoryStringStatement());
-                    spdlog::trace("Created prepared statement for: {}", StoreHistoryString);
-                }
+                prepareStatement(StoreHistoryString, QueryBuilder::storeHistoryStringStatement());
 
                 auto row = tx.exec_prepared1(StoreHistoryString, event);
                 tx.commit();
@@ -744,14 +1290,10 @@ namespace pqxx_conn
         try
         {
             // add the error message to the database
-            auto error_id = pqxx::perform([&full_attr_name, &error_msg, this]() {
+            auto error_id = perform(StoreErrorString, [&full_attr_name, &error_msg, this]() {
                 pqxx::work tx {(*_conn), StoreErrorString};
 
-                if (!tx.prepared(StoreErrorString).exists())
-                {
-                    tx.conn().prepare(StoreErrorString, QueryBuilder::storeErrorStatement());
-                    spdlog::trace("Created prepared statement for: {}", StoreErrorString);
-                }
+                prepareStatement(StoreErrorString, QueryBuilder::storeErrorStatement());
 
                 // expect a single row returned
                 auto row = tx.exec_prepared1(StoreErrorString, error_msg);
@@ -780,12 +1322,19 @@ namespace pqxx_conn
 
     //=============================================================================
     //=============================================================================
-    void DbConnection::checkAttributeExists(const std::string &full_attr_name, const std::string &location)
+    auto DbConnection::checkAttributeExists(const std::string &full_attr_name, const std::string &location) -> bool
     {
         // check the attribute has been configured and added to the database,
         // if it has not then we can not use it for operations
         if (!_conf_id_cache->valueExists(full_attr_name))
         {
+            // an unknown attribute is an expected result when reporting an event status
+            if (_event_status != nullptr)
+            {
+                *_event_status = hdbpp::HdbEventStatus::UnknownAttribute;
+                return false;
+            }
+
             string msg {"This attribute [" + full_attr_name +
                 "] does not exist in the database. Unable to work with this attribute until it is added."};
 
@@ -794,6 +1343,8 @@ namespace pqxx_conn
             spdlog::error("Throwing consistency error with message: \"{}\"", msg);
             Tango::Except::throw_exception("Consistency Error", msg, location);
         }
+
+        return true;
     }
 
     //=============================================================================
@@ -811,6 +1362,82 @@ namespace pqxx_conn
             spdlog::error("Throwing connection error with message: \"{}\"", msg);
             Tango::Except::throw_exception("Connection Error", msg, location);
         }
+
+        if (_connection_lost || !_conn->is_open())
+            reconnect(location);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::reconnect(const std::string &location)
+    {
+        if (!_circuit_breaker.allow())
+        {
+            string msg {"The database is unavailable, the connection will be retried in " +
+                std::to_string(_circuit_breaker.retryIn().count()) + "ms"};
+
+            // the breaker is open while the database is down, so keep this out of the error log
+            spdlog::debug("Failing fast while the circuit breaker is open: \"{}\"", msg);
+            Tango::Except::throw_exception("Connection Error", msg, location);
+        }
+
+        spdlog::info("The connection to the database was lost, reconnecting");
+
+        try
+        {
+            // a new connection, the statements are prepared on it again by connect()
+            connect(_connection_string);
+        }
+        catch (const Tango::DevFailed &)
+        {
+            _connection_lost = true;
+            _circuit_breaker.failure();
+            _metrics.connectionState(true, _circuit_breaker.opens());
+            throw;
+        }
+
+        _circuit_breaker.success();
+        _metrics.connectionState(false, _circuit_breaker.opens());
+        warmCaches();
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::warmCaches()
+    {
+        // the error message cache is not loaded, it is unbounded and refilled on use
+        try
+        {
+            _conf_id_cache->fetchAll();
+            _event_id_cache->fetchAll();
+        }
+        catch (const Tango::DevFailed &)
+        {
+            spdlog::warn("Unable to warm the caches after reconnecting, they will be filled on use");
+        }
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::connectionLost(const std::string &what)
+    {
+        if (!_connection_lost)
+            spdlog::warn("The connection to the database was lost: \"{}\"", what);
+
+        _connection_lost = true;
+        _circuit_breaker.failure();
+        _metrics.connectionState(true, _circuit_breaker.opens());
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void DbConnection::connectionRestored()
+    {
+        spdlog::info("The connection to the database was restored");
+
+        _connection_lost = false;
+        _circuit_breaker.success();
+        _metrics.connectionState(false, _circuit_breaker.opens());
     }
 
     //=============================================================================
@@ -20,18 +20,32 @@
 #ifndef _PSQL_CONNECTION_HPP
 #define _PSQL_CONNECTION_HPP
 
+#include "AttributeProfiler.hpp"
 #include "AttributeTraits.hpp"
+#include "BatchController.hpp"
+#include "CircuitBreaker.hpp"
 #include "ColumnCache.hpp"
 #include "ConnectionBase.hpp"
+#include "DataSpan.hpp"
 #include "HdbppTxFactory.hpp"
+#include "Metrics.hpp"
+#include "PqEventLoop.hpp"
 #include "QueryBuilder.hpp"
+#include "SlowQueryLog.hpp"
+#include "StageTimer.hpp"
 #include "TimescaleSchema.hpp"
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <hdb++/HdbEventStatus.h>
 #include <iostream>
 #include <memory>
 #include <pqxx/pqxx>
 #include <string>
+#include <unordered_set>
 
 namespace hdbpp_internal
 {
@@ -56,6 +70,21 @@ namespace pqxx_conn
             PreparedStatement
         };
 
+        // Sets which data and error event statements are prepared when connecting, so the
+        // first event of each attribute type does not pay to prepare its statement
+        enum class StatementWarmup
+        {
+            // prepare each statement on first use
+            None,
+
+            // prepare the statements for the traits of the attributes in the database
+            Archived,
+
+            // prepare the statements for every supported traits, scalar and spectrum only,
+            // since image attributes can not be added
+            All
+        };
+
         DbConnection(DbStoreMethod db_store_method);
 
         // connection API
@@ -64,11 +93,88 @@ namespace pqxx_conn
         auto isOpen() const noexcept -> bool override { return _connected; }
         auto isClosed() const noexcept -> bool override { return !isOpen(); }
 
+        // once the connection is lost, the next call reconnects, and after failure_threshold
+        // failures in a row calls fail fast until a backoff (doubling from base_backoff up to
+        // max_backoff, with jitter) has passed, see CircuitBreaker. On reconnecting, the
+        // statements are warmed up again, as are the attribute and history event id caches
+        void reconnectPolicy(std::size_t failure_threshold,
+            std::chrono::milliseconds base_backoff,
+            std::chrono::milliseconds max_backoff)
+        {
+            _circuit_breaker.configure(failure_threshold, base_backoff, max_backoff);
+        }
+
+        // the statements to prepare on connect, set before connect(). The same statements are
+        // prepared again whenever the connection is reset
+        void statementWarmup(StatementWarmup warmup) noexcept { _statement_warmup = warmup; }
+
+        // the number of statements prepared on the current connection
+        auto preparedStatements() const noexcept -> std::size_t { return _prepared_statements.size(); }
+
         // this API allows the connection to buffer the event data store
         // requests, and send them all at once to the db, this will increase
-        // insert time. Flush will execute the sql and clear the buffer
+        // insert time. Flush will execute the sql and clear the buffer. If the
+        // buffer fails as a whole, each query is retried on its own, and a storage
+        // error thrown if any still fail. When failed is given, the index of each
+        // failed query is added to it instead, and only a lost connection throws
         void buffer(bool enable) { _enable_buffering = enable; }
-        void flush();
+        void flush(std::vector<std::size_t> *failed = nullptr);
+
+        // drop everything buffered since the last flush and stop buffering, for a call that
+        // fails before it flushes, so the next flush does not store its queries. Batches the
+        // pipeline has already sent can not be recalled, so they are waited on, and the number
+        // of queries they committed is returned
+        auto discardBuffer() -> std::size_t;
+
+        // the number of queries buffered since the last flush, including any batches the
+        // pipeline has already sent
+        auto bufferSize() const noexcept -> std::size_t { return _buffer_offset + _sql_buffer.size(); }
+
+        // flush the buffer over the non-blocking connections of the event loop, rather than
+        // the pqxx connection, failing the flush if it takes longer than the timeout (zero
+        // for none). A flush the database rejected, or that was never sent because it timed
+        // out waiting for a free connection, is retried query by query over the pqxx
+        // connection as usual. A flush that timed out or lost its connection once sent may
+        // have committed, so it is never run again, and the flush fails with a connection error.
+        // Passing a null event loop returns to flushing over the pqxx connection
+        void eventLoop(std::unique_ptr<PqEventLoop> event_loop, std::chrono::milliseconds timeout)
+        {
+            _event_loop = std::move(event_loop);
+            _event_loop_timeout = timeout;
+        }
+
+        // with an event loop set, send each batch_size queries buffered ahead of the flush, so
+        // the next batch is serialised while the last is stored. At most depth batches are in
+        // flight, buffering waits for the oldest beyond that. The flush then settles every
+        // batch sent, as if the buffer had been stored at once. A batch_size of zero disables
+        void pipeline(std::size_t batch_size, std::size_t depth)
+        {
+            _pipeline_batch_size = batch_size;
+            _pipeline_depth = std::max<std::size_t>(depth, 1);
+        }
+
+        // cut batches from the buffer adaptively to keep each under the latency target (zero
+        // disables), see BatchController. Replaces the fixed pipeline batch size, and without
+        // an event loop each batch is stored by the flush as a transaction of its own
+        void batchController(std::chrono::microseconds target_latency,
+            std::size_t min_batch_size,
+            std::size_t max_batch_size,
+            std::chrono::milliseconds max_flush_interval)
+        {
+            _batch_controller.configure(target_latency, min_batch_size, max_batch_size, max_flush_interval);
+            publishBatchDecisions();
+        }
+
+        // while set, the data event store functions report an unknown attribute by setting
+        // the status, rather than throwing. Used to build per event batch results
+        void eventStatus(hdbpp::HdbEventStatus *status) noexcept { _event_status = status; }
+
+        // log statements that succeed but take longer than the threshold (zero disables),
+        // and explain every explain_sample'th slow prepared statement (zero disables)
+        void slowQueryLog(std::chrono::microseconds threshold, unsigned int explain_sample)
+        {
+            _slow_query_log.configure(threshold, explain_sample);
+        }
 
         // storage API
 
@@ -100,8 +206,19 @@ namespace pqxx_conn
             const std::string &description);
 
         // this function can store the event data for all the supported
-        // tango types. The data is passed in a unique pointer so the function
-        // can take ownership of the data.
+        // tango types. The data is viewed via a non-owning span, so it can be
+        // serialised directly from the Tango buffers without copying. The viewed
+        // data need only remain valid for the duration of the call.
+        template<typename T>
+        void storeDataEvent(const std::string &full_attr_name,
+            double event_time,
+            int quality,
+            const DataSpan<T> &value_r,
+            const DataSpan<T> &value_w,
+            const AttributeTraits &traits);
+
+        // overload of storeDataEvent() for owned data, the data is passed in a
+        // unique pointer so the function can take ownership of the data.
         template<typename T>
         void storeDataEvent(const std::string &full_attr_name,
             double event_time,
@@ -110,6 +227,12 @@ namespace pqxx_conn
             std::unique_ptr<std::vector<T>> value_w,
             const AttributeTraits &traits);
 
+        // buffer a data event query that was built outside the connection, by a
+        // DataEventSerialiser, for the attribute with the given id and data size.
+        // Buffering must be enabled
+        void bufferDataEvent(
+            std::string &&query, int conf_id, const std::string &full_attr_name, std::size_t bytes, int type);
+
         // store a data error event in the data tables
         void storeDataEventError(const std::string &full_attr_name,
             double event_time,
@@ -131,13 +254,123 @@ namespace pqxx_conn
         // get the AttributeTraits of an attribute in the database
         auto fetchAttributeTraits(const std::string &full_attr_name) -> AttributeTraits;
 
+        // get the id of an attribute only if it is already cached, the database is never
+        // queried. Safe to call from several threads while no events are being stored
+        auto cachedAttributeId(const std::string &full_attr_name, int &conf_id) const -> bool
+        {
+            return _conf_id_cache->cachedValue(full_attr_name, conf_id);
+        }
+
+        // metrics API
+
+        // get the runtime counters for this connection, safe to call from any thread
+        auto stats() const -> hdbpp::HdbStats;
+
+        // the timing of the event storage stages on this connection, they record from any
+        // thread without a lock, so may be used through a const connection
+        auto stageTimers() const noexcept -> StageTimers * { return &_stage_timers; }
+
+        // profile the events stored by each attribute, keeping capacity counters (zero
+        // disables) and reporting the busiest top_n in stats() and topAttributes()
+        void attributeProfiler(std::size_t capacity, std::size_t top_n)
+        {
+            _attribute_profiler.configure(capacity, top_n);
+        }
+
+        // the busiest attributes, safe to call from any thread
+        auto topAttributes() const -> std::vector<hdbpp::HdbAttributeLoad> { return _attribute_profiler.top(); }
+
     private:
+        // run the transaction via pqxx::perform, counting any retries. The statement class
+        // and number of rows are reported by the slow query log, along with the prepared
+        // statement name (if any) so it can be sampled for an explain. A run the slow query
+        // log must not see, such as the explain itself, is not recorded
+        template<typename Func>
+        auto perform(const std::string &statement_class,
+            Func &&func,
+            std::size_t rows = 1,
+            const std::string *prepared_name = nullptr,
+            bool record_slow = true) -> decltype(func());
+
+        // a batch of buffered queries, and the index of its first query since the last flush
+        struct SqlBatch
+        {
+            std::vector<std::string> queries;
+            std::vector<std::pair<int, bool>> types;
+            std::size_t offset = 0;
+            std::chrono::steady_clock::time_point start;
+
+            // the result of a batch the pipeline has sent to the event loop, and when it
+            // completed
+            struct Sent
+            {
+                PqEventLoop::Result result;
+                std::chrono::steady_clock::time_point completed;
+            };
+
+            std::future<Sent> sent;
+        };
+
+        // define the prepared statement on the connection, unless it already is, and if now is
+        // set, prepare it on the server at once rather than on first use. The statements
+        // prepared are tracked here, so the store functions need not ask pqxx each time
+        void prepareStatement(const std::string &name, const std::string &statement, bool now = false);
+        auto isPrepared(const std::string &name) const -> bool { return _prepared_statements.count(name) > 0; }
+
+        // prepare the statements chosen by the statement warm up on the server, a failure is
+        // logged and the statements left to be prepared on first use
+        void warmStatements();
+
+        // prepare the data and error event statements for the traits on the server
+        void prepareDataEventStatements(const AttributeTraits &traits);
+
+        // run the query on the event loop, raising the pqxx exception the pqxx connection
+        // would have for a failure. When the query may have committed regardless, this is
+        // a pqxx::in_doubt_error, which is not retried
+        void executeOnEventLoop(const std::string &query);
+        void checkEventLoopResult(const PqEventLoop::Result &result);
+
+        // move the buffer into a batch
+        auto takeBuffer() -> SqlBatch;
+
+        // cut a batch from the buffer, sending it when there is an event loop
+        void cutBatch();
+
+        // send the buffer to the event loop as a pipelined batch
+        void sendBatch();
+
+        // store the batch, or wait on it when already sent, retrying each query on its own
+        // should the batch fail
+        void storeBatch(SqlBatch &batch, std::vector<std::size_t> *failed);
+
+        // count a buffered event, of the given tango type and if it is an error event, as
+        // stored or failed
+        void countEvent(const std::pair<int, bool> &type, bool stored);
+
+        // copy the batch controller decisions into the metrics
+        void publishBatchDecisions();
+
+        // add a query to the buffer, for the data or error event of the given tango type
+        void bufferQuery(std::string &&query, int type, bool error_event = false);
+
         void storeEvent(const std::string &full_attr_name, const std::string &event);
         void storeErrorMsg(const std::string &full_attr_name, const std::string &error_msg);
 
-        void checkAttributeExists(const std::string &full_attr_name, const std::string &location);
+        // returns false (rather than throwing) for an unknown attribute only when
+        // an event status is set
+        auto checkAttributeExists(const std::string &full_attr_name, const std::string &location) -> bool;
         void checkConnection(const std::string &location);
 
+        // reconnect after the connection was lost, unless the circuit breaker is open
+        void reconnect(const std::string &location);
+
+        // reload the id caches emptied by a reconnect
+        void warmCaches();
+
+        // track the state of the connection from the result of each transaction
+        void connectionLost(const std::string &what);
+        void connectionRestored();
+
         void handlePqxxError(
             const std::string &msg, const std::string &what, const std::string &query, const std::string &location);
 
@@ -154,6 +387,11 @@ namespace pqxx_conn
         // cache the state to save asking the actual connection over and over
         bool _connected = false;
 
+        // set when a transaction failed on a lost connection, until a transaction succeeds
+        // or a reconnect is made. The breaker guards the attempts to reconnect
+        bool _connection_lost = false;
+        CircuitBreaker _circuit_breaker;
+
         // cache some database entries to speed up lookup, for example
         // various string ids and type ids
 
@@ -168,12 +406,51 @@ namespace pqxx_conn
         // configured db access method
         DbStoreMethod _db_store_method;
 
+        // the statements prepared on the current connection, and those prepared on connect
+        std::unordered_set<std::string> _prepared_statements;
+        StatementWarmup _statement_warmup = StatementWarmup::None;
+        bool _rewarm_statements = false;
+
         // it is possible to buffer store requests as sql strings, then flush
         // them all to the database at once, this increases insert speed, since
         // multiple statements can be sent across the wire at once. This vector
         // holds the preapred sql until the connection is flushed
         bool _enable_buffering = false;
         std::vector<std::string> _sql_buffer;
+
+        // the tango type of each event in the sql buffer, and if it is an error
+        // event, so the metrics can be counted when the buffer is flushed
+        std::vector<std::pair<int, bool>> _sql_buffer_types;
+
+        // when set, the buffer is flushed over the event loop
+        std::unique_ptr<PqEventLoop> _event_loop;
+        std::chrono::milliseconds _event_loop_timeout {0};
+
+        // the batches cut from the buffer since the last flush, sent ahead by the pipeline
+        // when there is an event loop, and the number of queries they hold
+        std::deque<SqlBatch> _batches;
+        std::size_t _buffer_offset = 0;
+        std::size_t _pipeline_batch_size = 0;
+        std::size_t _pipeline_depth = 2;
+
+        // when enabled, decides when to cut a batch, timed from the first query buffered
+        BatchController _batch_controller;
+        std::chrono::steady_clock::time_point _buffer_start;
+
+        // runtime counters, read by stats()
+        ConnectionMetrics _metrics;
+
+        // times the event storage stages, see stageTimers()
+        mutable StageTimers _stage_timers;
+
+        // logs successful but slow statements
+        SlowQueryLog _slow_query_log;
+
+        // finds the attributes storing the most events
+        AttributeProfiler _attribute_profiler;
+
+        // when set, where the result of the current data event is reported
+        hdbpp::HdbEventStatus *_event_status = nullptr;
     };
 } // namespace pqxx_conn
 } // namespace hdbpp_internal
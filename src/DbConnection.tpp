@@ -21,6 +21,10 @@
 #define _PSQL_CONNECTION_TPP
 
 #include "PqxxExtension.hpp"
+#include "Probes.hpp"
+
+#include <string>
+#include <type_traits>
 
 namespace hdbpp_internal
 {
@@ -35,39 +39,43 @@ namespace pqxx_conn
         template<typename T>
         struct Store
         {
-            static void run(const std::unique_ptr<std::vector<T>> &value,
+            static void run(const DataSpan<T> &value,
                 const AttributeTraits &traits,
                 pqxx::prepare::invocation &inv,
                 pqxx::work & /*unused*/)
             {
-                // for a scalar, store the first element of the vector,
+                // for a scalar, store the first element of the span,
                 // we do not expect more than 1 element, for an array, store
-                // the entire vector
+                // the entire span
                 if (traits.isScalar())
-                    inv((*value)[0]);
+                    inv(value[0]);
                 else
-                    inv(*value);
+                    inv(value);
             }
         };
 
         template<>
         struct Store<std::string>
         {
-            static void run(const std::unique_ptr<std::vector<std::string>> &value,
+            static void run(const DataSpan<std::string> &value,
                 const AttributeTraits &traits,
                 pqxx::prepare::invocation &inv,
                 pqxx::work &tx)
             {
                 if (traits.isScalar())
-                    inv((*value)[0]);
+                    inv(value[0]);
                 else
                 {
                     // a string needs quoting to be stored via this method, so it does not cause
-                    // an error in the prepared statement
-                    for (auto &str : *value)
-                        str = tx.esc(str);
+                    // an error in the prepared statement. The span is read only, so the quoted
+                    // strings are built into a local copy
+                    std::vector<std::string> escaped;
+                    escaped.reserve(value.size());
+
+                    for (const auto &str : value)
+                        escaped.push_back(tx.esc(str));
 
-                    inv(*value);
+                    inv(escaped);
                 }
             }
         };
@@ -77,26 +85,146 @@ namespace pqxx_conn
         template<>
         struct Store<bool>
         {
-            static void run(const std::unique_ptr<std::vector<bool>> &value,
+            static void run(const DataSpan<bool> &value,
                 const AttributeTraits &traits,
                 pqxx::prepare::invocation &inv,
                 pqxx::work & /*unused*/)
             {
-                // a vector<bool> is not actually a vector<bool>, rather its some kind of bitfield. When
-                // trying to return an element, we appear to get some kind of bitfield reference (?),
-                // and since we have no way to handle this in the string_traits templates, it causes
-                // errors. Here we work around it, by creating a local variable and passing that instead
+                // the bool span may be viewing a vector<bool>, which is not actually a vector<bool>,
+                // rather its some kind of bitfield. The span returns elements by value, but we still
+                // pass a local variable so the invocation is bound to a real bool
                 if (traits.isScalar())
                 {
-                    bool v = (*value)[0];
+                    bool v = value[0];
                     inv(v);
                 }
                 else
-                    inv(*value);
+                    inv(value);
             }
         };
+
+        //=============================================================================
+        //=============================================================================
+        template<typename T>
+        auto dataBytes(const DataSpan<T> &value) -> std::size_t
+        {
+            return value.size() * sizeof(T);
+        }
+
+        inline auto dataBytes(const DataSpan<std::string> &value) -> std::size_t
+        {
+            std::size_t bytes = 0;
+
+            for (const auto &str : value)
+                bytes += str.size();
+
+            return bytes;
+        }
     } // namespace store_data_utils
 
+    namespace perform_utils
+    {
+        //=============================================================================
+        //=============================================================================
+        // run the function then done, returning the result of the function, which may be void
+        template<typename Func, typename Done>
+        auto runThen(Func &&func, Done &&done) ->
+            typename std::enable_if<std::is_void<decltype(func())>::value>::type
+        {
+            func();
+            done();
+        }
+
+        //=============================================================================
+        //=============================================================================
+        template<typename Func, typename Done>
+        auto runThen(Func &&func, Done &&done) ->
+            typename std::enable_if<!std::is_void<decltype(func())>::value, decltype(func())>::type
+        {
+            auto result = func();
+            done();
+            return result;
+        }
+    } // namespace perform_utils
+
+    //=============================================================================
+    //=============================================================================
+    template<typename Func>
+    auto DbConnection::perform(const std::string &statement_class,
+        Func &&func,
+        std::size_t rows,
+        const std::string *prepared_name,
+        bool record_slow) -> decltype(func())
+    {
+        // while the database is known to be down, fail fast rather than block on the network.
+        // The flush reaches here without checkConnection(), which reconnects
+        if (_connection_lost && _circuit_breaker.isOpen())
+            throw pqxx::broken_connection("The database is unavailable, the connection will be retried in " +
+                std::to_string(_circuit_breaker.retryIn().count()) + "ms");
+
+        if (_rewarm_statements)
+        {
+            _rewarm_statements = false;
+            warmStatements();
+        }
+
+        // pqxx::perform reruns the transaction when the connection breaks, so any
+        // call after the first is a retry
+        auto attempts = 0;
+
+        // the duration includes any retries, a failed statement is not recorded
+        SlowQueryLog::Scope slow_query_scope(_slow_query_log, statement_class, rows, prepared_name);
+
+        if (!record_slow)
+            slow_query_scope.dismiss();
+
+        try
+        {
+            auto run = [&, this]() {
+                return pqxx::perform([&, this]() {
+                    if (attempts++ > 0)
+                    {
+                        HDBPP_PROBE1(tx_retry, attempts);
+                        _metrics.retry();
+
+                        // the connection has been reset, losing its prepared statements on the
+                        // server. pqxx prepares each again on first use, so the next transaction
+                        // warms them up again first
+                        _rewarm_statements = true;
+                    }
+
+                    return func();
+                });
+            };
+
+            // pqxx may have reset a lost connection itself
+            return perform_utils::runThen(run, [this]() {
+                if (_connection_lost)
+                    connectionRestored();
+            });
+        }
+        catch (const pqxx::broken_connection &ex)
+        {
+            slow_query_scope.dismiss();
+            connectionLost(ex.what());
+            throw;
+        }
+        catch (const pqxx::in_doubt_error &ex)
+        {
+            // the connection broke during the commit, pqxx::perform does not run the
+            // transaction again since it may have committed, but the connection is lost all
+            // the same
+            slow_query_scope.dismiss();
+            connectionLost(ex.what());
+            throw;
+        }
+        catch (...)
+        {
+            slow_query_scope.dismiss();
+            throw;
+        }
+    }
+
     //=============================================================================
     //=============================================================================
     template<typename T>
@@ -106,79 +234,141 @@ namespace pqxx_conn
         std::unique_ptr<vector<T>> value_r,
         std::unique_ptr<vector<T>> value_w,
         const AttributeTraits &traits)
+    {
+        // an unset unique_ptr is treated the same as an empty vector, i.e. a null is stored
+        storeDataEvent<T>(full_attr_name,
+            event_time,
+            quality,
+            value_r ? DataSpan<T>(*value_r) : DataSpan<T>(),
+            value_w ? DataSpan<T>(*value_w) : DataSpan<T>(),
+            traits);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    template<typename T>
+    void DbConnection::storeDataEvent(const std::string &full_attr_name,
+        double event_time,
+        int quality,
+        const DataSpan<T> &value_r,
+        const DataSpan<T> &value_w,
+        const AttributeTraits &traits)
     {
         assert(!full_attr_name.empty());
         assert(traits.isValid());
 
-        spdlog::trace("Storing data event for attribute {} with traits {}, value_r valid: {}, value_w valid: {}",
+        HDBPP_LOG_TRACE("Storing data event for attribute {} with traits {}, value_r valid: {}, value_w valid: {}",
             full_attr_name,
             traits,
-            !value_r->empty(),
-            !value_w->empty());
+            !value_r.empty(),
+            !value_w.empty());
 
         checkConnection(LOCATION_INFO);
-        checkAttributeExists(full_attr_name, LOCATION_INFO);
+
+        if (!checkAttributeExists(full_attr_name, LOCATION_INFO))
+        {
+            _metrics.eventFailed(traits.type());
+            return;
+        }
+
+        // the attribute is now known to be cached, so look its id up once for all paths
+        auto conf_id = _conf_id_cache->value(full_attr_name);
+
+        if (_attribute_profiler.enabled())
+        {
+            _attribute_profiler.record(conf_id,
+                full_attr_name,
+                store_data_utils::dataBytes(value_r) + store_data_utils::dataBytes(value_w),
+                false);
+        }
 
         // if we are buffering the queries, then just save it until the buffer is flushed,
         // otherwise execute directly
         if (_enable_buffering)
         {
-            auto query = QueryBuilder::storeDataEventString<T>(pqxx::to_string(_conf_id_cache->value(full_attr_name)),
-                pqxx::to_string(event_time),
-                pqxx::to_string(quality),
-                value_r,
-                value_w,
-                traits);
+            std::string query;
+
+            {
+                ScopedStageTimer timer(&_stage_timers, Stage::QueryBuild);
+
+                query = QueryBuilder::storeDataEventString<T>(pqxx::to_string(conf_id),
+                    pqxx::to_string(event_time),
+                    pqxx::to_string(quality),
+                    value_r,
+                    value_w,
+                    traits);
 
-            query += ";";
-            _sql_buffer.push_back(query);
+                query += ";";
+            }
+
+            // buffering may cut a batch, and wait on the pipeline, which is not query building
+            bufferQuery(std::move(query), traits.type());
         }
         else
         {
+            // there is a single special case here, arrays of strings need a different syntax to store,
+            // to avoid the quoting. Its likely we will need more for DevEncoded and DevEnum
+            auto use_prepared = !(_db_store_method == DbStoreMethod::InsertString ||
+                (traits.isArray() && traits.type() == Tango::DEV_STRING));
+
+            const auto &prepared_name = _query_builder.storeDataEventName(traits);
+
+            // the slow query log may have sampled this statement to be run via explain
+            auto explain = use_prepared && _slow_query_log.takeExplain(prepared_name);
+
             try
             {
-                return pqxx::perform([&, this]() {
+                auto store = [&, this]() {
                     pqxx::work tx {(*_conn), StoreDataEvent};
 
-                    // there is a single special case here, arrays of strings need a different syntax to store,
-                    // to avoid the quoting. Its likely we will need more for DevEncoded and DevEnum
-                    if (_db_store_method == DbStoreMethod::InsertString ||
-                        (traits.isArray() && traits.type() == Tango::DEV_STRING) || _enable_buffering)
+                    if (!use_prepared)
                     {
-                        auto query = QueryBuilder::storeDataEventString<T>(
-                            pqxx::to_string(_conf_id_cache->value(full_attr_name)),
-                            pqxx::to_string(event_time),
-                            pqxx::to_string(quality),
-                            value_r,
-                            value_w,
-                            traits);
+                        std::string query;
+
+                        {
+                            ScopedStageTimer timer(&_stage_timers, Stage::QueryBuild);
+
+                            query = QueryBuilder::storeDataEventString<T>(pqxx::to_string(conf_id),
+                                pqxx::to_string(event_time),
+                                pqxx::to_string(quality),
+                                value_r,
+                                value_w,
+                                traits);
+                        }
 
                         if (_enable_buffering)
-                            _sql_buffer.push_back(query);
+                            bufferQuery(std::move(query), traits.type());
                         else
+                        {
+                            ScopedStageTimer timer(&_stage_timers, Stage::Execute);
                             tx.exec0(query);
+                        }
                     }
                     else
                     {
                         // prepare as a prepared statement, we are going to use these
                         // queries often
-                        if (!tx.prepared(_query_builder.storeDataEventName(traits)).exists())
+                        if (!isPrepared(prepared_name))
+                            prepareStatement(prepared_name, _query_builder.storeDataEventStatement<T>(traits));
+
+                        // the explain variant takes the same parameters and still stores the data
+                        if (explain && !isPrepared(SlowQueryLog::explainName(prepared_name)))
                         {
-                            tx.conn().prepare(_query_builder.storeDataEventName(traits),
-                                _query_builder.storeDataEventStatement<T>(traits));
+                            prepareStatement(SlowQueryLog::explainName(prepared_name),
+                                SlowQueryLog::explainStatement(_query_builder.storeDataEventStatement<T>(traits)));
                         }
 
                         // get the pqxx prepared statement invocation object to allow us to
                         // bind each parameter in turn, this gives us the flexibility to bind
                         // conditional parameters (as long as the query string matches)
-                        auto inv = tx.prepared(_query_builder.storeDataEventName(traits));
+                        auto inv = tx.prepared(explain ? SlowQueryLog::explainName(prepared_name) : prepared_name);
 
                         // this lambda stores the data value correctly into the invocation,
                         // we must treat scalar/spectrum in different ways, one is a single
-                        // element and the other an array. Further, the unique_ptr may be
+                        // element and the other an array. Further, the span may be
                         // empty and signify a null should be stored in the column instead
-                        auto store_value = [&tx, &traits, &inv](auto &value) {
-                            if (value && !value->empty())
+                        auto store_value = [&tx, &traits, &inv](const DataSpan<T> &value) {
+                            if (!value.empty())
                             {
                                 store_data_utils::Store<T>::run(value, traits, inv, tx);
                             }
@@ -192,27 +382,50 @@ namespace pqxx_conn
                         };
 
                         // bind all the parameters
-                        inv(_conf_id_cache->value(full_attr_name));
-                        inv(event_time);
+                        {
+                            ScopedStageTimer timer(&_stage_timers, Stage::QueryBuild);
+                            inv(conf_id);
+                            inv(event_time);
 
-                        if (traits.hasReadData())
-                            store_value(value_r);
+                            if (traits.hasReadData())
+                                store_value(value_r);
 
-                        if (traits.hasWriteData())
-                            store_value(value_w);
+                            if (traits.hasWriteData())
+                                store_value(value_w);
 
-                        inv(quality);
+                            inv(quality);
+                        }
 
                         // execute
-                        inv.exec();
+                        ScopedStageTimer timer(&_stage_timers, Stage::Execute);
+                        auto result = inv.exec();
+
+                        if (explain)
+                        {
+                            std::vector<std::string> plan;
+
+                            for (const auto &row : result)
+                                plan.emplace_back(row[0].c_str());
+
+                            SlowQueryLog::logPlan(prepared_name, plan);
+                        }
                     }
 
                     // commit the result
+                    ScopedStageTimer timer(&_stage_timers, Stage::Commit);
                     tx.commit();
-                });
+                };
+
+                // the explain runs slower than the statement it samples, so it is not recorded,
+                // it would be logged as slow and count towards the next sample
+                perform(StoreDataEvent, store, 1, use_prepared ? &prepared_name : nullptr, !explain);
+
+                _metrics.eventStored(traits.type());
             }
             catch (const pqxx::pqxx_exception &ex)
             {
+                _metrics.eventFailed(traits.type());
+
                 handlePqxxError("The attribute [" + full_attr_name + "] data event was not saved.",
                     ex.base().what(),
                     _query_builder.storeDataEventStatement<T>(traits),
@@ -0,0 +1,667 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "EventCapture.hpp"
+
+#include "AttributeTraits.hpp"
+#include "LibUtils.hpp"
+
+#include <sys/time.h>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+namespace
+{
+    //=============================================================================
+    //=============================================================================
+    template<typename T>
+    void writePod(ostream &os, const T &value)
+    {
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+        os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    //=============================================================================
+    //=============================================================================
+    template<typename T>
+    auto readPod(istream &is) -> T
+    {
+        T value {};
+
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+        is.read(reinterpret_cast<char *>(&value), sizeof(T));
+        return value;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void writeString(ostream &os, const string &value)
+    {
+        writePod<uint32_t>(os, static_cast<uint32_t>(value.size()));
+        os.write(value.data(), value.size());
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto readString(istream &is) -> string
+    {
+        auto size = readPod<uint32_t>(is);
+        string value(size, '\0');
+        is.read(&value[0], size);
+        return value;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void writeTime(ostream &os, const Tango::TimeVal &tv)
+    {
+        writePod<int64_t>(os, tv.tv_sec);
+        writePod<int64_t>(os, tv.tv_usec);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto readTime(istream &is) -> Tango::TimeVal
+    {
+        Tango::TimeVal tv {};
+        tv.tv_sec = readPod<int64_t>(is);
+        tv.tv_usec = readPod<int64_t>(is);
+        tv.tv_nsec = 0;
+        return tv;
+    }
+
+    // Event values, fixed size types are written as a block, bools and strings element by element
+    template<typename T>
+    struct Values
+    {
+        static void write(ostream &os, const vector<T> &values)
+        {
+            writePod<uint32_t>(os, static_cast<uint32_t>(values.size()));
+            os.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+        }
+
+        static void read(istream &is, vector<T> &values)
+        {
+            values.resize(readPod<uint32_t>(is));
+            is.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(T));
+        }
+    };
+
+    template<>
+    struct Values<bool>
+    {
+        static void write(ostream &os, const vector<bool> &values)
+        {
+            writePod<uint32_t>(os, static_cast<uint32_t>(values.size()));
+
+            for (auto value : values)
+                writePod<uint8_t>(os, value ? 1 : 0);
+        }
+
+        static void read(istream &is, vector<bool> &values)
+        {
+            values.resize(readPod<uint32_t>(is));
+
+            for (size_t i = 0; i < values.size(); i++)
+                values[i] = readPod<uint8_t>(is) != 0;
+        }
+    };
+
+    template<>
+    struct Values<string>
+    {
+        static void write(ostream &os, const vector<string> &values)
+        {
+            writePod<uint32_t>(os, static_cast<uint32_t>(values.size()));
+
+            for (auto &value : values)
+                writeString(os, value);
+        }
+
+        static void read(istream &is, vector<string> &values)
+        {
+            values.resize(readPod<uint32_t>(is));
+
+            for (auto &value : values)
+                value = readString(is);
+        }
+    };
+
+    //=============================================================================
+    //=============================================================================
+    template<typename T>
+    void extractRead(Tango::DeviceAttribute &attr, const AttributeTraits & /*traits*/, vector<T> &value)
+    {
+        attr.extract_read(value);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void extractRead(Tango::DeviceAttribute &attr, const AttributeTraits &traits, vector<Tango::DevState> &value)
+    {
+        // a scalar state is streamed out, as in HdbppTxDataEvent
+        if (traits.isScalar())
+        {
+            Tango::DevState state;
+
+            if (attr >> state)
+                value.push_back(state);
+        }
+        else
+            attr.extract_read(value);
+    }
+
+    //=============================================================================
+    //=============================================================================
+    template<typename Func>
+    auto withStorageType(int type, Func &&func) -> bool
+    {
+        // maps the tango type to the type the data is extracted as, this matches the
+        // types used by HdbppTxDataEvent
+        switch (type)
+        {
+            case Tango::DEV_BOOLEAN: func(bool {}); break;
+            case Tango::DEV_SHORT: func(int16_t {}); break;
+            case Tango::DEV_LONG: func(int32_t {}); break;
+            case Tango::DEV_LONG64: func(int64_t {}); break;
+            case Tango::DEV_FLOAT: func(float {}); break;
+            case Tango::DEV_DOUBLE: func(double {}); break;
+            case Tango::DEV_UCHAR: func(uint8_t {}); break;
+            case Tango::DEV_USHORT: func(uint16_t {}); break;
+            case Tango::DEV_ULONG: func(uint32_t {}); break;
+            case Tango::DEV_ULONG64: func(uint64_t {}); break;
+            case Tango::DEV_STRING: func(string {}); break;
+            case Tango::DEV_STATE: func(Tango::DevState {}); break;
+            case Tango::DEV_ENUM: func(int16_t {}); break;
+            default: return false;
+        }
+
+        return true;
+    }
+} // namespace
+
+//=============================================================================
+//=============================================================================
+EventCaptureWriter::EventCaptureWriter(const string &file_name) :
+    _file(file_name, ios::binary | ios::trunc), _file_name(file_name), _start(chrono::steady_clock::now())
+{
+    if (!_file.is_open())
+    {
+        string msg {"Unable to open the event capture file: " + file_name};
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    struct timeval tv
+    {};
+
+    gettimeofday(&tv, nullptr);
+
+    _file.write(capture::Magic.data(), capture::Magic.size());
+    writePod<uint32_t>(_file, capture::Version);
+    writePod<int64_t>(_file, tv.tv_sec);
+    writePod<int64_t>(_file, tv.tv_usec);
+
+    _enabled = true;
+    checkStream();
+    spdlog::info("Capturing events to file: {}", file_name);
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::addAttribute(const string &fqdn_attr_name, int type, int format, int write_type)
+{
+    lock_guard<mutex> lock(_lock);
+
+    if (!_enabled)
+        return;
+
+    writeHeader(capture::CaptureRecordType::AddAttribute);
+    writeString(_file, fqdn_attr_name);
+    writePod<int32_t>(_file, type);
+    writePod<int32_t>(_file, format);
+    writePod<int32_t>(_file, write_type);
+    checkStream();
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::insertEvent(Tango::EventData *event_data, const hdbpp::HdbEventDataType &data_type)
+{
+    lock_guard<mutex> lock(_lock);
+
+    if (!_enabled)
+        return;
+
+    writeHeader(capture::CaptureRecordType::InsertEvent);
+    writeEvent(event_data, data_type);
+    checkStream();
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::insertEvents(const vector<tuple<Tango::EventData *, hdbpp::HdbEventDataType>> &events)
+{
+    lock_guard<mutex> lock(_lock);
+
+    if (!_enabled)
+        return;
+
+    writeHeader(capture::CaptureRecordType::InsertEvents);
+    writePod<uint32_t>(_file, static_cast<uint32_t>(events.size()));
+
+    for (auto &event : events)
+        writeEvent(get<0>(event), get<1>(event));
+
+    checkStream();
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::insertParamEvent(Tango::AttrConfEventData *param_event)
+{
+    lock_guard<mutex> lock(_lock);
+
+    if (!_enabled)
+        return;
+
+    auto &info = *(param_event->attr_conf);
+
+    writeHeader(capture::CaptureRecordType::ParamEvent);
+    writeString(_file, param_event->attr_name);
+    writeTime(_file, param_event->get_date());
+    writeString(_file, info.label);
+    writeString(_file, info.unit);
+    writeString(_file, info.standard_unit);
+    writeString(_file, info.display_unit);
+    writeString(_file, info.format);
+    writeString(_file, info.description);
+    writeString(_file, info.events.arch_event.archive_rel_change);
+    writeString(_file, info.events.arch_event.archive_abs_change);
+    writeString(_file, info.events.arch_event.archive_period);
+    Values<string>::write(_file, info.enum_labels);
+    checkStream();
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::insertHistoryEvent(const string &fqdn_attr_name, unsigned char event)
+{
+    lock_guard<mutex> lock(_lock);
+
+    if (!_enabled)
+        return;
+
+    writeHeader(capture::CaptureRecordType::HistoryEvent);
+    writeString(_file, fqdn_attr_name);
+    writePod<uint8_t>(_file, event);
+    checkStream();
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::updateTtl(const string &fqdn_attr_name, unsigned int ttl)
+{
+    lock_guard<mutex> lock(_lock);
+
+    if (!_enabled)
+        return;
+
+    writeHeader(capture::CaptureRecordType::UpdateTtl);
+    writeString(_file, fqdn_attr_name);
+    writePod<uint32_t>(_file, ttl);
+    checkStream();
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::writeHeader(capture::CaptureRecordType type)
+{
+    auto offset = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - _start);
+    writePod<uint8_t>(_file, static_cast<uint8_t>(type));
+    writePod<uint64_t>(_file, static_cast<uint64_t>(offset.count()));
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::writeEvent(Tango::EventData *event_data, const hdbpp::HdbEventDataType &data_type)
+{
+    writeString(_file, data_type.attr_name);
+    writePod<int32_t>(_file, data_type.max_dim_x);
+    writePod<int32_t>(_file, data_type.max_dim_y);
+    writePod<int32_t>(_file, data_type.data_type);
+    writePod<int32_t>(_file, static_cast<int32_t>(data_type.data_format));
+    writePod<int32_t>(_file, data_type.write_type);
+
+    writeString(_file, event_data->attr_name);
+    writePod<uint8_t>(_file, event_data->err ? 1 : 0);
+
+    if (event_data->err)
+        writeString(_file, event_data->errors.length() > 0 ? string(event_data->errors[0].desc) : string());
+
+    writePod<uint8_t>(_file, event_data->attr_value != nullptr ? 1 : 0);
+
+    if (event_data->attr_value == nullptr)
+        return;
+
+    auto &attr = *(event_data->attr_value);
+
+    writePod<int32_t>(_file, attr.get_quality());
+    writeTime(_file, attr.get_date());
+    writePod<int32_t>(_file, attr.dim_x);
+    writePod<int32_t>(_file, attr.dim_y);
+    writePod<int32_t>(_file, attr.w_dim_x);
+    writePod<int32_t>(_file, attr.w_dim_y);
+
+    // the data is extracted from a copy, since extraction may alter the state of the
+    // attribute, and the original must be stored unchanged
+    AttributeTraits traits {static_cast<Tango::AttrWriteType>(data_type.write_type),
+        data_type.data_format,
+        static_cast<Tango::CmdArgType>(data_type.data_type)};
+
+    auto supported = withStorageType(data_type.data_type, [&](auto tag) {
+        using T = decltype(tag);
+
+        vector<T> value_r;
+        vector<T> value_w;
+
+        Tango::DeviceAttribute copy(attr);
+        copy.reset_exceptions(Tango::DeviceAttribute::isempty_flag);
+
+        // only events that would store data have their data captured
+        if (!event_data->err && !copy.is_empty() && copy.get_quality() != Tango::ATTR_INVALID)
+        {
+            if (traits.hasReadData())
+                extractRead(copy, traits, value_r);
+
+            if (traits.hasWriteData())
+                copy.extract_set(value_w);
+        }
+
+        Values<T>::write(_file, value_r);
+        Values<T>::write(_file, value_w);
+    });
+
+    // unsupported types are recorded with no data, as the library will not store them either
+    if (!supported)
+    {
+        writePod<uint32_t>(_file, 0);
+        writePod<uint32_t>(_file, 0);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureWriter::checkStream()
+{
+    if (!_file.good())
+    {
+        spdlog::error("Error: Failed to write to the event capture file: {}, capture disabled", _file_name);
+        _enabled = false;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+auto CaptureRecord::eventTuples() const -> vector<tuple<Tango::EventData *, hdbpp::HdbEventDataType>>
+{
+    vector<tuple<Tango::EventData *, hdbpp::HdbEventDataType>> tuples;
+
+    for (size_t i = 0; i < events.size(); i++)
+        tuples.emplace_back(events[i].get(), event_types[i]);
+
+    return tuples;
+}
+
+//=============================================================================
+//=============================================================================
+auto copyEventData(const Tango::EventData &event_data) -> unique_ptr<Tango::EventData>
+{
+    // the DeviceAttribute copy constructor copies the data sequences
+    auto *attr = event_data.attr_value != nullptr ? new Tango::DeviceAttribute(*event_data.attr_value) : nullptr;
+
+    auto attr_name = event_data.attr_name;
+    auto event = event_data.event;
+    auto errors = event_data.errors;
+
+    // the event takes ownership of the attribute, the device is not copied since the
+    // library never uses it, and the proxy may be gone by the time the copy is stored
+    auto copy = make_unique<Tango::EventData>(nullptr, attr_name, event, attr, errors);
+    copy->err = event_data.err;
+    copy->reception_date = event_data.reception_date;
+    return copy;
+}
+
+//=============================================================================
+//=============================================================================
+EventCaptureReader::EventCaptureReader(const string &file_name) : _file(file_name, ios::binary), _file_name(file_name)
+{
+    string magic(capture::Magic.size(), '\0');
+    _file.read(&magic[0], magic.size());
+
+    if (!_file.good() || magic != capture::Magic)
+    {
+        string msg {"The file is not an event capture file: " + file_name};
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    auto version = readPod<uint32_t>(_file);
+
+    if (version != capture::Version)
+    {
+        string msg {"Unsupported event capture file version: " + to_string(version) + " in file: " + file_name};
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    auto start = readTime(_file);
+    _start_time = start.tv_sec + start.tv_usec / 1.0e6;
+    checkStream();
+}
+
+//=============================================================================
+//=============================================================================
+auto EventCaptureReader::next(CaptureRecord &record) -> bool
+{
+    auto type = _file.get();
+
+    if (type == char_traits<char>::eof())
+        return false;
+
+    record = CaptureRecord();
+    record.type = static_cast<capture::CaptureRecordType>(type);
+    record.offset = chrono::nanoseconds(readPod<uint64_t>(_file));
+
+    switch (record.type)
+    {
+        case capture::CaptureRecordType::AddAttribute:
+            record.attr_name = readString(_file);
+            record.data_type = readPod<int32_t>(_file);
+            record.data_format = readPod<int32_t>(_file);
+            record.write_type = readPod<int32_t>(_file);
+            break;
+
+        case capture::CaptureRecordType::InsertEvent:
+        case capture::CaptureRecordType::InsertEvents:
+        {
+            auto count = record.type == capture::CaptureRecordType::InsertEvent ? 1 : readPod<uint32_t>(_file);
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                auto event = readEvent();
+                record.events.push_back(move(get<0>(event)));
+                record.event_types.push_back(get<1>(event));
+            }
+
+            break;
+        }
+
+        case capture::CaptureRecordType::ParamEvent:
+        {
+            auto info = new Tango::AttributeInfoEx();
+            record.attr_name = readString(_file);
+            auto tv = shift(readTime(_file));
+            info->label = readString(_file);
+            info->unit = readString(_file);
+            info->standard_unit = readString(_file);
+            info->display_unit = readString(_file);
+            info->format = readString(_file);
+            info->description = readString(_file);
+            info->events.arch_event.archive_rel_change = readString(_file);
+            info->events.arch_event.archive_abs_change = readString(_file);
+            info->events.arch_event.archive_period = readString(_file);
+            Values<string>::read(_file, info->enum_labels);
+
+            // the event takes ownership of the attribute info
+            string event = "attr_conf";
+            Tango::DevErrorList errors;
+            record.param_event = make_unique<Tango::AttrConfEventData>(nullptr, record.attr_name, event, info, errors);
+            record.param_event->reception_date = tv;
+            break;
+        }
+
+        case capture::CaptureRecordType::HistoryEvent:
+            record.attr_name = readString(_file);
+            record.history_event = readPod<uint8_t>(_file);
+            break;
+
+        case capture::CaptureRecordType::UpdateTtl:
+            record.attr_name = readString(_file);
+            record.ttl = readPod<uint32_t>(_file);
+            break;
+
+        default:
+            string msg {"Unknown record type: " + to_string(type) + " in event capture file: " + _file_name};
+            spdlog::error("Error: {}", msg);
+            Tango::Except::throw_exception("Runtime Error", msg, LOCATION_INFO);
+    }
+
+    checkStream();
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+auto EventCaptureReader::readEvent() -> tuple<unique_ptr<Tango::EventData>, hdbpp::HdbEventDataType>
+{
+    hdbpp::HdbEventDataType data_type;
+    data_type.attr_name = readString(_file);
+    data_type.max_dim_x = readPod<int32_t>(_file);
+    data_type.max_dim_y = readPod<int32_t>(_file);
+    data_type.data_type = readPod<int32_t>(_file);
+    data_type.data_format = static_cast<Tango::AttrDataFormat>(readPod<int32_t>(_file));
+    data_type.write_type = readPod<int32_t>(_file);
+
+    auto attr_name = readString(_file);
+    auto err = readPod<uint8_t>(_file) != 0;
+
+    Tango::DevErrorList errors;
+
+    if (err)
+    {
+        auto desc = readString(_file);
+        errors.length(1);
+        errors[0].reason = CORBA::string_dup("API_EventCapture");
+        errors[0].desc = CORBA::string_dup(desc.c_str());
+        errors[0].origin = CORBA::string_dup("EventCaptureReader");
+    }
+
+    Tango::DeviceAttribute *attr = nullptr;
+
+    if (readPod<uint8_t>(_file) != 0)
+    {
+        auto quality = static_cast<Tango::AttrQuality>(readPod<int32_t>(_file));
+        auto tv = shift(readTime(_file));
+        auto dim_x = readPod<int32_t>(_file);
+        auto dim_y = readPod<int32_t>(_file);
+        auto w_dim_x = readPod<int32_t>(_file);
+        auto w_dim_y = readPod<int32_t>(_file);
+
+        auto supported = withStorageType(data_type.data_type, [&](auto tag) {
+            using T = decltype(tag);
+
+            vector<T> value_r;
+            vector<T> value_w;
+            Values<T>::read(_file, value_r);
+            Values<T>::read(_file, value_w);
+
+            if (value_r.empty() && value_w.empty())
+            {
+                attr = new Tango::DeviceAttribute();
+            }
+            else
+            {
+                // Tango delivers the read data followed by the set point in a single sequence
+                vector<T> value = value_r;
+                value.insert(value.end(), value_w.begin(), value_w.end());
+                attr = new Tango::DeviceAttribute(attr_name.c_str(), value);
+            }
+        });
+
+        if (!supported)
+        {
+            readPod<uint32_t>(_file);
+            readPod<uint32_t>(_file);
+            attr = new Tango::DeviceAttribute();
+        }
+
+        attr->quality = quality;
+        attr->time = tv;
+        attr->dim_x = dim_x;
+        attr->dim_y = dim_y;
+        attr->w_dim_x = w_dim_x;
+        attr->w_dim_y = w_dim_y;
+    }
+
+    // the event takes ownership of the attribute
+    string event = "archive";
+    auto event_data = make_unique<Tango::EventData>(nullptr, attr_name, event, attr, errors);
+    event_data->err = err;
+
+    return make_tuple(move(event_data), data_type);
+}
+
+//=============================================================================
+//=============================================================================
+auto EventCaptureReader::shift(Tango::TimeVal tv) const -> Tango::TimeVal
+{
+    if (_time_shift == 0.0)
+        return tv;
+
+    auto usec = static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec + static_cast<int64_t>(_time_shift * 1.0e6);
+    tv.tv_sec = usec / 1000000;
+    tv.tv_usec = usec % 1000000;
+    return tv;
+}
+
+//=============================================================================
+//=============================================================================
+void EventCaptureReader::checkStream()
+{
+    if (!_file.good())
+    {
+        string msg {"Unexpected end of event capture file: " + _file_name};
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Runtime Error", msg, LOCATION_INFO);
+    }
+}
+
+} // namespace hdbpp_internal
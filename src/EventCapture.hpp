@@ -0,0 +1,152 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _EVENT_CAPTURE_HPP
+#define _EVENT_CAPTURE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <hdb++/AbstractDB.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tango.h>
+#include <tuple>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// The capture file records the exact stream of calls made into the library, with their
+// payloads and the time they were made, so a production load can be replayed later
+// against a test database (see the replay-tool in the benchmarks). The format is a
+// simple binary stream, in host byte order:
+//
+//   header: "HDBPPCAP", uint32 version, int64 start time (seconds), int64 start time (microseconds)
+//   record: uint8 CaptureRecordType, uint64 nanoseconds since the start, payload
+//
+// Strings are written as a uint32 length then the characters, and event data as
+// uint32 element counts followed by the values.
+namespace capture
+{
+    const std::string Magic = "HDBPPCAP";
+    const uint32_t Version = 1;
+
+    enum class CaptureRecordType : uint8_t
+    {
+        AddAttribute = 1,
+        InsertEvent = 2,
+        InsertEvents = 3,
+        ParamEvent = 4,
+        HistoryEvent = 5,
+        UpdateTtl = 6
+    };
+} // namespace capture
+
+// Writes the calls made into the library to a capture file. A failure to write
+// disables the capture, with an error logged, archiving is never interrupted by it.
+class EventCaptureWriter
+{
+public:
+    // open the capture file, throws a Tango exception if the file can not be created
+    EventCaptureWriter(const std::string &file_name);
+
+    void addAttribute(const std::string &fqdn_attr_name, int type, int format, int write_type);
+    void insertEvent(Tango::EventData *event_data, const hdbpp::HdbEventDataType &data_type);
+    void insertEvents(const std::vector<std::tuple<Tango::EventData *, hdbpp::HdbEventDataType>> &events);
+    void insertParamEvent(Tango::AttrConfEventData *param_event);
+    void insertHistoryEvent(const std::string &fqdn_attr_name, unsigned char event);
+    void updateTtl(const std::string &fqdn_attr_name, unsigned int ttl);
+
+    auto isOpen() const noexcept -> bool { return _enabled; }
+
+private:
+    void writeHeader(capture::CaptureRecordType type);
+    void writeEvent(Tango::EventData *event_data, const hdbpp::HdbEventDataType &data_type);
+    void checkStream();
+
+    std::mutex _lock;
+    std::ofstream _file;
+    std::string _file_name;
+    bool _enabled = false;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// A single call read back from a capture file. Only the fields relevant to the
+// record type are set. The record owns any Tango objects it holds.
+struct CaptureRecord
+{
+    capture::CaptureRecordType type;
+
+    // time since the capture started
+    std::chrono::nanoseconds offset;
+
+    // AddAttribute, HistoryEvent, UpdateTtl
+    std::string attr_name;
+    int data_type = 0;
+    int data_format = 0;
+    int write_type = 0;
+    unsigned char history_event = 0;
+    unsigned int ttl = 0;
+
+    // InsertEvent (a single entry) and InsertEvents
+    std::vector<std::unique_ptr<Tango::EventData>> events;
+    std::vector<hdbpp::HdbEventDataType> event_types;
+
+    // ParamEvent
+    std::unique_ptr<Tango::AttrConfEventData> param_event;
+
+    // get the events as passed to insert_events()
+    auto eventTuples() const -> std::vector<std::tuple<Tango::EventData *, hdbpp::HdbEventDataType>>;
+};
+
+// Deep copy an event, including its attribute value and errors, so it can be stored after
+// the original has been released. The copy owns its attribute value
+auto copyEventData(const Tango::EventData &event_data) -> std::unique_ptr<Tango::EventData>;
+
+// Reads a capture file back as a series of CaptureRecords, with the Tango event objects
+// rebuilt so they can be passed straight back into the library.
+class EventCaptureReader
+{
+public:
+    // open the capture file, throws a Tango exception if it is missing or not a capture file
+    EventCaptureReader(const std::string &file_name);
+
+    // read the next record, returns false at the end of the file
+    auto next(CaptureRecord &record) -> bool;
+
+    // wall clock time the capture was started, in seconds since the epoch
+    auto startTime() const noexcept -> double { return _start_time; }
+
+    // shift all event times by the given number of seconds, so a capture can be replayed
+    // into a database more than once without the events colliding
+    void shiftEventTimes(double seconds) noexcept { _time_shift = seconds; }
+
+private:
+    auto readEvent() -> std::tuple<std::unique_ptr<Tango::EventData>, hdbpp::HdbEventDataType>;
+    auto shift(Tango::TimeVal tv) const -> Tango::TimeVal;
+    void checkStream();
+
+    std::ifstream _file;
+    std::string _file_name;
+    double _start_time = 0.0;
+    double _time_shift = 0.0;
+};
+
+} // namespace hdbpp_internal
+#endif // _EVENT_CAPTURE_HPP
@@ -22,6 +22,7 @@
 #include <hdb++/HdbClient.h>
 
 using namespace std;
+using namespace hdbpp_internal;
 
 namespace hdbpp
 {
@@ -47,6 +48,152 @@ void HdbClient::insert_events(vector<tuple<Tango::EventData *, HdbEventDataType>
     _db->insert_events(events);
 }
 
+//=============================================================================
+//=============================================================================
+vector<HdbEventStatus> HdbClient::insert_events_status(vector<tuple<Tango::EventData *, HdbEventDataType>> events)
+{
+    return static_cast<HdbppTimescaleDbApi *>(_db.get())->insert_events_status(move(events));
+}
+
+//=============================================================================
+//=============================================================================
+future<HdbEventStatus> HdbClient::insert_event_async(Tango::EventData *event, const HdbEventDataType &data_type)
+{
+    return static_cast<HdbppTimescaleDbApi *>(_db.get())->insert_event_async(event, data_type);
+}
+
+//=============================================================================
+//=============================================================================
+future<vector<HdbEventStatus>> HdbClient::insert_events_async(
+    vector<tuple<Tango::EventData *, HdbEventDataType>> events)
+{
+    return static_cast<HdbppTimescaleDbApi *>(_db.get())->insert_events_async(move(events));
+}
+
+//=============================================================================
+//=============================================================================
+void HdbClient::insert_events_async(
+    vector<tuple<Tango::EventData *, HdbEventDataType>> events, HdbInsertCallback callback)
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())->insert_events_async(move(events), move(callback));
+}
+
+//=============================================================================
+//=============================================================================
+HdbAttributeHandle HdbClient::attribute_handle(const string &name)
+{
+    return static_cast<HdbppTimescaleDbApi *>(_db.get())->attribute_handle(name);
+}
+
+//=============================================================================
+//=============================================================================
+template<typename T>
+void HdbClient::store_scalar(HdbAttributeHandle handle, int64_t time_us, int quality, const T &value_r)
+{
+    // without a write value, the write part is stored without data
+    static_cast<HdbppTimescaleDbApi *>(_db.get())
+        ->store_data<T>(handle, time_us, quality, DataSpan<T>(&value_r, 1), DataSpan<T>(), true);
+}
+
+//=============================================================================
+//=============================================================================
+template<typename T>
+void HdbClient::store_scalar(
+    HdbAttributeHandle handle, int64_t time_us, int quality, const T &value_r, const T &value_w)
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())
+        ->store_data<T>(handle, time_us, quality, DataSpan<T>(&value_r, 1), DataSpan<T>(&value_w, 1), true);
+}
+
+//=============================================================================
+//=============================================================================
+template<typename T>
+void HdbClient::store_array(HdbAttributeHandle handle,
+    int64_t time_us,
+    int quality,
+    const T *value_r,
+    size_t size_r,
+    const T *value_w,
+    size_t size_w)
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())
+        ->store_data<T>(handle, time_us, quality, DataSpan<T>(value_r, size_r), DataSpan<T>(value_w, size_w), false);
+}
+
+// the types supported by the typed api
+template void HdbClient::store_scalar<bool>(HdbAttributeHandle, int64_t, int, const bool &);
+template void HdbClient::store_scalar<int16_t>(HdbAttributeHandle, int64_t, int, const int16_t &);
+template void HdbClient::store_scalar<int32_t>(HdbAttributeHandle, int64_t, int, const int32_t &);
+template void HdbClient::store_scalar<int64_t>(HdbAttributeHandle, int64_t, int, const int64_t &);
+template void HdbClient::store_scalar<float>(HdbAttributeHandle, int64_t, int, const float &);
+template void HdbClient::store_scalar<double>(HdbAttributeHandle, int64_t, int, const double &);
+template void HdbClient::store_scalar<uint8_t>(HdbAttributeHandle, int64_t, int, const uint8_t &);
+template void HdbClient::store_scalar<uint16_t>(HdbAttributeHandle, int64_t, int, const uint16_t &);
+template void HdbClient::store_scalar<uint32_t>(HdbAttributeHandle, int64_t, int, const uint32_t &);
+template void HdbClient::store_scalar<uint64_t>(HdbAttributeHandle, int64_t, int, const uint64_t &);
+template void HdbClient::store_scalar<string>(HdbAttributeHandle, int64_t, int, const string &);
+template void HdbClient::store_scalar<Tango::DevState>(HdbAttributeHandle, int64_t, int, const Tango::DevState &);
+
+template void HdbClient::store_scalar<bool>(HdbAttributeHandle, int64_t, int, const bool &, const bool &);
+template void HdbClient::store_scalar<int16_t>(HdbAttributeHandle, int64_t, int, const int16_t &, const int16_t &);
+template void HdbClient::store_scalar<int32_t>(HdbAttributeHandle, int64_t, int, const int32_t &, const int32_t &);
+template void HdbClient::store_scalar<int64_t>(HdbAttributeHandle, int64_t, int, const int64_t &, const int64_t &);
+template void HdbClient::store_scalar<float>(HdbAttributeHandle, int64_t, int, const float &, const float &);
+template void HdbClient::store_scalar<double>(HdbAttributeHandle, int64_t, int, const double &, const double &);
+template void HdbClient::store_scalar<uint8_t>(HdbAttributeHandle, int64_t, int, const uint8_t &, const uint8_t &);
+template void HdbClient::store_scalar<uint16_t>(HdbAttributeHandle, int64_t, int, const uint16_t &, const uint16_t &);
+template void HdbClient::store_scalar<uint32_t>(HdbAttributeHandle, int64_t, int, const uint32_t &, const uint32_t &);
+template void HdbClient::store_scalar<uint64_t>(HdbAttributeHandle, int64_t, int, const uint64_t &, const uint64_t &);
+template void HdbClient::store_scalar<string>(HdbAttributeHandle, int64_t, int, const string &, const string &);
+template void HdbClient::store_scalar<Tango::DevState>(
+    HdbAttributeHandle, int64_t, int, const Tango::DevState &, const Tango::DevState &);
+
+template void HdbClient::store_array<bool>(
+    HdbAttributeHandle, int64_t, int, const bool *, size_t, const bool *, size_t);
+template void HdbClient::store_array<int16_t>(
+    HdbAttributeHandle, int64_t, int, const int16_t *, size_t, const int16_t *, size_t);
+template void HdbClient::store_array<int32_t>(
+    HdbAttributeHandle, int64_t, int, const int32_t *, size_t, const int32_t *, size_t);
+template void HdbClient::store_array<int64_t>(
+    HdbAttributeHandle, int64_t, int, const int64_t *, size_t, const int64_t *, size_t);
+template void HdbClient::store_array<float>(
+    HdbAttributeHandle, int64_t, int, const float *, size_t, const float *, size_t);
+template void HdbClient::store_array<double>(
+    HdbAttributeHandle, int64_t, int, const double *, size_t, const double *, size_t);
+template void HdbClient::store_array<uint8_t>(
+    HdbAttributeHandle, int64_t, int, const uint8_t *, size_t, const uint8_t *, size_t);
+template void HdbClient::store_array<uint16_t>(
+    HdbAttributeHandle, int64_t, int, const uint16_t *, size_t, const uint16_t *, size_t);
+template void HdbClient::store_array<uint32_t>(
+    HdbAttributeHandle, int64_t, int, const uint32_t *, size_t, const uint32_t *, size_t);
+template void HdbClient::store_array<uint64_t>(
+    HdbAttributeHandle, int64_t, int, const uint64_t *, size_t, const uint64_t *, size_t);
+template void HdbClient::store_array<string>(
+    HdbAttributeHandle, int64_t, int, const string *, size_t, const string *, size_t);
+template void HdbClient::store_array<Tango::DevState>(
+    HdbAttributeHandle, int64_t, int, const Tango::DevState *, size_t, const Tango::DevState *, size_t);
+
+//=============================================================================
+//=============================================================================
+void HdbClient::store_error(HdbAttributeHandle handle, int64_t time_us, int quality, const string &error_msg)
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())->store_error(handle, time_us, quality, error_msg);
+}
+
+//=============================================================================
+//=============================================================================
+void HdbClient::begin_batch()
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())->begin_batch();
+}
+
+//=============================================================================
+//=============================================================================
+void HdbClient::end_batch()
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())->end_batch();
+}
+
 //=============================================================================
 //=============================================================================
 void HdbClient::insert_param_event(Tango::AttrConfEventData *data, const HdbEventDataType &data_type)
@@ -82,4 +229,32 @@ bool HdbClient::supported(HdbppFeatures feature)
     return _db->supported(feature);
 }
 
+//=============================================================================
+//=============================================================================
+void HdbClient::enable_stage_timing(bool enable)
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())->enable_stage_timing(enable);
+}
+
+//=============================================================================
+//=============================================================================
+vector<HdbStageTiming> HdbClient::stage_timings()
+{
+    return static_cast<HdbppTimescaleDbApi *>(_db.get())->stage_timings();
+}
+
+//=============================================================================
+//=============================================================================
+void HdbClient::reset_stage_timings()
+{
+    static_cast<HdbppTimescaleDbApi *>(_db.get())->reset_stage_timings();
+}
+
+//=============================================================================
+//=============================================================================
+HdbStats HdbClient::stats()
+{
+    return static_cast<HdbppTimescaleDbApi *>(_db.get())->stats();
+}
+
 } // namespace hdbpp
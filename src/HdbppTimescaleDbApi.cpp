@@ -19,6 +19,8 @@
 
 #include "HdbppTimescaleDbApi.hpp"
 
+#include "AttributeName.hpp"
+#include "DataEventSerialiser.hpp"
 #include "DbConnection.hpp"
 #include "HdbppTxDataEvent.hpp"
 #include "HdbppTxDataEventError.hpp"
@@ -27,8 +29,12 @@
 #include "HdbppTxParameterEvent.hpp"
 #include "HdbppTxUpdateTtl.hpp"
 #include "LibUtils.hpp"
+#include "Probes.hpp"
 
+#include <algorithm>
+#include <exception>
 #include <locale>
+#include <type_traits>
 
 using namespace std;
 using namespace hdbpp_internal;
@@ -39,7 +45,53 @@ namespace hdbpp
 struct HdbppTimescaleDbApiUtils
 {
     static auto getConfigParam(const map<string, string> &conf, const string &param, bool mandatory) -> string;
+
+    static auto getConfigParamUInt(const map<string, string> &conf, const string &param, unsigned int default_value)
+        -> unsigned int;
     static auto extractConfig(const vector<string> &config, const string &separator) -> map<string, string>;
+
+    // store the data of an event via the given connection, this may be the DbConnection,
+    // or a DataEventSerialiser building the query on another thread
+    template<typename Conn>
+    static void storeDataEvent(Conn &conn, Tango::EventData *event_data, const HdbEventDataType &data_type)
+    {
+        // build a data event request, this will store 0 or more data elements,
+        // pending on type, format and quality
+        conn.template createTx<HdbppTxDataEvent>()
+            .withName(event_data->attr_name)
+            .withTraits(static_cast<Tango::AttrWriteType>(data_type.write_type),
+                static_cast<Tango::AttrDataFormat>(data_type.data_format),
+                static_cast<Tango::CmdArgType>(data_type.data_type))
+            .withAttribute(event_data->attr_value)
+            .withMaxDims(data_type.max_dim_x, data_type.max_dim_y)
+            .withEventTime(event_data->attr_value->get_date())
+            .withQuality(event_data->attr_value->get_quality())
+            .store();
+    }
+
+    // check the type stored by the typed api matches the tango type of the attribute,
+    // this is the reverse of the type translation in HdbppTxDataEvent
+    template<typename T>
+    static auto typeMatches(Tango::CmdArgType type) -> bool
+    {
+        switch (type)
+        {
+            case Tango::DEV_BOOLEAN: return is_same<T, bool>::value;
+            case Tango::DEV_SHORT: return is_same<T, int16_t>::value;
+            case Tango::DEV_LONG: return is_same<T, int32_t>::value;
+            case Tango::DEV_LONG64: return is_same<T, int64_t>::value;
+            case Tango::DEV_FLOAT: return is_same<T, float>::value;
+            case Tango::DEV_DOUBLE: return is_same<T, double>::value;
+            case Tango::DEV_UCHAR: return is_same<T, uint8_t>::value;
+            case Tango::DEV_USHORT: return is_same<T, uint16_t>::value;
+            case Tango::DEV_ULONG: return is_same<T, uint32_t>::value;
+            case Tango::DEV_ULONG64: return is_same<T, uint64_t>::value;
+            case Tango::DEV_STRING: return is_same<T, string>::value;
+            case Tango::DEV_STATE: return is_same<T, Tango::DevState>::value;
+            case Tango::DEV_ENUM: return is_same<T, int16_t>::value;
+            default: return false;
+        }
+    }
 };
 
 //=============================================================================
@@ -76,6 +128,34 @@ auto HdbppTimescaleDbApiUtils::getConfigParam(const map<string, string> &conf, c
     return iter == conf.end() ? "" : (*iter).second;
 }
 
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApiUtils::getConfigParamUInt(
+    const map<string, string> &conf, const string &param, unsigned int default_value) -> unsigned int
+{
+    auto value = getConfigParam(conf, param, false);
+
+    if (value.empty())
+        return default_value;
+
+    try
+    {
+        size_t end = 0;
+        auto result = stoul(value, &end);
+
+        if (end == value.size() && value[0] != '-')
+            return static_cast<unsigned int>(result);
+    }
+    catch (logic_error &)
+    {
+        // fall through to the error below
+    }
+
+    std::string msg {"Configuration parsing error: parameter: " + param + " is not a positive integer: " + value};
+    Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    return default_value;
+}
+
 //=============================================================================
 //=============================================================================
 HdbppTimescaleDbApi::HdbppTimescaleDbApi(const string &/*id*/, const vector<string> &configuration)
@@ -100,8 +180,31 @@ HdbppTimescaleDbApi::HdbppTimescaleDbApi(const string &/*id*/, const vector<stri
     auto log_syslog = HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "log_syslog", false);
     auto log_file_name = HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "log_file_name", false);
 
+    auto log_queue_size = HdbppTimescaleDbApiUtils::getConfigParamUInt(
+        libhdb_conf, "log_queue_size", LogConfigurator::DefaultQueueSize);
+
+    auto log_overflow_policy =
+        param_to_lower(HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "log_overflow_policy", false));
+
+    if (log_queue_size == 0)
+    {
+        std::string msg {"Configuration parsing error: log_queue_size must be greater than 0"};
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    if (!log_overflow_policy.empty() && log_overflow_policy != "overrun_oldest" && log_overflow_policy != "block")
+    {
+        std::string msg {"Configuration parsing error: log_overflow_policy must be overrun_oldest or block, not: " +
+            log_overflow_policy};
+
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
     // init the base logging system
-    LogConfigurator::initLogging(_identity);
+    LogConfigurator::initLogging(_identity,
+        log_queue_size,
+        log_overflow_policy == "block" ? spdlog::async_overflow_policy::block :
+                                         LogConfigurator::DefaultOverflowPolicy);
 
     if (param_to_lower(log_file) == "true")
         LogConfigurator::initFileLogging(_identity, log_file_name);
@@ -132,6 +235,9 @@ HdbppTimescaleDbApi::HdbppTimescaleDbApi(const string &/*id*/, const vector<stri
     spdlog::info("Logging to syslog: {}", log_syslog);
     spdlog::info("Logging to file: {}", log_file);
     spdlog::info("Logfile (if any): {}", log_file_name);
+    spdlog::info("Logging queue size: {}", log_queue_size);
+    spdlog::info(
+        "Logging queue overflow policy: {}", log_overflow_policy.empty() ? "overrun_oldest" : log_overflow_policy);
 
     spdlog::info("Starting libhdbpp-timescale shared library...");
 
@@ -139,12 +245,201 @@ HdbppTimescaleDbApi::HdbppTimescaleDbApi(const string &/*id*/, const vector<stri
     auto connection_string = HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "connect_string", true);
     spdlog::info("Mandatory config parameter connect_string: {}", connection_string);
 
+    // statement_warmup optional config parameter ----
+    auto statement_warmup =
+        param_to_lower(HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "statement_warmup", false));
+
+    spdlog::info("Optional config parameter statement_warmup: {}", statement_warmup);
+
+    auto warmup = pqxx_conn::DbConnection::StatementWarmup::Archived;
+
+    if (statement_warmup == "none")
+        warmup = pqxx_conn::DbConnection::StatementWarmup::None;
+    else if (statement_warmup == "all")
+        warmup = pqxx_conn::DbConnection::StatementWarmup::All;
+    else if (!statement_warmup.empty() && statement_warmup != "archived")
+    {
+        std::string msg {
+            "Configuration parsing error: statement_warmup must be none, archived or all, not: " + statement_warmup};
+
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
     // allocate a connection to store data with
     _conn = make_unique<pqxx_conn::DbConnection>(pqxx_conn::DbConnection::DbStoreMethod::PreparedStatement);
+    _conn->statementWarmup(warmup);
+
+    // reconnect_failure_threshold, reconnect_backoff and reconnect_backoff_max optional config parameters ----
+    auto reconnect_failure_threshold =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "reconnect_failure_threshold", 3);
+
+    auto reconnect_backoff = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "reconnect_backoff", 100);
+
+    auto reconnect_backoff_max =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "reconnect_backoff_max", 30000);
+
+    spdlog::info("Optional config parameter reconnect_failure_threshold: {}", reconnect_failure_threshold);
+    spdlog::info("Optional config parameter reconnect_backoff: {}", reconnect_backoff);
+    spdlog::info("Optional config parameter reconnect_backoff_max: {}", reconnect_backoff_max);
+
+    _conn->reconnectPolicy(reconnect_failure_threshold,
+        chrono::milliseconds(reconnect_backoff),
+        chrono::milliseconds(reconnect_backoff_max));
 
     // now bring up the connection
     _conn->connect(connection_string);
 
+    // capture_file optional config parameter ----
+    auto capture_file = HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "capture_file", false);
+    spdlog::info("Optional config parameter capture_file: {}", capture_file);
+
+    if (!capture_file.empty())
+        _capture = make_unique<EventCaptureWriter>(capture_file);
+
+    // stage_timing optional config parameter ----
+    auto stage_timing = HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "stage_timing", false);
+    auto stage_timing_log_interval =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "stage_timing_log_interval", 0);
+
+    spdlog::info("Optional config parameter stage_timing: {}", stage_timing);
+    spdlog::info("Optional config parameter stage_timing_log_interval: {}", stage_timing_log_interval);
+
+    if (param_to_lower(stage_timing) == "true")
+    {
+        _conn->stageTimers()->enable(true);
+
+        if (stage_timing_log_interval > 0)
+        {
+            _stage_timing_logger =
+                make_unique<StageTimingLogger>(*_conn->stageTimers(), chrono::seconds(stage_timing_log_interval));
+        }
+    }
+
+    // metrics_file optional config parameter ----
+    auto metrics_file = HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "metrics_file", false);
+    auto metrics_interval = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "metrics_interval", 15);
+
+    spdlog::info("Optional config parameter metrics_file: {}", metrics_file);
+    spdlog::info("Optional config parameter metrics_interval: {}", metrics_interval);
+
+    if (!metrics_file.empty())
+    {
+        if (metrics_interval == 0)
+        {
+            std::string msg {"Configuration parsing error: metrics_interval must be greater than 0"};
+            Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+        }
+
+        _metrics_writer = make_unique<MetricsFileWriter>(
+            metrics_file, chrono::seconds(metrics_interval), [this]() { return _conn->stats(); });
+    }
+
+    // slow_query_threshold optional config parameter ----
+    auto slow_query_threshold = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "slow_query_threshold", 0);
+    auto slow_query_explain_sample =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "slow_query_explain_sample", 0);
+
+    spdlog::info("Optional config parameter slow_query_threshold: {}", slow_query_threshold);
+    spdlog::info("Optional config parameter slow_query_explain_sample: {}", slow_query_explain_sample);
+
+    _conn->slowQueryLog(chrono::milliseconds(slow_query_threshold), slow_query_explain_sample);
+
+    // attribute_profile_size optional config parameter ----
+    auto attribute_profile_size =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "attribute_profile_size", 0);
+    auto attribute_top_n = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "attribute_top_n", 10);
+    auto attribute_report_interval =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "attribute_report_interval", 0);
+
+    spdlog::info("Optional config parameter attribute_profile_size: {}", attribute_profile_size);
+    spdlog::info("Optional config parameter attribute_top_n: {}", attribute_top_n);
+    spdlog::info("Optional config parameter attribute_report_interval: {}", attribute_report_interval);
+
+    _conn->attributeProfiler(attribute_profile_size, attribute_top_n);
+
+    if (attribute_profile_size > 0 && attribute_report_interval > 0)
+    {
+        _attribute_profile_logger = make_unique<AttributeProfileLogger>(
+            chrono::seconds(attribute_report_interval), [this]() { return _conn->topAttributes(); });
+    }
+
+    // insert_threads optional config parameter ----
+    auto insert_threads = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "insert_threads", 1);
+    auto parallel_batch_size =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "parallel_batch_size", 1000);
+
+    spdlog::info("Optional config parameter insert_threads: {}", insert_threads);
+    spdlog::info("Optional config parameter parallel_batch_size: {}", parallel_batch_size);
+
+    // the thread calling insert_events() works alongside the pool
+    if (insert_threads > 1)
+    {
+        _insert_pool = make_unique<ThreadPool>(insert_threads - 1);
+        _parallel_batch_size = parallel_batch_size;
+    }
+
+    // io_connections optional config parameter ----
+    auto io_connections = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "io_connections", 0);
+    auto io_timeout = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "io_timeout", 0);
+
+    spdlog::info("Optional config parameter io_connections: {}", io_connections);
+    spdlog::info("Optional config parameter io_timeout: {}", io_timeout);
+
+    // pipeline_batch_size optional config parameter ----
+    auto pipeline_batch_size = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "pipeline_batch_size", 0);
+    auto pipeline_depth = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "pipeline_depth", 2);
+
+    spdlog::info("Optional config parameter pipeline_batch_size: {}", pipeline_batch_size);
+    spdlog::info("Optional config parameter pipeline_depth: {}", pipeline_depth);
+
+    // the pipeline sends its batches over the event loop, so needs at least one connection
+    if (pipeline_batch_size > 0 && io_connections == 0)
+        io_connections = 1;
+
+    if (io_connections > 0)
+        _conn->eventLoop(make_unique<PqEventLoop>(connection_string, io_connections), chrono::milliseconds(io_timeout));
+
+    _conn->pipeline(pipeline_batch_size, pipeline_depth);
+
+    // adaptive_batch_latency optional config parameter ----
+    auto adaptive_batch_latency =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "adaptive_batch_latency", 0);
+    auto adaptive_batch_min = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "adaptive_batch_min", 10);
+    auto adaptive_batch_max = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "adaptive_batch_max", 10000);
+    auto adaptive_flush_interval =
+        HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "adaptive_flush_interval", 1000);
+
+    spdlog::info("Optional config parameter adaptive_batch_latency: {}", adaptive_batch_latency);
+    spdlog::info("Optional config parameter adaptive_batch_min: {}", adaptive_batch_min);
+    spdlog::info("Optional config parameter adaptive_batch_max: {}", adaptive_batch_max);
+    spdlog::info("Optional config parameter adaptive_flush_interval: {}", adaptive_flush_interval);
+
+    _conn->batchController(chrono::milliseconds(adaptive_batch_latency),
+        adaptive_batch_min,
+        adaptive_batch_max,
+        chrono::milliseconds(adaptive_flush_interval));
+
+    // thread_safe optional config parameter ----
+    auto thread_safe = HdbppTimescaleDbApiUtils::getConfigParam(libhdb_conf, "thread_safe", false);
+    auto group_commit_size = HdbppTimescaleDbApiUtils::getConfigParamUInt(libhdb_conf, "group_commit_size", 1000);
+
+    spdlog::info("Optional config parameter thread_safe: {}", thread_safe);
+    spdlog::info("Optional config parameter group_commit_size: {}", group_commit_size);
+
+    // the engine is only ever started here, so the mode of the instance never changes. The
+    // capture is recorded as the engine stores each group, so a replay stores in the same order
+    if (param_to_lower(thread_safe) == "true")
+    {
+        _engine = make_unique<StorageEngine<EventTuple>>(
+            [this](vector<EventTuple> &events) {
+                if (_capture)
+                    _capture->insertEvents(events);
+
+                return storeEventsStatus(events);
+            },
+            group_commit_size);
+    }
+
     spdlog::info("Started libhdbpp-timescale shared library successfully");
 }
 
@@ -152,6 +447,14 @@ HdbppTimescaleDbApi::HdbppTimescaleDbApi(const string &/*id*/, const vector<stri
 //=============================================================================
 HdbppTimescaleDbApi::~HdbppTimescaleDbApi()
 {
+    // stop the background threads before the connection goes, the engine first since
+    // it stores anything still queued
+    _engine.reset();
+    _stage_timing_logger.reset();
+    _metrics_writer.reset();
+    _attribute_profile_logger.reset();
+    _insert_pool.reset();
+
     if (_conn->isOpen())
         _conn->disconnect();
 
@@ -164,33 +467,243 @@ void HdbppTimescaleDbApi::insert_event(Tango::EventData *event_data, const HdbEv
 {
     assert(event_data);
     assert(event_data->attr_value);
-    spdlog::trace("Insert data event for attribute: {}", event_data->attr_name);
+    HDBPP_LOG_TRACE("Insert data event for attribute: {}", event_data->attr_name);
+
+    if (_engine)
+    {
+        submitEvents({make_tuple(event_data, data_type)});
+        return;
+    }
+
+    if (_capture)
+        _capture->insertEvent(event_data, data_type);
+
+    HDBPP_PROBE2(insert_event_enter, event_data->attr_name.c_str(), data_type.data_type);
+
+    try
+    {
+        // hand the call to the internal routine
+        doInsertEvent(event_data, data_type);
+    }
+    catch (Tango::DevFailed &e)
+    {
+        HDBPP_PROBE2(insert_event_exit, event_data->attr_name.c_str(), 0);
+        throw;
+    }
 
-    // hand the call to the internal routine
-    doInsertEvent(event_data, data_type);
+    HDBPP_PROBE2(insert_event_exit, event_data->attr_name.c_str(), 1);
 }
 
 //=============================================================================
 //=============================================================================
 void HdbppTimescaleDbApi::insert_events(vector<tuple<Tango::EventData *, HdbEventDataType>> events)
 {
+    if (_engine)
+    {
+        submitEvents(events);
+        return;
+    }
+
+    if (_capture)
+        _capture->insertEvents(events);
+
+    HDBPP_PROBE1(insert_events_enter, events.size());
     _conn->buffer(true);
 
     try
     {
-        for (auto event : events)
-            doInsertEvent(get<0>(event), get<1>(event));
+        if (_insert_pool && events.size() >= _parallel_batch_size)
+            insertEventsParallel(events);
+        else
+        {
+            for (auto event : events)
+                doInsertEvent(get<0>(event), get<1>(event));
+        }
 
         _conn->flush();
     }
     catch (Tango::DevFailed &e)
     {
-        // ensure this is disabled on error
-        _conn->buffer(false);
+        // ensure this is disabled on error, and nothing is left for the next flush. Batches
+        // the pipeline sent ahead commit on their own, so the caller is told how many events
+        // were stored regardless
+        auto committed = _conn->discardBuffer();
+        HDBPP_PROBE2(insert_events_exit, events.size(), 0);
+
+        if (committed > 0)
+        {
+            string msg {std::to_string(committed) + " of the " + std::to_string(events.size()) +
+                " events were stored by batches sent before the failure, do not insert them again"};
+
+            spdlog::error("Error: {}", msg);
+            Tango::Except::re_throw_exception(e, "Storage Error", msg, LOCATION_INFO);
+        }
+
         throw;
     }
 
     _conn->buffer(false);
+    HDBPP_PROBE2(insert_events_exit, events.size(), 1);
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::insert_events_status(vector<tuple<Tango::EventData *, HdbEventDataType>> events)
+    -> vector<HdbEventStatus>
+{
+    if (_engine)
+        return submitAndWait(move(events));
+
+    if (_capture)
+        _capture->insertEvents(events);
+
+    return storeEventsStatus(events);
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::storeEventsStatus(vector<EventTuple> &events) -> vector<HdbEventStatus>
+{
+    HDBPP_PROBE1(insert_events_enter, events.size());
+
+    // the connection must be up front, after this only a lost connection throws
+    if (_conn->isClosed())
+    {
+        string msg {"The connection is reporting it is closed. Unable to store the events."};
+        spdlog::error("Throwing connection error with message: \"{}\"", msg);
+        Tango::Except::throw_exception("Connection Error", msg, LOCATION_INFO);
+    }
+
+    vector<HdbEventStatus> statuses(events.size(), HdbEventStatus::Ok);
+
+    // the event each buffered query belongs to, an event may not buffer a query
+    // when it fails before it gets to the database. The failed queries are indexed
+    // from the start of the buffer, which is the base
+    auto base = _conn->bufferSize();
+    vector<size_t> query_events;
+    query_events.reserve(events.size());
+
+    vector<size_t> failed;
+    _conn->buffer(true);
+
+    try
+    {
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            auto buffered = _conn->bufferSize();
+            _conn->eventStatus(&statuses[i]);
+
+            try
+            {
+                doInsertEvent(get<0>(events[i]), get<1>(events[i]));
+            }
+            catch (Tango::DevFailed &e)
+            {
+                // a lost connection fails the whole batch, the database may have failed
+                // the event, in a lookup or storing its error message, anything else
+                // failed while converting the event for storage
+                auto reason = e.errors.length() > 0 ? string(e.errors[0].reason) : string();
+
+                if (_conn->isClosed() || reason == "Connection Error")
+                    throw;
+
+                if (reason == "Storage Error" || reason == "Consistency Error")
+                    statuses[i] = HdbEventStatus::DbError;
+                else
+                    statuses[i] = HdbEventStatus::ConversionError;
+            }
+
+            _conn->eventStatus(nullptr);
+
+            if (_conn->bufferSize() > buffered)
+                query_events.push_back(i);
+        }
+
+        if (_conn->bufferSize() > 0)
+            _conn->flush(&failed);
+    }
+    catch (Tango::DevFailed &)
+    {
+        // ensure this is disabled on error, and nothing is left for the next flush
+        _conn->eventStatus(nullptr);
+        _conn->discardBuffer();
+        HDBPP_PROBE2(insert_events_exit, events.size(), 0);
+        throw;
+    }
+
+    _conn->buffer(false);
+
+    for (auto query : failed)
+    {
+        if (query >= base && query - base < query_events.size())
+            statuses[query_events[query - base]] = HdbEventStatus::DbError;
+    }
+
+    auto all_ok = all_of(
+        statuses.begin(), statuses.end(), [](HdbEventStatus status) { return status == HdbEventStatus::Ok; });
+
+    HDBPP_PROBE2(insert_events_exit, events.size(), all_ok ? 1 : 0);
+    return statuses;
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::insert_event_async(Tango::EventData *event_data, const HdbEventDataType &data_type)
+    -> future<HdbEventStatus>
+{
+    auto result = make_shared<promise<HdbEventStatus>>();
+
+    insert_events_async({make_tuple(event_data, data_type)},
+        [result](const vector<HdbEventStatus> &statuses, exception_ptr error) {
+            if (error)
+                result->set_exception(error);
+            else
+                result->set_value(statuses[0]);
+        });
+
+    return result->get_future();
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::insert_events_async(vector<tuple<Tango::EventData *, HdbEventDataType>> events)
+    -> future<vector<HdbEventStatus>>
+{
+    auto result = make_shared<promise<vector<HdbEventStatus>>>();
+
+    insert_events_async(move(events), [result](const vector<HdbEventStatus> &statuses, exception_ptr error) {
+        if (error)
+            result->set_exception(error);
+        else
+            result->set_value(statuses);
+    });
+
+    return result->get_future();
+}
+
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::insert_events_async(
+    vector<tuple<Tango::EventData *, HdbEventDataType>> events, HdbInsertCallback callback)
+{
+    // rejected outside thread safe mode, before any of the events are copied
+    auto &engine = asyncEngine();
+
+    // the caller may release its events once this returns, so the engine stores copies,
+    // which are released along with the callback once the events are stored
+    auto copies = make_shared<vector<unique_ptr<Tango::EventData>>>();
+    copies->reserve(events.size());
+
+    for (auto &event : events)
+    {
+        copies->push_back(copyEventData(*get<0>(event)));
+        get<0>(event) = copies->back().get();
+    }
+
+    engine.submit(move(events),
+        [copies, callback](const vector<HdbEventStatus> &statuses, exception_ptr error) {
+            callback(statuses, error);
+        });
 }
 
 //=============================================================================
@@ -201,11 +714,16 @@ void HdbppTimescaleDbApi::insert_param_event(
     assert(param_event);
     spdlog::trace("Insert parameter event request for attribute: {}", param_event->attr_name);
 
-    _conn->createTx<HdbppTxParameterEvent>()
-        .withName(param_event->attr_name)
-        .withEventTime(param_event->get_date())
-        .withAttrInfo(*(param_event->attr_conf))
-        .store();
+    serialised([&]() {
+        if (_capture)
+            _capture->insertParamEvent(param_event);
+
+        _conn->createTx<HdbppTxParameterEvent>()
+            .withName(param_event->attr_name)
+            .withEventTime(param_event->get_date())
+            .withAttrInfo(*(param_event->attr_conf))
+            .store();
+    });
 }
 
 //=============================================================================
@@ -218,13 +736,18 @@ void HdbppTimescaleDbApi::add_attribute(const std::string &fqdn_attr_name, int t
     // forgive the ugly casting, but for some reason we receive the enum values
     // already cast to ints, we cast them back to enums so they function as
     // enums again
-    _conn->createTx<HdbppTxNewAttribute>()
-        .withName(fqdn_attr_name)
-        .withTraits(static_cast<Tango::AttrWriteType>(write_type),
-            static_cast<Tango::AttrDataFormat>(format),
-            static_cast<Tango::CmdArgType>(type))
-        .withTtl(0)
-        .store();
+    serialised([&]() {
+        if (_capture)
+            _capture->addAttribute(fqdn_attr_name, type, format, write_type);
+
+        _conn->createTx<HdbppTxNewAttribute>()
+            .withName(fqdn_attr_name)
+            .withTraits(static_cast<Tango::AttrWriteType>(write_type),
+                static_cast<Tango::AttrDataFormat>(format),
+                static_cast<Tango::CmdArgType>(type))
+            .withTtl(0)
+            .store();
+    });
 }
 
 //=============================================================================
@@ -233,7 +756,13 @@ void HdbppTimescaleDbApi::update_ttl(const std::string &fqdn_attr_name, unsigned
 {
     assert(!fqdn_attr_name.empty());
     spdlog::trace("TTL event request for attribute: {}, with ttl: {}", fqdn_attr_name, ttl);
-    _conn->createTx<HdbppTxUpdateTtl>().withName(fqdn_attr_name).withTtl(ttl).store();
+
+    serialised([&]() {
+        if (_capture)
+            _capture->updateTtl(fqdn_attr_name, ttl);
+
+        _conn->createTx<HdbppTxUpdateTtl>().withName(fqdn_attr_name).withTtl(ttl).store();
+    });
 }
 
 //=============================================================================
@@ -242,7 +771,13 @@ void HdbppTimescaleDbApi::insert_history_event(const std::string &fqdn_attr_name
 {
     assert(!fqdn_attr_name.empty());
     spdlog::trace("History event request for attribute: {}", fqdn_attr_name);
-    _conn->createTx<HdbppTxHistoryEvent>().withName(fqdn_attr_name).withEvent(event).store();
+
+    serialised([&]() {
+        if (_capture)
+            _capture->insertHistoryEvent(fqdn_attr_name, event);
+
+        _conn->createTx<HdbppTxHistoryEvent>().withName(fqdn_attr_name).withEvent(event).store();
+    });
 }
 
 //=============================================================================
@@ -261,6 +796,209 @@ auto HdbppTimescaleDbApi::supported(HdbppFeatures feature) -> bool
     return supported;
 }
 
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::enable_stage_timing(bool enable)
+{
+    spdlog::info("Stage timing enabled: {}", enable);
+    _conn->stageTimers()->enable(enable);
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::stage_timings() -> vector<HdbStageTiming>
+{
+    auto histograms = _conn->stageTimers()->snapshot();
+    vector<HdbStageTiming> timings;
+
+    for (size_t i = 0; i < StageCount; i++)
+    {
+        auto &histogram = histograms[i];
+
+        HdbStageTiming timing;
+        timing.stage = stageName(static_cast<Stage>(i));
+        timing.count = histogram.count();
+        timing.mean_us = histogram.mean() / 1000.0;
+        timing.p50_us = histogram.percentile(50.0) / 1000.0;
+        timing.p99_us = histogram.percentile(99.0) / 1000.0;
+        timing.p999_us = histogram.percentile(99.9) / 1000.0;
+        timing.max_us = histogram.max() / 1000.0;
+        timings.push_back(timing);
+    }
+
+    return timings;
+}
+
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::reset_stage_timings()
+{
+    _conn->stageTimers()->reset();
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::stats() -> HdbStats
+{
+    return _conn->stats();
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::attribute_handle(const std::string &fqdn_attr_name) -> HdbAttributeHandle
+{
+    assert(!fqdn_attr_name.empty());
+    spdlog::trace("Attribute handle request for attribute: {}", fqdn_attr_name);
+
+    // the same name the transactions store the attribute under
+    AttributeName attr_name {fqdn_attr_name};
+    auto storage_name = "tango://" + attr_name.tangoHostWithDomain() + "/" + attr_name.fullAttributeName();
+
+    HdbAttributeHandle handle;
+
+    // the typed attributes are only touched by the engine in thread safe mode
+    serialised([&]() {
+        auto id = _typed_attribute_ids.find(storage_name);
+
+        if (id != _typed_attribute_ids.end())
+        {
+            handle.id = id->second;
+            return;
+        }
+
+        if (!_conn->fetchAttributeArchived(storage_name))
+        {
+            string msg {"Attribute is not archived. Unable to resolve a handle for attribute: " + fqdn_attr_name};
+            spdlog::error("Error: {}", msg);
+            Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+        }
+
+        _typed_attributes.push_back({storage_name, _conn->fetchAttributeTraits(storage_name)});
+
+        handle.id = static_cast<int>(_typed_attributes.size() - 1);
+        _typed_attribute_ids.emplace(storage_name, handle.id);
+    });
+
+    return handle;
+}
+
+//=============================================================================
+//=============================================================================
+template<typename T>
+void HdbppTimescaleDbApi::store_data(HdbAttributeHandle handle,
+    int64_t time_us,
+    int quality,
+    const DataSpan<T> &value_r,
+    const DataSpan<T> &value_w,
+    bool scalar)
+{
+    // the call waits for the engine, so the viewed values outlive the store
+    serialised([&]() {
+        const auto &attribute = typedAttribute(handle);
+        const auto &traits = attribute.traits;
+
+        if (!HdbppTimescaleDbApiUtils::typeMatches<T>(traits.type()) || scalar != traits.isScalar())
+        {
+            std::stringstream msg;
+            msg << "The " << (scalar ? "scalar" : "array") << " store type does not match the attribute traits: ["
+                << traits << "]. Unable to store data event for attribute: " << attribute.storage_name;
+
+            spdlog::error("Error: {}", msg.str());
+            Tango::Except::throw_exception("Invalid Argument", msg.str(), LOCATION_INFO);
+        }
+
+        // as the data event transaction does, invalid events and the parts of the event the
+        // attribute does not have are stored without data
+        auto valid = quality != Tango::ATTR_INVALID;
+
+        _conn->storeDataEvent<T>(attribute.storage_name,
+            static_cast<double>(time_us) / 1.0e6,
+            quality,
+            valid && traits.hasReadData() ? value_r : DataSpan<T>(),
+            valid && traits.hasWriteData() ? value_w : DataSpan<T>(),
+            traits);
+    });
+}
+
+// the types supported by the typed api
+template void HdbppTimescaleDbApi::store_data<bool>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<bool> &, const DataSpan<bool> &, bool);
+template void HdbppTimescaleDbApi::store_data<int16_t>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<int16_t> &, const DataSpan<int16_t> &, bool);
+template void HdbppTimescaleDbApi::store_data<int32_t>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<int32_t> &, const DataSpan<int32_t> &, bool);
+template void HdbppTimescaleDbApi::store_data<int64_t>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<int64_t> &, const DataSpan<int64_t> &, bool);
+template void HdbppTimescaleDbApi::store_data<float>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<float> &, const DataSpan<float> &, bool);
+template void HdbppTimescaleDbApi::store_data<double>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<double> &, const DataSpan<double> &, bool);
+template void HdbppTimescaleDbApi::store_data<uint8_t>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<uint8_t> &, const DataSpan<uint8_t> &, bool);
+template void HdbppTimescaleDbApi::store_data<uint16_t>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<uint16_t> &, const DataSpan<uint16_t> &, bool);
+template void HdbppTimescaleDbApi::store_data<uint32_t>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<uint32_t> &, const DataSpan<uint32_t> &, bool);
+template void HdbppTimescaleDbApi::store_data<uint64_t>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<uint64_t> &, const DataSpan<uint64_t> &, bool);
+template void HdbppTimescaleDbApi::store_data<string>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<string> &, const DataSpan<string> &, bool);
+template void HdbppTimescaleDbApi::store_data<Tango::DevState>(
+    HdbAttributeHandle, int64_t, int, const DataSpan<Tango::DevState> &, const DataSpan<Tango::DevState> &, bool);
+
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::store_error(HdbAttributeHandle handle, int64_t time_us, int quality, const string &error_msg)
+{
+    serialised([&]() {
+        const auto &attribute = typedAttribute(handle);
+
+        _conn->storeDataEventError(
+            attribute.storage_name, static_cast<double>(time_us) / 1.0e6, quality, error_msg, attribute.traits);
+    });
+}
+
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::begin_batch()
+{
+    // the engine batches the events of concurrent callers itself, and a batch left open
+    // by one caller would capture the stores of every other caller
+    if (_engine)
+    {
+        string msg {"Typed store batches are not supported in thread safe mode"};
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    _conn->buffer(true);
+}
+
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::end_batch()
+{
+    if (_engine)
+    {
+        string msg {"Typed store batches are not supported in thread safe mode"};
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    try
+    {
+        _conn->flush();
+    }
+    catch (Tango::DevFailed &)
+    {
+        // ensure this is disabled on error, and nothing is left for the next flush
+        _conn->discardBuffer();
+        throw;
+    }
+
+    _conn->buffer(false);
+}
+
 //=============================================================================
 //=============================================================================
 void HdbppTimescaleDbApi::doInsertEvent(Tango::EventData *event_data, const HdbEventDataType &data_type)
@@ -268,7 +1006,7 @@ void HdbppTimescaleDbApi::doInsertEvent(Tango::EventData *event_data, const HdbE
     // if there is an error, we store an error, since there will be no data passed in
     if (event_data->err)
     {
-        spdlog::trace("Event type is error for attribute: {}", event_data->attr_name);
+        HDBPP_LOG_TRACE("Event type is error for attribute: {}", event_data->attr_name);
 
         // no time data is passed for errors, so make something up
         struct timeval tv
@@ -294,20 +1032,164 @@ void HdbppTimescaleDbApi::doInsertEvent(Tango::EventData *event_data, const HdbE
     }
     else
     {
-        spdlog::trace("Event type is data for attribute: {}", event_data->attr_name);
+        HDBPP_LOG_TRACE("Event type is data for attribute: {}", event_data->attr_name);
+        HdbppTimescaleDbApiUtils::storeDataEvent(*_conn, event_data, data_type);
+    }
+}
 
-        // build a data event request, this will store 0 or more data elements,
-        // pending on type, format and quality
-        _conn->createTx<HdbppTxDataEvent>()
-            .withName(event_data->attr_name)
-            .withTraits(static_cast<Tango::AttrWriteType>(data_type.write_type),
-                static_cast<Tango::AttrDataFormat>(data_type.data_format),
-                static_cast<Tango::CmdArgType>(data_type.data_type))
-            .withAttribute(event_data->attr_value)
-            .withEventTime(event_data->attr_value->get_date())
-            .withQuality(event_data->attr_value->get_quality())
-            .store();
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::insertEventsParallel(const vector<tuple<Tango::EventData *, HdbEventDataType>> &events)
+{
+    vector<pqxx_conn::DataEventSerialiser::Result> results(events.size());
+
+    // a few ranges per thread, so the threads can balance the load by stealing
+    // ranges when the events vary in size
+    auto grain = max(events.size() / ((_insert_pool->size() + 1) * 4), size_t {1});
+
+    auto serialise = [&events, &results, this](size_t begin, size_t end) {
+        pqxx_conn::DataEventSerialiser serialiser(*_conn);
+
+        for (auto i = begin; i < end; i++)
+        {
+            // error events are left to the connection, they may store a new error message
+            if (get<0>(events[i])->err)
+                continue;
+
+            serialiser.target(&results[i]);
+
+            try
+            {
+                HdbppTimescaleDbApiUtils::storeDataEvent(serialiser, get<0>(events[i]), get<1>(events[i]));
+            }
+            catch (...)
+            {
+                results[i].error = current_exception();
+            }
+        }
+    };
+
+    _insert_pool->parallelFor(events.size(), grain, serialise);
+
+    // merge the queries into the connection buffer in batch order, any error is raised at
+    // the event that caused it, as it would be when inserting the events one at a time
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        auto &result = results[i];
+
+        if (result.error)
+            rethrow_exception(result.error);
+
+        if (result.resolved)
+        {
+            _conn->bufferDataEvent(
+                move(result.query), result.conf_id, result.full_attr_name, result.bytes, result.type);
+        }
+        else
+            doInsertEvent(get<0>(events[i]), get<1>(events[i]));
     }
 }
 
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::submitEvents(const vector<EventTuple> &events)
+{
+    // the events may be stored in a group with those of other callers, so failures
+    // are reported via the statuses, and raised here for this caller only, with the
+    // same reason the call would have raised outside thread safe mode
+    auto statuses = submitAndWait(events);
+
+    for (size_t i = 0; i < statuses.size(); i++)
+    {
+        auto &attr_name = get<0>(events[i])->attr_name;
+
+        switch (statuses[i])
+        {
+            case HdbEventStatus::Ok: break;
+
+            case HdbEventStatus::UnknownAttribute:
+            {
+                string msg {"This attribute [" + attr_name +
+                    "] does not exist in the database. Unable to work with this attribute until it is added."};
+
+                spdlog::error("Throwing consistency error with message: \"{}\"", msg);
+                Tango::Except::throw_exception("Consistency Error", msg, LOCATION_INFO);
+            }
+
+            case HdbEventStatus::ConversionError:
+            {
+                string msg {"Failed to extract the attribute data for attribute: [" + attr_name + "]"};
+
+                spdlog::error("Error: {}", msg);
+                Tango::Except::throw_exception("Runtime Error", msg, LOCATION_INFO);
+            }
+
+            case HdbEventStatus::DbError:
+            {
+                string msg {"Failed to store event for attribute: [" + attr_name + "]"};
+
+                spdlog::error("Throwing storage error with message: \"{}\"", msg);
+                Tango::Except::throw_exception("Storage Error", msg, LOCATION_INFO);
+            }
+        }
+    }
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::submitAndWait(vector<EventTuple> events) -> vector<HdbEventStatus>
+{
+    // an insert from a completion callback would wait on the engine thread it is running on
+    if (_engine->onEngineThread())
+    {
+        string msg {"Unable to insert events from an asynchronous insert callback, use the asynchronous insert "
+                    "functions instead"};
+
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Runtime Error", msg, LOCATION_INFO);
+    }
+
+    return _engine->submit(move(events)).get();
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::asyncEngine() -> StorageEngine<EventTuple> &
+{
+    if (!_engine)
+    {
+        string msg {"Asynchronous inserts are only supported in thread safe mode, set the thread_safe configuration "
+                    "parameter"};
+
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    return *_engine;
+}
+
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApi::serialised(const function<void()> &func)
+{
+    if (_engine)
+        _engine->execute(func);
+    else
+        func();
+}
+
+//=============================================================================
+//=============================================================================
+auto HdbppTimescaleDbApi::typedAttribute(HdbAttributeHandle handle) const -> const TypedAttribute &
+{
+    if (handle.id < 0 || static_cast<size_t>(handle.id) >= _typed_attributes.size())
+    {
+        string msg {"Invalid attribute handle: " + to_string(handle.id) + ". Unable to store the event."};
+        spdlog::error("Error: {}", msg);
+        Tango::Except::throw_exception("Invalid Argument", msg, LOCATION_INFO);
+    }
+
+    return _typed_attributes[handle.id];
+}
+
 } // namespace hdbpp
@@ -20,12 +20,25 @@
 #ifndef _HDBPP_TIMESCALE_IMPL_HPP
 #define _HDBPP_TIMESCALE_IMPL_HPP
 
+#include "AttributeProfiler.hpp"
 #include "DbConnection.hpp"
+#include "EventCapture.hpp"
+#include "Metrics.hpp"
+#include "StageTimer.hpp"
+#include "StorageEngine.hpp"
+#include "ThreadPool.hpp"
 
 #include <hdb++/AbstractDB.h>
+#include <hdb++/HdbAttributeHandle.h>
+#include <hdb++/HdbEventStatus.h>
+#include <hdb++/HdbStats.h>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <tango.h>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 namespace hdbpp
@@ -45,9 +58,54 @@ public:
     void insert_event(Tango::EventData *event_data, const HdbEventDataType &data_type) override;
 
     // Insert multiple attribute archive events. Any attributes that do not exist will
-    // cause an exception. On failure the fall back is to insert events individually
+    // cause an exception. On failure the fall back is to insert events individually.
+    // Batches sent ahead by the pipeline commit on their own, so when an event fails
+    // after a batch was sent, the events of that batch stay stored, and the exception
+    // says how many
     void insert_events(std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events) override;
 
+    // Insert multiple attribute archive events, returning the status of each event in the
+    // same order, so failed events can be retried or dropped precisely. Unknown attributes,
+    // conversion and database errors are reported in the statuses, only a connection
+    // failure throws an exception
+    auto insert_events_status(std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events)
+        -> std::vector<HdbEventStatus>;
+
+    // Queue the events to be stored by the storage engine, and return at once. The events
+    // are copied, so may be released as soon as the call returns. The future is given the
+    // status of each event, and the callback is run on the engine thread, once the events
+    // are committed. Only supported in thread safe mode, which starts the engine
+    auto insert_event_async(Tango::EventData *event_data, const HdbEventDataType &data_type)
+        -> std::future<HdbEventStatus>;
+
+    auto insert_events_async(std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events)
+        -> std::future<std::vector<HdbEventStatus>>;
+
+    void insert_events_async(
+        std::vector<std::tuple<Tango::EventData *, HdbEventDataType>> events, HdbInsertCallback callback);
+
+    // Resolve an archived attribute to a handle for the typed store functions below
+    auto attribute_handle(const std::string &fqdn_attr_name) -> HdbAttributeHandle;
+
+    // Store an event of type T for the attribute directly from the viewed values, T must
+    // match the attribute type. Scalar is set by the scalar store api, and must match the
+    // attribute format
+    template<typename T>
+    void store_data(HdbAttributeHandle handle,
+        int64_t time_us,
+        int quality,
+        const hdbpp_internal::DataSpan<T> &value_r,
+        const hdbpp_internal::DataSpan<T> &value_w,
+        bool scalar);
+
+    // Store an error event for the attribute
+    void store_error(HdbAttributeHandle handle, int64_t time_us, int quality, const std::string &error_msg);
+
+    // Buffer the typed stores until end_batch(), which flushes them to the database. Not
+    // supported in thread safe mode
+    void begin_batch();
+    void end_batch();
+
     // Inserts the attribute configuration data (Tango Attribute Configuration event data)
     // into the database. The attribute must be configured to be stored in HDB++,
     // otherwise an exception will be thrown.
@@ -71,11 +129,80 @@ public:
     // Check what hdbpp features this library supports. This library supports: TTL, BATCH_INSERTS
     auto supported(HdbppFeatures feature) -> bool override;
 
+    // Turn the timing of the event storage stages on or off. Each instance of the
+    // library times its own connection
+    void enable_stage_timing(bool enable);
+
+    // Get the timing of each event storage stage since timing was enabled, or last reset
+    auto stage_timings() -> std::vector<HdbStageTiming>;
+
+    // Clear the stage timings
+    void reset_stage_timings();
+
+    // Get the runtime counters and gauges for the connection, safe to call from any thread
+    auto stats() -> HdbStats;
+
 private:
+    using EventTuple = std::tuple<Tango::EventData *, HdbEventDataType>;
+
     void doInsertEvent(Tango::EventData *event_data, const HdbEventDataType &data_type);
 
+    // buffer the events, extracting and serialising the data events across the insert pool
+    void insertEventsParallel(const std::vector<EventTuple> &events);
+
+    // store the events as a single batch, the body of insert_events_status()
+    auto storeEventsStatus(std::vector<EventTuple> &events) -> std::vector<HdbEventStatus>;
+
+    // submit the events to the storage engine, and throw if any was not stored
+    void submitEvents(const std::vector<EventTuple> &events);
+
+    // submit the events to the storage engine and wait for their statuses, throws when
+    // called on the engine thread, which would deadlock
+    auto submitAndWait(std::vector<EventTuple> events) -> std::vector<HdbEventStatus>;
+
+    // the storage engine for the asynchronous inserts, throws if not in thread safe mode
+    auto asyncEngine() -> hdbpp_internal::StorageEngine<EventTuple> &;
+
+    // in thread safe mode run the function on the storage engine, otherwise run it here
+    void serialised(const std::function<void()> &func);
+
+    // an attribute resolved by attribute_handle()
+    struct TypedAttribute
+    {
+        std::string storage_name;
+        hdbpp_internal::AttributeTraits traits;
+    };
+
+    auto typedAttribute(HdbAttributeHandle handle) const -> const TypedAttribute &;
+
     std::unique_ptr<hdbpp_internal::pqxx_conn::DbConnection> _conn;
     std::string _identity;
+
+    // when configured, every call into the library is recorded for later replay
+    std::unique_ptr<hdbpp_internal::EventCaptureWriter> _capture;
+
+    // when configured, the stage timings are written to the log periodically
+    std::unique_ptr<hdbpp_internal::StageTimingLogger> _stage_timing_logger;
+
+    // when configured, the stats are written to a Prometheus text file periodically
+    std::unique_ptr<hdbpp_internal::MetricsFileWriter> _metrics_writer;
+
+    // when configured, the busiest attributes are written to the log periodically
+    std::unique_ptr<hdbpp_internal::AttributeProfileLogger> _attribute_profile_logger;
+
+    // when configured, batches of at least parallel_batch_size events are serialised
+    // across this pool
+    std::unique_ptr<hdbpp_internal::ThreadPool> _insert_pool;
+    std::size_t _parallel_batch_size = 0;
+
+    // in thread safe mode, every call that uses the connection is run by the engine,
+    // and the events of concurrent callers are stored together
+    std::unique_ptr<hdbpp_internal::StorageEngine<EventTuple>> _engine;
+
+    // the attributes resolved for the typed store api, a handle is an index into the
+    // vector, and the map finds the handle of an attribute by its storage name
+    std::vector<TypedAttribute> _typed_attributes;
+    std::unordered_map<std::string, int> _typed_attribute_ids;
 };
 
 } // namespace hdbpp
@@ -20,10 +20,158 @@
 #ifndef _HDBPP_TX_DATA_EVENT_HPP
 #define _HDBPP_TX_DATA_EVENT_HPP
 
+#include "BufferPool.hpp"
+#include "DataSpan.hpp"
 #include "HdbppTxDataEventBase.hpp"
+#include "StageTimer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
 
 namespace hdbpp_internal
 {
+// Utilities to view the data held inside a Tango::DeviceAttribute in place. The
+// DeviceAttribute keeps its data in CORBA sequences (publicly accessible), so rather
+// than copy the data out via extract_read()/extract_set(), we view the sequence buffer
+// directly and hand a DataSpan to the connection.
+namespace data_event_utils
+{
+    //=============================================================================
+    //=============================================================================
+    template<typename T, typename SeqVar>
+    auto viewSequence(SeqVar &seq, std::size_t &length) -> const T *
+    {
+        // the sequence is only allocated when the attribute carries data of this type
+        const auto *sequence = seq.operator->();
+
+        if (sequence == nullptr)
+            return nullptr;
+
+        const auto *buffer = sequence->get_buffer();
+
+        // the CORBA types are mapped to our own fixed width types, these must have the
+        // same layout for the buffer to be viewed in place
+        using Element = std::remove_cv_t<std::remove_pointer_t<decltype(buffer)>>;
+        static_assert(sizeof(Element) == sizeof(T), "Tango sequence element size does not match the storage type");
+
+        length = sequence->length();
+
+        // NOLINTNEXTLINE (cppcoreguidelines-pro-type-reinterpret-cast)
+        return reinterpret_cast<const T *>(buffer);
+    }
+
+    // Maps the storage type to the sequence inside the DeviceAttribute. The primary
+    // template is used for types that can not be viewed (strings are CORBA strings,
+    // not std::string), these must be extracted via the Tango API instead
+    template<typename T>
+    struct Sequence
+    {
+        static auto view(Tango::DeviceAttribute & /*unused*/, std::size_t & /*unused*/) -> const T * { return nullptr; }
+    };
+
+    template<>
+    struct Sequence<bool>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const bool *
+        {
+            return viewSequence<bool>(attr.BooleanSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<int16_t>
+    {
+        // also used for Tango::DEV_ENUM, which Tango stores as shorts
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const int16_t *
+        {
+            return viewSequence<int16_t>(attr.ShortSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<int32_t>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const int32_t *
+        {
+            return viewSequence<int32_t>(attr.LongSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<int64_t>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const int64_t *
+        {
+            return viewSequence<int64_t>(attr.Long64Seq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<float>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const float *
+        {
+            return viewSequence<float>(attr.FloatSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<double>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const double *
+        {
+            return viewSequence<double>(attr.DoubleSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<uint8_t>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const uint8_t *
+        {
+            return viewSequence<uint8_t>(attr.UCharSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<uint16_t>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const uint16_t *
+        {
+            return viewSequence<uint16_t>(attr.UShortSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<uint32_t>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const uint32_t *
+        {
+            return viewSequence<uint32_t>(attr.ULongSeq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<uint64_t>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const uint64_t *
+        {
+            return viewSequence<uint64_t>(attr.ULong64Seq, length);
+        }
+    };
+
+    template<>
+    struct Sequence<Tango::DevState>
+    {
+        static auto view(Tango::DeviceAttribute &attr, std::size_t &length) -> const Tango::DevState *
+        {
+            return viewSequence<Tango::DevState>(attr.StateSeq, length);
+        }
+    };
+} // namespace data_event_utils
+
 // Used to store data about an attribute in the database. This transaction class
 // will determine if the data exists and what data is to be stored based on the
 // attribute traits it is given. The HdbppTxDataEvent class also acts as the main
@@ -47,6 +195,14 @@ public:
         return *this;
     }
 
+    // the maximum dimensions of the attribute, an upper bound on the buffers reserved
+    // when data has to be extracted from the attribute, rather than viewed in place
+    auto withMaxDims(int max_dim_x, int max_dim_y) -> HdbppTxDataEvent<Conn> &
+    {
+        _max_elements = static_cast<std::size_t>(std::max(max_dim_x, 1)) * std::max(max_dim_y, 1);
+        return *this;
+    }
+
     // trigger the database storage routines
     auto store() -> HdbppTxDataEvent<Conn> &;
 
@@ -55,12 +211,20 @@ public:
 private:
     // perform the actual storage for the type, this template helps
     // resolve the fact we are storing many different types via this tx
-    // class
+    // class. When allow_view is false the data is always extracted by copy
     template<typename T, typename ReadFunctor, typename WriteFunctor>
-    void doStore(ReadFunctor extract_read, WriteFunctor extract_write);
+    void doStore(ReadFunctor extract_read, WriteFunctor extract_write, bool allow_view = true);
+
+    // attempt to view the read or write part of the attribute data in place,
+    // returns false if the data can not be viewed and must be extracted instead
+    template<typename T>
+    auto viewData(bool write_part, DataSpan<T> &value) -> bool;
 
     // the device attribute to extract the value from
     Tango::DeviceAttribute *_dev_attr = nullptr;
+
+    // upper bound on the capacity reserved in any buffers the data is extracted into
+    std::size_t _max_elements = std::numeric_limits<std::size_t>::max();
 };
 
 //=============================================================================
@@ -136,7 +300,7 @@ auto HdbppTxDataEvent<Conn>::store() -> HdbppTxDataEvent<Conn> &
                     return read_state;
                 };
 
-                this->template doStore<Tango::DevState>(state_scalar_read_extractor, write_extractor);
+                this->template doStore<Tango::DevState>(state_scalar_read_extractor, write_extractor, false);
             }
             else
                 this->template doStore<Tango::DevState>(read_extractor, write_extractor);
@@ -163,64 +327,129 @@ auto HdbppTxDataEvent<Conn>::store() -> HdbppTxDataEvent<Conn> &
 //=============================================================================
 template<typename Conn>
 template<typename T, typename ReadFunctor, typename WriteFunctor>
-void HdbppTxDataEvent<Conn>::doStore(ReadFunctor extract_read, WriteFunctor extract_write)
+void HdbppTxDataEvent<Conn>::doStore(ReadFunctor extract_read, WriteFunctor extract_write, bool allow_view)
 {
     // this is the general extractor algorithm, it is primed for a means to do the
     // actual extraction, the split allows some variation in types to be dealt with.
-    auto value = [this](auto extractor, bool has_data, const std::string &write_type) {
-        // this is the return, a unique ptr potentially with a vector in
-        auto value = make_unique<std::vector<T>>();
+    // Where possible the data is viewed in place, only when this is not possible is
+    // it extracted (copied) into the given vector, which then backs the returned span
+    auto value = [this, allow_view](auto extractor,
+                     bool has_data,
+                     bool write_part,
+                     typename BufferPool<T>::Buffer &extracted,
+                     const std::string &write_type) {
+        // this is the return, an empty span signifies no data
+        DataSpan<T> value;
 
         // its possible in some cases to get events that are empty or invalid,
         // we still store the event, but with no event data, so filter them
         // here, and if we detect one, do not extract data, instead return
-        // a vector with no elements in
+        // an empty span
         if (has_data && !_dev_attr->is_empty() && Base::quality() != Tango::ATTR_INVALID)
         {
-            // attempt to extract data, if none is received then clear
-            // the unique_ptr as a signal to following functions there is no data
-            if (!extractor(*value))
+            if (!(allow_view && this->template viewData<T>(write_part, value)))
             {
-                std::stringstream msg;
+                // only now is a buffer taken from the thread's pool, sized to the data
+                // in this event, which the attribute's maximum dimensions bound
+                auto count = write_part ? _dev_attr->get_nb_written() : _dev_attr->get_nb_read();
+
+                extracted = BufferPool<T>::threadPool().acquire(
+                    std::min(static_cast<std::size_t>(std::max(count, 1)), _max_elements));
 
-                msg << "Failed to extract the attribute data for attribute: ["
-                    << Base::attributeName().fullAttributeName() << "]. Traits: [" << Base::attributeTraits()
-                    << "], and read action [" << write_type << "]";
+                // attempt to extract data, if none is received then this is an error
+                if (!extractor(extracted.get()))
+                {
+                    std::stringstream msg;
 
-                spdlog::error("Error: {}", msg.str());
-                Tango::Except::throw_exception("Runtime Error", msg.str(), LOCATION_INFO);
+                    msg << "Failed to extract the attribute data for attribute: ["
+                        << Base::attributeName().fullAttributeName() << "]. Traits: [" << Base::attributeTraits()
+                        << "], and read action [" << write_type << "]";
+
+                    spdlog::error("Error: {}", msg.str());
+                    Tango::Except::throw_exception("Runtime Error", msg.str(), LOCATION_INFO);
+                }
+
+                value = DataSpan<T>(extracted.get());
             }
         }
         // log some more unusual conditions
         else if (Base::quality() == Tango::ATTR_INVALID)
         {
-            spdlog::debug("Quality is {} for attribute: [{}] (write type: {}), no data extracted",
+            HDBPP_LOG_DEBUG("Quality is {} for attribute: [{}] (write type: {}), no data extracted",
                 Base::quality(),
                 Base::attributeName().fqdnAttributeName(),
                 write_type);
         }
         else if (_dev_attr->is_empty())
         {
-            spdlog::debug("Attribute [{}] (write type: {}), empty, no data extracted",
+            HDBPP_LOG_DEBUG("Attribute [{}] (write type: {}), empty, no data extracted",
                 Base::attributeName().fqdnAttributeName(),
                 write_type);
         }
 
-        // release ownership of the unique_ptr back to the caller
         return value;
     };
 
+    // backing storage for any data that could not be viewed in place, must remain in
+    // scope until the connection has stored the event. The buffers are taken from
+    // the thread's pool only when needed, and returned to it once the event is stored.
+    // By this point the data has been serialised, so the buffers are free to be reused
+    typename BufferPool<T>::Buffer extracted_r;
+    typename BufferPool<T>::Buffer extracted_w;
+
+    DataSpan<T> value_r;
+    DataSpan<T> value_w;
+
+    {
+        ScopedStageTimer timer(HdbppTxBase<Conn>::connection().stageTimers(), Stage::Extract);
+        value_r = value(extract_read, Base::attributeTraits().hasReadData(), false, extracted_r, "read");
+        value_w = value(extract_write, Base::attributeTraits().hasWriteData(), true, extracted_w, "set");
+    }
+
     // attempt to store the error in the database, any exceptions are left to
     // propergate to the caller
     HdbppTxBase<Conn>::connection().template storeDataEvent<T>(
         HdbppTxBase<Conn>::attrNameForStorage(Base::attributeName()),
         Base::eventTime(),
         Base::quality(),
-        std::move(value(extract_read, Base::attributeTraits().hasReadData(), "read")),
-        std::move(value(extract_write, Base::attributeTraits().hasWriteData(), "set")),
+        value_r,
+        value_w,
         Base::attributeTraits());
 }
 
+//=============================================================================
+//=============================================================================
+template<typename Conn>
+template<typename T>
+auto HdbppTxDataEvent<Conn>::viewData(bool write_part, DataSpan<T> &value) -> bool
+{
+    std::size_t length = 0;
+    const T *buffer = data_event_utils::Sequence<T>::view(*_dev_attr, length);
+
+    if (buffer == nullptr)
+        return false;
+
+    auto nb_read = static_cast<std::size_t>(std::max(_dev_attr->get_nb_read(), 0));
+    auto offset = std::size_t {0};
+    auto count = nb_read;
+
+    if (write_part)
+    {
+        // Tango places the set point after the read value in the sequence, unless
+        // only a single copy of the data was sent (write only attributes)
+        count = static_cast<std::size_t>(std::max(_dev_attr->get_nb_written(), 0));
+        offset = length >= nb_read + count ? nb_read : 0;
+    }
+
+    // anything unexpected is left to the Tango extraction routines to deal with
+    if (count == 0 || offset + count > length)
+        return false;
+
+    // NOLINTNEXTLINE (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    value = DataSpan<T>(buffer + offset, count);
+    return true;
+}
+
 //=============================================================================
 //=============================================================================
 template<typename Conn>
@@ -0,0 +1,234 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _LATENCY_HISTOGRAM_HPP
+#define _LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// A fixed memory, log-linear histogram for recording latencies (in the style of
+// HdrHistogram). Values below 2^SubBucketBits are counted exactly, above that
+// each power of two range is split into 2^(SubBucketBits - 1) linear sub buckets,
+// so every recorded value is known to within 1/64 of its magnitude. Recording is
+// a few integer operations and never allocates, so it can be used on the hot path.
+// The class is not thread safe, use one histogram per thread and merge() them.
+class LatencyHistogram
+{
+    friend class AtomicLatencyHistogram;
+
+public:
+    static constexpr int SubBucketBits = 7;
+    static constexpr uint64_t SubBucketCount = uint64_t(1) << SubBucketBits;
+    static constexpr uint64_t SubBucketHalfCount = SubBucketCount / 2;
+    static constexpr std::size_t BucketCount = SubBucketCount + (64 - SubBucketBits) * SubBucketHalfCount;
+
+    LatencyHistogram() : _counts(BucketCount, 0) {}
+
+    // record a single value, typically a duration in nanoseconds
+    void record(uint64_t value) noexcept
+    {
+        _counts[bucketIndex(value)]++;
+        _total++;
+        _sum += value;
+        _min = std::min(_min, value);
+        _max = std::max(_max, value);
+    }
+
+    // add all the values recorded in other to this histogram
+    void merge(const LatencyHistogram &other) noexcept
+    {
+        for (std::size_t i = 0; i < BucketCount; i++)
+            _counts[i] += other._counts[i];
+
+        _total += other._total;
+        _sum += other._sum;
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+    }
+
+    void reset() noexcept
+    {
+        std::fill(_counts.begin(), _counts.end(), 0);
+        _total = 0;
+        _sum = 0;
+        _min = std::numeric_limits<uint64_t>::max();
+        _max = 0;
+    }
+
+    auto count() const noexcept -> uint64_t { return _total; }
+    auto empty() const noexcept -> bool { return _total == 0; }
+    auto min() const noexcept -> uint64_t { return _total == 0 ? 0 : _min; }
+    auto max() const noexcept -> uint64_t { return _max; }
+    auto mean() const noexcept -> double { return _total == 0 ? 0.0 : static_cast<double>(_sum) / _total; }
+
+    // get the value at the given percentile (0 to 100). The result is the highest
+    // value that is equivalent (same bucket) to the recorded value, clamped to
+    // the recorded maximum, so the result is never below the true value
+    auto percentile(double percent) const noexcept -> uint64_t;
+
+    // helpers to map between values and bucket indexes, public so they can be tested
+    static auto bucketIndex(uint64_t value) noexcept -> std::size_t;
+    static auto bucketLowest(std::size_t index) noexcept -> uint64_t;
+    static auto bucketHighest(std::size_t index) noexcept -> uint64_t;
+
+private:
+    std::vector<uint64_t> _counts;
+    uint64_t _total = 0;
+    uint64_t _sum = 0;
+    uint64_t _min = std::numeric_limits<uint64_t>::max();
+    uint64_t _max = 0;
+};
+
+// A LatencyHistogram recorded by a single thread, and read from any other without a
+// lock. Each count is a relaxed atomic, so a reader sees every count whole, though not
+// necessarily all of them as of the same record.
+class AtomicLatencyHistogram
+{
+public:
+    AtomicLatencyHistogram() : _counts(new std::atomic<uint64_t>[LatencyHistogram::BucketCount]) { reset(); }
+
+    // record a single value, only the owning thread may record
+    void record(uint64_t value) noexcept
+    {
+        increment(_counts[LatencyHistogram::bucketIndex(value)], 1);
+        increment(_total, 1);
+        increment(_sum, value);
+
+        if (value < _min.load(std::memory_order_relaxed))
+            _min.store(value, std::memory_order_relaxed);
+
+        if (value > _max.load(std::memory_order_relaxed))
+            _max.store(value, std::memory_order_relaxed);
+    }
+
+    // clear the counts, only the owning thread may reset
+    void reset() noexcept
+    {
+        for (std::size_t i = 0; i < LatencyHistogram::BucketCount; i++)
+            _counts[i].store(0, std::memory_order_relaxed);
+
+        _total.store(0, std::memory_order_relaxed);
+        _sum.store(0, std::memory_order_relaxed);
+        _min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        _max.store(0, std::memory_order_relaxed);
+    }
+
+    // add the values recorded so far to the histogram, safe to call from any thread
+    void mergeInto(LatencyHistogram &histogram) const noexcept
+    {
+        for (std::size_t i = 0; i < LatencyHistogram::BucketCount; i++)
+            histogram._counts[i] += _counts[i].load(std::memory_order_relaxed);
+
+        histogram._total += _total.load(std::memory_order_relaxed);
+        histogram._sum += _sum.load(std::memory_order_relaxed);
+        histogram._min = std::min(histogram._min, _min.load(std::memory_order_relaxed));
+        histogram._max = std::max(histogram._max, _max.load(std::memory_order_relaxed));
+    }
+
+private:
+    // there is a single writer, so a load and store is enough, and avoids a locked
+    // read-modify-write on the hot path
+    static void increment(std::atomic<uint64_t> &counter, uint64_t value) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> _counts;
+    std::atomic<uint64_t> _total {0};
+    std::atomic<uint64_t> _sum {0};
+    std::atomic<uint64_t> _min {std::numeric_limits<uint64_t>::max()};
+    std::atomic<uint64_t> _max {0};
+};
+
+//=============================================================================
+//=============================================================================
+inline auto LatencyHistogram::percentile(double percent) const noexcept -> uint64_t
+{
+    if (_total == 0)
+        return 0;
+
+    percent = std::min(std::max(percent, 0.0), 100.0);
+
+    // the rank of the value we are looking for, at least the first value
+    auto rank = static_cast<uint64_t>(percent / 100.0 * _total + 0.5);
+    rank = std::max(rank, uint64_t(1));
+
+    uint64_t seen = 0;
+
+    for (std::size_t i = 0; i < BucketCount; i++)
+    {
+        seen += _counts[i];
+
+        if (seen >= rank)
+            return std::max(std::min(bucketHighest(i), _max), min());
+    }
+
+    return _max;
+}
+
+//=============================================================================
+//=============================================================================
+inline auto LatencyHistogram::bucketIndex(uint64_t value) noexcept -> std::size_t
+{
+    if (value < SubBucketCount)
+        return static_cast<std::size_t>(value);
+
+    // position of the highest set bit, at least SubBucketBits here
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - SubBucketBits + 1;
+
+    // the top SubBucketBits of the value, always in [half count, count)
+    auto sub_bucket = value >> shift;
+
+    return static_cast<std::size_t>(
+        SubBucketCount + (msb - SubBucketBits) * SubBucketHalfCount + (sub_bucket - SubBucketHalfCount));
+}
+
+//=============================================================================
+//=============================================================================
+inline auto LatencyHistogram::bucketLowest(std::size_t index) noexcept -> uint64_t
+{
+    if (index < SubBucketCount)
+        return index;
+
+    auto offset = index - SubBucketCount;
+    auto shift = offset / SubBucketHalfCount + 1;
+    auto sub_bucket = SubBucketHalfCount + offset % SubBucketHalfCount;
+    return sub_bucket << shift;
+}
+
+//=============================================================================
+//=============================================================================
+inline auto LatencyHistogram::bucketHighest(std::size_t index) noexcept -> uint64_t
+{
+    if (index < SubBucketCount)
+        return index;
+
+    auto shift = (index - SubBucketCount) / SubBucketHalfCount + 1;
+    return bucketLowest(index) + ((uint64_t(1) << shift) - 1);
+}
+
+} // namespace hdbpp_internal
+#endif // _LATENCY_HISTOGRAM_HPP
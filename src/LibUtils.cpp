@@ -135,7 +135,13 @@ auto operator<<(ostream &os, Tango::AttrQuality quality) -> ostream &
 
 //=============================================================================
 //=============================================================================
-void LogConfigurator::initLogging(const std::string &identity)
+constexpr std::size_t LogConfigurator::DefaultQueueSize;
+constexpr spdlog::async_overflow_policy LogConfigurator::DefaultOverflowPolicy;
+
+//=============================================================================
+//=============================================================================
+void LogConfigurator::initLogging(
+    const std::string &identity, std::size_t queue_size, spdlog::async_overflow_policy overflow_policy)
 {
     auto logger = spdlog::get(logging_utils::LibLoggerName + "_" + identity);
 
@@ -143,14 +149,17 @@ void LogConfigurator::initLogging(const std::string &identity)
     {
         try
         {
-            spdlog::init_thread_pool(8192, 1);
+            // the queue is shared by all loggers, so the first library instance to
+            // initialise logging sets its size
+            if (!spdlog::thread_pool())
+                spdlog::init_thread_pool(queue_size, 1);
 
             auto dist_sink = make_shared<spdlog::sinks::dist_sink_mt>();
 
             auto logger = make_shared<spdlog::async_logger>(logging_utils::LibLoggerName + "_" + identity,
                 dist_sink,
                 spdlog::thread_pool(),
-                spdlog::async_overflow_policy::overrun_oldest);
+                overflow_policy);
 
             // set the logger as the default so it can be accessed all over the library
             spdlog::register_logger(logger);
@@ -25,6 +25,7 @@
 #include <type_traits>
 
 // spdlog includes used by them module
+#include "spdlog/async_logger.h"
 #include "spdlog/fmt/ostr.h"
 #include "spdlog/spdlog.h"
 
@@ -60,7 +61,16 @@ auto operator<<(std::ostream &os, Tango::AttrQuality quality) -> std::ostream &;
 
 struct LogConfigurator
 {
-    static void initLogging(const std::string &identity);
+    // defaults for the async logger queue, when the queue is full the overflow
+    // policy either drops the oldest message or blocks the caller until there is room
+    static constexpr std::size_t DefaultQueueSize = 8192;
+    static constexpr spdlog::async_overflow_policy DefaultOverflowPolicy =
+        spdlog::async_overflow_policy::overrun_oldest;
+
+    static void initLogging(const std::string &identity,
+        std::size_t queue_size = DefaultQueueSize,
+        spdlog::async_overflow_policy overflow_policy = DefaultOverflowPolicy);
+
     static void initSyslogLogging(const std::string &identity);
     static void initConsoleLogging(const std::string &identity);
     static void initFileLogging(const std::string &identity, const std::string &log_file_name);
@@ -103,5 +113,24 @@ namespace logging_utils
 
 #define LOCATION_INFO std::string(logging_utils::getFileName(__FILE__)) + ":" + std::string(__func__) + ":" S2(__LINE__)
 
+// Per event log statements use these macros rather than spdlog directly. Below
+// HDBPP_LOG_ACTIVE_LEVEL (set by the HOT_PATH_LOG_LEVEL build flag) they compile to
+// nothing, so neither the arguments nor the runtime level check cost anything
+#ifndef HDBPP_LOG_ACTIVE_LEVEL
+#define HDBPP_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+
+#if HDBPP_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define HDBPP_LOG_TRACE(...) spdlog::trace(__VA_ARGS__)
+#else
+#define HDBPP_LOG_TRACE(...) static_cast<void>(0)
+#endif
+
+#if HDBPP_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define HDBPP_LOG_DEBUG(...) spdlog::debug(__VA_ARGS__)
+#else
+#define HDBPP_LOG_DEBUG(...) static_cast<void>(0)
+#endif
+
 }; // namespace hdbpp_internal
 #endif // _LIBUTILS_H
@@ -0,0 +1,291 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "Metrics.hpp"
+
+#include "LibUtils.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+namespace
+{
+    //=============================================================================
+    //=============================================================================
+    void header(ostream &os, const string &name, const string &type, const string &help)
+    {
+        os << "# HELP " << name << " " << help << "\n";
+        os << "# TYPE " << name << " " << type << "\n";
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void perType(ostream &os, const string &name, const string &help, const map<string, uint64_t> &values)
+    {
+        header(os, name, "counter", help);
+
+        for (auto &value : values)
+            os << name << "{type=\"" << value.first << "\"} " << value.second << "\n";
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto escapeLabel(const string &value) -> string
+    {
+        string escaped;
+        escaped.reserve(value.size());
+
+        for (auto character : value)
+        {
+            if (character == '\\' || character == '"')
+                escaped += '\\';
+
+            if (character == '\n')
+                escaped += "\\n";
+            else
+                escaped += character;
+        }
+
+        return escaped;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void perAttribute(ostream &os,
+        const string &name,
+        const string &help,
+        const vector<hdbpp::HdbAttributeLoad> &loads,
+        uint64_t hdbpp::HdbAttributeLoad::*field)
+    {
+        // a gauge, since an attribute may drop out of the busiest set
+        header(os, name, "gauge", help);
+
+        for (auto &load : loads)
+            os << name << "{attribute=\"" << escapeLabel(load.name) << "\"} " << load.*field << "\n";
+    }
+} // namespace
+
+//=============================================================================
+//=============================================================================
+void ConnectionMetrics::flushed(size_t events, uint64_t duration)
+{
+    lock_guard<mutex> guard(_flush_lock);
+    _batch_events += events;
+    _batch_size.record(events);
+    _flush_duration.record(duration);
+}
+
+//=============================================================================
+//=============================================================================
+void ConnectionMetrics::fill(hdbpp::HdbStats &stats) const
+{
+    for (size_t i = 0; i < TypeCount; i++)
+    {
+        auto stored = _stored[i].load(memory_order_relaxed);
+        auto failed = _failed[i].load(memory_order_relaxed);
+
+        if (stored > 0 || failed > 0)
+        {
+            auto name = tangoEnumToString(static_cast<Tango::CmdArgType>(i));
+            stats.events_stored[name] = stored;
+            stats.events_failed[name] = failed;
+        }
+    }
+
+    stats.error_events_stored = _error_events_stored.load(memory_order_relaxed);
+    stats.retries = _retries.load(memory_order_relaxed);
+    stats.reconnects = _reconnects.load(memory_order_relaxed);
+    stats.connection_lost = _connection_lost.load(memory_order_relaxed);
+    stats.circuit_opens = _circuit_opens.load(memory_order_relaxed);
+    stats.buffer_depth = _buffer_depth.load(memory_order_relaxed);
+    stats.adaptive_batch_size = _adaptive_batch_size.load(memory_order_relaxed);
+    stats.adaptive_flush_interval_us = _adaptive_flush_interval_us.load(memory_order_relaxed);
+    stats.adaptive_increases = _adaptive_increases.load(memory_order_relaxed);
+    stats.adaptive_decreases = _adaptive_decreases.load(memory_order_relaxed);
+
+    {
+        lock_guard<mutex> guard(_flush_lock);
+        stats.batches = _flush_duration.count();
+        stats.batch_events = _batch_events;
+        stats.batch_size_p50 = _batch_size.percentile(50.0);
+        stats.batch_size_max = _batch_size.max();
+        stats.flush_mean_us = _flush_duration.mean() / 1000.0;
+        stats.flush_p50_us = _flush_duration.percentile(50.0) / 1000.0;
+        stats.flush_p99_us = _flush_duration.percentile(99.0) / 1000.0;
+        stats.flush_max_us = _flush_duration.max() / 1000.0;
+    }
+
+    auto cache = [&stats](const string &name, const CacheMetrics &metrics) {
+        hdbpp::HdbCacheStats cache_stats;
+        cache_stats.name = name;
+        cache_stats.hits = metrics.hits.load(memory_order_relaxed);
+        cache_stats.misses = metrics.misses.load(memory_order_relaxed);
+        stats.caches.push_back(cache_stats);
+    };
+
+    cache("conf_id", conf_id_cache);
+    cache("error_desc_id", error_desc_id_cache);
+    cache("event_id", event_id_cache);
+}
+
+//=============================================================================
+//=============================================================================
+auto formatPrometheus(const hdbpp::HdbStats &stats) -> string
+{
+    stringstream os;
+
+    perType(os, "hdbpp_events_stored_total", "Events stored, by Tango type.", stats.events_stored);
+    perType(os, "hdbpp_events_failed_total", "Events that failed to store, by Tango type.", stats.events_failed);
+
+    header(os, "hdbpp_error_events_stored_total", "counter", "Error events stored.");
+    os << "hdbpp_error_events_stored_total " << stats.error_events_stored << "\n";
+
+    header(os, "hdbpp_batch_size_events", "summary", "Events in each batch flushed to the database.");
+    os << "hdbpp_batch_size_events{quantile=\"0.5\"} " << stats.batch_size_p50 << "\n";
+    os << "hdbpp_batch_size_events{quantile=\"1\"} " << stats.batch_size_max << "\n";
+    os << "hdbpp_batch_size_events_sum " << stats.batch_events << "\n";
+    os << "hdbpp_batch_size_events_count " << stats.batches << "\n";
+
+    header(os, "hdbpp_flush_duration_seconds", "summary", "Time taken to flush a batch to the database.");
+    os << "hdbpp_flush_duration_seconds{quantile=\"0.5\"} " << stats.flush_p50_us / 1.0e6 << "\n";
+    os << "hdbpp_flush_duration_seconds{quantile=\"0.99\"} " << stats.flush_p99_us / 1.0e6 << "\n";
+    os << "hdbpp_flush_duration_seconds{quantile=\"1\"} " << stats.flush_max_us / 1.0e6 << "\n";
+    os << "hdbpp_flush_duration_seconds_sum " << stats.flush_mean_us * stats.batches / 1.0e6 << "\n";
+    os << "hdbpp_flush_duration_seconds_count " << stats.batches << "\n";
+
+    header(os, "hdbpp_buffer_depth_events", "gauge", "Events buffered, waiting for a flush.");
+    os << "hdbpp_buffer_depth_events " << stats.buffer_depth << "\n";
+
+    if (stats.adaptive_batch_size > 0)
+    {
+        header(os, "hdbpp_adaptive_batch_size_events", "gauge", "Batch size currently chosen by the batch controller.");
+        os << "hdbpp_adaptive_batch_size_events " << stats.adaptive_batch_size << "\n";
+
+        header(os,
+            "hdbpp_adaptive_flush_interval_seconds",
+            "gauge",
+            "Flush interval currently chosen by the batch controller.");
+        os << "hdbpp_adaptive_flush_interval_seconds " << stats.adaptive_flush_interval_us / 1.0e6 << "\n";
+
+        header(os, "hdbpp_adaptive_increases_total", "counter", "Additive increases made by the batch controller.");
+        os << "hdbpp_adaptive_increases_total " << stats.adaptive_increases << "\n";
+
+        header(os,
+            "hdbpp_adaptive_decreases_total",
+            "counter",
+            "Multiplicative decreases made by the batch controller after a slow or failed batch.");
+        os << "hdbpp_adaptive_decreases_total " << stats.adaptive_decreases << "\n";
+    }
+
+    header(os, "hdbpp_cache_hits_total", "counter", "Id cache lookups served from the cache.");
+
+    for (auto &cache : stats.caches)
+        os << "hdbpp_cache_hits_total{cache=\"" << cache.name << "\"} " << cache.hits << "\n";
+
+    header(os, "hdbpp_cache_misses_total", "counter", "Id cache lookups that went to the database.");
+
+    for (auto &cache : stats.caches)
+        os << "hdbpp_cache_misses_total{cache=\"" << cache.name << "\"} " << cache.misses << "\n";
+
+    header(os, "hdbpp_reconnects_total", "counter", "Connections made to the database after the first.");
+    os << "hdbpp_reconnects_total " << stats.reconnects << "\n";
+
+    header(os, "hdbpp_retries_total", "counter", "Transactions retried after a broken connection.");
+    os << "hdbpp_retries_total " << stats.retries << "\n";
+
+    header(os, "hdbpp_connection_lost", "gauge", "1 while the connection to the database is lost.");
+    os << "hdbpp_connection_lost " << (stats.connection_lost ? 1 : 0) << "\n";
+
+    header(os,
+        "hdbpp_circuit_opens_total",
+        "counter",
+        "Times the circuit breaker opened, failing calls fast while the database is down.");
+    os << "hdbpp_circuit_opens_total " << stats.circuit_opens << "\n";
+
+    if (!stats.top_attributes.empty())
+    {
+        perAttribute(os,
+            "hdbpp_top_attribute_events",
+            "Estimated events stored by the busiest attributes.",
+            stats.top_attributes,
+            &hdbpp::HdbAttributeLoad::events);
+
+        perAttribute(os,
+            "hdbpp_top_attribute_bytes",
+            "Event data bytes stored by the busiest attributes.",
+            stats.top_attributes,
+            &hdbpp::HdbAttributeLoad::bytes);
+
+        perAttribute(os,
+            "hdbpp_top_attribute_errors",
+            "Error events stored by the busiest attributes.",
+            stats.top_attributes,
+            &hdbpp::HdbAttributeLoad::errors);
+    }
+
+    return os.str();
+}
+
+//=============================================================================
+//=============================================================================
+MetricsFileWriter::MetricsFileWriter(string file_name, chrono::seconds interval, function<hdbpp::HdbStats()> stats) :
+    _file_name(move(file_name)), _stats(move(stats)), _task(interval, [this]() { write(); })
+{}
+
+//=============================================================================
+//=============================================================================
+MetricsFileWriter::~MetricsFileWriter()
+{
+    _task.stop();
+
+    // a final write, so the file holds the totals on shutdown
+    write();
+}
+
+//=============================================================================
+//=============================================================================
+auto MetricsFileWriter::write() -> bool
+{
+    auto tmp_file_name = _file_name + ".tmp";
+
+    {
+        ofstream file(tmp_file_name, ios::trunc);
+        file << formatPrometheus(_stats());
+
+        if (!file.good())
+        {
+            spdlog::error("Error: Failed to write the metrics file: {}", tmp_file_name);
+            return false;
+        }
+    }
+
+    if (rename(tmp_file_name.c_str(), _file_name.c_str()) != 0)
+    {
+        spdlog::error("Error: Failed to rename the metrics file: {} to: {}", tmp_file_name, _file_name);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace hdbpp_internal
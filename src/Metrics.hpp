@@ -0,0 +1,141 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _METRICS_HPP
+#define _METRICS_HPP
+
+#include "LatencyHistogram.hpp"
+#include "PeriodicTask.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <hdb++/HdbStats.h>
+#include <mutex>
+#include <string>
+
+namespace hdbpp_internal
+{
+// Hit and miss counters for a ColumnCache
+struct CacheMetrics
+{
+    std::atomic<uint64_t> hits {0};
+    std::atomic<uint64_t> misses {0};
+};
+
+// The runtime metrics for a single DbConnection. Everything is a relaxed atomic
+// (or behind a lock only taken on flush), so the metrics can be read by stats()
+// from any thread while the connection is storing events.
+class ConnectionMetrics
+{
+public:
+    // enough to index every Tango::CmdArgType data type
+    static const std::size_t TypeCount = 32;
+
+    void eventStored(int type) noexcept { count(_stored, type); }
+    void eventFailed(int type) noexcept { count(_failed, type); }
+    void errorEventStored() noexcept { _error_events_stored.fetch_add(1, std::memory_order_relaxed); }
+    void retry() noexcept { _retries.fetch_add(1, std::memory_order_relaxed); }
+    void reconnect() noexcept { _reconnects.fetch_add(1, std::memory_order_relaxed); }
+
+    // whether the connection is lost, and the number of times the circuit breaker has opened
+    void connectionState(bool lost, uint64_t circuit_opens) noexcept
+    {
+        _connection_lost.store(lost, std::memory_order_relaxed);
+        _circuit_opens.store(circuit_opens, std::memory_order_relaxed);
+    }
+    void bufferDepth(std::size_t depth) noexcept { _buffer_depth.store(depth, std::memory_order_relaxed); }
+
+    // the current decisions of the batch controller, and how often it has changed them
+    void batchDecisions(
+        std::size_t batch_size, uint64_t flush_interval_us, uint64_t increases, uint64_t decreases) noexcept
+    {
+        _adaptive_batch_size.store(batch_size, std::memory_order_relaxed);
+        _adaptive_flush_interval_us.store(flush_interval_us, std::memory_order_relaxed);
+        _adaptive_increases.store(increases, std::memory_order_relaxed);
+        _adaptive_decreases.store(decreases, std::memory_order_relaxed);
+    }
+
+    // record a batch of events flushed to the database, and how long it took in nanoseconds
+    void flushed(std::size_t events, uint64_t duration);
+
+    // fill the stats with the current values
+    void fill(hdbpp::HdbStats &stats) const;
+
+    // the caches owned by the connection
+    CacheMetrics conf_id_cache;
+    CacheMetrics error_desc_id_cache;
+    CacheMetrics event_id_cache;
+
+private:
+    using TypeCounters = std::array<std::atomic<uint64_t>, TypeCount>;
+
+    static void count(TypeCounters &counters, int type) noexcept
+    {
+        if (type >= 0 && static_cast<std::size_t>(type) < TypeCount)
+            counters[type].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    TypeCounters _stored {};
+    TypeCounters _failed {};
+    std::atomic<uint64_t> _error_events_stored {0};
+    std::atomic<uint64_t> _retries {0};
+    std::atomic<uint64_t> _reconnects {0};
+    std::atomic<bool> _connection_lost {false};
+    std::atomic<uint64_t> _circuit_opens {0};
+    std::atomic<uint64_t> _buffer_depth {0};
+    std::atomic<uint64_t> _adaptive_batch_size {0};
+    std::atomic<uint64_t> _adaptive_flush_interval_us {0};
+    std::atomic<uint64_t> _adaptive_increases {0};
+    std::atomic<uint64_t> _adaptive_decreases {0};
+
+    mutable std::mutex _flush_lock;
+    uint64_t _batch_events = 0;
+    LatencyHistogram _batch_size;
+    LatencyHistogram _flush_duration;
+};
+
+// format the stats in the Prometheus text exposition format
+auto formatPrometheus(const hdbpp::HdbStats &stats) -> std::string;
+
+// Periodically writes the stats to a file in the Prometheus text format, for the
+// node exporter textfile collector. The file is written to a temporary file and
+// renamed into place, so the collector never reads a partial file.
+class MetricsFileWriter
+{
+public:
+    MetricsFileWriter(std::string file_name, std::chrono::seconds interval, std::function<hdbpp::HdbStats()> stats);
+    ~MetricsFileWriter();
+
+    MetricsFileWriter(const MetricsFileWriter &) = delete;
+    auto operator=(const MetricsFileWriter &) -> MetricsFileWriter & = delete;
+
+    // write the file now, returns false on failure
+    auto write() -> bool;
+
+private:
+    std::string _file_name;
+    std::function<hdbpp::HdbStats()> _stats;
+    PeriodicTask _task;
+};
+
+} // namespace hdbpp_internal
+#endif // _METRICS_HPP
@@ -0,0 +1,98 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _MPSC_QUEUE_HPP
+#define _MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <utility>
+
+namespace hdbpp_internal
+{
+// An unbounded, lock free, multi producer single consumer queue (Vyukov's node based
+// queue). Any number of threads may push() at once, without locks, a push costs an
+// allocation and a single atomic exchange. Only one thread may pop().
+//
+// A push is made visible in two steps (exchange, then link), so for a moment the
+// consumer may see the queue as empty while a push is in flight. Callers that sleep
+// on an empty queue must re-check after the producer has finished its push.
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : _head(new Node), _tail(_head.load()) {}
+
+    ~MpscQueue()
+    {
+        T value;
+
+        while (pop(value))
+            ;
+
+        delete _tail;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    auto operator=(const MpscQueue &) -> MpscQueue & = delete;
+
+    // safe to call from any thread
+    void push(T value)
+    {
+        auto *node = new Node {std::move(value)};
+        auto *previous = _head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_seq_cst);
+    }
+
+    // consumer thread only, returns false when the queue is empty
+    auto pop(T &value) -> bool
+    {
+        auto *next = _tail->next.load(std::memory_order_seq_cst);
+
+        if (next == nullptr)
+            return false;
+
+        // the tail is always an empty node, the popped node becomes the new one
+        value = std::move(next->value);
+        next->value = T {};
+
+        delete _tail;
+        _tail = next;
+        return true;
+    }
+
+    // consumer thread only
+    auto empty() const -> bool { return _tail->next.load(std::memory_order_seq_cst) == nullptr; }
+
+private:
+    struct Node
+    {
+        Node() = default;
+        explicit Node(T &&node_value) : value(std::move(node_value)) {}
+
+        T value {};
+        std::atomic<Node *> next {nullptr};
+    };
+
+    // producers push at the head, the consumer pops from the tail
+    std::atomic<Node *> _head;
+    Node *_tail;
+};
+
+} // namespace hdbpp_internal
+#endif // _MPSC_QUEUE_HPP
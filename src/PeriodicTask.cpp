@@ -0,0 +1,66 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "PeriodicTask.hpp"
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+//=============================================================================
+//=============================================================================
+PeriodicTask::PeriodicTask(chrono::milliseconds interval, function<void()> task) :
+    _interval(interval), _task(move(task))
+{
+    _thread = thread(&PeriodicTask::run, this);
+}
+
+//=============================================================================
+//=============================================================================
+PeriodicTask::~PeriodicTask()
+{
+    stop();
+}
+
+//=============================================================================
+//=============================================================================
+void PeriodicTask::stop()
+{
+    {
+        lock_guard<mutex> guard(_lock);
+        _stop = true;
+    }
+
+    _stop_signal.notify_one();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+//=============================================================================
+//=============================================================================
+void PeriodicTask::run()
+{
+    unique_lock<mutex> guard(_lock);
+
+    while (!_stop_signal.wait_for(guard, _interval, [this]() { return _stop; }))
+        _task();
+}
+
+} // namespace hdbpp_internal
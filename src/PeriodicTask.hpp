@@ -0,0 +1,59 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _PERIODIC_TASK_HPP
+#define _PERIODIC_TASK_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace hdbpp_internal
+{
+// Runs a task on a background thread every interval until stopped. The task is
+// not run on start or stop, an owner that wants a final run calls it after stop().
+// Declare it as the owner's last member, so the thread is joined before the state
+// the task uses is destroyed
+class PeriodicTask
+{
+public:
+    PeriodicTask(std::chrono::milliseconds interval, std::function<void()> task);
+    ~PeriodicTask();
+
+    PeriodicTask(const PeriodicTask &) = delete;
+    auto operator=(const PeriodicTask &) -> PeriodicTask & = delete;
+
+    // wake the thread and wait for it to exit, safe to call more than once
+    void stop();
+
+private:
+    void run();
+
+    std::chrono::milliseconds _interval;
+    std::function<void()> _task;
+    std::mutex _lock;
+    std::condition_variable _stop_signal;
+    bool _stop = false;
+    std::thread _thread;
+};
+
+} // namespace hdbpp_internal
+#endif // _PERIODIC_TASK_HPP
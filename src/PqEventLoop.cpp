@@ -0,0 +1,626 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "PqEventLoop.hpp"
+
+#include "LibUtils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+namespace
+{
+    // how long a connection that failed to reset waits before trying again
+    const chrono::seconds ResetRetryInterval {1};
+
+    // the most events handled per wait, and the longest wait
+    const int MaxEvents = 32;
+    const chrono::milliseconds MaxWait {60000};
+} // namespace
+
+//=============================================================================
+//=============================================================================
+PqEventLoop::PqEventLoop(const string &connect_string, size_t connections) :
+    _connect_string(connect_string), _connections(max(connections, size_t {1}))
+{
+    spdlog::info("Starting the I/O event loop with {} connections", _connections.size());
+
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event wake_event {};
+    wake_event.events = EPOLLIN;
+    wake_event.data.ptr = nullptr;
+
+    if (_epoll_fd < 0 || _wake_fd < 0 || epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &wake_event) != 0)
+    {
+        string msg {"Failed to create the I/O event loop. Error: " + string(strerror(errno))};
+        release();
+
+        spdlog::error("Throwing connection error with message: \"{}\"", msg);
+        Tango::Except::throw_exception("Connection Error", msg, LOCATION_INFO);
+    }
+
+    for (auto &connection : _connections)
+    {
+        connection.conn = PQconnectdb(_connect_string.c_str());
+
+        if (PQstatus(connection.conn) != CONNECTION_OK || PQsetnonblocking(connection.conn, 1) != 0)
+        {
+            string msg {"Failed to connect the I/O event loop to the database. Error: " +
+                string(PQerrorMessage(connection.conn))};
+
+            release();
+
+            spdlog::error("Throwing connection error with message: \"{}\"", msg);
+            Tango::Except::throw_exception("Connection Error", msg, LOCATION_INFO);
+        }
+
+        connection.state = Connection::State::Idle;
+        watch(connection, EPOLLIN);
+        _connected++;
+    }
+
+    _thread = thread(&PqEventLoop::run, this);
+}
+
+//=============================================================================
+//=============================================================================
+PqEventLoop::~PqEventLoop()
+{
+    _stop = true;
+    wake();
+    _thread.join();
+    release();
+}
+
+//=============================================================================
+//=============================================================================
+auto PqEventLoop::submit(string query, chrono::milliseconds timeout, Callback callback) -> uint64_t
+{
+    auto request = make_unique<Query>();
+    request->query = move(query);
+    request->callback = move(callback);
+
+    if (timeout.count() > 0)
+        request->deadline = Clock::now() + timeout;
+
+    uint64_t id = 0;
+
+    {
+        lock_guard<mutex> guard(_lock);
+        id = _next_id++;
+        request->id = id;
+        _in_flight++;
+        _submitted.push_back(move(request));
+    }
+
+    wake();
+    return id;
+}
+
+//=============================================================================
+//=============================================================================
+auto PqEventLoop::execute(string query, chrono::milliseconds timeout) -> Result
+{
+    auto result = make_shared<promise<Result>>();
+    auto completed = result->get_future();
+
+    submit(move(query), timeout, [result](const Result &query_result) { result->set_value(query_result); });
+    return completed.get();
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::cancel(uint64_t id)
+{
+    {
+        lock_guard<mutex> guard(_lock);
+        _cancel_requests.insert(id);
+    }
+
+    wake();
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::run()
+{
+    array<epoll_event, MaxEvents> events {};
+    unordered_set<uint64_t> cancels;
+
+    while (true)
+    {
+        // take over the queries and cancels handed in by the callers
+        {
+            lock_guard<mutex> guard(_lock);
+
+            for (auto &query : _submitted)
+                _queued.push_back(move(query));
+
+            _submitted.clear();
+            cancels.swap(_cancel_requests);
+        }
+
+        if (_stop)
+            break;
+
+        applyCancels(cancels);
+        cancels.clear();
+        checkDeadlines();
+        dispatch();
+
+        auto count = epoll_wait(_epoll_fd, events.data(), MaxEvents, nextTimeout());
+
+        if (count < 0 && errno != EINTR)
+        {
+            spdlog::error("Error: The I/O event loop failed to wait for events: {}", strerror(errno));
+            break;
+        }
+
+        for (auto i = 0; i < count; i++)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                uint64_t value = 0;
+                auto ignored = read(_wake_fd, &value, sizeof(value));
+                (void)ignored;
+                continue;
+            }
+
+            handleEvents(*static_cast<Connection *>(events[i].data.ptr), events[i].events);
+        }
+    }
+
+    shutdown();
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::dispatch()
+{
+    for (auto &connection : _connections)
+    {
+        if (_queued.empty())
+            return;
+
+        if (connection.state != Connection::State::Idle)
+            continue;
+
+        auto query = move(_queued.front());
+        _queued.pop_front();
+
+        // the connection has failed since it was last used, so the query was not sent,
+        // and is left for the next free connection
+        if (PQsendQuery(connection.conn, query->query.c_str()) == 0)
+        {
+            _queued.push_front(move(query));
+            lost(connection);
+            continue;
+        }
+
+        connection.state = Connection::State::Busy;
+        connection.query = move(query);
+        connection.result = Result();
+
+        // a large query may not fit in the socket buffer, in which case the rest is
+        // sent as the socket becomes writable
+        auto flushed = PQflush(connection.conn);
+
+        if (flushed < 0)
+            lost(connection);
+        else
+            watch(connection, flushed == 0 ? EPOLLIN : EPOLLIN | EPOLLOUT);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::handleEvents(Connection &connection, uint32_t events)
+{
+    switch (connection.state)
+    {
+        case Connection::State::Resetting: pollReset(connection); return;
+        case Connection::State::Down: return;
+        default: break;
+    }
+
+    // the server sent data, or closed the connection
+    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0)
+    {
+        if (connection.state == Connection::State::Busy)
+        {
+            readResults(connection);
+        }
+        else
+        {
+            // nothing is expected on an idle connection, apart from notices and the
+            // server closing it
+            if (PQconsumeInput(connection.conn) == 0 || PQstatus(connection.conn) == CONNECTION_BAD)
+            {
+                lost(connection);
+                return;
+            }
+        }
+    }
+
+    // libpq may need to send more after reading, as well as when the socket is writable
+    if (connection.state == Connection::State::Busy && (connection.interest & EPOLLOUT) != 0)
+    {
+        auto flushed = PQflush(connection.conn);
+
+        if (flushed < 0)
+            lost(connection);
+        else if (flushed == 0)
+            watch(connection, EPOLLIN);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::readResults(Connection &connection)
+{
+    if (PQconsumeInput(connection.conn) == 0)
+    {
+        lost(connection);
+        return;
+    }
+
+    while (PQisBusy(connection.conn) == 0)
+    {
+        auto *result = PQgetResult(connection.conn);
+
+        // the end of the query, the connection is free again. The query is gone when it
+        // was timed out or cancelled, and the caller has already been told
+        if (result == nullptr)
+        {
+            connection.state = Connection::State::Idle;
+            watch(connection, EPOLLIN);
+
+            if (connection.query)
+                complete(move(connection.query), connection.result);
+
+            connection.result = Result();
+            return;
+        }
+
+        auto status = PQresultStatus(result);
+
+        // the first error is reported, the rest of the statements are skipped by the server
+        if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK && status != PGRES_EMPTY_QUERY &&
+            connection.result.ok())
+        {
+            connection.result.status = Result::Status::Error;
+            connection.result.error = PQresultErrorMessage(result);
+        }
+
+        PQclear(result);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::checkDeadlines()
+{
+    auto now = Clock::now();
+
+    for (auto iter = _queued.begin(); iter != _queued.end();)
+    {
+        if ((*iter)->deadline <= now)
+        {
+            Result result;
+            result.status = Result::Status::NotSent;
+            result.error = "The query timed out waiting for a free connection";
+
+            complete(move(*iter), result);
+            iter = _queued.erase(iter);
+        }
+        else
+            iter++;
+    }
+
+    for (auto &connection : _connections)
+    {
+        if (connection.state == Connection::State::Busy && connection.query && connection.query->deadline <= now)
+            cancelRunning(connection, Result::Status::TimedOut, "The query timed out");
+
+        if (connection.state == Connection::State::Down && connection.retry_at <= now)
+            startReset(connection);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::applyCancels(const unordered_set<uint64_t> &cancels)
+{
+    if (cancels.empty())
+        return;
+
+    for (auto iter = _queued.begin(); iter != _queued.end();)
+    {
+        if (cancels.count((*iter)->id) > 0)
+        {
+            Result result;
+            result.status = Result::Status::NotSent;
+            result.error = "The query was cancelled before it was sent";
+
+            complete(move(*iter), result);
+            iter = _queued.erase(iter);
+        }
+        else
+            iter++;
+    }
+
+    for (auto &connection : _connections)
+    {
+        if (connection.state == Connection::State::Busy && connection.query &&
+            cancels.count(connection.query->id) > 0)
+            cancelRunning(connection, Result::Status::Cancelled, "The query was cancelled");
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::shutdown()
+{
+    for (auto &connection : _connections)
+    {
+        if (connection.state == Connection::State::Busy && connection.query)
+            cancelRunning(connection, Result::Status::Cancelled, "The I/O event loop was stopped");
+    }
+
+    {
+        lock_guard<mutex> guard(_lock);
+
+        for (auto &query : _submitted)
+            _queued.push_back(move(query));
+
+        _submitted.clear();
+    }
+
+    for (auto &query : _queued)
+    {
+        Result result;
+        result.status = Result::Status::NotSent;
+        result.error = "The I/O event loop was stopped before the query was sent";
+        complete(move(query), result);
+    }
+
+    _queued.clear();
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::complete(unique_ptr<Query> query, const Result &result)
+{
+    _in_flight--;
+
+    // a failing callback must not stop the loop
+    try
+    {
+        query->callback(result);
+    }
+    catch (std::exception &e)
+    {
+        spdlog::error("I/O event loop completion callback raised an exception: {}", e.what());
+    }
+    catch (...)
+    {
+        spdlog::error("I/O event loop completion callback raised an unknown exception");
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::cancelRunning(Connection &connection, Result::Status status, const string &msg)
+{
+    // ask the server to stop the query, this opens a short lived connection to the server.
+    // The connection stays busy until the server has stopped, but the caller is told now
+    auto *cancel = PQgetCancel(connection.conn);
+
+    if (cancel != nullptr)
+    {
+        array<char, 256> error {};
+
+        if (PQcancel(cancel, error.data(), static_cast<int>(error.size())) == 0)
+            spdlog::warn("Failed to cancel a running query: {}", error.data());
+
+        PQfreeCancel(cancel);
+    }
+
+    Result result;
+    result.status = status;
+    result.error = msg;
+    complete(move(connection.query), result);
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::lost(Connection &connection)
+{
+    spdlog::warn("The I/O event loop lost a connection to the database: {}", PQerrorMessage(connection.conn));
+    _connected--;
+
+    if (connection.query)
+    {
+        Result result;
+        result.status = Result::Status::ConnectionLost;
+        result.error = PQerrorMessage(connection.conn);
+        complete(move(connection.query), result);
+    }
+
+    connection.result = Result();
+    startReset(connection);
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::startReset(Connection &connection)
+{
+    // the reset closes the socket, so it must leave epoll first
+    unwatch(connection);
+
+    if (PQresetStart(connection.conn) == 0)
+    {
+        connection.state = Connection::State::Down;
+        connection.retry_at = Clock::now() + ResetRetryInterval;
+        return;
+    }
+
+    // as if PQresetPoll had asked to write
+    connection.state = Connection::State::Resetting;
+    watch(connection, EPOLLOUT);
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::pollReset(Connection &connection)
+{
+    auto status = PQresetPoll(connection.conn);
+
+    if (status == PGRES_POLLING_READING || status == PGRES_POLLING_WRITING)
+    {
+        watch(connection, status == PGRES_POLLING_READING ? EPOLLIN : EPOLLOUT);
+        return;
+    }
+
+    if (status == PGRES_POLLING_OK && PQsetnonblocking(connection.conn, 1) == 0)
+    {
+        spdlog::info("The I/O event loop reconnected to the database");
+        connection.state = Connection::State::Idle;
+        watch(connection, EPOLLIN);
+        _connected++;
+        return;
+    }
+
+    // try again later
+    unwatch(connection);
+    connection.state = Connection::State::Down;
+    connection.retry_at = Clock::now() + ResetRetryInterval;
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::watch(Connection &connection, uint32_t interest)
+{
+    auto socket = PQsocket(connection.conn);
+
+    if (socket != connection.socket)
+        unwatch(connection);
+
+    if (socket < 0)
+        return;
+
+    epoll_event event {};
+    event.events = interest;
+    event.data.ptr = &connection;
+
+    // a socket closed by libpq leaves epoll, and its number may be reused by the next
+    // socket, so modify the existing registration if there is one, otherwise add it
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, socket, &event) != 0 &&
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, socket, &event) != 0)
+    {
+        spdlog::error("Error: The I/O event loop failed to watch a connection: {}", strerror(errno));
+    }
+
+    connection.socket = socket;
+    connection.interest = interest;
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::unwatch(Connection &connection)
+{
+    // fails harmlessly when the socket has already been closed
+    if (connection.socket >= 0)
+        epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, connection.socket, nullptr);
+
+    connection.socket = -1;
+    connection.interest = 0;
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::wake()
+{
+    uint64_t value = 1;
+    auto ignored = write(_wake_fd, &value, sizeof(value));
+    (void)ignored;
+}
+
+//=============================================================================
+//=============================================================================
+auto PqEventLoop::nextTimeout() const -> int
+{
+    auto next = Clock::time_point::max();
+
+    for (auto &query : _queued)
+        next = min(next, query->deadline);
+
+    for (auto &connection : _connections)
+    {
+        if (connection.state == Connection::State::Busy && connection.query)
+            next = min(next, connection.query->deadline);
+
+        if (connection.state == Connection::State::Down)
+            next = min(next, connection.retry_at);
+    }
+
+    if (next == Clock::time_point::max())
+        return -1;
+
+    // round up, so the deadline has passed when the wait ends
+    auto wait = chrono::duration_cast<chrono::milliseconds>(next - Clock::now()) + chrono::milliseconds(1);
+    return static_cast<int>(min(max(wait.count(), chrono::milliseconds::rep {0}), MaxWait.count()));
+}
+
+//=============================================================================
+//=============================================================================
+void PqEventLoop::release()
+{
+    for (auto &connection : _connections)
+    {
+        if (connection.conn != nullptr)
+            PQfinish(connection.conn);
+
+        connection.conn = nullptr;
+    }
+
+    if (_wake_fd >= 0)
+        close(_wake_fd);
+
+    if (_epoll_fd >= 0)
+        close(_epoll_fd);
+
+    _wake_fd = -1;
+    _epoll_fd = -1;
+}
+
+} // namespace hdbpp_internal
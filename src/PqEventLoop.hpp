@@ -0,0 +1,196 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _PQ_EVENT_LOOP_HPP
+#define _PQ_EVENT_LOOP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <libpq-fe.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// An alternative to the blocking pqxx calls for the storage hot path. The PqEventLoop
+// holds several libpq connections in non-blocking mode, and drives them all from a single
+// I/O thread with epoll. Queries are queued from any thread, and run on the first free
+// connection, so one thread can keep many connections busy while the callers get on
+// with serialising the next batch.
+//
+// Each query may hold several statements, and is run as a single (implicit) transaction,
+// so it either commits as a whole or not at all. Queries can be given a timeout, and be
+// cancelled, both of which cancel the query on the server if it is already running. A
+// lost connection is reset in the background without blocking the other connections.
+class PqEventLoop
+{
+public:
+    // the outcome of a query
+    struct Result
+    {
+        enum class Status
+        {
+            // the query committed
+            Ok,
+
+            // the database rejected the query, the error holds the message
+            Error,
+
+            // the connection was lost while the query was running, it may or may not
+            // have committed, the reply could have been lost after the commit
+            ConnectionLost,
+
+            // the timeout expired while the query was running. The query is cancelled on
+            // the server, but may still have committed before the cancel reached it
+            TimedOut,
+
+            // cancelled by cancel() or shutdown while the query was running. As with a
+            // timeout, the query may still have committed
+            Cancelled,
+
+            // the query timed out or was cancelled while still queued, waiting for a free
+            // connection. It was never sent, so can safely be run again
+            NotSent
+        };
+
+        Status status = Status::Ok;
+        std::string error;
+
+        auto ok() const noexcept -> bool { return status == Status::Ok; }
+    };
+
+    // run on the I/O thread once the query completes, so it must not block
+    using Callback = std::function<void(const Result &)>;
+
+    // connect the given number of connections, throws a Tango exception if any can not
+    // connect. A zero timeout in the calls below means no timeout
+    PqEventLoop(const std::string &connect_string, std::size_t connections);
+
+    // queries still running are reported as cancelled, and those still queued as not sent
+    ~PqEventLoop();
+
+    PqEventLoop(const PqEventLoop &) = delete;
+    auto operator=(const PqEventLoop &) -> PqEventLoop & = delete;
+
+    // queue the query, returning an id for cancel(). Safe to call from any thread
+    auto submit(std::string query, std::chrono::milliseconds timeout, Callback callback) -> uint64_t;
+
+    // queue the query, and wait for it to complete. Safe to call from any thread
+    auto execute(std::string query, std::chrono::milliseconds timeout) -> Result;
+
+    // cancel a queued or running query, a query that has already completed is not
+    // affected. Safe to call from any thread
+    void cancel(uint64_t id);
+
+    // the number of connections, and the number that are currently connected
+    auto connections() const noexcept -> std::size_t { return _connections.size(); }
+    auto connected() const noexcept -> std::size_t { return _connected.load(std::memory_order_relaxed); }
+
+    // the number of queries queued or running, safe to call from any thread
+    auto inFlight() const noexcept -> std::size_t { return _in_flight.load(std::memory_order_relaxed); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Query
+    {
+        uint64_t id = 0;
+        std::string query;
+        Clock::time_point deadline = Clock::time_point::max();
+        Callback callback;
+    };
+
+    struct Connection
+    {
+        enum class State
+        {
+            Idle,
+            Busy,
+            Resetting,
+            Down
+        };
+
+        PGconn *conn = nullptr;
+        State state = State::Down;
+
+        // the socket registered with epoll, it changes when the connection is reset
+        int socket = -1;
+        uint32_t interest = 0;
+
+        // the running query, and the first error it reported
+        std::unique_ptr<Query> query;
+        Result result;
+
+        // when a down connection next tries to reset
+        Clock::time_point retry_at;
+    };
+
+    void run();
+    void dispatch();
+    void handleEvents(Connection &connection, uint32_t events);
+    void readResults(Connection &connection);
+    void checkDeadlines();
+    void applyCancels(const std::unordered_set<uint64_t> &cancels);
+    void shutdown();
+    void release();
+
+    void complete(std::unique_ptr<Query> query, const Result &result);
+    void cancelRunning(Connection &connection, Result::Status status, const std::string &msg);
+
+    void lost(Connection &connection);
+    void startReset(Connection &connection);
+    void pollReset(Connection &connection);
+
+    void watch(Connection &connection, uint32_t interest);
+    void unwatch(Connection &connection);
+    void wake();
+    auto nextTimeout() const -> int;
+
+    std::string _connect_string;
+    std::vector<Connection> _connections;
+
+    int _epoll_fd = -1;
+    int _wake_fd = -1;
+
+    // queries waiting for a connection, and the ids to cancel, handed over from the
+    // callers under the lock
+    std::mutex _lock;
+    std::deque<std::unique_ptr<Query>> _submitted;
+    std::unordered_set<uint64_t> _cancel_requests;
+    uint64_t _next_id = 1;
+
+    // owned by the I/O thread
+    std::deque<std::unique_ptr<Query>> _queued;
+
+    std::atomic<std::size_t> _connected {0};
+    std::atomic<std::size_t> _in_flight {0};
+    std::atomic<bool> _stop {false};
+    std::thread _thread;
+};
+
+} // namespace hdbpp_internal
+#endif // _PQ_EVENT_LOOP_HPP
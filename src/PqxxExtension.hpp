@@ -20,6 +20,8 @@
 #ifndef _PQXX_EXTENSION_HPP
 #define _PQXX_EXTENSION_HPP
 
+#include "DataSpan.hpp"
+
 #include <algorithm>
 #include <iostream>
 #include <pqxx/pqxx>
@@ -328,6 +330,38 @@ public:
     }
 };
 
+// Spans are used to pass borrowed event data into the prepared statements, they
+// are only ever converted to strings, never read back from the database.
+template<typename T>
+struct string_traits<hdbpp_internal::DataSpan<T>>
+{
+public:
+    static constexpr auto name() noexcept -> const char * { return "DataSpan"; }
+
+    // NOLINTNEXTLINE (readability-identifier-naming)
+    static constexpr bool has_null() noexcept { return false; }
+
+    // NOLINTNEXTLINE (readability-identifier-naming)
+    static bool is_null(const hdbpp_internal::DataSpan<T> & /*unused*/) { return false; }
+
+    [[noreturn]] static auto null() -> hdbpp_internal::DataSpan<T> { internal::throw_null_conversion(name()); }
+
+    // NOLINTNEXTLINE (readability-identifier-naming)
+    [[noreturn]] static void from_string(const char /*unused*/[], hdbpp_internal::DataSpan<T> & /*unused*/)
+    {
+        throw pqxx::conversion_error("Can not convert to a non-owning DataSpan");
+    }
+
+    // NOLINTNEXTLINE (readability-identifier-naming)
+    static std::string to_string(const hdbpp_internal::DataSpan<T> &value)
+    {
+        if (value.empty())
+            return {};
+
+        return "{" + separated_list(",", value.begin(), value.end()) + "}";
+    }
+};
+
 // Specialization for unsigned char, which was not included in pqxx,
 // this becomes an int16_t in the database
 template<>
@@ -0,0 +1,75 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _PROBES_HPP
+#define _PROBES_HPP
+
+// USDT (SystemTap/DTrace style) static tracepoints on the storage hot path. When
+// built with ENABLE_USDT_PROBES and sys/sdt.h is found, each probe is a single nop
+// instruction until a tracer (bpftrace, perf, stap) attaches to it. Otherwise the
+// probes compile away completely. All probes are in the hdbpp provider:
+//
+//   insert_event_enter(const char *attr_name, int type)
+//   insert_event_exit(const char *attr_name, int success)
+//   insert_events_enter(size_t count)
+//   insert_events_exit(size_t count, int success)
+//   cache_miss(const char *table)
+//   flush_start(size_t queries)
+//   flush_end(size_t queries, int success)
+//   tx_retry(int attempt)
+//   reconnect()
+//
+// for example, to see a histogram of flush latency:
+//
+//   bpftrace -e 'usdt:/usr/local/lib/libhdb++timescale.so:hdbpp:flush_start { @s[tid] = nsecs; }
+//       usdt:/usr/local/lib/libhdb++timescale.so:hdbpp:flush_end /@s[tid]/ {
+//       @us = hist((nsecs - @s[tid]) / 1000); delete(@s[tid]); }'
+
+#ifdef HDBPP_ENABLE_PROBES
+
+#include <sys/sdt.h>
+
+#define HDBPP_PROBE(name) DTRACE_PROBE(hdbpp, name)
+#define HDBPP_PROBE1(name, arg1) DTRACE_PROBE1(hdbpp, name, arg1)
+#define HDBPP_PROBE2(name, arg1, arg2) DTRACE_PROBE2(hdbpp, name, arg1, arg2)
+
+#else
+
+#define HDBPP_PROBE(name) \
+    do                    \
+    {                     \
+    } while (false)
+
+// the arguments are named in an unevaluated sizeof, so variables only used
+// by the probes do not raise unused warnings
+#define HDBPP_PROBE1(name, arg1)           \
+    do                                     \
+    {                                      \
+        static_cast<void>(sizeof((arg1))); \
+    } while (false)
+
+#define HDBPP_PROBE2(name, arg1, arg2)     \
+    do                                     \
+    {                                      \
+        static_cast<void>(sizeof((arg1))); \
+        static_cast<void>(sizeof((arg2))); \
+    } while (false)
+
+#endif // HDBPP_ENABLE_PROBES
+
+#endif // _PROBES_HPP
@@ -438,6 +438,32 @@ namespace pqxx_conn
         return query;
     }
 
+    //=============================================================================
+    //=============================================================================
+    auto QueryBuilder::fetchAllTraitsStatement() -> const string &
+    {
+        // clang-format off
+        static string query =
+            "SELECT DISTINCT " +
+                schema::ConfTypeColTypeNum + "," +
+                schema::ConfFormatColFormatNum + "," +
+                schema::ConfWriteColWriteNum + " " +
+            "FROM " +
+                schema::ConfTableName + " c," +
+                schema::ConfTypeTableName + " t," +
+                schema::ConfFormatTableName + " f," +
+                schema::ConfWriteTableName + " w " +
+            "WHERE " +
+                "t." + schema::ConfColTypeId + "=c." + schema::ConfColTypeId + " " +
+            "AND " +
+                "f." + schema::ConfColFormatTypeId + "=c." + schema::ConfColFormatTypeId + " " +
+            "AND " +
+                "w." + schema::ConfColWriteTypeId + "=c." + schema::ConfColWriteTypeId;
+        // clang-format on
+
+        return query;
+    }
+
     //=============================================================================
     //=============================================================================
     auto QueryBuilder::tableName(const AttributeTraits &traits) -> string
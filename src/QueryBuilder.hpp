@@ -21,6 +21,7 @@
 #define _QUERY_BUILDER_HPP
 
 #include "AttributeTraits.hpp"
+#include "DataSpan.hpp"
 #include "HdbppDefines.hpp"
 #include "PqxxExtension.hpp"
 #include "TimescaleSchema.hpp"
@@ -68,34 +69,43 @@ namespace pqxx_conn
         template<typename T>
         struct DataToString
         {
-            static auto run(const std::unique_ptr<std::vector<T>> &value, bool is_array) -> std::string
+            static auto run(const DataSpan<T> &value, bool is_array) -> std::string
             {
                 if (! is_array)
-                    return pqxx::to_string((*value)[0]);
+                    return pqxx::to_string(value[0]);
 
                 return "'" + pqxx::to_string(value) + "'";
             }
+
+            static auto run(const std::unique_ptr<std::vector<T>> &value, bool is_array) -> std::string
+            {
+                return run(DataSpan<T>(*value), is_array);
+            }
         };
 
-        // Convert a vector<bool> to a postgres array
+        // Convert a span of bools to a postgres array
         template<>
         struct DataToString<bool>
         {
-            static auto run(const std::unique_ptr<std::vector<bool>> &value, bool is_array) -> std::string
+            static auto run(const DataSpan<bool> &value, bool is_array) -> std::string
             {
-                // a vector<bool> is not actually a vector<bool>, rather its some kind of bitfield. When
-                // trying to return an element, we appear to get some kind of bitfield reference,
-                // so we return the value to a local variable to remove the reference to the bitfield and
-                // this ensure its actually a bool passed into the conversion framework
+                // the bool span returns its elements by value, so this is always
+                // a real bool passed into the conversion framework, even when the
+                // span is viewing a vector<bool> bitfield
                 if (!is_array)
                 {
-                    bool v = (*value)[0];
+                    bool v = value[0];
                     return pqxx::to_string(v);
                 }
 
                 // handled by our own extensions in PqxxExtensions.hpp
                 return "'" + pqxx::to_string(value) + "'";
             }
+
+            static auto run(const std::unique_ptr<std::vector<bool>> &value, bool is_array) -> std::string
+            {
+                return run(DataSpan<bool>(*value), is_array);
+            }
         };
 
         // This specialisation for strings uses the ARRAY syntax and dollar quoting to
@@ -103,7 +113,7 @@ namespace pqxx_conn
         template<>
         struct DataToString<std::string>
         {
-            static auto run(const std::unique_ptr<std::vector<std::string>> &value, bool is_array) -> std::string
+            static auto run(const DataSpan<std::string> &value, bool is_array) -> std::string
             {
                 // arrays of strings need both the ARRAY keywords and dollar escaping, this is so we
                 // do not have to rely on the postgres escape functions that double and then store
@@ -111,23 +121,28 @@ namespace pqxx_conn
                 if (!is_array)
                 {
                     // use dollars to ensure it saves
-                    return "$$" + pqxx::to_string((*value)[0]) + "$$";
+                    return "$$" + value[0] + "$$";
                 }
 
-                auto iter = value->begin();
+                auto iter = value.begin();
                 std::string result = "ARRAY[";
 
-                result = result + "$$" + pqxx::to_string((*iter)) + "$$";
+                result = result + "$$" + (*iter) + "$$";
 
-                for (++iter; iter != value->end(); ++iter)
+                for (++iter; iter != value.end(); ++iter)
                 {
                     result += ",";
-                    result += "$$" + pqxx::to_string((*iter)) + "$$";
+                    result += "$$" + (*iter) + "$$";
                 }
 
                 result += "]";
                 return result;
             }
+
+            static auto run(const std::unique_ptr<std::vector<std::string>> &value, bool is_array) -> std::string
+            {
+                return run(DataSpan<std::string>(*value), is_array);
+            }
         };
     }; // namespace query_utils
 
@@ -145,6 +160,7 @@ namespace pqxx_conn
     const string StoreTtl = "StoreTtl";
     const string FetchLastHistoryEvent = "FetchLastHistoryEvent";
     const string FetchAttributeTraits = "FetchAttributeTraits";
+    const string FetchAllTraits = "FetchAllTraits";
     const string FetchValue = "FetchKey";
     const string FetchAllValues = "FetchAllKeys";
 
@@ -166,6 +182,9 @@ namespace pqxx_conn
         static auto fetchLastHistoryEventStatement() -> const std::string &;
         static auto fetchAttributeTraitsStatement() -> const std::string &;
 
+        // the distinct traits of every attribute in the database
+        static auto fetchAllTraitsStatement() -> const std::string &;
+
         static auto storeParameterEventStatement() -> const std::string &;
         static auto storeParameterEventString(const std::string &full_attr_name,
                 const std::string &event_time,
@@ -201,7 +220,17 @@ namespace pqxx_conn
         // A variant of storeDataEventStatement that builds a string based on the
         // parameters, this is then passed back to the caller to be executed. No
         // internal caching, so its less efficient, but can be chained in a pipe
-        // to batch data to the database.
+        // to batch data to the database. The data is read directly from the given
+        // spans, so it is copied only once, into the query string.
+        template<typename T>
+        static auto storeDataEventString(const std::string &id,
+            const std::string &event_time,
+            const std::string &quality,
+            const DataSpan<T> &value_r,
+            const DataSpan<T> &value_w,
+            const AttributeTraits &traits) -> std::string;
+
+        // Overload for owned data, simply views the vectors and builds the query
         template<typename T>
         static auto storeDataEventString(const std::string &id,
             const std::string &event_time,
@@ -291,12 +320,14 @@ namespace pqxx_conn
         return result->second;
     }
 
+    //=============================================================================
+    //=============================================================================
     template<typename T>
     auto QueryBuilder::storeDataEventString(const std::string &id,
         const std::string &event_time,
         const std::string &quality,
-        const std::unique_ptr<vector<T>> &value_r,
-        const std::unique_ptr<vector<T>> &value_w,
+        const DataSpan<T> &value_r,
+        const DataSpan<T> &value_w,
         const AttributeTraits &traits) -> std::string
     {
         auto query = "INSERT INTO " + QueryBuilder::tableName(traits) + " (" + schema::DatColId + "," +
@@ -315,7 +346,7 @@ namespace pqxx_conn
         // add the read parameter with cast
         if (traits.hasReadData())
         {
-            if (value_r->empty())
+            if (value_r.empty())
             {
                 query = query + ",NULL";
             }
@@ -329,7 +360,7 @@ namespace pqxx_conn
         // add the write parameter with cast
         if (traits.hasWriteData())
         {
-            if (value_w->empty())
+            if (value_w.empty())
             {
                 query = query + ",NULL";
             }
@@ -346,6 +377,20 @@ namespace pqxx_conn
         return query;
     }
 
+    //=============================================================================
+    //=============================================================================
+    template<typename T>
+    auto QueryBuilder::storeDataEventString(const std::string &id,
+        const std::string &event_time,
+        const std::string &quality,
+        const std::unique_ptr<vector<T>> &value_r,
+        const std::unique_ptr<vector<T>> &value_w,
+        const AttributeTraits &traits) -> std::string
+    {
+        return storeDataEventString<T>(
+            id, event_time, quality, DataSpan<T>(*value_r), DataSpan<T>(*value_w), traits);
+    }
+
 } // namespace pqxx_conn
 } // namespace hdbpp_internal
 #endif // _QUERY_BUILDER_HPP
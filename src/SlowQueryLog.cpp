@@ -0,0 +1,132 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "SlowQueryLog.hpp"
+
+#include "spdlog/spdlog.h"
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+//=============================================================================
+//=============================================================================
+SlowQueryLog::Scope::Scope(
+    SlowQueryLog &log, const string &statement_class, size_t rows, const string *prepared_name) noexcept :
+    _log(log),
+    _statement_class(statement_class),
+    _rows(rows),
+    _prepared_name(prepared_name),
+    _dismissed(!log.enabled())
+{
+    // no need to read the clock when the log is disabled
+    if (!_dismissed)
+        _start = chrono::steady_clock::now();
+}
+
+//=============================================================================
+//=============================================================================
+SlowQueryLog::Scope::~Scope()
+{
+    if (_dismissed)
+        return;
+
+    try
+    {
+        _log.record(_statement_class, _rows, chrono::steady_clock::now() - _start, _prepared_name);
+    }
+    catch (...)
+    {
+        // never throw from the destructor, the statement has already succeeded
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void SlowQueryLog::configure(chrono::microseconds threshold, unsigned int explain_sample)
+{
+    _threshold = threshold;
+    _explain_sample = explain_sample;
+    _pending_explains.clear();
+}
+
+//=============================================================================
+//=============================================================================
+auto SlowQueryLog::record(
+    const string &statement_class, size_t rows, chrono::nanoseconds duration, const string *prepared_name) -> bool
+{
+    if (!enabled() || duration < _threshold)
+        return false;
+
+    _slow_count++;
+
+    spdlog::warn("Slow statement: {} rows: {} took: {} ms (threshold: {} ms)",
+        statement_class,
+        rows,
+        chrono::duration<double, milli>(duration).count(),
+        chrono::duration<double, milli>(_threshold).count());
+
+    if (prepared_name != nullptr && _explain_sample > 0)
+    {
+        // sample every nth slow prepared statement to be explained on its next run
+        if (_slow_prepared_count++ % _explain_sample == 0)
+        {
+            spdlog::info("Prepared statement: {} will be explained on its next run", *prepared_name);
+            _pending_explains.insert(*prepared_name);
+        }
+    }
+
+    return true;
+}
+
+//=============================================================================
+//=============================================================================
+auto SlowQueryLog::takeExplain(const string &prepared_name) -> bool
+{
+    if (_pending_explains.empty())
+        return false;
+
+    return _pending_explains.erase(prepared_name) > 0;
+}
+
+//=============================================================================
+//=============================================================================
+auto SlowQueryLog::explainName(const string &prepared_name) -> string
+{
+    return "Explain" + prepared_name;
+}
+
+//=============================================================================
+//=============================================================================
+auto SlowQueryLog::explainStatement(const string &statement) -> string
+{
+    return "EXPLAIN (ANALYZE, BUFFERS) " + statement;
+}
+
+//=============================================================================
+//=============================================================================
+void SlowQueryLog::logPlan(const string &prepared_name, const vector<string> &plan)
+{
+    spdlog::warn("Plan for slow prepared statement: {}", prepared_name);
+
+    for (const auto &line : plan)
+        spdlog::warn("    {}", line);
+}
+
+} // namespace hdbpp_internal
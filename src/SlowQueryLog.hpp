@@ -0,0 +1,113 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _SLOW_QUERY_LOG_HPP
+#define _SLOW_QUERY_LOG_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// Logs statements that succeeded but were slow, e.g. chunk creation stalls or index
+// bloat on the data tables. Each executed transaction (or flushed batch) is recorded
+// with its duration, and those over the threshold are logged with their statement
+// class (the transaction name) and row count, never the query itself, since it may
+// carry a large array payload.
+//
+// For prepared statements, every nth slow statement is sampled: the next time that
+// statement runs it is executed via EXPLAIN (ANALYZE, BUFFERS) instead, so the data
+// is still stored exactly once, and the plan is logged.
+//
+// Owned by a single DbConnection, so it is not thread safe.
+class SlowQueryLog
+{
+public:
+    // Records a statement when it goes out of scope, unless dismissed
+    // because the statement failed
+    class Scope
+    {
+    public:
+        Scope(SlowQueryLog &log,
+            const std::string &statement_class,
+            std::size_t rows,
+            const std::string *prepared_name) noexcept;
+
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        auto operator=(const Scope &) -> Scope & = delete;
+
+        void dismiss() noexcept { _dismissed = true; }
+
+    private:
+        SlowQueryLog &_log;
+        const std::string &_statement_class;
+        std::size_t _rows;
+        const std::string *_prepared_name;
+        std::chrono::steady_clock::time_point _start;
+        bool _dismissed;
+    };
+
+    // a zero threshold disables the log, a zero explain_sample disables explains
+    void configure(std::chrono::microseconds threshold, unsigned int explain_sample);
+
+    auto enabled() const noexcept -> bool { return _threshold.count() > 0; }
+    auto threshold() const noexcept -> std::chrono::microseconds { return _threshold; }
+    auto explainSample() const noexcept -> unsigned int { return _explain_sample; }
+
+    // record an executed statement, returns true and logs it when slow. When the
+    // statement was prepared its name is given, so it can be sampled for an explain
+    auto record(const std::string &statement_class,
+        std::size_t rows,
+        std::chrono::nanoseconds duration,
+        const std::string *prepared_name = nullptr) -> bool;
+
+    // returns true once for each time the prepared statement has been sampled
+    // for an explain, the caller must then run it via the explain statement
+    auto takeExplain(const std::string &prepared_name) -> bool;
+
+    // number of slow statements recorded
+    auto slowCount() const noexcept -> uint64_t { return _slow_count; }
+
+    // the name and statement of the explain variant of a prepared statement, it
+    // takes the same parameters
+    static auto explainName(const std::string &prepared_name) -> std::string;
+    static auto explainStatement(const std::string &statement) -> std::string;
+
+    // log the plan returned by running an explain statement
+    static void logPlan(const std::string &prepared_name, const std::vector<std::string> &plan);
+
+private:
+    std::chrono::microseconds _threshold {0};
+    unsigned int _explain_sample = 0;
+
+    uint64_t _slow_count = 0;
+    uint64_t _slow_prepared_count = 0;
+
+    // prepared statements sampled to be explained on their next run
+    std::unordered_set<std::string> _pending_explains;
+};
+
+} // namespace hdbpp_internal
+#endif // _SLOW_QUERY_LOG_HPP
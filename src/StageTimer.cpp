@@ -0,0 +1,254 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "StageTimer.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+namespace
+{
+    // the timings one thread has recorded into one set of StageTimers
+    struct ThreadTimers
+    {
+        array<AtomicLatencyHistogram, StageCount> histograms;
+
+        // the reset the histograms were last cleared for, see StageTimers::reset()
+        atomic<uint64_t> generation {0};
+    };
+
+    // the source of registry ids, an id is never reused, so a thread can not mistake
+    // new timers for a destroyed set that happened to live at the same address
+    atomic<uint64_t> next_registry_id {1};
+} // namespace
+
+// the live per thread timers, and the timings of the threads that have exited. The lock
+// is never taken on the hot path, only when a thread first records, or exits
+struct StageTimers::Registry
+{
+    uint64_t id = next_registry_id.fetch_add(1, memory_order_relaxed);
+    mutex lock;
+    vector<ThreadTimers *> threads;
+    StageHistograms retired;
+
+    // bumped by each reset, a thread's histograms only count for the current generation
+    atomic<uint64_t> generation {0};
+};
+
+namespace
+{
+    // the timers a thread records into, one per set of StageTimers it has used. They
+    // are retired as the thread exits, unless the StageTimers has gone already
+    struct ThreadLocalTimers
+    {
+        struct Entry
+        {
+            uint64_t id;
+            weak_ptr<StageTimers::Registry> registry;
+            unique_ptr<ThreadTimers> timers;
+        };
+
+        ~ThreadLocalTimers()
+        {
+            for (auto &entry : entries)
+            {
+                auto registry = entry.registry.lock();
+
+                if (!registry)
+                    continue;
+
+                lock_guard<mutex> guard(registry->lock);
+
+                if (entry.timers->generation.load(memory_order_relaxed) ==
+                    registry->generation.load(memory_order_relaxed))
+                {
+                    for (size_t i = 0; i < StageCount; i++)
+                        entry.timers->histograms[i].mergeInto(registry->retired[i]);
+                }
+
+                registry->threads.erase(
+                    find(registry->threads.begin(), registry->threads.end(), entry.timers.get()));
+            }
+        }
+
+        // find or create the timers for the registry, dropping any whose registry is gone
+        auto timersFor(const shared_ptr<StageTimers::Registry> &registry) -> ThreadTimers *
+        {
+            entries.erase(remove_if(entries.begin(),
+                              entries.end(),
+                              [](const Entry &entry) { return entry.registry.expired(); }),
+                entries.end());
+
+            for (auto &entry : entries)
+                if (entry.id == registry->id)
+                    return entry.timers.get();
+
+            auto timers = make_unique<ThreadTimers>();
+
+            {
+                lock_guard<mutex> guard(registry->lock);
+                timers->generation.store(registry->generation.load(memory_order_relaxed), memory_order_relaxed);
+                registry->threads.push_back(timers.get());
+            }
+
+            entries.push_back(Entry {registry->id, registry, move(timers)});
+            return entries.back().timers.get();
+        }
+
+        vector<Entry> entries;
+
+        // the last timers recorded into, so the hot path need not search
+        uint64_t last_id = 0;
+        ThreadTimers *last = nullptr;
+    };
+
+    thread_local ThreadLocalTimers thread_timers;
+} // namespace
+
+//=============================================================================
+//=============================================================================
+auto stageName(Stage stage) noexcept -> const char *
+{
+    switch (stage)
+    {
+        case Stage::Extract: return "extract";
+        case Stage::CacheLookup: return "cache_lookup";
+        case Stage::QueryBuild: return "query_build";
+        case Stage::Execute: return "execute";
+        case Stage::Commit: return "commit";
+    }
+
+    return "unknown";
+}
+
+//=============================================================================
+//=============================================================================
+StageTimers::StageTimers() : _registry(make_shared<Registry>()) {}
+
+//=============================================================================
+//=============================================================================
+StageTimers::~StageTimers() = default;
+
+//=============================================================================
+//=============================================================================
+void StageTimers::record(Stage stage, uint64_t duration) noexcept
+{
+    auto &local = thread_timers;
+
+    if (local.last_id != _registry->id)
+    {
+        try
+        {
+            local.last = local.timersFor(_registry);
+            local.last_id = _registry->id;
+        }
+        catch (...)
+        {
+            // timing is best effort, it must never fail the store
+            return;
+        }
+    }
+
+    auto &timers = *local.last;
+    auto generation = _registry->generation.load(memory_order_relaxed);
+
+    // the timers were reset since this thread last recorded, so clear its timings first
+    if (timers.generation.load(memory_order_relaxed) != generation)
+    {
+        for (auto &histogram : timers.histograms)
+            histogram.reset();
+
+        timers.generation.store(generation, memory_order_release);
+    }
+
+    timers.histograms[static_cast<size_t>(stage)].record(duration);
+}
+
+//=============================================================================
+//=============================================================================
+auto StageTimers::snapshot() const -> StageHistograms
+{
+    lock_guard<mutex> guard(_registry->lock);
+
+    auto result = _registry->retired;
+    auto generation = _registry->generation.load(memory_order_relaxed);
+
+    // a thread that has not recorded since the last reset has not cleared its timings
+    // yet, so they are skipped
+    for (auto *timers : _registry->threads)
+    {
+        if (timers->generation.load(memory_order_acquire) != generation)
+            continue;
+
+        for (size_t i = 0; i < StageCount; i++)
+            timers->histograms[i].mergeInto(result[i]);
+    }
+
+    return result;
+}
+
+//=============================================================================
+//=============================================================================
+void StageTimers::reset()
+{
+    lock_guard<mutex> guard(_registry->lock);
+
+    for (auto &histogram : _registry->retired)
+        histogram.reset();
+
+    _registry->generation.fetch_add(1, memory_order_relaxed);
+}
+
+//=============================================================================
+//=============================================================================
+StageTimingLogger::StageTimingLogger(const StageTimers &timers, chrono::seconds interval) :
+    _task(interval, [&timers]() { log(timers); })
+{}
+
+//=============================================================================
+//=============================================================================
+StageTimingLogger::~StageTimingLogger() = default;
+
+//=============================================================================
+//=============================================================================
+void StageTimingLogger::log(const StageTimers &timers)
+{
+    auto histograms = timers.snapshot();
+
+    for (size_t i = 0; i < StageCount; i++)
+    {
+        auto &histogram = histograms[i];
+
+        spdlog::info("Stage timing: {}: count: {}, mean: {:.1f}us, p50: {:.1f}us, p99: {:.1f}us, max: {:.1f}us",
+            stageName(static_cast<Stage>(i)),
+            histogram.count(),
+            histogram.mean() / 1000.0,
+            histogram.percentile(50.0) / 1000.0,
+            histogram.percentile(99.0) / 1000.0,
+            histogram.max() / 1000.0);
+    }
+}
+
+} // namespace hdbpp_internal
@@ -0,0 +1,150 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _STAGE_TIMER_HPP
+#define _STAGE_TIMER_HPP
+
+#include "LatencyHistogram.hpp"
+#include "PeriodicTask.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace hdbpp_internal
+{
+// The stages an event passes through on its way to the database
+enum class Stage : std::size_t
+{
+    // getting the data out of the Tango DeviceAttribute (HdbppTxDataEvent)
+    Extract = 0,
+
+    // attribute id lookups in the ColumnCache
+    CacheLookup,
+
+    // building the sql string, or binding the prepared statement parameters
+    QueryBuild,
+
+    // running the query on the server (or the buffered queries on flush)
+    Execute,
+
+    // committing the transaction
+    Commit
+};
+
+const std::size_t StageCount = 5;
+
+using StageHistograms = std::array<LatencyHistogram, StageCount>;
+
+auto stageName(Stage stage) noexcept -> const char *;
+
+// Timing of the hot path stages, each connection has its own. The timers are always
+// compiled in, but only record when enabled, so the disabled cost is a single relaxed
+// atomic load per stage. Each thread records into its own histograms of relaxed atomic
+// counts, so recording takes no lock, and there is no contention between threads storing
+// events. The per thread histograms are merged on snapshot(), and are kept (merged into a
+// retired set) when a thread exits.
+class StageTimers
+{
+public:
+    StageTimers();
+    ~StageTimers();
+
+    StageTimers(const StageTimers &) = delete;
+    auto operator=(const StageTimers &) -> StageTimers & = delete;
+
+    void enable(bool enable) noexcept { _enabled.store(enable, std::memory_order_relaxed); }
+    auto enabled() const noexcept -> bool { return _enabled.load(std::memory_order_relaxed); }
+
+    // record a duration, in nanoseconds, against the stage for the calling thread
+    void record(Stage stage, uint64_t duration) noexcept;
+
+    // the timings for all threads merged together
+    auto snapshot() const -> StageHistograms;
+
+    // clear the timings for all threads, each clears its own histograms when it next records
+    void reset();
+
+    // the threads recording into the timers, shared with the threads so they can retire
+    // their timings should they outlive the timers
+    struct Registry;
+
+private:
+    std::atomic<bool> _enabled {false};
+    std::shared_ptr<Registry> _registry;
+};
+
+// Times the enclosing scope and records it against the given stage, when the timers are
+// given and enabled
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(StageTimers *timers, Stage stage) noexcept :
+        _timers(timers),
+        _stage(stage),
+        _enabled(timers != nullptr && timers->enabled())
+    {
+        if (_enabled)
+            _start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedStageTimer()
+    {
+        if (_enabled)
+        {
+            _timers->record(_stage,
+                static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start)
+                        .count()));
+        }
+    }
+
+    ScopedStageTimer(const ScopedStageTimer &) = delete;
+    auto operator=(const ScopedStageTimer &) -> ScopedStageTimer & = delete;
+
+private:
+    StageTimers *_timers;
+    Stage _stage;
+    bool _enabled;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Periodically writes the stage timings (since they were enabled or last reset) to the
+// log at info level, from a background thread. The timers must outlive the logger
+class StageTimingLogger
+{
+public:
+    StageTimingLogger(const StageTimers &timers, std::chrono::seconds interval);
+    ~StageTimingLogger();
+
+    StageTimingLogger(const StageTimingLogger &) = delete;
+    auto operator=(const StageTimingLogger &) -> StageTimingLogger & = delete;
+
+    // write the current timings to the log
+    static void log(const StageTimers &timers);
+
+private:
+    PeriodicTask _task;
+};
+
+} // namespace hdbpp_internal
+#endif // _STAGE_TIMER_HPP
@@ -0,0 +1,366 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _STORAGE_ENGINE_HPP
+#define _STORAGE_ENGINE_HPP
+
+#include "MpscQueue.hpp"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <hdb++/HdbEventStatus.h>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// Serialises the use of a single (not thread safe) connection between any number of
+// producer threads, without a lock around the connection. Producers push requests onto
+// a lock free queue, and a single engine thread drains it, so only the engine thread
+// ever touches the connection.
+//
+// Every event queued while the engine is busy is stored together in the next group
+// (group commit), via a single call to the store function, so under load the batch
+// size grows with the number of producers, and the cost of each round trip to the
+// database is shared. Other work (new attributes, history events etc) is run on the
+// engine thread in queue order, between the groups.
+template<typename Event>
+class StorageEngine
+{
+public:
+    using Statuses = std::vector<hdbpp::HdbEventStatus>;
+
+    // stores a group of events as a single batch, returning the status of each event
+    using StoreFunc = std::function<Statuses(std::vector<Event> &)>;
+
+    // told the statuses of the submitted events, or the exception raised storing them
+    using Callback = std::function<void(const Statuses &, std::exception_ptr)>;
+
+    // a group is closed once it holds at least max_group events
+    StorageEngine(StoreFunc store, std::size_t max_group);
+    ~StorageEngine();
+
+    StorageEngine(const StorageEngine &) = delete;
+    auto operator=(const StorageEngine &) -> StorageEngine & = delete;
+
+    // queue the events to be stored, the future is given the status of each event once
+    // they have been, or the exception raised storing their group. Safe to call from
+    // any thread
+    auto submit(std::vector<Event> events) -> std::future<Statuses>;
+
+    // as submit(), but rather than a future the callback is run on the engine thread once
+    // the events are stored. Any exception raised by the callback is logged and dropped
+    void submit(std::vector<Event> events, Callback callback);
+
+    // run the work on the engine thread, in queue order, and wait for it to finish. Any
+    // exception raised by the work is rethrown here. Safe to call from any thread
+    void execute(const std::function<void()> &work);
+
+    // true when called on the engine thread, such as from a completion callback, where
+    // waiting on the engine would deadlock
+    auto onEngineThread() const noexcept -> bool { return std::this_thread::get_id() == _thread.get_id(); }
+
+    // the number of groups stored, and the events in them, safe to call from any thread
+    auto groups() const noexcept -> uint64_t { return _groups.load(std::memory_order_relaxed); }
+    auto groupedEvents() const noexcept -> uint64_t { return _grouped_events.load(std::memory_order_relaxed); }
+
+private:
+    // a request holds either events, or work to run. The result is given to the
+    // callback when there is one, otherwise the promise
+    struct Request
+    {
+        std::vector<Event> events;
+        std::function<void()> work;
+        std::promise<Statuses> result;
+        Callback callback;
+    };
+
+    using Requests = std::vector<std::unique_ptr<Request>>;
+
+    void push(std::unique_ptr<Request> request);
+    void run();
+    void process(Requests &requests);
+    void storeGroup(Requests &requests, std::size_t begin, std::size_t end);
+    void complete(Request &request, Statuses statuses, std::exception_ptr error);
+
+    StoreFunc _store;
+    std::size_t _max_group;
+
+    MpscQueue<std::unique_ptr<Request>> _queue;
+
+    // the engine thread sleeps on the signal when the queue is empty, producers only
+    // take the lock to wake it when it is sleeping
+    std::mutex _lock;
+    std::condition_variable _work_signal;
+    std::atomic<bool> _sleeping {false};
+    std::atomic<bool> _stop {false};
+
+    std::atomic<uint64_t> _groups {0};
+    std::atomic<uint64_t> _grouped_events {0};
+
+    std::thread _thread;
+};
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+StorageEngine<Event>::StorageEngine(StoreFunc store, std::size_t max_group) :
+    _store(std::move(store)), _max_group(std::max(max_group, std::size_t {1}))
+{
+    _thread = std::thread(&StorageEngine::run, this);
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+StorageEngine<Event>::~StorageEngine()
+{
+    // anything already queued is still stored before the engine stops
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _stop = true;
+    }
+
+    _work_signal.notify_one();
+    _thread.join();
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+auto StorageEngine<Event>::submit(std::vector<Event> events) -> std::future<Statuses>
+{
+    auto request = std::make_unique<Request>();
+    request->events = std::move(events);
+
+    auto result = request->result.get_future();
+    push(std::move(request));
+    return result;
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+void StorageEngine<Event>::submit(std::vector<Event> events, Callback callback)
+{
+    auto request = std::make_unique<Request>();
+    request->events = std::move(events);
+    request->callback = std::move(callback);
+    push(std::move(request));
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+void StorageEngine<Event>::execute(const std::function<void()> &work)
+{
+    // work run by the engine may itself call back into the engine
+    if (onEngineThread())
+    {
+        work();
+        return;
+    }
+
+    auto request = std::make_unique<Request>();
+    request->work = work;
+
+    auto result = request->result.get_future();
+    push(std::move(request));
+    result.get();
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+void StorageEngine<Event>::push(std::unique_ptr<Request> request)
+{
+    _queue.push(std::move(request));
+
+    // the push is complete, so if the engine checked the queue before it, it has
+    // already marked itself as sleeping, and must be woken
+    if (_sleeping.load())
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _work_signal.notify_one();
+    }
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+void StorageEngine<Event>::run()
+{
+    Requests requests;
+
+    while (true)
+    {
+        std::unique_ptr<Request> request;
+        std::size_t events = 0;
+
+        // take everything queued, up to the group size
+        while (events < _max_group && _queue.pop(request))
+        {
+            events += request->work ? 1 : request->events.size();
+            requests.push_back(std::move(request));
+        }
+
+        if (!requests.empty())
+        {
+            process(requests);
+            requests.clear();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(_lock);
+
+        if (_stop)
+            return;
+
+        _sleeping = true;
+        _work_signal.wait(guard, [this]() { return _stop || !_queue.empty(); });
+        _sleeping = false;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+void StorageEngine<Event>::process(Requests &requests)
+{
+    std::size_t begin = 0;
+
+    while (begin < requests.size())
+    {
+        auto &request = *requests[begin];
+
+        if (request.work)
+        {
+            try
+            {
+                request.work();
+                request.result.set_value({});
+            }
+            catch (...)
+            {
+                request.result.set_exception(std::current_exception());
+            }
+
+            begin++;
+            continue;
+        }
+
+        // store the run of event requests up to the next work as one group
+        auto end = begin;
+
+        while (end < requests.size() && !requests[end]->work)
+            end++;
+
+        storeGroup(requests, begin, end);
+        begin = end;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+void StorageEngine<Event>::storeGroup(Requests &requests, std::size_t begin, std::size_t end)
+{
+    std::vector<Event> events;
+    std::vector<std::size_t> sizes;
+
+    for (auto i = begin; i < end; i++)
+    {
+        auto &request_events = requests[i]->events;
+        sizes.push_back(request_events.size());
+        events.insert(events.end(),
+            std::make_move_iterator(request_events.begin()),
+            std::make_move_iterator(request_events.end()));
+    }
+
+    _groups.fetch_add(1, std::memory_order_relaxed);
+    _grouped_events.fetch_add(events.size(), std::memory_order_relaxed);
+
+    try
+    {
+        auto statuses = _store(events);
+        assert(statuses.size() == events.size());
+
+        // hand each request back the statuses of its own events
+        auto offset = statuses.begin();
+
+        for (auto i = begin; i < end; i++)
+        {
+            auto size = static_cast<std::ptrdiff_t>(sizes[i - begin]);
+            complete(*requests[i], Statuses(offset, offset + size), nullptr);
+            offset += size;
+        }
+    }
+    catch (...)
+    {
+        // the group failed as a whole, for example the connection was lost
+        auto error = std::current_exception();
+
+        for (auto i = begin; i < end; i++)
+            complete(*requests[i], {}, error);
+    }
+}
+
+//=============================================================================
+//=============================================================================
+template<typename Event>
+void StorageEngine<Event>::complete(Request &request, Statuses statuses, std::exception_ptr error)
+{
+    if (!request.callback)
+    {
+        if (error)
+            request.result.set_exception(error);
+        else
+            request.result.set_value(std::move(statuses));
+
+        return;
+    }
+
+    // a failing callback must not stop the engine, or fail the rest of the group
+    try
+    {
+        request.callback(statuses, error);
+    }
+    catch (std::exception &e)
+    {
+        spdlog::error("Storage engine completion callback raised an exception: {}", e.what());
+    }
+    catch (...)
+    {
+        spdlog::error("Storage engine completion callback raised an unknown exception");
+    }
+}
+
+} // namespace hdbpp_internal
+#endif // _STORAGE_ENGINE_HPP
@@ -0,0 +1,210 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+namespace hdbpp_internal
+{
+//=============================================================================
+//=============================================================================
+ThreadPool::ThreadPool(size_t threads)
+{
+    for (size_t i = 0; i < threads; i++)
+        _queues.push_back(make_unique<Queue>());
+
+    for (size_t i = 0; i < threads; i++)
+        _workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+//=============================================================================
+//=============================================================================
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(_lock);
+        _stop = true;
+    }
+
+    _work_signal.notify_all();
+
+    for (auto &worker : _workers)
+        worker.join();
+}
+
+//=============================================================================
+//=============================================================================
+void ThreadPool::parallelFor(size_t count, size_t grain, const function<void(size_t, size_t)> &func)
+{
+    grain = max(grain, size_t {1});
+
+    // nothing to share the work with
+    if (_workers.empty() || count <= grain)
+    {
+        for (size_t begin = 0; begin < count; begin += grain)
+            func(begin, min(begin + grain, count));
+
+        return;
+    }
+
+    // the state shared by the ranges of this call, the caller does not return until
+    // every range is done, so it can live on the stack
+    struct State
+    {
+        mutex lock;
+        condition_variable done_signal;
+        size_t remaining = 0;
+        exception_ptr error;
+    } state;
+
+    state.remaining = (count + grain - 1) / grain;
+
+    size_t queue = 0;
+
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+        auto end = min(begin + grain, count);
+
+        push(queue, [&state, &func, begin, end]() {
+            exception_ptr error;
+
+            try
+            {
+                func(begin, end);
+            }
+            catch (...)
+            {
+                error = current_exception();
+            }
+
+            // notify under the lock, so the caller can not see the last range complete
+            // and destroy the state before the notify is done
+            lock_guard<mutex> guard(state.lock);
+
+            if (error && !state.error)
+                state.error = error;
+
+            if (--state.remaining == 0)
+                state.done_signal.notify_all();
+        });
+
+        queue = (queue + 1) % _queues.size();
+    }
+
+    // the caller has no queue of its own, so it steals until there is nothing
+    // left, then waits for the workers to finish the ranges they hold
+    Task task;
+
+    while (take(_queues.size(), task))
+    {
+        task();
+        task = nullptr;
+    }
+
+    unique_lock<mutex> guard(state.lock);
+    state.done_signal.wait(guard, [&state]() { return state.remaining == 0; });
+
+    if (state.error)
+        rethrow_exception(state.error);
+}
+
+//=============================================================================
+//=============================================================================
+void ThreadPool::run(size_t index)
+{
+    Task task;
+
+    while (true)
+    {
+        if (take(index, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        unique_lock<mutex> guard(_lock);
+        _work_signal.wait(guard, [this]() { return _stop || _queued > 0; });
+
+        if (_stop)
+            return;
+    }
+}
+
+//=============================================================================
+//=============================================================================
+void ThreadPool::push(size_t index, Task &&task)
+{
+    {
+        lock_guard<mutex> guard(_queues[index]->lock);
+        _queues[index]->tasks.push_back(move(task));
+    }
+
+    {
+        lock_guard<mutex> guard(_lock);
+        _queued++;
+    }
+
+    _work_signal.notify_one();
+}
+
+//=============================================================================
+//=============================================================================
+auto ThreadPool::take(size_t index, Task &task) -> bool
+{
+    auto taken = false;
+
+    for (size_t i = 0; i < _queues.size() && !taken; i++)
+    {
+        auto &queue = *_queues[(index + i) % _queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+
+        if (queue.tasks.empty())
+            continue;
+
+        // the newest task from our own queue, while its data is still warm, the
+        // oldest when stealing from another
+        if (i == 0 && index < _queues.size())
+        {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        taken = true;
+    }
+
+    if (taken)
+    {
+        lock_guard<mutex> guard(_lock);
+        _queued--;
+    }
+
+    return taken;
+}
+
+} // namespace hdbpp_internal
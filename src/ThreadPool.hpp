@@ -0,0 +1,84 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#ifndef _THREAD_POOL_HPP
+#define _THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hdbpp_internal
+{
+// A small work stealing thread pool, used to spread the cpu bound work of a large batch
+// across cores. Each worker has its own queue, it takes work from the back of its own
+// queue and steals from the front of the other queues when its own runs dry, so a
+// worker stuck on an expensive item does not hold up the rest of the batch.
+class ThreadPool
+{
+public:
+    // the pool starts the given number of worker threads, zero is allowed, in which
+    // case all work is done on the calling thread
+    explicit ThreadPool(std::size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    auto operator=(const ThreadPool &) -> ThreadPool & = delete;
+
+    auto size() const noexcept -> std::size_t { return _workers.size(); }
+
+    // split [0, count) into ranges of at most grain items, and call func(begin, end) for
+    // each range across the pool. The calling thread works on the ranges too, and the call
+    // returns once every range is done. The first exception thrown by func is rethrown
+    // once all the ranges have finished
+    void parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &func);
+
+private:
+    using Task = std::function<void()>;
+
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void run(std::size_t index);
+    void push(std::size_t index, Task &&task);
+
+    // take a task, from the back of the given queue, or the front of any other
+    auto take(std::size_t index, Task &task) -> bool;
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    // idle workers wait for tasks to be queued, the count of queued tasks is
+    // protected by the lock
+    std::mutex _lock;
+    std::condition_variable _work_signal;
+    std::size_t _queued = 0;
+    bool _stop = false;
+};
+
+} // namespace hdbpp_internal
+#endif // _THREAD_POOL_HPP
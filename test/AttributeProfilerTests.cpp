@@ -0,0 +1,176 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "AttributeProfiler.hpp"
+#include "catch2/catch.hpp"
+
+#include <string>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+namespace attribute_profiler_test
+{
+//=============================================================================
+//=============================================================================
+auto attributeName(int id) -> string
+{
+    return "tango://localhost:10000/test/profiler/device/attr" + to_string(id);
+}
+} // namespace attribute_profiler_test
+
+SCENARIO("A disabled AttributeProfiler records nothing", "[attribute-profiler]")
+{
+    GIVEN("A default AttributeProfiler")
+    {
+        AttributeProfiler profiler;
+
+        WHEN("Events are recorded")
+        {
+            profiler.record(1, attribute_profiler_test::attributeName(1), 8, false);
+
+            THEN("It is disabled and reports no attributes")
+            {
+                REQUIRE(!profiler.enabled());
+                REQUIRE(profiler.top().empty());
+            }
+        }
+    }
+}
+
+SCENARIO("AttributeProfiler counts events exactly while it has free counters", "[attribute-profiler]")
+{
+    GIVEN("An AttributeProfiler with more counters than attributes")
+    {
+        AttributeProfiler profiler;
+        profiler.configure(10, 3);
+
+        REQUIRE(profiler.enabled());
+
+        WHEN("Events are recorded for five attributes, attribute n storing n events")
+        {
+            for (auto id = 1; id <= 5; id++)
+                for (auto event = 0; event < id; event++)
+                    profiler.record(id, attribute_profiler_test::attributeName(id), 8, event == 0);
+
+            THEN("The top three are reported busiest first, with exact counts")
+            {
+                auto top = profiler.top();
+
+                REQUIRE(top.size() == 3);
+
+                for (auto i = 0; i < 3; i++)
+                {
+                    auto id = 5 - i;
+                    REQUIRE(top[i].att_conf_id == id);
+                    REQUIRE(top[i].name == attribute_profiler_test::attributeName(id));
+                    REQUIRE(top[i].events == static_cast<uint64_t>(id));
+                    REQUIRE(top[i].max_overcount == 0);
+                    REQUIRE(top[i].bytes == static_cast<uint64_t>(id * 8));
+                    REQUIRE(top[i].errors == 1);
+                }
+            }
+            AND_WHEN("The profiler is reset")
+            {
+                profiler.reset();
+
+                THEN("No attributes are reported")
+                {
+                    REQUIRE(profiler.top().empty());
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("AttributeProfiler finds the heavy hitters among many attributes", "[attribute-profiler]")
+{
+    GIVEN("An AttributeProfiler with 16 counters")
+    {
+        AttributeProfiler profiler;
+        profiler.configure(16, 2);
+
+        WHEN("Two busy attributes are interleaved with many quiet ones")
+        {
+            // 1000 quiet attributes storing one event each, against two busy attributes
+            // storing 200 and 100, well above the 1/16 guarantee of the 1300 total events
+            auto quiet_id = 100;
+
+            for (auto round = 0; round < 100; round++)
+            {
+                profiler.record(1, attribute_profiler_test::attributeName(1), 8, false);
+                profiler.record(1, attribute_profiler_test::attributeName(1), 8, false);
+                profiler.record(2, attribute_profiler_test::attributeName(2), 8, false);
+
+                for (auto quiet = 0; quiet < 10; quiet++, quiet_id++)
+                    profiler.record(quiet_id, attribute_profiler_test::attributeName(quiet_id), 8, false);
+            }
+
+            THEN("They are reported as the busiest, within the error bound")
+            {
+                auto top = profiler.top();
+
+                REQUIRE(top.size() == 2);
+                REQUIRE(top[0].att_conf_id == 1);
+                REQUIRE(top[1].att_conf_id == 2);
+
+                // Space-Saving never under counts, and over counts by at most max_overcount
+                REQUIRE(top[0].events >= 200);
+                REQUIRE(top[0].events - top[0].max_overcount <= 200);
+                REQUIRE(top[1].events >= 100);
+                REQUIRE(top[1].events - top[1].max_overcount <= 100);
+            }
+        }
+    }
+}
+
+SCENARIO("AttributeProfiler reuses the lowest counter for a new attribute", "[attribute-profiler]")
+{
+    GIVEN("A full AttributeProfiler with 2 counters")
+    {
+        AttributeProfiler profiler;
+        profiler.configure(2, 2);
+
+        for (auto i = 0; i < 5; i++)
+            profiler.record(1, attribute_profiler_test::attributeName(1), 8, false);
+
+        for (auto i = 0; i < 3; i++)
+            profiler.record(2, attribute_profiler_test::attributeName(2), 8, false);
+
+        WHEN("A new attribute is recorded")
+        {
+            profiler.record(3, attribute_profiler_test::attributeName(3), 16, true);
+
+            THEN("It takes over the lowest counter, inheriting its count as the over count")
+            {
+                auto top = profiler.top();
+
+                REQUIRE(top.size() == 2);
+                REQUIRE(top[0].att_conf_id == 1);
+                REQUIRE(top[0].events == 5);
+                REQUIRE(top[1].att_conf_id == 3);
+                REQUIRE(top[1].name == attribute_profiler_test::attributeName(3));
+                REQUIRE(top[1].events == 4);
+                REQUIRE(top[1].max_overcount == 3);
+                REQUIRE(top[1].bytes == 16);
+                REQUIRE(top[1].errors == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "BatchController.hpp"
+#include "catch2/catch.hpp"
+
+#include <chrono>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+SCENARIO("A BatchController is disabled until given a latency target", "[batch-controller]")
+{
+    GIVEN("A default BatchController")
+    {
+        BatchController controller;
+
+        THEN("It is disabled and ignores any batch")
+        {
+            REQUIRE(!controller.enabled());
+            REQUIRE(!controller.record(100, chrono::seconds(10), true));
+            REQUIRE(controller.decreases() == 0);
+        }
+    }
+}
+
+SCENARIO("A BatchController adapts the batch size and flush interval AIMD style", "[batch-controller]")
+{
+    GIVEN("A BatchController targeting 100ms, with batches of 100 to 10100 events and a 1s flush interval")
+    {
+        BatchController controller;
+        controller.configure(chrono::milliseconds(100), 100, 10100, chrono::seconds(1));
+
+        THEN("It starts at the maximum")
+        {
+            REQUIRE(controller.enabled());
+            REQUIRE(controller.batchSize() == 10100);
+            REQUIRE(controller.flushInterval() == chrono::seconds(1));
+        }
+        WHEN("A batch takes longer than the target")
+        {
+            REQUIRE(controller.record(10100, chrono::milliseconds(150), false));
+
+            THEN("The batch size and flush interval are halved")
+            {
+                REQUIRE(controller.batchSize() == 5050);
+                REQUIRE(controller.flushInterval() == chrono::milliseconds(500));
+                REQUIRE(controller.decreases() == 1);
+            }
+            AND_WHEN("Another batch cut before the decrease is also slow")
+            {
+                THEN("It is not decreased again")
+                {
+                    REQUIRE(!controller.record(10100, chrono::milliseconds(150), false));
+                    REQUIRE(controller.batchSize() == 5050);
+                    REQUIRE(controller.decreases() == 1);
+                }
+            }
+            AND_WHEN("A batch under the target is stored")
+            {
+                REQUIRE(controller.record(5050, chrono::milliseconds(50), false));
+
+                THEN("The batch size and flush interval grow by a step")
+                {
+                    REQUIRE(controller.batchSize() == 5150);
+                    REQUIRE(controller.flushInterval() == chrono::milliseconds(510));
+                    REQUIRE(controller.increases() == 1);
+                }
+            }
+        }
+        WHEN("A batch fails")
+        {
+            REQUIRE(controller.record(10100, chrono::milliseconds(1), true));
+
+            THEN("It is treated as slow")
+            {
+                REQUIRE(controller.batchSize() == 5050);
+                REQUIRE(controller.decreases() == 1);
+            }
+        }
+        WHEN("Every batch is slow")
+        {
+            for (auto i = 0; i < 20; i++)
+                controller.record(controller.batchSize(), chrono::seconds(1), false);
+
+            THEN("The decisions stop at the minimum")
+            {
+                REQUIRE(controller.batchSize() == 100);
+                REQUIRE(controller.flushInterval() == chrono::milliseconds(10));
+                REQUIRE(!controller.record(100, chrono::seconds(1), false));
+            }
+            AND_WHEN("The database recovers")
+            {
+                for (auto i = 0; i < 200; i++)
+                    controller.record(controller.batchSize(), chrono::milliseconds(10), false);
+
+                THEN("The decisions return to the maximum")
+                {
+                    REQUIRE(controller.batchSize() == 10100);
+                    REQUIRE(controller.flushInterval() == chrono::seconds(1));
+                    REQUIRE(!controller.record(10100, chrono::milliseconds(10), false));
+                }
+            }
+        }
+    }
+}
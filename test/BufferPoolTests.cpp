@@ -0,0 +1,136 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "BufferPool.hpp"
+#include "catch2/catch.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+SCENARIO("BufferPool hands out buffers with the requested capacity", "[buffer-pool]")
+{
+    GIVEN("An empty BufferPool")
+    {
+        BufferPool<double> pool;
+        REQUIRE(pool.size() == 0);
+
+        WHEN("Acquiring a buffer")
+        {
+            auto buffer = pool.acquire(1024);
+
+            THEN("The buffer is empty and has the capacity reserved")
+            {
+                REQUIRE(buffer.get().empty());
+                REQUIRE(buffer.get().capacity() >= 1024);
+            }
+        }
+    }
+}
+
+SCENARIO("BufferPool recycles buffers when they are released", "[buffer-pool]")
+{
+    GIVEN("A BufferPool and a buffer that has been filled with data")
+    {
+        BufferPool<string> pool;
+        const string *data = nullptr;
+
+        {
+            auto buffer = pool.acquire(16);
+            buffer.get().assign(10, "value");
+            data = buffer.get().data();
+        }
+
+        THEN("The buffer is returned to the pool when the handle goes out of scope")
+        {
+            REQUIRE(pool.size() == 1);
+        }
+        WHEN("Acquiring a buffer again")
+        {
+            auto buffer = pool.acquire(16);
+
+            THEN("The same storage is reused, and it is empty")
+            {
+                REQUIRE(pool.size() == 0);
+                REQUIRE(buffer.get().empty());
+                REQUIRE(buffer.get().data() == data);
+            }
+        }
+    }
+    GIVEN("A BufferPool and more buffers than it will hold")
+    {
+        BufferPool<int32_t> pool;
+
+        {
+            vector<BufferPool<int32_t>::Buffer> buffers;
+
+            for (size_t i = 0; i < BufferPool<int32_t>::MaxFreeBuffers * 2; i++)
+                buffers.push_back(pool.acquire(8));
+        }
+
+        THEN("Only a limited number of free buffers are kept")
+        {
+            REQUIRE(pool.size() == BufferPool<int32_t>::MaxFreeBuffers);
+        }
+    }
+    GIVEN("A BufferPool and a buffer larger than it will keep")
+    {
+        BufferPool<double> pool;
+
+        {
+            auto buffer = pool.acquire(BufferPool<double>::MaxBufferBytes / sizeof(double) + 1);
+        }
+
+        THEN("The buffer is freed rather than returned to the pool")
+        {
+            REQUIRE(pool.size() == 0);
+        }
+    }
+    GIVEN("An empty buffer handle")
+    {
+        BufferPool<int16_t> pool;
+
+        {
+            BufferPool<int16_t>::Buffer buffer;
+            REQUIRE(buffer.get().empty());
+
+            buffer = pool.acquire(8);
+            buffer.get().push_back(1);
+        }
+
+        THEN("A buffer assigned to it is returned to the pool")
+        {
+            REQUIRE(pool.size() == 1);
+        }
+    }
+}
+
+SCENARIO("Each thread has its own BufferPool", "[buffer-pool]")
+{
+    GIVEN("The pool for this thread")
+    {
+        auto &pool = BufferPool<float>::threadPool();
+
+        THEN("The same pool is returned each time it is requested on this thread")
+        {
+            REQUIRE(&pool == &BufferPool<float>::threadPool());
+        }
+    }
+}
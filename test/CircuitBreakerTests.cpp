@@ -0,0 +1,133 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "CircuitBreaker.hpp"
+#include "catch2/catch.hpp"
+
+#include <chrono>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+SCENARIO("A CircuitBreaker opens after its failure threshold, and fails fast while open", "[circuit-breaker]")
+{
+    GIVEN("A CircuitBreaker opening after 3 failures, with a backoff of 100ms to 400ms")
+    {
+        CircuitBreaker breaker;
+        breaker.configure(3, chrono::milliseconds(100), chrono::milliseconds(400));
+
+        auto now = CircuitBreaker::Clock::now();
+
+        THEN("It starts closed")
+        {
+            REQUIRE(breaker.state() == CircuitBreaker::State::Closed);
+            REQUIRE(breaker.allow(now));
+            REQUIRE(breaker.retryIn(now) == chrono::milliseconds(0));
+        }
+        WHEN("It fails less than the threshold")
+        {
+            breaker.failure(now);
+            breaker.failure(now);
+
+            THEN("It stays closed")
+            {
+                REQUIRE(breaker.state() == CircuitBreaker::State::Closed);
+                REQUIRE(breaker.failures() == 2);
+                REQUIRE(breaker.allow(now));
+            }
+            AND_WHEN("It then succeeds")
+            {
+                breaker.success();
+                breaker.failure(now);
+
+                THEN("The failures are counted afresh")
+                {
+                    REQUIRE(breaker.failures() == 1);
+                    REQUIRE(breaker.state() == CircuitBreaker::State::Closed);
+                }
+            }
+        }
+        WHEN("It fails up to the threshold")
+        {
+            for (auto i = 0; i < 3; i++)
+                breaker.failure(now);
+
+            THEN("It opens, and refuses attempts for between half and all of the backoff")
+            {
+                REQUIRE(breaker.isOpen());
+                REQUIRE(breaker.opens() == 1);
+                REQUIRE(!breaker.allow(now));
+                REQUIRE(!breaker.allow(now + chrono::milliseconds(49)));
+                REQUIRE(breaker.retryIn(now) >= chrono::milliseconds(49));
+                REQUIRE(breaker.retryIn(now) <= chrono::milliseconds(100));
+            }
+            AND_WHEN("The backoff has passed")
+            {
+                now += chrono::milliseconds(100);
+
+                THEN("A single attempt is allowed, half open")
+                {
+                    REQUIRE(breaker.allow(now));
+                    REQUIRE(breaker.state() == CircuitBreaker::State::HalfOpen);
+                }
+                AND_WHEN("The attempt fails")
+                {
+                    REQUIRE(breaker.allow(now));
+                    breaker.failure(now);
+
+                    THEN("It opens again at once, with the backoff doubled")
+                    {
+                        REQUIRE(breaker.isOpen());
+                        REQUIRE(breaker.opens() == 2);
+                        REQUIRE(!breaker.allow(now + chrono::milliseconds(99)));
+                        REQUIRE(breaker.allow(now + chrono::milliseconds(200)));
+                    }
+                }
+                AND_WHEN("The attempt succeeds")
+                {
+                    REQUIRE(breaker.allow(now));
+                    breaker.success();
+
+                    THEN("It closes")
+                    {
+                        REQUIRE(breaker.state() == CircuitBreaker::State::Closed);
+                        REQUIRE(breaker.failures() == 0);
+                        REQUIRE(breaker.allow(now));
+                    }
+                }
+            }
+        }
+        WHEN("Every attempt fails")
+        {
+            for (auto i = 0; i < 10; i++)
+            {
+                now += chrono::seconds(1);
+                breaker.allow(now);
+                breaker.failure(now);
+            }
+
+            THEN("The backoff stops at the maximum")
+            {
+                REQUIRE(breaker.isOpen());
+                REQUIRE(breaker.retryIn(now) >= chrono::milliseconds(199));
+                REQUIRE(breaker.retryIn(now) <= chrono::milliseconds(400));
+            }
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "DataSpan.hpp"
+#include "PqxxExtension.hpp"
+#include "QueryBuilder.hpp"
+#include "catch2/catch.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace hdbpp_internal;
+using namespace hdbpp_internal::pqxx_conn;
+
+SCENARIO("A DataSpan views the data it is given without copying it", "[data-span]")
+{
+    GIVEN("A vector of doubles")
+    {
+        vector<double> data {1.1, 2.2, 3.3, 4.4};
+
+        WHEN("Viewing the entire vector")
+        {
+            DataSpan<double> span(data);
+
+            THEN("The span refers to the vector data")
+            {
+                REQUIRE(span.size() == data.size());
+                REQUIRE(span.data() == data.data());
+                REQUIRE(span[2] == data[2]);
+                REQUIRE(vector<double>(span.begin(), span.end()) == data);
+            }
+        }
+        WHEN("Viewing part of the vector")
+        {
+            DataSpan<double> span(data.data() + 1, 2);
+
+            THEN("The span only covers the given part")
+            {
+                REQUIRE(span.size() == 2);
+                REQUIRE(span[0] == data[1]);
+                REQUIRE(span[1] == data[2]);
+            }
+        }
+    }
+    GIVEN("A default constructed DataSpan")
+    {
+        DataSpan<int32_t> span;
+
+        THEN("The span is empty")
+        {
+            REQUIRE(span.empty());
+            REQUIRE(span.size() == 0);
+            REQUIRE(span.begin() == span.end());
+        }
+    }
+}
+
+SCENARIO("A DataSpan of bool can view both arrays and vector<bool>", "[data-span]")
+{
+    GIVEN("A vector<bool> and an equivalent array of bool")
+    {
+        vector<bool> bits {true, false, true};
+        bool array[] = {true, false, true};
+
+        WHEN("Viewing both with a DataSpan")
+        {
+            DataSpan<bool> bits_span(bits);
+            DataSpan<bool> array_span(array, 3);
+
+            THEN("Both spans return the same elements")
+            {
+                REQUIRE(bits_span.size() == array_span.size());
+
+                for (size_t i = 0; i < bits_span.size(); i++)
+                    REQUIRE(bits_span[i] == array_span[i]);
+            }
+            AND_THEN("Both spans convert to the same postgres array string")
+            {
+                REQUIRE(pqxx::to_string(bits_span) == pqxx::to_string(bits));
+                REQUIRE(pqxx::to_string(array_span) == pqxx::to_string(bits));
+            }
+        }
+    }
+}
+
+SCENARIO("Query strings built from a DataSpan match those built from owned data", "[data-span][query-string]")
+{
+    GIVEN("Some spectrum data in a vector and a span over it")
+    {
+        auto value_r = make_unique<vector<double>>(vector<double> {1.1, 2.2, 3.3});
+        auto value_w = make_unique<vector<double>>();
+        DataSpan<double> span_r(*value_r);
+        DataSpan<double> span_w;
+
+        AttributeTraits traits {Tango::READ, Tango::SPECTRUM, Tango::DEV_DOUBLE};
+
+        WHEN("Building a query string from both")
+        {
+            auto owned = QueryBuilder::storeDataEventString<double>("1", "0", "0", value_r, value_w, traits);
+            auto viewed = QueryBuilder::storeDataEventString<double>("1", "0", "0", span_r, span_w, traits);
+
+            THEN("The query strings are identical") { REQUIRE(owned == viewed); }
+        }
+    }
+}
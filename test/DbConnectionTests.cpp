@@ -17,6 +17,7 @@
    You should have received a copy of the Lesser GNU General Public License
    along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include "DataEventSerialiser.hpp"
 #include "DbConnection.hpp"
 #include "HdbppDefines.hpp"
 #include "LibUtils.hpp"
@@ -25,6 +26,7 @@
 #include "TimescaleSchema.hpp"
 #include "catch2/catch.hpp"
 
+#include <algorithm>
 #include <cfloat>
 #include <locale>
 #include <pqxx/pqxx>
@@ -1083,6 +1085,494 @@ TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
     SUCCEED("Passed");
 }
 
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Storing event data for an unknown attribute with an event status set reports the status",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto status = hdbpp::HdbEventStatus::Ok;
+
+    testConn().eventStatus(&status);
+
+    REQUIRE_NOTHROW(testConn().storeDataEvent(attr_name::TestAttrFinalName,
+        1.0,
+        Tango::ATTR_VALID,
+        move(make_unique<std::vector<double>>(1, 1.0)),
+        move(make_unique<std::vector<double>>(1, 1.0)),
+        traits));
+
+    REQUIRE_NOTHROW(
+        testConn().storeDataEventError(attr_name::TestAttrFinalName, 1.0, Tango::ATTR_VALID, "error", traits));
+
+    testConn().eventStatus(nullptr);
+
+    REQUIRE(status == hdbpp::HdbEventStatus::UnknownAttribute);
+    REQUIRE(testConn().bufferSize() == 0);
+    REQUIRE(testConn().stats().events_failed["DEV_DOUBLE"] == 2);
+
+    // without a status, the unknown attribute is an error again
+    REQUIRE_THROWS_AS(testConn().storeDataEvent(attr_name::TestAttrFinalName,
+                          1.0,
+                          Tango::ATTR_VALID,
+                          move(make_unique<std::vector<double>>(1, 1.0)),
+                          move(make_unique<std::vector<double>>(1, 1.0)),
+                          traits),
+        Tango::DevFailed);
+
+    testConn().buffer(false);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Flushing a buffer with one statement causing an error reports the failed statement",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    store2EventDataSameTime<Tango::DEV_DOUBLE>(name, traits);
+    REQUIRE(testConn().bufferSize() == 2);
+
+    vector<size_t> failed;
+    REQUIRE_NOTHROW(testConn().flush(&failed));
+
+    // the second event has the same time as the first, so is rejected
+    REQUIRE(failed.size() == 1);
+    REQUIRE(failed[0] == 1);
+    REQUIRE(testConn().bufferSize() == 0);
+
+    testConn().buffer(false);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Flushing a buffer over the event loop stores the events, and reports failed statements",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().eventLoop(make_unique<PqEventLoop>(postgres_db::HdbppConnectionString, 2), chrono::seconds(30));
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    for (int i = 0; i < 10; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    REQUIRE_NOTHROW(testConn().flush());
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 10);
+
+    // the second event has the same time as the first, so the batch fails on the event
+    // loop, and is retried query by query
+    store2EventDataSameTime<Tango::DEV_DOUBLE>(name, traits);
+
+    vector<size_t> failed;
+    REQUIRE_NOTHROW(testConn().flush(&failed));
+    REQUIRE(failed.size() == 1);
+    REQUIRE(failed[0] == 1);
+
+    testConn().buffer(false);
+    testConn().eventLoop(nullptr, chrono::milliseconds(0));
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "A flush over the event loop that times out is not run again",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().eventLoop(make_unique<PqEventLoop>(postgres_db::HdbppConnectionString, 1), chrono::milliseconds(200));
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    for (int i = 0; i < 5; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    {
+        // hold a lock on the table, so the batch can not complete before the timeout. Were
+        // the batch run again query by query, the flush would block on the lock too
+        pqxx::work tx {verifyConn()};
+        tx.exec0("LOCK TABLE " + QueryBuilder::tableName(traits) + " IN ACCESS EXCLUSIVE MODE");
+
+        vector<size_t> failed;
+        REQUIRE_THROWS_AS(testConn().flush(&failed), Tango::DevFailed);
+        REQUIRE(failed.empty());
+        tx.commit();
+    }
+
+    REQUIRE(testConn().bufferSize() == 0);
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 0);
+    REQUIRE(testConn().stats().events_failed["DEV_DOUBLE"] == 5);
+
+    testConn().buffer(false);
+    testConn().eventLoop(nullptr, chrono::milliseconds(0));
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "A flush that times out before the event loop sends it is retried",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    // keep the only event loop connection busy, so the batch times out in the queue
+    auto event_loop = make_unique<PqEventLoop>(postgres_db::HdbppConnectionString, 1);
+    event_loop->submit("SELECT pg_sleep(1);", chrono::milliseconds(0), [](const PqEventLoop::Result &) {});
+
+    testConn().eventLoop(move(event_loop), chrono::milliseconds(200));
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    for (int i = 0; i < 5; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    vector<size_t> failed;
+    REQUIRE_NOTHROW(testConn().flush(&failed));
+    REQUIRE(failed.empty());
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 5);
+
+    testConn().buffer(false);
+    testConn().eventLoop(nullptr, chrono::milliseconds(0));
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Losing an event loop connection does not reconnect the pqxx connection",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    // name the event loop connections, so they alone can be ended
+    testConn().eventLoop(
+        make_unique<PqEventLoop>(postgres_db::HdbppConnectionString + " application_name=hdbpp_event_loop_test", 1),
+        chrono::seconds(30));
+
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+    auto reconnects = testConn().stats().reconnects;
+
+    for (int i = 0; i < 5; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    {
+        pqxx::work tx {verifyConn()};
+
+        REQUIRE_NOTHROW(tx.exec("SELECT pg_terminate_backend(pid) FROM pg_stat_activity WHERE application_name = "
+                                "'hdbpp_event_loop_test'"));
+
+        tx.commit();
+    }
+
+    // the batch either runs once the event loop has reset its connection, or, when sent
+    // before the loss was noticed, fails as its outcome is unknown
+    try
+    {
+        testConn().flush();
+    }
+    catch (const Tango::DevFailed &)
+    {
+    }
+
+    testConn().buffer(false);
+    testConn().eventLoop(nullptr, chrono::milliseconds(0));
+
+    auto stats = testConn().stats();
+    REQUIRE(!stats.connection_lost);
+    REQUIRE(stats.circuit_opens == 0);
+    REQUIRE(stats.reconnects == reconnects);
+
+    // the pqxx connection was never lost
+    REQUIRE_NOTHROW(testConn().storeHistoryEvent(name, events::PauseEvent));
+    REQUIRE(testConn().stats().reconnects == reconnects);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Pipelined batches are sent before the flush, and failed statements are reported across batches",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().eventLoop(make_unique<PqEventLoop>(postgres_db::HdbppConnectionString, 2), chrono::seconds(30));
+    testConn().pipeline(2, 2);
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    for (int i = 0; i < 4; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    // the third batch fails on its second event, which has the same time as the first
+    store2EventDataSameTime<Tango::DEV_DOUBLE>(name, traits);
+
+    // every batch has been sent, but is still counted until the flush
+    REQUIRE(testConn().bufferSize() == 6);
+
+    vector<size_t> failed;
+    REQUIRE_NOTHROW(testConn().flush(&failed));
+    REQUIRE(failed.size() == 1);
+    REQUIRE(failed[0] == 5);
+    REQUIRE(testConn().bufferSize() == 0);
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 5);
+
+    // an odd event is left in the buffer, and stored by the flush with the batch before
+    for (int i = 0; i < 3; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    REQUIRE_NOTHROW(testConn().flush());
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 8);
+
+    testConn().buffer(false);
+    testConn().pipeline(0, 2);
+    testConn().eventLoop(nullptr, chrono::milliseconds(0));
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Discarding the buffer waits for the pipelined batches and drops the rest",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().eventLoop(make_unique<PqEventLoop>(postgres_db::HdbppConnectionString, 2), chrono::seconds(30));
+    testConn().pipeline(2, 2);
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    // two batches are sent, and the last event is left in the buffer
+    for (int i = 0; i < 5; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    REQUIRE(testConn().bufferSize() == 5);
+    REQUIRE(testConn().discardBuffer() == 4);
+    REQUIRE(testConn().bufferSize() == 0);
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 4);
+    REQUIRE(testConn().stats().events_failed["DEV_DOUBLE"] == 1);
+
+    // nothing is left for the next flush to store
+    REQUIRE_NOTHROW(testConn().flush());
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 4);
+
+    {
+        pqxx::work tx {verifyConn()};
+        auto result = tx.exec1("SELECT COUNT(*) FROM " + QueryBuilder::tableName(traits));
+        REQUIRE(result[0].as<int>() == 4);
+        tx.commit();
+    }
+
+    testConn().pipeline(0, 2);
+    testConn().eventLoop(nullptr, chrono::milliseconds(0));
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "The batch controller cuts the buffer into batches of its chosen size",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().batchController(chrono::seconds(10), 2, 2, chrono::seconds(10));
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    for (int i = 0; i < 5; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    // without an event loop, the batches are cut but only stored by the flush
+    REQUIRE(testConn().bufferSize() == 5);
+    REQUIRE(testConn().stats().batches == 0);
+
+    REQUIRE_NOTHROW(testConn().flush());
+
+    auto stats = testConn().stats();
+    REQUIRE(stats.batches == 3);
+    REQUIRE(stats.events_stored["DEV_DOUBLE"] == 5);
+    REQUIRE(stats.adaptive_batch_size == 2);
+    REQUIRE(stats.adaptive_decreases == 0);
+
+    testConn().buffer(false);
+    testConn().batchController(chrono::microseconds(0), 0, 0, chrono::milliseconds(0));
+    REQUIRE(testConn().stats().adaptive_batch_size == 0);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Connecting with a statement warm up prepares the data event statements",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::PreparedStatement);
+
+    AttributeTraits scalar_traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    AttributeTraits string_array_traits {Tango::READ, Tango::SPECTRUM, Tango::DEV_STRING};
+    auto name = storeAttributeByTraits(scalar_traits);
+    storeAttributeByTraits(string_array_traits);
+
+    // the data and error statements of the archived traits, an array of strings is never
+    // stored via a data statement
+    testConn().statementWarmup(DbConnection::StatementWarmup::Archived);
+    REQUIRE_NOTHROW(resetConn());
+    REQUIRE(testConn().preparedStatements() == 3);
+
+    // the warmed statement is used, rather than prepared again
+    storeTestEventData<Tango::DEV_DOUBLE>(name, scalar_traits);
+    REQUIRE(testConn().preparedStatements() == 3);
+
+    // 13 types, the scalar and spectrum formats (image attributes can not be added) and
+    // 4 write types, less the 4 string array data statements
+    testConn().statementWarmup(DbConnection::StatementWarmup::All);
+    REQUIRE_NOTHROW(resetConn());
+    REQUIRE(testConn().preparedStatements() == 204);
+
+    testConn().statementWarmup(DbConnection::StatementWarmup::None);
+    REQUIRE_NOTHROW(resetConn());
+    REQUIRE(testConn().preparedStatements() == 0);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Buffered event data is counted in the connection stats",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    for (int i = 0; i < 10; i++)
+        storeTestEventData<Tango::DEV_DOUBLE>(name, traits);
+
+    auto buffered = testConn().stats();
+    REQUIRE(buffered.buffer_depth == 10);
+    REQUIRE(buffered.batches == 0);
+
+    REQUIRE_NOTHROW(testConn().flush());
+
+    auto flushed = testConn().stats();
+    REQUIRE(flushed.buffer_depth == 0);
+    REQUIRE(flushed.batches == 1);
+    REQUIRE(flushed.batch_events == 10);
+    REQUIRE(flushed.batch_size_max == 10);
+    REQUIRE(flushed.events_stored["DEV_DOUBLE"] == 10);
+    REQUIRE(flushed.events_failed["DEV_DOUBLE"] == 0);
+
+    // the attribute id was loaded once, then served from the cache
+    auto conf_id_cache = find_if(flushed.caches.begin(), flushed.caches.end(), [](const hdbpp::HdbCacheStats &cache) {
+        return cache.name == "conf_id";
+    });
+
+    REQUIRE(conf_id_cache != flushed.caches.end());
+    REQUIRE(conf_id_cache->hits > 0);
+
+    testConn().buffer(false);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Storing event data serialised away from the connection via the buffer",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SPECTRUM, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    vector<double> value_r {1.0, 2.0, 3.0};
+    vector<double> value_w {4.0, 5.0, 6.0};
+
+    DataEventSerialiser serialiser(testConn());
+
+    // an attribute that has not been cached is left for the connection to store
+    DataEventSerialiser::Result unknown;
+    serialiser.target(&unknown);
+
+    REQUIRE_NOTHROW(serialiser.storeDataEvent<double>(
+        name + "-unknown", 1.0, Tango::ATTR_VALID, DataSpan<double>(value_r), DataSpan<double>(value_w), traits));
+
+    REQUIRE(!unknown.resolved);
+
+    DataEventSerialiser::Result result;
+    serialiser.target(&result);
+
+    REQUIRE_NOTHROW(serialiser.storeDataEvent<double>(
+        name, 1.0, Tango::ATTR_VALID, DataSpan<double>(value_r), DataSpan<double>(value_w), traits));
+
+    REQUIRE(result.resolved);
+    REQUIRE(result.full_attr_name == name);
+    REQUIRE(result.type == Tango::DEV_DOUBLE);
+    REQUIRE(result.bytes == 6 * sizeof(double));
+
+    testConn().buffer(true);
+    testConn().bufferDataEvent(move(result.query), result.conf_id, result.full_attr_name, result.bytes, result.type);
+
+    REQUIRE(testConn().bufferSize() == 1);
+    REQUIRE_NOTHROW(testConn().flush());
+    REQUIRE(testConn().stats().events_stored["DEV_DOUBLE"] == 1);
+
+    checkStoreTestEventData(name, traits, make_tuple(value_r, value_w));
+
+    testConn().buffer(false);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Failed buffered event data is counted in the connection stats",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    REQUIRE_NOTHROW(clearTables());
+    resetDbAccess(DbConnection::DbStoreMethod::InsertString);
+
+    testConn().buffer(true);
+
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+    auto name = storeAttributeByTraits(traits);
+
+    store2EventDataSameTime<Tango::DEV_DOUBLE>(name, traits);
+    REQUIRE_THROWS_AS(testConn().flush(), Tango::DevFailed);
+
+    auto stats = testConn().stats();
+    REQUIRE(stats.events_stored["DEV_DOUBLE"] == 1);
+    REQUIRE(stats.events_failed["DEV_DOUBLE"] == 1);
+    REQUIRE(stats.buffer_depth == 0);
+
+    testConn().buffer(false);
+    SUCCEED("Passed");
+}
+
 TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
     "Storing complex arrays of strings containing postgres escape characters",
     "[db-access][hdbpp-db-access][db-connection]")
@@ -1324,6 +1814,33 @@ TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
     SUCCEED("Passed");
 }
 
+TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
+    "Storing a history event after the server ends the connection reconnects transparently",
+    "[db-access][hdbpp-db-access][db-connection]")
+{
+    AttributeTraits traits {Tango::READ, Tango::SCALAR, Tango::DEV_DOUBLE};
+    REQUIRE_NOTHROW(clearTables());
+    auto name = storeAttributeByTraits(traits);
+
+    {
+        // end every other session on the database, including the one under test
+        pqxx::work tx {verifyConn()};
+
+        REQUIRE_NOTHROW(tx.exec("SELECT pg_terminate_backend(pid) FROM pg_stat_activity WHERE datname = "
+                                "current_database() AND pid <> pg_backend_pid()"));
+
+        tx.commit();
+    }
+
+    REQUIRE_NOTHROW(testConn().storeHistoryEvent(name, events::PauseEvent));
+
+    string event;
+    REQUIRE_NOTHROW(event = testConn().fetchLastHistoryEvent(name));
+    REQUIRE(event == events::PauseEvent);
+    REQUIRE(!testConn().stats().connection_lost);
+    SUCCEED("Passed");
+}
+
 TEST_CASE_METHOD(pqxx_conn_test::DbConnectionTestsFixture,
     "When no history events have been stored, no error is thrown requesting the last event",
     "[db-access][hdbpp-db-access][db-connection]")
@@ -0,0 +1,369 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "EventCapture.hpp"
+#include "TestHelpers.hpp"
+#include "catch2/catch.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace hdbpp_internal;
+using namespace hdbpp_test;
+
+namespace capture_test
+{
+const string CaptureFile = "/tmp/hdbpp-event-capture-test.cap";
+
+//=============================================================================
+//=============================================================================
+auto dataType(const AttributeTraits &traits) -> hdbpp::HdbEventDataType
+{
+    hdbpp::HdbEventDataType data_type;
+    data_type.attr_name = attr_name::TestAttrFQDName;
+    data_type.max_dim_x = traits.isScalar() ? 1 : 10;
+    data_type.max_dim_y = 0;
+    data_type.data_type = traits.type();
+    data_type.data_format = traits.formatType();
+    data_type.write_type = traits.writeType();
+    return data_type;
+}
+
+//=============================================================================
+//=============================================================================
+auto dataEvent(const AttributeTraits &traits) -> unique_ptr<Tango::EventData>
+{
+    auto attr = new Tango::DeviceAttribute(data_gen::createDeviceAttribute(traits));
+    attr->quality = Tango::ATTR_VALID;
+    attr->time.tv_sec = 1000;
+    attr->time.tv_usec = 250;
+
+    string name = attr_name::TestAttrFQDName;
+    string event = "archive";
+    Tango::DevErrorList errors;
+    return make_unique<Tango::EventData>(nullptr, name, event, attr, errors);
+}
+} // namespace capture_test
+
+SCENARIO("An EventCaptureReader rejects files that are not capture files", "[event-capture]")
+{
+    GIVEN("A file that does not hold a capture")
+    {
+        {
+            ofstream file(capture_test::CaptureFile, ios::binary | ios::trunc);
+            file << "not a capture file";
+        }
+
+        WHEN("Opening it with an EventCaptureReader")
+        {
+            THEN("An exception is raised")
+            {
+                REQUIRE_THROWS_AS(EventCaptureReader(capture_test::CaptureFile), Tango::DevFailed);
+            }
+        }
+    }
+
+    remove(capture_test::CaptureFile.c_str());
+}
+
+SCENARIO("Non event calls are captured and read back in order", "[event-capture]")
+{
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SPECTRUM, Tango::DEV_DOUBLE};
+
+    GIVEN("A capture file holding an add attribute, history event and ttl update")
+    {
+        {
+            EventCaptureWriter writer(capture_test::CaptureFile);
+            REQUIRE(writer.isOpen());
+
+            writer.addAttribute(attr_name::TestAttrFQDName, traits.type(), traits.formatType(), traits.writeType());
+            writer.insertHistoryEvent(attr_name::TestAttrFQDName, 3);
+            writer.updateTtl(attr_name::TestAttrFQDName, 48);
+        }
+
+        WHEN("Reading the file back")
+        {
+            EventCaptureReader reader(capture_test::CaptureFile);
+            CaptureRecord add, history, ttl, end;
+
+            REQUIRE(reader.next(add));
+            REQUIRE(reader.next(history));
+            REQUIRE(reader.next(ttl));
+
+            THEN("The records match the calls made, and are in order")
+            {
+                REQUIRE(reader.startTime() > 0.0);
+
+                REQUIRE(add.type == capture::CaptureRecordType::AddAttribute);
+                REQUIRE(add.attr_name == attr_name::TestAttrFQDName);
+                REQUIRE(add.data_type == traits.type());
+                REQUIRE(add.data_format == traits.formatType());
+                REQUIRE(add.write_type == traits.writeType());
+
+                REQUIRE(history.type == capture::CaptureRecordType::HistoryEvent);
+                REQUIRE(history.attr_name == attr_name::TestAttrFQDName);
+                REQUIRE(history.history_event == 3);
+
+                REQUIRE(ttl.type == capture::CaptureRecordType::UpdateTtl);
+                REQUIRE(ttl.ttl == 48);
+
+                REQUIRE(add.offset <= history.offset);
+                REQUIRE(history.offset <= ttl.offset);
+            }
+            AND_THEN("There are no more records")
+            {
+                REQUIRE(!reader.next(end));
+            }
+        }
+    }
+
+    remove(capture_test::CaptureFile.c_str());
+}
+
+SCENARIO("Data events round trip through a capture file", "[event-capture]")
+{
+    GIVEN("A capture file holding a data event for each implemented type")
+    {
+        auto traits_array = utils::getTraitsImplemented();
+        vector<unique_ptr<Tango::EventData>> originals;
+
+        {
+            EventCaptureWriter writer(capture_test::CaptureFile);
+
+            for (auto &traits : traits_array)
+            {
+                originals.push_back(capture_test::dataEvent(traits));
+                writer.insertEvent(originals.back().get(), capture_test::dataType(traits));
+            }
+        }
+
+        WHEN("Reading the events back")
+        {
+            EventCaptureReader reader(capture_test::CaptureFile);
+
+            THEN("Each event and its description match the original")
+            {
+                for (size_t i = 0; i < traits_array.size(); i++)
+                {
+                    CaptureRecord record;
+                    REQUIRE(reader.next(record));
+                    REQUIRE(record.type == capture::CaptureRecordType::InsertEvent);
+                    REQUIRE(record.events.size() == 1);
+
+                    auto data_type = capture_test::dataType(traits_array[i]);
+                    auto &original = *(originals[i]->attr_value);
+                    auto &replayed = *(record.events[0]->attr_value);
+
+                    REQUIRE(record.events[0]->attr_name == originals[i]->attr_name);
+                    REQUIRE(!record.events[0]->err);
+                    REQUIRE(record.event_types[0].attr_name == data_type.attr_name);
+                    REQUIRE(record.event_types[0].max_dim_x == data_type.max_dim_x);
+                    REQUIRE(record.event_types[0].data_type == data_type.data_type);
+                    REQUIRE(record.event_types[0].data_format == data_type.data_format);
+                    REQUIRE(record.event_types[0].write_type == data_type.write_type);
+
+                    REQUIRE(replayed.get_quality() == original.get_quality());
+                    REQUIRE(replayed.time.tv_sec == original.time.tv_sec);
+                    REQUIRE(replayed.time.tv_usec == original.time.tv_usec);
+                    REQUIRE(replayed.dim_x == original.dim_x);
+                    REQUIRE(replayed.dim_y == original.dim_y);
+                    REQUIRE(replayed.w_dim_x == original.w_dim_x);
+                    REQUIRE(replayed.w_dim_y == original.w_dim_y);
+                }
+            }
+        }
+    }
+
+    remove(capture_test::CaptureFile.c_str());
+}
+
+SCENARIO("Event data values are captured exactly", "[event-capture]")
+{
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SPECTRUM, Tango::DEV_DOUBLE};
+
+    GIVEN("A capture file holding a double spectrum event")
+    {
+        auto event_data = capture_test::dataEvent(traits);
+        vector<double> original_r, original_w;
+
+        {
+            Tango::DeviceAttribute copy(*(event_data->attr_value));
+            copy.extract_read(original_r);
+            copy.extract_set(original_w);
+        }
+
+        {
+            EventCaptureWriter writer(capture_test::CaptureFile);
+            writer.insertEvent(event_data.get(), capture_test::dataType(traits));
+        }
+
+        WHEN("Reading the event back with the times shifted")
+        {
+            EventCaptureReader reader(capture_test::CaptureFile);
+            reader.shiftEventTimes(10.5);
+
+            CaptureRecord record;
+            REQUIRE(reader.next(record));
+
+            vector<double> replayed_r, replayed_w;
+            record.events[0]->attr_value->extract_read(replayed_r);
+            record.events[0]->attr_value->extract_set(replayed_w);
+
+            THEN("The read and write values are unchanged, and only the time moved")
+            {
+                REQUIRE(replayed_r == original_r);
+                REQUIRE(replayed_w == original_w);
+                REQUIRE(record.events[0]->attr_value->time.tv_sec == 1010);
+                REQUIRE(record.events[0]->attr_value->time.tv_usec == 500250);
+            }
+        }
+    }
+
+    remove(capture_test::CaptureFile.c_str());
+}
+
+SCENARIO("Error events and parameter events round trip through a capture file", "[event-capture]")
+{
+    AttributeTraits traits {Tango::READ, Tango::SCALAR, Tango::DEV_DOUBLE};
+
+    GIVEN("A capture file holding an error event and a parameter event")
+    {
+        string name = attr_name::TestAttrFQDName;
+        string event = "archive";
+        Tango::DevErrorList errors;
+        errors.length(1);
+        errors[0].desc = CORBA::string_dup("An error message");
+
+        auto error_event =
+            make_unique<Tango::EventData>(nullptr, name, event, new Tango::DeviceAttribute(), errors);
+
+        error_event->err = true;
+
+        auto info = new Tango::AttributeInfoEx();
+        info->label = attr_info::AttrInfoLabel;
+        info->enum_labels = attr_info::AttrInfoEnumLabels;
+        info->unit = attr_info::AttrInfoUnit;
+        info->description = attr_info::AttrInfoDescription;
+        info->events.arch_event.archive_period = attr_info::AttrInfoPeriod;
+
+        string conf_event = "attr_conf";
+        Tango::DevErrorList no_errors;
+        Tango::AttrConfEventData param_event(nullptr, name, conf_event, info, no_errors);
+
+        {
+            EventCaptureWriter writer(capture_test::CaptureFile);
+            writer.insertEvents({make_tuple(error_event.get(), capture_test::dataType(traits))});
+            writer.insertParamEvent(&param_event);
+        }
+
+        WHEN("Reading the events back")
+        {
+            EventCaptureReader reader(capture_test::CaptureFile);
+            CaptureRecord events, param;
+            REQUIRE(reader.next(events));
+            REQUIRE(reader.next(param));
+
+            THEN("The error is preserved")
+            {
+                REQUIRE(events.type == capture::CaptureRecordType::InsertEvents);
+                REQUIRE(events.eventTuples().size() == 1);
+                REQUIRE(events.events[0]->err);
+                REQUIRE(string(events.events[0]->errors[0].desc) == "An error message");
+                REQUIRE(events.events[0]->attr_value != nullptr);
+            }
+            AND_THEN("The attribute configuration is preserved")
+            {
+                REQUIRE(param.type == capture::CaptureRecordType::ParamEvent);
+                REQUIRE(param.param_event->attr_name == name);
+                REQUIRE(param.param_event->attr_conf->label == attr_info::AttrInfoLabel);
+                REQUIRE(param.param_event->attr_conf->enum_labels == attr_info::AttrInfoEnumLabels);
+                REQUIRE(param.param_event->attr_conf->unit == attr_info::AttrInfoUnit);
+                REQUIRE(param.param_event->attr_conf->description == attr_info::AttrInfoDescription);
+                REQUIRE(param.param_event->attr_conf->events.arch_event.archive_period == attr_info::AttrInfoPeriod);
+            }
+        }
+    }
+
+    remove(capture_test::CaptureFile.c_str());
+}
+
+SCENARIO("A copied event outlives the original", "[event-capture]")
+{
+    AttributeTraits traits {Tango::READ_WRITE, Tango::SPECTRUM, Tango::DEV_DOUBLE};
+
+    GIVEN("A double spectrum event")
+    {
+        auto event_data = capture_test::dataEvent(traits);
+        vector<double> original_r, original_w;
+
+        {
+            Tango::DeviceAttribute copy(*(event_data->attr_value));
+            copy.extract_read(original_r);
+            copy.extract_set(original_w);
+        }
+
+        WHEN("Copying the event, then releasing the original")
+        {
+            auto copy = copyEventData(*event_data);
+            event_data.reset();
+
+            vector<double> copied_r, copied_w;
+            copy->attr_value->extract_read(copied_r);
+            copy->attr_value->extract_set(copied_w);
+
+            THEN("The copy holds the same name, time and values")
+            {
+                REQUIRE(copy->attr_name == attr_name::TestAttrFQDName);
+                REQUIRE_FALSE(copy->err);
+                REQUIRE(copy->attr_value->time.tv_sec == 1000);
+                REQUIRE(copy->attr_value->time.tv_usec == 250);
+                REQUIRE(copied_r == original_r);
+                REQUIRE(copied_w == original_w);
+            }
+        }
+    }
+
+    GIVEN("An error event")
+    {
+        string name = attr_name::TestAttrFQDName;
+        string event = "archive";
+        Tango::DevErrorList errors;
+        errors.length(1);
+        errors[0].desc = CORBA::string_dup("An error message");
+
+        auto error_event =
+            make_unique<Tango::EventData>(nullptr, name, event, new Tango::DeviceAttribute(), errors);
+
+        error_event->err = true;
+
+        WHEN("Copying the event")
+        {
+            auto copy = copyEventData(*error_event);
+            error_event.reset();
+
+            THEN("The error is preserved")
+            {
+                REQUIRE(copy->err);
+                REQUIRE(string(copy->errors[0].desc) == "An error message");
+                REQUIRE(copy->attr_value != nullptr);
+            }
+        }
+    }
+}
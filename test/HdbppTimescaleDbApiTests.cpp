@@ -0,0 +1,465 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "QueryBuilder.hpp"
+#include "TestHelpers.hpp"
+#include "TimescaleSchema.hpp"
+#include "catch2/catch.hpp"
+
+#include <hdb++/HdbClient.h>
+#include <memory>
+#include <pqxx/pqxx>
+#include <string>
+#include <sys/time.h>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+using namespace hdbpp;
+using namespace hdbpp_internal;
+using namespace hdbpp_internal::pqxx_conn;
+using namespace hdbpp_test;
+using namespace hdbpp_test::psql_connection;
+
+namespace hdbpp_api_test
+{
+using Event = tuple<Tango::EventData *, HdbEventDataType>;
+
+const AttributeTraits DoubleTraits {Tango::READ, Tango::SCALAR, Tango::DEV_DOUBLE};
+const AttributeTraits LongTraits {Tango::READ, Tango::SCALAR, Tango::DEV_LONG};
+
+class HdbppTimescaleDbApiTestsFixture
+{
+private:
+    unique_ptr<HdbClient> _client;
+    vector<unique_ptr<Tango::EventData>> _events;
+    Tango::TimeVal _event_time {};
+
+    static unique_ptr<pqxx::connection> _verify_conn;
+
+protected:
+    // the client under test, created on first use with any extra configuration
+    HdbClient &client(const vector<string> &extra_config = {});
+    pqxx::connection &verifyConn();
+
+    void clearTables();
+
+    // add an attribute named for the suffix, returning its name
+    string addAttribute(const string &suffix, const AttributeTraits &traits);
+
+    // an event for the attribute at the next event time, holding generated data of the
+    // value traits, which may differ from those of the attribute to fail its conversion
+    Event createEvent(const string &name, const AttributeTraits &traits);
+    Event createEvent(const string &name, const AttributeTraits &traits, const AttributeTraits &value_traits);
+
+    // the next event time, in microseconds since the epoch
+    int64_t nextTime();
+
+    int countRows(const AttributeTraits &traits);
+
+    // the last row stored in the table of the traits
+    pqxx::row lastRow(const AttributeTraits &traits);
+
+public:
+    HdbppTimescaleDbApiTestsFixture();
+};
+
+unique_ptr<pqxx::connection> HdbppTimescaleDbApiTestsFixture::_verify_conn = unique_ptr<pqxx::connection> {};
+
+//=============================================================================
+//=============================================================================
+HdbppTimescaleDbApiTestsFixture::HdbppTimescaleDbApiTestsFixture()
+{
+    struct timeval tv
+    {};
+
+    gettimeofday(&tv, nullptr);
+    _event_time.tv_sec = tv.tv_sec;
+    _event_time.tv_usec = tv.tv_usec;
+    _event_time.tv_nsec = 0;
+}
+
+//=============================================================================
+//=============================================================================
+HdbClient &HdbppTimescaleDbApiTestsFixture::client(const vector<string> &extra_config)
+{
+    if (_client == nullptr)
+    {
+        vector<string> config {"connect_string=" + postgres_db::HdbppConnectionString, "logging_level=error"};
+        config.insert(config.end(), extra_config.begin(), extra_config.end());
+        REQUIRE_NOTHROW(_client = make_unique<HdbClient>("tests", config));
+    }
+
+    return *_client;
+}
+
+//=============================================================================
+//=============================================================================
+pqxx::connection &HdbppTimescaleDbApiTestsFixture::verifyConn()
+{
+    if (_verify_conn == nullptr)
+        _verify_conn = make_unique<pqxx::connection>(postgres_db::HdbppConnectionString);
+
+    return *_verify_conn;
+}
+
+//=============================================================================
+//=============================================================================
+void HdbppTimescaleDbApiTestsFixture::clearTables()
+{
+    string query = "TRUNCATE ";
+
+    for (auto &traits : utils::getTraits())
+        query += QueryBuilder::tableName(traits) + ",";
+
+    query += schema::ErrTableName + ",";
+    query += schema::ParamTableName + ",";
+    query += schema::HistoryEventTableName + ",";
+    query += schema::HistoryTableName + ",";
+    query += schema::ConfTableName + " RESTART IDENTITY";
+
+    pqxx::work tx {verifyConn()};
+    REQUIRE_NOTHROW(tx.exec(query));
+    tx.commit();
+}
+
+//=============================================================================
+//=============================================================================
+string HdbppTimescaleDbApiTestsFixture::addAttribute(const string &suffix, const AttributeTraits &traits)
+{
+    auto name = attr_name::TestAttrFQDName + "_" + suffix;
+
+    REQUIRE_NOTHROW(client().add_attribute(name,
+        static_cast<int>(traits.type()),
+        static_cast<int>(traits.formatType()),
+        static_cast<int>(traits.writeType())));
+
+    return name;
+}
+
+//=============================================================================
+//=============================================================================
+Event HdbppTimescaleDbApiTestsFixture::createEvent(const string &name, const AttributeTraits &traits)
+{
+    return createEvent(name, traits, traits);
+}
+
+//=============================================================================
+//=============================================================================
+Event HdbppTimescaleDbApiTestsFixture::createEvent(
+    const string &name, const AttributeTraits &traits, const AttributeTraits &value_traits)
+{
+    nextTime();
+
+    string attr_name = name;
+    string event = "archive";
+    Tango::DevErrorList no_errors;
+
+    // the event takes ownership of the DeviceAttribute
+    auto value = new Tango::DeviceAttribute(data_gen::createDeviceAttribute(value_traits));
+    value->time = _event_time;
+
+    _events.push_back(make_unique<Tango::EventData>(nullptr, attr_name, event, value, no_errors));
+
+    HdbEventDataType data_type;
+    data_type.attr_name = name;
+    data_type.max_dim_x = traits.isScalar() ? 1 : 10;
+    data_type.max_dim_y = 0;
+    data_type.data_type = static_cast<int>(traits.type());
+    data_type.data_format = traits.formatType();
+    data_type.write_type = static_cast<int>(traits.writeType());
+
+    return make_tuple(_events.back().get(), data_type);
+}
+
+//=============================================================================
+//=============================================================================
+int64_t HdbppTimescaleDbApiTestsFixture::nextTime()
+{
+    if (++_event_time.tv_usec >= 1000000)
+    {
+        _event_time.tv_usec = 0;
+        _event_time.tv_sec++;
+    }
+
+    return static_cast<int64_t>(_event_time.tv_sec) * 1000000 + _event_time.tv_usec;
+}
+
+//=============================================================================
+//=============================================================================
+int HdbppTimescaleDbApiTestsFixture::countRows(const AttributeTraits &traits)
+{
+    pqxx::work tx {verifyConn()};
+    auto row = tx.exec1("SELECT COUNT(*) FROM " + QueryBuilder::tableName(traits));
+    tx.commit();
+    return row.at(0).as<int>();
+}
+
+//=============================================================================
+//=============================================================================
+pqxx::row HdbppTimescaleDbApiTestsFixture::lastRow(const AttributeTraits &traits)
+{
+    pqxx::work tx {verifyConn()};
+
+    auto row = tx.exec1("SELECT * FROM " + QueryBuilder::tableName(traits) + " ORDER BY " + schema::DatColDataTime +
+        " DESC LIMIT 1");
+
+    tx.commit();
+    return row;
+}
+} // namespace hdbpp_api_test
+
+TEST_CASE_METHOD(hdbpp_api_test::HdbppTimescaleDbApiTestsFixture,
+    "Inserting events with statuses reports the status of each event in its position",
+    "[db-access][hdbpp-api]")
+{
+    using namespace hdbpp_api_test;
+
+    clearTables();
+    auto name_a = addAttribute("a", DoubleTraits);
+    auto name_b = addAttribute("b", DoubleTraits);
+
+    auto stored = createEvent(name_a, DoubleTraits);
+
+    // the unknown attribute was never added, the conversion extracts double data from
+    // an attribute holding long data, and the repeated event has the same time as the
+    // first, so the database rejects it
+    vector<Event> events {stored,
+        createEvent(attr_name::TestAttrFQDName + "_unknown", DoubleTraits),
+        createEvent(name_b, DoubleTraits, LongTraits),
+        stored,
+        createEvent(name_b, DoubleTraits)};
+
+    vector<HdbEventStatus> statuses;
+    REQUIRE_NOTHROW(statuses = client().insert_events_status(events));
+
+    REQUIRE(statuses.size() == 5);
+    REQUIRE(statuses[0] == HdbEventStatus::Ok);
+    REQUIRE(statuses[1] == HdbEventStatus::UnknownAttribute);
+    REQUIRE(statuses[2] == HdbEventStatus::ConversionError);
+    REQUIRE(statuses[3] == HdbEventStatus::DbError);
+    REQUIRE(statuses[4] == HdbEventStatus::Ok);
+    REQUIRE(countRows(DoubleTraits) == 2);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(hdbpp_api_test::HdbppTimescaleDbApiTestsFixture,
+    "Inserting events after an aborted batch neither stores nor reports the aborted events",
+    "[db-access][hdbpp-api]")
+{
+    using namespace hdbpp_api_test;
+
+    clearTables();
+    auto name_a = addAttribute("a", DoubleTraits);
+    auto name_b = addAttribute("b", DoubleTraits);
+
+    // the unknown attribute aborts the batch after the first two events are buffered
+    REQUIRE_THROWS_AS(client().insert_events({createEvent(name_a, DoubleTraits),
+                          createEvent(name_b, DoubleTraits),
+                          createEvent(attr_name::TestAttrFQDName + "_unknown", DoubleTraits)}),
+        Tango::DevFailed);
+
+    REQUIRE(countRows(DoubleTraits) == 0);
+
+    auto stored = createEvent(name_a, DoubleTraits);
+
+    vector<HdbEventStatus> statuses;
+    REQUIRE_NOTHROW(statuses = client().insert_events_status({stored, createEvent(name_b, DoubleTraits), stored}));
+
+    REQUIRE(statuses.size() == 3);
+    REQUIRE(statuses[0] == HdbEventStatus::Ok);
+    REQUIRE(statuses[1] == HdbEventStatus::Ok);
+    REQUIRE(statuses[2] == HdbEventStatus::DbError);
+    REQUIRE(countRows(DoubleTraits) == 2);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(hdbpp_api_test::HdbppTimescaleDbApiTestsFixture,
+    "An event failing after a pipelined batch was sent reports the events already stored",
+    "[db-access][hdbpp-api]")
+{
+    using namespace hdbpp_api_test;
+
+    client({"pipeline_batch_size=2", "io_connections=1"});
+
+    clearTables();
+    auto name_a = addAttribute("a", DoubleTraits);
+    auto name_b = addAttribute("b", DoubleTraits);
+
+    // two batches are sent before the unknown attribute fails the call
+    vector<Event> events {createEvent(name_a, DoubleTraits),
+        createEvent(name_b, DoubleTraits),
+        createEvent(name_a, DoubleTraits),
+        createEvent(name_b, DoubleTraits),
+        createEvent(attr_name::TestAttrFQDName + "_unknown", DoubleTraits)};
+
+    auto raised = false;
+
+    try
+    {
+        client().insert_events(events);
+    }
+    catch (Tango::DevFailed &e)
+    {
+        // the original error is kept, and the stored events are reported after it
+        raised = true;
+        REQUIRE(e.errors.length() == 2);
+        REQUIRE(string(e.errors[0].reason) == "Consistency Error");
+        REQUIRE(string(e.errors[1].desc).find("4 of the 5 events were stored") != string::npos);
+    }
+
+    REQUIRE(raised);
+    REQUIRE(countRows(DoubleTraits) == 4);
+
+    // nothing from the failed call is settled or stored by the next
+    vector<HdbEventStatus> statuses;
+    REQUIRE_NOTHROW(statuses = client().insert_events_status({createEvent(name_a, DoubleTraits)}));
+    REQUIRE(statuses.size() == 1);
+    REQUIRE(statuses[0] == HdbEventStatus::Ok);
+    REQUIRE(countRows(DoubleTraits) == 5);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(hdbpp_api_test::HdbppTimescaleDbApiTestsFixture,
+    "Resolving attribute handles for the typed store api",
+    "[db-access][hdbpp-api][typed-api]")
+{
+    using namespace hdbpp_api_test;
+
+    clearTables();
+    auto name_a = addAttribute("a", DoubleTraits);
+    auto name_b = addAttribute("b", LongTraits);
+
+    HdbAttributeHandle handle_a;
+    HdbAttributeHandle handle_b;
+    REQUIRE_NOTHROW(handle_a = client().attribute_handle(name_a));
+    REQUIRE_NOTHROW(handle_b = client().attribute_handle(name_b));
+    REQUIRE(handle_a.id != handle_b.id);
+
+    // the same attribute resolves to the same handle, however it is named
+    REQUIRE(client().attribute_handle(name_a).id == handle_a.id);
+    REQUIRE(client().attribute_handle(attr_name::TestAttrFQDNameNoTangoQual + "_a").id == handle_a.id);
+
+    // an attribute that has not been added can not be resolved
+    REQUIRE_THROWS_AS(client().attribute_handle(attr_name::TestAttrFQDName + "_unknown"), Tango::DevFailed);
+
+    // nor can a handle the client never gave out be stored to
+    HdbAttributeHandle invalid;
+    invalid.id = handle_b.id + 1;
+    REQUIRE_THROWS_AS(client().store_scalar<double>(invalid, nextTime(), Tango::ATTR_VALID, 1.0), Tango::DevFailed);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(hdbpp_api_test::HdbppTimescaleDbApiTestsFixture,
+    "Typed stores that do not match the attribute type or format are rejected",
+    "[db-access][hdbpp-api][typed-api]")
+{
+    using namespace hdbpp_api_test;
+
+    AttributeTraits array_traits {Tango::READ, Tango::SPECTRUM, Tango::DEV_DOUBLE};
+
+    clearTables();
+    auto scalar = client().attribute_handle(addAttribute("scalar", DoubleTraits));
+    auto array = client().attribute_handle(addAttribute("array", array_traits));
+
+    vector<double> values {1.0, 2.0, 3.0};
+
+    REQUIRE_THROWS_AS(client().store_scalar<int32_t>(scalar, nextTime(), Tango::ATTR_VALID, 1), Tango::DevFailed);
+    REQUIRE_THROWS_AS(
+        client().store_array<double>(scalar, nextTime(), Tango::ATTR_VALID, values.data(), values.size()),
+        Tango::DevFailed);
+
+    REQUIRE_THROWS_AS(client().store_scalar<double>(array, nextTime(), Tango::ATTR_VALID, 1.0), Tango::DevFailed);
+    REQUIRE_THROWS_AS(
+        client().store_array<int32_t>(array, nextTime(), Tango::ATTR_VALID, nullptr, 0), Tango::DevFailed);
+
+    REQUIRE(countRows(DoubleTraits) == 0);
+    REQUIRE(countRows(array_traits) == 0);
+
+    REQUIRE_NOTHROW(client().store_scalar<double>(scalar, nextTime(), Tango::ATTR_VALID, 1.0));
+    REQUIRE_NOTHROW(client().store_array<double>(array, nextTime(), Tango::ATTR_VALID, values.data(), values.size()));
+
+    REQUIRE(countRows(DoubleTraits) == 1);
+    REQUIRE(countRows(array_traits) == 1);
+    REQUIRE(lastRow(array_traits).at(schema::DatColValueR).as<vector<double>>() == values);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(hdbpp_api_test::HdbppTimescaleDbApiTestsFixture,
+    "Typed stores only store a write value the attribute has and the caller gave",
+    "[db-access][hdbpp-api][typed-api]")
+{
+    using namespace hdbpp_api_test;
+
+    AttributeTraits read_write_traits {Tango::READ_WRITE, Tango::SCALAR, Tango::DEV_DOUBLE};
+
+    clearTables();
+    auto read_only = client().attribute_handle(addAttribute("read", DoubleTraits));
+    auto read_write = client().attribute_handle(addAttribute("read_write", read_write_traits));
+
+    // the write value is ignored for a read only attribute
+    REQUIRE_NOTHROW(client().store_scalar<double>(read_only, nextTime(), Tango::ATTR_VALID, 1.0, 2.0));
+
+    auto row = lastRow(DoubleTraits);
+    REQUIRE(row.at(schema::DatColValueR).as<double>() == 1.0);
+    REQUIRE(row.at(schema::DatColValueW).is_null());
+
+    // a write value that is not given is stored as NULL, not a zero set point
+    REQUIRE_NOTHROW(client().store_scalar<double>(read_write, nextTime(), Tango::ATTR_VALID, 3.0));
+
+    row = lastRow(read_write_traits);
+    REQUIRE(row.at(schema::DatColValueR).as<double>() == 3.0);
+    REQUIRE(row.at(schema::DatColValueW).is_null());
+
+    REQUIRE_NOTHROW(client().store_scalar<double>(read_write, nextTime(), Tango::ATTR_VALID, 4.0, 5.0));
+
+    row = lastRow(read_write_traits);
+    REQUIRE(row.at(schema::DatColValueR).as<double>() == 4.0);
+    REQUIRE(row.at(schema::DatColValueW).as<double>() == 5.0);
+    SUCCEED("Passed");
+}
+
+TEST_CASE_METHOD(hdbpp_api_test::HdbppTimescaleDbApiTestsFixture,
+    "Typed stores in a batch are stored together by the end of the batch",
+    "[db-access][hdbpp-api][typed-api]")
+{
+    using namespace hdbpp_api_test;
+
+    clearTables();
+    auto handle = client().attribute_handle(addAttribute("a", DoubleTraits));
+
+    REQUIRE_NOTHROW(client().begin_batch());
+
+    for (int i = 0; i < 3; i++)
+        REQUIRE_NOTHROW(client().store_scalar<double>(handle, nextTime(), Tango::ATTR_VALID, i));
+
+    REQUIRE_NOTHROW(client().store_error(handle, nextTime(), Tango::ATTR_INVALID, "error"));
+
+    // a rejected store leaves the batch open, and the stores before it buffered
+    REQUIRE_THROWS_AS(client().store_scalar<int32_t>(handle, nextTime(), Tango::ATTR_VALID, 1), Tango::DevFailed);
+    REQUIRE(countRows(DoubleTraits) == 0);
+
+    REQUIRE_NOTHROW(client().end_batch());
+    REQUIRE(countRows(DoubleTraits) == 4);
+
+    // the batch is closed, so the next store is stored at once
+    REQUIRE_NOTHROW(client().store_scalar<double>(handle, nextTime(), Tango::ATTR_VALID, 3.0));
+    REQUIRE(countRows(DoubleTraits) == 5);
+    SUCCEED("Passed");
+}
@@ -128,12 +128,15 @@ public:
     bool isOpen() const noexcept override { return _conn_state; }
     bool isClosed() const noexcept override { return !isOpen(); }
 
+    // the stages are not timed
+    StageTimers *stageTimers() const noexcept { return nullptr; }
+
     template<typename T>
     void storeDataEvent(const string &full_attr_name,
         double event_time,
         int quality,
-        unique_ptr<vector<T>> value_r,
-        unique_ptr<vector<T>> value_w,
+        const DataSpan<T> &value_r,
+        const DataSpan<T> &value_w,
         const AttributeTraits &traits)
     {
         if (store_attribute_triggers_ex)
@@ -145,8 +148,8 @@ public:
         // TODO make it Tango::AttrQuality for API
         att_quality = (Tango::AttrQuality)quality;
         att_traits = traits;
-        data_size_r = value_r->size();
-        data_size_w = value_w->size();
+        data_size_r = value_r.size();
+        data_size_w = value_w.size();
     }
 
     // expose the results of the store function so they can be checked
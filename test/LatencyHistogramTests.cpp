@@ -0,0 +1,186 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "LatencyHistogram.hpp"
+#include "catch2/catch.hpp"
+
+#include <cstdint>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+SCENARIO("LatencyHistogram bucket boundaries cover every value", "[latency-histogram]")
+{
+    GIVEN("A selection of values across the full range")
+    {
+        vector<uint64_t> values {
+            0, 1, 127, 128, 129, 255, 256, 1000, 65535, 1000000, 123456789, uint64_t(1) << 40, UINT64_MAX};
+
+        // copy, so the static member is not odr-used by REQUIRE
+        const size_t bucket_count = LatencyHistogram::BucketCount;
+
+        WHEN("Mapping each value to a bucket")
+        {
+            THEN("The value lies within the bucket bounds, and the bucket is within the histogram")
+            {
+                for (auto value : values)
+                {
+                    auto index = LatencyHistogram::bucketIndex(value);
+                    REQUIRE(index < bucket_count);
+                    REQUIRE(LatencyHistogram::bucketLowest(index) <= value);
+                    REQUIRE(LatencyHistogram::bucketHighest(index) >= value);
+                }
+            }
+        }
+    }
+    GIVEN("Adjacent buckets")
+    {
+        THEN("The buckets are contiguous and do not overlap")
+        {
+            for (size_t i = 1; i < LatencyHistogram::BucketCount; i++)
+                REQUIRE(LatencyHistogram::bucketLowest(i) == LatencyHistogram::bucketHighest(i - 1) + 1);
+        }
+    }
+}
+
+SCENARIO("LatencyHistogram reports percentiles within its precision", "[latency-histogram]")
+{
+    GIVEN("A histogram with the values 1 to 10000 recorded")
+    {
+        LatencyHistogram histogram;
+
+        for (uint64_t i = 1; i <= 10000; i++)
+            histogram.record(i);
+
+        THEN("The summary values are correct")
+        {
+            REQUIRE(histogram.count() == 10000);
+            REQUIRE(histogram.min() == 1);
+            REQUIRE(histogram.max() == 10000);
+            REQUIRE(histogram.mean() == Approx(5000.5));
+        }
+        THEN("The percentiles are no lower than the true value and within 1/64 of it")
+        {
+            for (auto percent : {50.0, 90.0, 99.0, 99.9})
+            {
+                auto expected = static_cast<uint64_t>(percent * 100);
+                auto value = histogram.percentile(percent);
+                REQUIRE(value >= expected);
+                REQUIRE(value <= expected + expected / 64);
+            }
+        }
+        THEN("The 100th percentile is the maximum")
+        {
+            REQUIRE(histogram.percentile(100.0) == 10000);
+        }
+    }
+    GIVEN("An empty histogram")
+    {
+        LatencyHistogram histogram;
+
+        THEN("All the values are zero")
+        {
+            REQUIRE(histogram.empty());
+            REQUIRE(histogram.min() == 0);
+            REQUIRE(histogram.max() == 0);
+            REQUIRE(histogram.percentile(99.0) == 0);
+        }
+    }
+}
+
+SCENARIO("LatencyHistogram can merge and reset", "[latency-histogram]")
+{
+    GIVEN("Two histograms with different values")
+    {
+        LatencyHistogram first;
+        LatencyHistogram second;
+
+        for (int i = 0; i < 100; i++)
+        {
+            first.record(10);
+            second.record(1000000);
+        }
+
+        WHEN("Merging the second into the first")
+        {
+            first.merge(second);
+
+            THEN("The first holds all the values")
+            {
+                REQUIRE(first.count() == 200);
+                REQUIRE(first.min() == 10);
+                REQUIRE(first.max() == 1000000);
+                REQUIRE(first.percentile(25.0) == 10);
+                REQUIRE(first.percentile(75.0) >= 1000000);
+            }
+        }
+        WHEN("Resetting the first")
+        {
+            first.reset();
+
+            THEN("It is empty")
+            {
+                REQUIRE(first.empty());
+                REQUIRE(first.percentile(50.0) == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("AtomicLatencyHistogram records the same values as a LatencyHistogram", "[latency-histogram]")
+{
+    GIVEN("An AtomicLatencyHistogram and a LatencyHistogram recording the same values")
+    {
+        AtomicLatencyHistogram atomic_histogram;
+        LatencyHistogram expected;
+
+        for (uint64_t value = 1; value < 100000; value += 37)
+        {
+            atomic_histogram.record(value);
+            expected.record(value);
+        }
+
+        WHEN("Merging the atomic histogram into an empty histogram")
+        {
+            LatencyHistogram histogram;
+            atomic_histogram.mergeInto(histogram);
+
+            THEN("It matches the histogram recorded directly")
+            {
+                REQUIRE(histogram.count() == expected.count());
+                REQUIRE(histogram.min() == expected.min());
+                REQUIRE(histogram.max() == expected.max());
+                REQUIRE(histogram.mean() == expected.mean());
+                REQUIRE(histogram.percentile(50.0) == expected.percentile(50.0));
+                REQUIRE(histogram.percentile(99.0) == expected.percentile(99.0));
+            }
+        }
+        WHEN("Resetting the atomic histogram")
+        {
+            atomic_histogram.reset();
+
+            THEN("It merges as empty")
+            {
+                LatencyHistogram histogram;
+                atomic_histogram.mergeInto(histogram);
+                REQUIRE(histogram.empty());
+                REQUIRE(histogram.min() == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,252 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "Metrics.hpp"
+#include "catch2/catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tango.h>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+namespace metrics_test
+{
+const string MetricsFile = "/tmp/hdbpp-metrics-test.prom";
+
+//=============================================================================
+//=============================================================================
+auto readFile(const string &file_name) -> string
+{
+    ifstream file(file_name);
+    stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+} // namespace metrics_test
+
+SCENARIO("ConnectionMetrics counts events by type", "[metrics]")
+{
+    GIVEN("A ConnectionMetrics with events recorded against it")
+    {
+        ConnectionMetrics metrics;
+
+        metrics.eventStored(Tango::DEV_DOUBLE);
+        metrics.eventStored(Tango::DEV_DOUBLE);
+        metrics.eventFailed(Tango::DEV_STRING);
+        metrics.errorEventStored();
+        metrics.retry();
+        metrics.bufferDepth(7);
+        metrics.conf_id_cache.hits += 3;
+        metrics.conf_id_cache.misses += 1;
+
+        // out of range types are ignored
+        metrics.eventStored(-1);
+        metrics.eventStored(1000);
+
+        WHEN("Filling the stats")
+        {
+            hdbpp::HdbStats stats;
+            metrics.fill(stats);
+
+            THEN("The counts are reported against the type names")
+            {
+                REQUIRE(stats.events_stored.size() == 2);
+                REQUIRE(stats.events_stored["DEV_DOUBLE"] == 2);
+                REQUIRE(stats.events_failed["DEV_DOUBLE"] == 0);
+                REQUIRE(stats.events_stored["DEV_STRING"] == 0);
+                REQUIRE(stats.events_failed["DEV_STRING"] == 1);
+                REQUIRE(stats.error_events_stored == 1);
+                REQUIRE(stats.retries == 1);
+                REQUIRE(stats.reconnects == 0);
+                REQUIRE(stats.buffer_depth == 7);
+            }
+            AND_THEN("The caches are reported")
+            {
+                REQUIRE(stats.caches.size() == 3);
+                REQUIRE(stats.caches[0].name == "conf_id");
+                REQUIRE(stats.caches[0].hits == 3);
+                REQUIRE(stats.caches[0].misses == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("ConnectionMetrics records batch flushes", "[metrics]")
+{
+    GIVEN("A ConnectionMetrics with flushes recorded against it")
+    {
+        ConnectionMetrics metrics;
+        metrics.flushed(10, 1000000);
+        metrics.flushed(100, 3000000);
+
+        WHEN("Filling the stats")
+        {
+            hdbpp::HdbStats stats;
+            metrics.fill(stats);
+
+            THEN("The batch counts and flush durations are reported")
+            {
+                REQUIRE(stats.batches == 2);
+                REQUIRE(stats.batch_events == 110);
+                REQUIRE(stats.batch_size_max == 100);
+                REQUIRE(stats.flush_mean_us == Approx(2000.0));
+                REQUIRE(stats.flush_max_us == Approx(3000.0));
+            }
+        }
+    }
+}
+
+SCENARIO("Stats are formatted in the Prometheus text format", "[metrics]")
+{
+    GIVEN("Some stats")
+    {
+        hdbpp::HdbStats stats;
+        stats.events_stored["DEV_DOUBLE"] = 5;
+        stats.retries = 2;
+
+        hdbpp::HdbCacheStats cache;
+        cache.name = "conf_id";
+        cache.hits = 4;
+        stats.caches.push_back(cache);
+
+        WHEN("Formatting them")
+        {
+            auto text = formatPrometheus(stats);
+
+            THEN("Each metric has its type and value")
+            {
+                REQUIRE(text.find("# TYPE hdbpp_events_stored_total counter\n") != string::npos);
+                REQUIRE(text.find("hdbpp_events_stored_total{type=\"DEV_DOUBLE\"} 5\n") != string::npos);
+                REQUIRE(text.find("hdbpp_retries_total 2\n") != string::npos);
+                REQUIRE(text.find("hdbpp_cache_hits_total{cache=\"conf_id\"} 4\n") != string::npos);
+                REQUIRE(text.find("# TYPE hdbpp_buffer_depth_events gauge\n") != string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("The batch controller decisions are reported only when it is enabled", "[metrics]")
+{
+    GIVEN("A ConnectionMetrics with batch decisions recorded against it")
+    {
+        ConnectionMetrics metrics;
+        metrics.batchDecisions(500, 250000, 3, 1);
+
+        hdbpp::HdbStats stats;
+        metrics.fill(stats);
+
+        THEN("They are in the stats and formatted")
+        {
+            REQUIRE(stats.adaptive_batch_size == 500);
+            REQUIRE(stats.adaptive_flush_interval_us == 250000);
+            REQUIRE(stats.adaptive_increases == 3);
+            REQUIRE(stats.adaptive_decreases == 1);
+
+            auto text = formatPrometheus(stats);
+            REQUIRE(text.find("hdbpp_adaptive_batch_size_events 500\n") != string::npos);
+            REQUIRE(text.find("hdbpp_adaptive_flush_interval_seconds 0.25\n") != string::npos);
+            REQUIRE(text.find("hdbpp_adaptive_decreases_total 1\n") != string::npos);
+        }
+        AND_WHEN("The controller is disabled")
+        {
+            metrics.batchDecisions(0, 0, 0, 0);
+            metrics.fill(stats);
+
+            THEN("They are left out of the text format")
+            {
+                REQUIRE(formatPrometheus(stats).find("hdbpp_adaptive") == string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("The busiest attributes are formatted in the Prometheus text format", "[metrics]")
+{
+    GIVEN("Stats with a top attribute whose name needs escaping")
+    {
+        hdbpp::HdbStats stats;
+
+        hdbpp::HdbAttributeLoad load;
+        load.name = "tango://host:10000/a/b/c/\"attr\"";
+        load.events = 12;
+        load.bytes = 96;
+        load.errors = 1;
+        stats.top_attributes.push_back(load);
+
+        WHEN("Formatting them")
+        {
+            auto text = formatPrometheus(stats);
+
+            THEN("Each attribute metric is a gauge, labelled by the escaped attribute name")
+            {
+                const string label = "{attribute=\"tango://host:10000/a/b/c/\\\"attr\\\"\"}";
+
+                REQUIRE(text.find("# TYPE hdbpp_top_attribute_events gauge\n") != string::npos);
+                REQUIRE(text.find("hdbpp_top_attribute_events" + label + " 12\n") != string::npos);
+                REQUIRE(text.find("hdbpp_top_attribute_bytes" + label + " 96\n") != string::npos);
+                REQUIRE(text.find("hdbpp_top_attribute_errors" + label + " 1\n") != string::npos);
+            }
+        }
+    }
+    GIVEN("Stats without any top attributes")
+    {
+        hdbpp::HdbStats stats;
+
+        THEN("No attribute metrics are formatted")
+        {
+            REQUIRE(formatPrometheus(stats).find("hdbpp_top_attribute") == string::npos);
+        }
+    }
+}
+
+SCENARIO("MetricsFileWriter writes the stats to a file", "[metrics]")
+{
+    GIVEN("A MetricsFileWriter with a long interval")
+    {
+        remove(metrics_test::MetricsFile.c_str());
+
+        hdbpp::HdbStats stats;
+        stats.reconnects = 3;
+
+        {
+            MetricsFileWriter writer(metrics_test::MetricsFile, chrono::seconds(3600), [&stats]() { return stats; });
+
+            WHEN("Writing the file")
+            {
+                REQUIRE(writer.write());
+
+                THEN("The file holds the formatted stats")
+                {
+                    REQUIRE(metrics_test::readFile(metrics_test::MetricsFile) == formatPrometheus(stats));
+                }
+            }
+        }
+
+        THEN("The file is written when the writer is destroyed")
+        {
+            REQUIRE(metrics_test::readFile(metrics_test::MetricsFile).find("hdbpp_reconnects_total 3\n") !=
+                string::npos);
+        }
+
+        remove(metrics_test::MetricsFile.c_str());
+    }
+}
@@ -0,0 +1,80 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "PeriodicTask.hpp"
+#include "catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+SCENARIO("PeriodicTask runs the task every interval until stopped", "[periodic-task]")
+{
+    GIVEN("A PeriodicTask with a short interval")
+    {
+        atomic<int> runs {0};
+        PeriodicTask task(chrono::milliseconds(5), [&runs]() { runs++; });
+
+        WHEN("Waiting for several intervals then stopping it")
+        {
+            auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+
+            while (runs < 3 && chrono::steady_clock::now() < deadline)
+                this_thread::sleep_for(chrono::milliseconds(1));
+
+            task.stop();
+            auto stopped_runs = runs.load();
+
+            THEN("The task ran repeatedly, and not again after stop")
+            {
+                REQUIRE(stopped_runs >= 3);
+                this_thread::sleep_for(chrono::milliseconds(20));
+                REQUIRE(runs == stopped_runs);
+            }
+            AND_WHEN("Stopping it again")
+            {
+                task.stop();
+
+                THEN("The second stop is harmless") { REQUIRE(runs == stopped_runs); }
+            }
+        }
+    }
+    GIVEN("A PeriodicTask with a long interval")
+    {
+        atomic<int> runs {0};
+
+        WHEN("Destroying it before the interval has passed")
+        {
+            auto start = chrono::steady_clock::now();
+
+            {
+                PeriodicTask task(chrono::hours(1), [&runs]() { runs++; });
+            }
+
+            THEN("The task never ran, and the thread exited without waiting for the interval")
+            {
+                REQUIRE(runs == 0);
+                REQUIRE(chrono::steady_clock::now() - start < chrono::seconds(5));
+            }
+        }
+    }
+}
@@ -0,0 +1,354 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "PostgresFixture.hpp"
+
+#include "TestHelpers.hpp"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+#ifndef HDBPP_SCHEMA_DIR
+#define HDBPP_SCHEMA_DIR "db-schema"
+#endif
+
+namespace hdbpp_test
+{
+namespace postgres_fixture
+{
+    namespace
+    {
+        //=============================================================================
+        //=============================================================================
+        auto shellQuote(const string &value) -> string
+        {
+            string quoted = "'";
+
+            for (auto c : value)
+            {
+                if (c == '\'')
+                    quoted += "'\\''";
+                else
+                    quoted += c;
+            }
+
+            return quoted + "'";
+        }
+
+        //=============================================================================
+        //=============================================================================
+        void runCommand(const string &command)
+        {
+            if (system(command.c_str()) != 0)
+                throw runtime_error("Ephemeral database command failed: " + command);
+        }
+
+        //=============================================================================
+        //=============================================================================
+        auto captureCommand(const string &command) -> string
+        {
+            auto *pipe = popen(command.c_str(), "r");
+
+            if (pipe == nullptr)
+                throw runtime_error("Ephemeral database command failed: " + command);
+
+            string output;
+            char buffer[256];
+
+            while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+                output += buffer;
+
+            if (pclose(pipe) != 0)
+                throw runtime_error("Ephemeral database command failed: " + command);
+
+            // trim the trailing newlines
+            while (!output.empty() && (output.back() == '\n' || output.back() == '\r'))
+                output.pop_back();
+
+            return output;
+        }
+
+        //=============================================================================
+        //=============================================================================
+        auto findBinDir() -> string
+        {
+            auto *env = getenv(BinDirEnvVar.c_str());
+
+            if (env != nullptr)
+                return env;
+
+            // distributions often keep initdb/pg_ctl out of the path, pg_config knows where they are
+            try
+            {
+                return captureCommand("pg_config --bindir 2>/dev/null");
+            }
+            catch (const runtime_error &)
+            {
+                // fall back on the path
+                return "";
+            }
+        }
+
+        //=============================================================================
+        //=============================================================================
+        auto timescaleInstalled(const string &pg_config) -> bool
+        {
+            string lib_dir;
+
+            try
+            {
+                lib_dir = captureCommand(pg_config + " --pkglibdir 2>/dev/null");
+            }
+            catch (const runtime_error &)
+            {
+                return false;
+            }
+
+            auto *dir = opendir(lib_dir.c_str());
+
+            if (dir == nullptr)
+                return false;
+
+            auto found = false;
+
+            while (auto *entry = readdir(dir))
+            {
+                if (string(entry->d_name).compare(0, 11, "timescaledb") == 0)
+                {
+                    found = true;
+                    break;
+                }
+            }
+
+            closedir(dir);
+            return found;
+        }
+
+        //=============================================================================
+        //=============================================================================
+        auto freePort() -> int
+        {
+            auto fd = socket(AF_INET, SOCK_STREAM, 0);
+
+            sockaddr_in addr {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+
+            socklen_t len = sizeof(addr);
+
+            if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+                getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+            {
+                if (fd >= 0)
+                    close(fd);
+
+                throw runtime_error("Ephemeral database unable to find a free port");
+            }
+
+            // the port is released for postgres to use, there is a small chance another
+            // process takes it first, in which case the server will fail to start
+            close(fd);
+            return ntohs(addr.sin_port);
+        }
+    } // namespace
+
+    //=============================================================================
+    //=============================================================================
+    EphemeralPostgres::EphemeralPostgres(const ServerConfig &config) : _config(config)
+    {
+        if (_config.schema_file.empty())
+        {
+            auto *env = getenv(SchemaEnvVar.c_str());
+            _config.schema_file = env != nullptr ? env : string(HDBPP_SCHEMA_DIR) + "/schema.sql";
+        }
+
+        _bin_dir = findBinDir();
+        _timescale = _config.use_timescale && timescaleInstalled(_bin_dir.empty() ? "pg_config" : _bin_dir + "/pg_config");
+
+        // the destructor does not run when the constructor throws, so a server that started
+        // but failed to load the schema is stopped, and its directory removed, here
+        try
+        {
+            start();
+        }
+        catch (...)
+        {
+            try
+            {
+                stop();
+            }
+            catch (const runtime_error &e)
+            {
+                cerr << e.what() << endl;
+            }
+
+            throw;
+        }
+    }
+
+    //=============================================================================
+    //=============================================================================
+    EphemeralPostgres::~EphemeralPostgres()
+    {
+        try
+        {
+            stop();
+        }
+        catch (const runtime_error &e)
+        {
+            cerr << e.what() << endl;
+        }
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto EphemeralPostgres::connectString() const -> string
+    {
+        return "user=postgres host=127.0.0.1 port=" + to_string(_port) + " dbname=hdb";
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void EphemeralPostgres::applySettings(const map<string, string> &settings)
+    {
+        auto restart = false;
+
+        for (auto &setting : settings)
+        {
+            runSql("ALTER SYSTEM SET " + setting.first + " = '" + setting.second + "'", "postgres");
+
+            auto context = runSql("SELECT context FROM pg_settings WHERE name = '" + setting.first + "'", "postgres");
+            restart = restart || context == "postmaster";
+        }
+
+        if (restart)
+            runCommand(bin("pg_ctl") + " -D " + _data_dir + " -l " + _base_dir + "/server.log -w -t 60 restart > /dev/null");
+        else
+            runSql("SELECT pg_reload_conf()", "postgres");
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto EphemeralPostgres::setting(const string &name) -> string
+    {
+        return runSql("SHOW " + name, "postgres");
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void EphemeralPostgres::start()
+    {
+        char base_dir[] = "/tmp/hdbpp-pg-XXXXXX";
+
+        if (mkdtemp(base_dir) == nullptr)
+            throw runtime_error("Ephemeral database unable to create a temporary directory");
+
+        _base_dir = base_dir;
+        _data_dir = _base_dir + "/data";
+        _port = freePort();
+
+        runCommand(bin("initdb") + " -D " + _data_dir + " -U postgres -A trust -E UTF8 > " + _base_dir +
+            "/initdb.log 2>&1");
+
+        // settings are appended, so they override the defaults written by initdb
+        string conf = "\nlisten_addresses = '127.0.0.1'\nport = " + to_string(_port) +
+            "\nunix_socket_directories = '" + _base_dir + "'\n";
+
+        if (_timescale)
+            conf += "shared_preload_libraries = 'timescaledb'\ntimescaledb.telemetry_level = off\n";
+
+        for (auto &setting : _config.settings)
+            conf += setting.first + " = '" + setting.second + "'\n";
+
+        runCommand("printf '%s' " + shellQuote(conf) + " >> " + _data_dir + "/postgresql.conf");
+        runCommand(bin("pg_ctl") + " -D " + _data_dir + " -l " + _base_dir + "/server.log -w -t 60 start > /dev/null");
+        _running = true;
+
+        // the schema creates the hdb database itself. Without timescale the extension and
+        // hypertable statements fail, and the tables are left as plain tables
+        runCommand(bin("psql") + " -h 127.0.0.1 -p " + to_string(_port) + " -U postgres -d template1 -q -f " +
+            shellQuote(_config.schema_file) + " > " + _base_dir + "/schema.log 2>&1");
+
+        // check the schema loaded, so a failure is reported here and not by the first test
+        runSql("SELECT count(*) FROM att_conf_type");
+    }
+
+    //=============================================================================
+    //=============================================================================
+    void EphemeralPostgres::stop()
+    {
+        if (_running)
+        {
+            _running = false;
+            runCommand(bin("pg_ctl") + " -D " + _data_dir + " -m fast -w stop > /dev/null");
+        }
+
+        if (!_base_dir.empty())
+        {
+            runCommand("rm -rf " + shellQuote(_base_dir));
+            _base_dir.clear();
+        }
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto EphemeralPostgres::runSql(const string &sql, const string &dbname) -> string
+    {
+        return captureCommand(bin("psql") + " -h 127.0.0.1 -p " + to_string(_port) + " -U postgres -d " + dbname +
+            " -tAq -v ON_ERROR_STOP=1 -c " + shellQuote(sql));
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto EphemeralPostgres::bin(const string &name) const -> string
+    {
+        return _bin_dir.empty() ? name : _bin_dir + "/" + name;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    auto useEphemeralDatabase(const ServerConfig &config) -> unique_ptr<EphemeralPostgres>
+    {
+        auto *env = getenv(EnableEnvVar.c_str());
+
+        if (env == nullptr || string(env).empty() || string(env) == "0" || string(env) == "false")
+            return nullptr;
+
+        auto server = make_unique<EphemeralPostgres>(config);
+
+        psql_connection::postgres_db::ConnectionString = server->connectString();
+        psql_connection::postgres_db::HdbppConnectionString = server->connectString();
+
+        cerr << "Using ephemeral database: " << server->connectString()
+             << (server->timescaleEnabled() ? " (with timescaledb)" : " (without timescaledb)") << endl;
+
+        return server;
+    }
+} // namespace postgres_fixture
+} // namespace hdbpp_test
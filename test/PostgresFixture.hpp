@@ -0,0 +1,108 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#ifndef _POSTGRES_FIXTURE_HPP
+#define _POSTGRES_FIXTURE_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace hdbpp_test
+{
+namespace postgres_fixture
+{
+    // Environment variable that enables the ephemeral database for a test or benchmark run
+    const std::string EnableEnvVar = "HDBPP_EPHEMERAL_DB";
+
+    // Optional environment variables to locate the postgres binaries and the schema
+    const std::string BinDirEnvVar = "HDBPP_PG_BINDIR";
+    const std::string SchemaEnvVar = "HDBPP_SCHEMA_FILE";
+
+    struct ServerConfig
+    {
+        // postgresql.conf settings for the server, for example synchronous_commit or shared_buffers
+        std::map<std::string, std::string> settings;
+
+        // load the timescaledb extension, when it is installed. Without it the schema
+        // is loaded as plain tables (the hypertable calls fail and are ignored)
+        bool use_timescale = true;
+
+        // schema to load, defaults to db-schema/schema.sql from the source tree
+        std::string schema_file;
+    };
+
+    // Runs a private PostgreSQL (with TimescaleDB if available) server for the duration
+    // of a test or benchmark run. The server is created with initdb in a temporary
+    // directory, started with pg_ctl on a free port on the loopback interface, has the
+    // hdb++ schema loaded, and is stopped and deleted again on destruction. This gives
+    // isolated and reproducible results on any machine with postgres installed. Note
+    // initdb will not run as root.
+    class EphemeralPostgres
+    {
+    public:
+        EphemeralPostgres(const ServerConfig &config = ServerConfig());
+        ~EphemeralPostgres();
+
+        EphemeralPostgres(const EphemeralPostgres &) = delete;
+        auto operator=(const EphemeralPostgres &) -> EphemeralPostgres & = delete;
+
+        // connection string for the hdb database on this server
+        auto connectString() const -> std::string;
+
+        // true if the server is running with the timescaledb extension
+        auto timescaleEnabled() const noexcept -> bool { return _timescale; }
+
+        auto dataDirectory() const -> const std::string & { return _data_dir; }
+        auto port() const noexcept -> int { return _port; }
+
+        // change server settings while running, the server is restarted if any of
+        // the settings can only be changed at startup (i.e. shared_buffers)
+        void applySettings(const std::map<std::string, std::string> &settings);
+
+        // get the current value of a server setting
+        auto setting(const std::string &name) -> std::string;
+
+    private:
+        void start();
+        void stop();
+
+        // run some sql against the given database, returning the unaligned output
+        auto runSql(const std::string &sql, const std::string &dbname = "hdb") -> std::string;
+
+        // full path to a postgres binary
+        auto bin(const std::string &name) const -> std::string;
+
+        ServerConfig _config;
+        std::string _bin_dir;
+        std::string _base_dir;
+        std::string _data_dir;
+        int _port = 0;
+        bool _timescale = false;
+        bool _running = false;
+    };
+
+    // When the EnableEnvVar is set, start an ephemeral server and point the test
+    // connection strings (psql_connection::postgres_db) at it. Returns nullptr, and
+    // leaves the connection strings alone, when the variable is not set. The server is
+    // stopped when the returned object is destroyed.
+    auto useEphemeralDatabase(const ServerConfig &config = ServerConfig()) -> std::unique_ptr<EphemeralPostgres>;
+
+} // namespace postgres_fixture
+} // namespace hdbpp_test
+#endif // _POSTGRES_FIXTURE_HPP
@@ -0,0 +1,177 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "PqEventLoop.hpp"
+#include "TestHelpers.hpp"
+#include "catch2/catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace hdbpp_internal;
+using namespace hdbpp_test::psql_connection;
+
+using Status = PqEventLoop::Result::Status;
+
+SCENARIO("The PqEventLoop runs queries and reports their result", "[db-access][pq-event-loop]")
+{
+    GIVEN("A PqEventLoop connected to the database")
+    {
+        PqEventLoop loop(postgres_db::HdbppConnectionString, 2);
+        REQUIRE(loop.connected() == 2);
+
+        WHEN("Running a query of several statements")
+        {
+            auto result = loop.execute("SELECT 1; SELECT 2;", chrono::milliseconds(0));
+
+            THEN("The query succeeds") { REQUIRE(result.ok()); }
+        }
+        WHEN("Running a query the database rejects")
+        {
+            auto result = loop.execute("SELECT 1; SELECT * FROM no_such_table; SELECT 2;", chrono::milliseconds(0));
+
+            THEN("The error is reported")
+            {
+                REQUIRE(result.status == Status::Error);
+                REQUIRE(result.error.find("no_such_table") != string::npos);
+            }
+        }
+        WHEN("Running a query that outlives its timeout")
+        {
+            auto start = chrono::steady_clock::now();
+            auto result = loop.execute("SELECT pg_sleep(10);", chrono::milliseconds(100));
+            auto elapsed = chrono::steady_clock::now() - start;
+
+            THEN("The query times out promptly, and the connections remain usable")
+            {
+                REQUIRE(result.status == Status::TimedOut);
+                REQUIRE(elapsed < chrono::seconds(5));
+                REQUIRE(loop.execute("SELECT 1;", chrono::seconds(5)).ok());
+                REQUIRE(loop.execute("SELECT 1;", chrono::seconds(5)).ok());
+            }
+        }
+        WHEN("Cancelling a running query")
+        {
+            promise<PqEventLoop::Result> result;
+
+            auto id = loop.submit("SELECT pg_sleep(10);",
+                chrono::milliseconds(0),
+                [&result](const PqEventLoop::Result &r) { result.set_value(r); });
+
+            this_thread::sleep_for(chrono::milliseconds(100));
+            loop.cancel(id);
+
+            THEN("The query is reported as cancelled")
+            {
+                REQUIRE(result.get_future().get().status == Status::Cancelled);
+                REQUIRE(loop.execute("SELECT 1;", chrono::seconds(5)).ok());
+            }
+        }
+    }
+}
+
+SCENARIO("The PqEventLoop runs queries on its connections at the same time", "[db-access][pq-event-loop]")
+{
+    GIVEN("A PqEventLoop with several connections")
+    {
+        const int connections = 4;
+        PqEventLoop loop(postgres_db::HdbppConnectionString, connections);
+
+        WHEN("Submitting a slow query for each connection")
+        {
+            atomic<int> completed {0};
+            auto start = chrono::steady_clock::now();
+
+            for (auto i = 0; i < connections; i++)
+            {
+                loop.submit(
+                    "SELECT pg_sleep(0.5);", chrono::milliseconds(0), [&completed](const PqEventLoop::Result &r) {
+                        if (r.ok())
+                            completed++;
+                    });
+            }
+
+            while (loop.inFlight() > 0)
+                this_thread::sleep_for(chrono::milliseconds(10));
+
+            auto elapsed = chrono::steady_clock::now() - start;
+
+            THEN("They all complete in little more than the time of one")
+            {
+                REQUIRE(completed == connections);
+                REQUIRE(elapsed < chrono::milliseconds(500 * connections));
+            }
+        }
+    }
+}
+
+SCENARIO("The PqEventLoop reports queries that never left the queue as not sent", "[db-access][pq-event-loop]")
+{
+    using Status = PqEventLoop::Result::Status;
+
+    GIVEN("A PqEventLoop with its only connection busy")
+    {
+        PqEventLoop loop(postgres_db::HdbppConnectionString, 1);
+        loop.submit("SELECT pg_sleep(1);", chrono::milliseconds(0), [](const PqEventLoop::Result &) {});
+
+        WHEN("Queueing a query that times out before the connection is free")
+        {
+            auto result = loop.execute("SELECT 1;", chrono::milliseconds(100));
+
+            THEN("The query is reported as not sent") { REQUIRE(result.status == Status::NotSent); }
+        }
+        WHEN("Cancelling a queued query")
+        {
+            promise<PqEventLoop::Result> result;
+
+            auto id = loop.submit(
+                "SELECT 1;", chrono::milliseconds(0), [&result](const PqEventLoop::Result &r) { result.set_value(r); });
+
+            loop.cancel(id);
+
+            THEN("The query is reported as not sent")
+            {
+                REQUIRE(result.get_future().get().status == Status::NotSent);
+            }
+        }
+        WHEN("Stopping the loop with a query queued")
+        {
+            promise<PqEventLoop::Result> result;
+
+            {
+                PqEventLoop stopped(postgres_db::HdbppConnectionString, 1);
+                stopped.submit("SELECT pg_sleep(1);", chrono::milliseconds(0), [](const PqEventLoop::Result &) {});
+
+                stopped.submit("SELECT 1;", chrono::milliseconds(0), [&result](const PqEventLoop::Result &r) {
+                    result.set_value(r);
+                });
+            }
+
+            THEN("The queued query is reported as not sent")
+            {
+                REQUIRE(result.get_future().get().status == Status::NotSent);
+            }
+        }
+    }
+}
@@ -0,0 +1,232 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "SlowQueryLog.hpp"
+#include "catch2/catch.hpp"
+
+#include <chrono>
+#include <string>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+namespace slow_query_log_test
+{
+const string StatementClass = "StoreDataEvent";
+const string PreparedName = "StoreDataEvent_scalar_devdouble_ro";
+} // namespace slow_query_log_test
+
+SCENARIO("SlowQueryLog only records statements over the threshold", "[slow-query-log]")
+{
+    GIVEN("A default SlowQueryLog")
+    {
+        SlowQueryLog log;
+
+        THEN("It is disabled and records nothing")
+        {
+            REQUIRE(!log.enabled());
+            REQUIRE(!log.record(slow_query_log_test::StatementClass, 1, chrono::seconds(10)));
+            REQUIRE(log.slowCount() == 0);
+        }
+    }
+    GIVEN("A SlowQueryLog with a 10ms threshold")
+    {
+        SlowQueryLog log;
+        log.configure(chrono::milliseconds(10), 0);
+
+        REQUIRE(log.enabled());
+
+        WHEN("A fast statement is recorded")
+        {
+            THEN("It is not slow")
+            {
+                REQUIRE(!log.record(slow_query_log_test::StatementClass, 1, chrono::milliseconds(2)));
+                REQUIRE(log.slowCount() == 0);
+            }
+        }
+        WHEN("Slow statements are recorded")
+        {
+            REQUIRE(log.record(slow_query_log_test::StatementClass, 1, chrono::milliseconds(10)));
+            REQUIRE(log.record(slow_query_log_test::StatementClass, 200, chrono::milliseconds(50)));
+
+            THEN("They are counted")
+            {
+                REQUIRE(log.slowCount() == 2);
+            }
+        }
+        WHEN("The threshold is set to zero")
+        {
+            log.configure(chrono::milliseconds(0), 0);
+
+            THEN("The log is disabled")
+            {
+                REQUIRE(!log.enabled());
+                REQUIRE(!log.record(slow_query_log_test::StatementClass, 1, chrono::seconds(10)));
+            }
+        }
+    }
+}
+
+SCENARIO("SlowQueryLog samples slow prepared statements for an explain", "[slow-query-log]")
+{
+    GIVEN("A SlowQueryLog with explains disabled")
+    {
+        SlowQueryLog log;
+        log.configure(chrono::milliseconds(10), 0);
+
+        WHEN("A slow prepared statement is recorded")
+        {
+            log.record(slow_query_log_test::StatementClass,
+                1,
+                chrono::milliseconds(20),
+                &slow_query_log_test::PreparedName);
+
+            THEN("No explain is requested")
+            {
+                REQUIRE(!log.takeExplain(slow_query_log_test::PreparedName));
+            }
+        }
+    }
+    GIVEN("A SlowQueryLog explaining every slow prepared statement")
+    {
+        SlowQueryLog log;
+        log.configure(chrono::milliseconds(10), 1);
+
+        WHEN("A slow statement that was not prepared is recorded")
+        {
+            log.record(slow_query_log_test::StatementClass, 1, chrono::milliseconds(20));
+
+            THEN("No explain is requested")
+            {
+                REQUIRE(!log.takeExplain(slow_query_log_test::PreparedName));
+            }
+        }
+        WHEN("A fast prepared statement is recorded")
+        {
+            log.record(slow_query_log_test::StatementClass,
+                1,
+                chrono::milliseconds(1),
+                &slow_query_log_test::PreparedName);
+
+            THEN("No explain is requested")
+            {
+                REQUIRE(!log.takeExplain(slow_query_log_test::PreparedName));
+            }
+        }
+        WHEN("A slow prepared statement is recorded")
+        {
+            log.record(slow_query_log_test::StatementClass,
+                1,
+                chrono::milliseconds(20),
+                &slow_query_log_test::PreparedName);
+
+            THEN("An explain is requested once for that statement only")
+            {
+                REQUIRE(!log.takeExplain("SomeOtherStatement"));
+                REQUIRE(log.takeExplain(slow_query_log_test::PreparedName));
+                REQUIRE(!log.takeExplain(slow_query_log_test::PreparedName));
+            }
+        }
+    }
+    GIVEN("A SlowQueryLog explaining every third slow prepared statement")
+    {
+        SlowQueryLog log;
+        log.configure(chrono::milliseconds(10), 3);
+
+        WHEN("Slow prepared statements are recorded, each explain taken as it is requested")
+        {
+            auto explains = 0;
+
+            for (auto i = 0; i < 9; i++)
+            {
+                log.record(slow_query_log_test::StatementClass,
+                    1,
+                    chrono::milliseconds(20),
+                    &slow_query_log_test::PreparedName);
+
+                if (log.takeExplain(slow_query_log_test::PreparedName))
+                    explains++;
+            }
+
+            THEN("Only every third is explained")
+            {
+                REQUIRE(explains == 3);
+            }
+        }
+    }
+}
+
+SCENARIO("SlowQueryLog::Scope records the duration of a statement", "[slow-query-log]")
+{
+    GIVEN("A SlowQueryLog with a 1us threshold")
+    {
+        SlowQueryLog log;
+        log.configure(chrono::microseconds(1), 0);
+
+        WHEN("A scope runs for longer than the threshold")
+        {
+            {
+                SlowQueryLog::Scope scope(log, slow_query_log_test::StatementClass, 1, nullptr);
+                auto start = chrono::steady_clock::now();
+
+                while (chrono::steady_clock::now() - start < chrono::microseconds(100))
+                {
+                }
+            }
+
+            THEN("The statement is recorded as slow")
+            {
+                REQUIRE(log.slowCount() == 1);
+            }
+        }
+        WHEN("A scope is dismissed")
+        {
+            {
+                SlowQueryLog::Scope scope(log, slow_query_log_test::StatementClass, 1, nullptr);
+                auto start = chrono::steady_clock::now();
+
+                while (chrono::steady_clock::now() - start < chrono::microseconds(100))
+                {
+                }
+
+                scope.dismiss();
+            }
+
+            THEN("Nothing is recorded")
+            {
+                REQUIRE(log.slowCount() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("SlowQueryLog builds the explain variant of a prepared statement", "[slow-query-log]")
+{
+    GIVEN("A prepared statement")
+    {
+        const string statement = "INSERT INTO att_scalar_devdouble (att_conf_id) VALUES ($1)";
+
+        THEN("The explain statement wraps it with EXPLAIN (ANALYZE, BUFFERS)")
+        {
+            REQUIRE(SlowQueryLog::explainStatement(statement) == "EXPLAIN (ANALYZE, BUFFERS) " + statement);
+            REQUIRE(SlowQueryLog::explainName(slow_query_log_test::PreparedName) !=
+                slow_query_log_test::PreparedName);
+        }
+    }
+}
@@ -0,0 +1,184 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+#include "StageTimer.hpp"
+#include "catch2/catch.hpp"
+
+#include <memory>
+#include <thread>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+SCENARIO("Stage timers only record when enabled", "[stage-timer]")
+{
+    GIVEN("Stage timing that is disabled")
+    {
+        StageTimers timers;
+
+        WHEN("A stage is timed")
+        {
+            {
+                ScopedStageTimer timer(&timers, Stage::Extract);
+            }
+
+            THEN("Nothing is recorded")
+            {
+                auto histograms = timers.snapshot();
+
+                for (auto &histogram : histograms)
+                    REQUIRE(histogram.empty());
+            }
+        }
+    }
+    GIVEN("Stage timing that is enabled")
+    {
+        StageTimers timers;
+        timers.enable(true);
+
+        WHEN("Stages are timed")
+        {
+            {
+                ScopedStageTimer timer(&timers, Stage::Extract);
+                this_thread::sleep_for(chrono::milliseconds(2));
+            }
+
+            timers.record(Stage::Commit, 1000);
+            timers.record(Stage::Commit, 2000);
+
+            THEN("The durations are recorded against the stages")
+            {
+                auto histograms = timers.snapshot();
+
+                REQUIRE(histograms[static_cast<size_t>(Stage::Extract)].count() == 1);
+                REQUIRE(histograms[static_cast<size_t>(Stage::Extract)].min() >= 2000000);
+                REQUIRE(histograms[static_cast<size_t>(Stage::Commit)].count() == 2);
+                REQUIRE(histograms[static_cast<size_t>(Stage::Commit)].max() == 2000);
+                REQUIRE(histograms[static_cast<size_t>(Stage::Execute)].empty());
+            }
+            AND_WHEN("The timers are reset")
+            {
+                timers.reset();
+
+                THEN("The timings are cleared")
+                {
+                    auto histograms = timers.snapshot();
+
+                    for (auto &histogram : histograms)
+                        REQUIRE(histogram.empty());
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Stage timings are merged across threads", "[stage-timer]")
+{
+    GIVEN("Stage timing that is enabled")
+    {
+        StageTimers timers;
+        timers.enable(true);
+
+        WHEN("Several threads record timings, then exit")
+        {
+            vector<thread> threads;
+
+            for (int i = 0; i < 4; i++)
+            {
+                threads.emplace_back([&timers]() {
+                    for (int j = 0; j < 100; j++)
+                        timers.record(Stage::Execute, 500);
+                });
+            }
+
+            for (auto &t : threads)
+                t.join();
+
+            timers.record(Stage::Execute, 500);
+
+            THEN("The snapshot holds the timings from the live and exited threads")
+            {
+                auto histograms = timers.snapshot();
+                REQUIRE(histograms[static_cast<size_t>(Stage::Execute)].count() == 401);
+            }
+        }
+    }
+}
+
+SCENARIO("Each set of stage timers keeps its own timings", "[stage-timer]")
+{
+    GIVEN("Two sets of stage timers that are enabled")
+    {
+        StageTimers first;
+        StageTimers second;
+        first.enable(true);
+        second.enable(true);
+
+        WHEN("Timings are recorded against each")
+        {
+            first.record(Stage::Execute, 500);
+            second.record(Stage::Execute, 500);
+            second.record(Stage::Execute, 500);
+
+            THEN("Each holds only its own timings")
+            {
+                REQUIRE(first.snapshot()[static_cast<size_t>(Stage::Execute)].count() == 1);
+                REQUIRE(second.snapshot()[static_cast<size_t>(Stage::Execute)].count() == 2);
+            }
+            AND_WHEN("One is reset")
+            {
+                first.reset();
+
+                THEN("The other keeps its timings")
+                {
+                    REQUIRE(first.snapshot()[static_cast<size_t>(Stage::Execute)].empty());
+                    REQUIRE(second.snapshot()[static_cast<size_t>(Stage::Execute)].count() == 2);
+                }
+            }
+        }
+    }
+    GIVEN("Stage timers that are reset and destroyed while a thread still holds timings")
+    {
+        auto timers = make_unique<StageTimers>();
+        timers->enable(true);
+        timers->record(Stage::Commit, 100);
+        timers->reset();
+        timers->record(Stage::Commit, 200);
+
+        THEN("Only the timings since the reset are reported")
+        {
+            auto histograms = timers->snapshot();
+            REQUIRE(histograms[static_cast<size_t>(Stage::Commit)].count() == 1);
+            REQUIRE(histograms[static_cast<size_t>(Stage::Commit)].max() == 200);
+        }
+
+        timers.reset();
+
+        WHEN("New timers are then used on the same thread")
+        {
+            StageTimers replacement;
+            replacement.enable(true);
+            replacement.record(Stage::Commit, 300);
+
+            THEN("They start empty")
+            {
+                REQUIRE(replacement.snapshot()[static_cast<size_t>(Stage::Commit)].count() == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,339 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "MpscQueue.hpp"
+#include "StorageEngine.hpp"
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace hdbpp_internal;
+using hdbpp::HdbEventStatus;
+
+SCENARIO("MpscQueue keeps the order of each producer", "[storage-engine]")
+{
+    GIVEN("An MpscQueue and several producer threads")
+    {
+        const int producers = 4;
+        const int items = 10000;
+
+        MpscQueue<unique_ptr<int>> queue;
+        vector<thread> threads;
+
+        for (auto producer = 0; producer < producers; producer++)
+        {
+            threads.emplace_back([&queue, producer]() {
+                for (auto i = 0; i < items; i++)
+                    queue.push(make_unique<int>(producer * items + i));
+            });
+        }
+
+        WHEN("Popping every item on a single consumer")
+        {
+            vector<int> last(producers, -1);
+            auto popped = 0;
+            auto in_order = true;
+
+            while (popped < producers * items)
+            {
+                unique_ptr<int> value;
+
+                if (!queue.pop(value))
+                    continue;
+
+                auto producer = *value / items;
+                in_order = in_order && *value % items == last[producer] + 1;
+                last[producer] = *value % items;
+                popped++;
+            }
+
+            for (auto &t : threads)
+                t.join();
+
+            THEN("Each item arrives once, in the order its producer pushed it")
+            {
+                REQUIRE(in_order);
+                REQUIRE(queue.empty());
+
+                for (auto value : last)
+                    REQUIRE(value == items - 1);
+            }
+        }
+    }
+}
+
+SCENARIO("StorageEngine stores submitted events and returns their statuses", "[storage-engine]")
+{
+    GIVEN("A StorageEngine that fails negative events")
+    {
+        vector<int> stored;
+
+        StorageEngine<int> engine(
+            [&stored](vector<int> &events) {
+                StorageEngine<int>::Statuses statuses;
+
+                for (auto event : events)
+                {
+                    stored.push_back(event);
+                    statuses.push_back(event < 0 ? HdbEventStatus::DbError : HdbEventStatus::Ok);
+                }
+
+                return statuses;
+            },
+            100);
+
+        WHEN("Submitting a batch of events")
+        {
+            auto statuses = engine.submit({1, -2, 3}).get();
+
+            THEN("The events are stored, and the statuses match the events")
+            {
+                REQUIRE(stored == vector<int> {1, -2, 3});
+                REQUIRE(statuses.size() == 3);
+                REQUIRE(statuses[0] == HdbEventStatus::Ok);
+                REQUIRE(statuses[1] == HdbEventStatus::DbError);
+                REQUIRE(statuses[2] == HdbEventStatus::Ok);
+            }
+        }
+        WHEN("Executing work")
+        {
+            auto ran = false;
+            engine.execute([&ran]() { ran = true; });
+
+            THEN("The work has run once execute returns") { REQUIRE(ran); }
+        }
+        WHEN("Executing work that throws")
+        {
+            THEN("The exception is raised by execute")
+            {
+                REQUIRE_THROWS_AS(engine.execute([]() { throw runtime_error("work failed"); }), runtime_error);
+            }
+        }
+    }
+}
+
+SCENARIO("StorageEngine runs the completion callback once the events are stored", "[storage-engine]")
+{
+    GIVEN("A StorageEngine that fails negative events")
+    {
+        StorageEngine<int> engine(
+            [](vector<int> &events) {
+                StorageEngine<int>::Statuses statuses;
+
+                for (auto event : events)
+                    statuses.push_back(event < 0 ? HdbEventStatus::DbError : HdbEventStatus::Ok);
+
+                return statuses;
+            },
+            100);
+
+        WHEN("Submitting events with a callback")
+        {
+            promise<StorageEngine<int>::Statuses> result;
+
+            engine.submit({1, -2}, [&result](const StorageEngine<int>::Statuses &statuses, exception_ptr error) {
+                if (error)
+                    result.set_exception(error);
+                else
+                    result.set_value(statuses);
+            });
+
+            auto statuses = result.get_future().get();
+
+            THEN("The callback is given the status of each event")
+            {
+                REQUIRE(statuses == StorageEngine<int>::Statuses {HdbEventStatus::Ok, HdbEventStatus::DbError});
+            }
+        }
+        WHEN("A callback throws")
+        {
+            engine.submit({1}, [](const StorageEngine<int>::Statuses &, exception_ptr) {
+                throw runtime_error("callback failed");
+            });
+
+            THEN("The engine carries on storing events") { REQUIRE(engine.submit({2}).get().size() == 1); }
+        }
+        WHEN("A callback checks which thread it is run on")
+        {
+            promise<bool> result;
+
+            engine.submit({1}, [&engine, &result](const StorageEngine<int>::Statuses &, exception_ptr) {
+                result.set_value(engine.onEngineThread());
+            });
+
+            THEN("It is run on the engine thread, and the caller is not")
+            {
+                REQUIRE(result.get_future().get());
+                REQUIRE(!engine.onEngineThread());
+            }
+        }
+    }
+
+    GIVEN("A StorageEngine whose store throws")
+    {
+        StorageEngine<int> engine(
+            [](vector<int> &) -> StorageEngine<int>::Statuses { throw runtime_error("lost"); }, 100);
+
+        WHEN("Submitting events with a callback")
+        {
+            promise<exception_ptr> result;
+
+            engine.submit({1}, [&result](const StorageEngine<int>::Statuses &, exception_ptr error) {
+                result.set_value(error);
+            });
+
+            auto error = result.get_future().get();
+
+            THEN("The callback is given the exception") { REQUIRE_THROWS_AS(rethrow_exception(error), runtime_error); }
+        }
+    }
+}
+
+SCENARIO("StorageEngine groups the events queued while it is busy", "[storage-engine]")
+{
+    GIVEN("A StorageEngine held busy by its first store")
+    {
+        mutex lock;
+        condition_variable signal;
+        auto release = false;
+        vector<size_t> group_sizes;
+
+        StorageEngine<int> engine(
+            [&](vector<int> &events) {
+                unique_lock<mutex> guard(lock);
+                group_sizes.push_back(events.size());
+                signal.wait(guard, [&release]() { return release; });
+                return StorageEngine<int>::Statuses(events.size(), HdbEventStatus::Ok);
+            },
+            100);
+
+        auto first = engine.submit({0});
+
+        // wait until the engine is inside the first store
+        {
+            unique_lock<mutex> guard(lock);
+            signal.wait_for(guard, chrono::seconds(10), [&group_sizes]() { return !group_sizes.empty(); });
+        }
+
+        WHEN("Several producers submit events meanwhile")
+        {
+            vector<future<StorageEngine<int>::Statuses>> results;
+
+            for (auto i = 1; i <= 5; i++)
+                results.push_back(engine.submit({i, i}));
+
+            {
+                lock_guard<mutex> guard(lock);
+                release = true;
+            }
+
+            signal.notify_all();
+            first.get();
+
+            for (auto &result : results)
+                REQUIRE(result.get().size() == 2);
+
+            THEN("They are stored together as a single group")
+            {
+                REQUIRE(group_sizes == vector<size_t> {1, 10});
+                REQUIRE(engine.groups() == 2);
+                REQUIRE(engine.groupedEvents() == 11);
+            }
+        }
+    }
+}
+
+SCENARIO("StorageEngine fails a group as a whole when the store throws", "[storage-engine]")
+{
+    GIVEN("A StorageEngine whose store throws")
+    {
+        StorageEngine<int> engine(
+            [](vector<int> &) -> StorageEngine<int>::Statuses { throw runtime_error("lost"); }, 100);
+
+        WHEN("Submitting events")
+        {
+            auto result = engine.submit({1, 2});
+
+            THEN("The future raises the exception") { REQUIRE_THROWS_AS(result.get(), runtime_error); }
+        }
+    }
+}
+
+SCENARIO("StorageEngine is safe to share between producer threads", "[storage-engine]")
+{
+    GIVEN("A StorageEngine and several producer threads")
+    {
+        // only the engine thread calls the store, so the count needs no lock
+        auto stored = 0;
+
+        StorageEngine<int> engine(
+            [&stored](vector<int> &events) {
+                stored += static_cast<int>(events.size());
+                return StorageEngine<int>::Statuses(events.size(), HdbEventStatus::Ok);
+            },
+            64);
+
+        WHEN("Each thread submits events and executes work")
+        {
+            const int producers = 8;
+            atomic<int> ok {0};
+            atomic<int> work {0};
+            vector<thread> threads;
+
+            for (auto producer = 0; producer < producers; producer++)
+            {
+                threads.emplace_back([&engine, &ok, &work]() {
+                    for (auto i = 0; i < 500; i++)
+                    {
+                        auto statuses = engine.submit({i}).get();
+                        ok += static_cast<int>(count(statuses.begin(), statuses.end(), HdbEventStatus::Ok));
+
+                        if (i % 50 == 0)
+                            engine.execute([&work]() { work++; });
+                    }
+                });
+            }
+
+            for (auto &t : threads)
+                t.join();
+
+            THEN("Every event is stored once, and all the work is run")
+            {
+                REQUIRE(ok == producers * 500);
+                REQUIRE(work == producers * 10);
+
+                // read on the engine thread, after everything before it
+                auto total = 0;
+                engine.execute([&stored, &total]() { total = stored; });
+                REQUIRE(total == producers * 500);
+                REQUIRE(engine.groupedEvents() == static_cast<uint64_t>(producers * 500));
+            }
+        }
+    }
+}
@@ -24,6 +24,15 @@ using namespace hdbpp_internal;
 
 namespace hdbpp_test
 {
+namespace psql_connection
+{
+    namespace postgres_db
+    {
+        std::string ConnectionString = "user=postgres host=localhost port=5432 dbname=hdb password=password";
+        std::string HdbppConnectionString = "user=postgres host=localhost port=5432 dbname=hdb password=password";
+    } // namespace postgres_db
+} // namespace psql_connection
+
 namespace data_gen
 {
     //=============================================================================
@@ -242,6 +251,49 @@ namespace data_gen
     {
         return move(genericData<int16_t>(size));
     }
+
+    //=============================================================================
+    //=============================================================================
+    template<Tango::CmdArgType Type>
+    Tango::DeviceAttribute deviceAttribute(const AttributeTraits &traits, int size)
+    {
+        auto elements = traits.isScalar() ? 1 : size;
+        auto parts = (traits.hasReadData() ? 1 : 0) + (traits.hasWriteData() ? 1 : 0);
+        auto value = data<Type>(elements * parts);
+
+        Tango::DeviceAttribute attr(attr_name::TestAttrFQDName.c_str(), *value);
+
+        // as in the unit tests, we have to set the public dimension fields directly,
+        // so get_nb_read()/get_nb_written() split the data correctly
+        attr.dim_x = traits.hasReadData() ? elements : 0;
+        attr.dim_y = 0;
+        attr.w_dim_x = traits.hasWriteData() ? elements : 0;
+        attr.w_dim_y = 0;
+        return attr;
+    }
+
+    //=============================================================================
+    //=============================================================================
+    Tango::DeviceAttribute createDeviceAttribute(const AttributeTraits &traits, int size)
+    {
+        switch (traits.type())
+        {
+            case Tango::DEV_BOOLEAN: return deviceAttribute<Tango::DEV_BOOLEAN>(traits, size);
+            case Tango::DEV_SHORT: return deviceAttribute<Tango::DEV_SHORT>(traits, size);
+            case Tango::DEV_LONG: return deviceAttribute<Tango::DEV_LONG>(traits, size);
+            case Tango::DEV_LONG64: return deviceAttribute<Tango::DEV_LONG64>(traits, size);
+            case Tango::DEV_FLOAT: return deviceAttribute<Tango::DEV_FLOAT>(traits, size);
+            case Tango::DEV_DOUBLE: return deviceAttribute<Tango::DEV_DOUBLE>(traits, size);
+            case Tango::DEV_UCHAR: return deviceAttribute<Tango::DEV_UCHAR>(traits, size);
+            case Tango::DEV_USHORT: return deviceAttribute<Tango::DEV_USHORT>(traits, size);
+            case Tango::DEV_ULONG: return deviceAttribute<Tango::DEV_ULONG>(traits, size);
+            case Tango::DEV_ULONG64: return deviceAttribute<Tango::DEV_ULONG64>(traits, size);
+            case Tango::DEV_STRING: return deviceAttribute<Tango::DEV_STRING>(traits, size);
+            case Tango::DEV_STATE: return deviceAttribute<Tango::DEV_STATE>(traits, size);
+            case Tango::DEV_ENUM: return deviceAttribute<Tango::DEV_ENUM>(traits, size);
+            default: throw runtime_error("Unsupported type for createDeviceAttribute()");
+        }
+    }
 } // namespace data_gen
 
 namespace utils
@@ -36,9 +36,10 @@ namespace psql_connection
 {
     namespace postgres_db
     {
-        // connection strings
-        const std::string ConnectionString = "user=postgres host=localhost port=5432 dbname=hdb password=password";
-        const std::string HdbppConnectionString = "user=postgres host=localhost port=5432 dbname=hdb password=password";
+        // connection strings, these default to a pre-provisioned database on localhost, but
+        // are repointed when the tests run against an ephemeral server (see PostgresFixture.hpp)
+        extern std::string ConnectionString;
+        extern std::string HdbppConnectionString;
     } // namespace postgres_db
 } // namespace psql_connection
 
@@ -258,6 +259,11 @@ namespace data_gen
 
         return generateScalarData<Type>(empty_data);
     }
+
+    // Create a DeviceAttribute holding generated data for the given traits. The read and
+    // write parts each hold size elements (1 for a scalar), and are laid out as Tango
+    // delivers them, the read data followed by the set point
+    Tango::DeviceAttribute createDeviceAttribute(const hdbpp_internal::AttributeTraits &traits, int size = 10);
 } // namespace data_gen
 
 namespace utils
@@ -0,0 +1,173 @@
+/* Copyright (C) : 2014-2019
+   European Synchrotron Radiation Facility
+   BP 220, Grenoble 38043, FRANCE
+
+   This file is part of libhdb++timescale.
+
+   libhdb++timescale is free software: you can redistribute it and/or modify
+   it under the terms of the Lesser GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   libhdb++timescale is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the Lesser
+   GNU General Public License for more details.
+
+   You should have received a copy of the Lesser GNU General Public License
+   along with libhdb++timescale.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "ThreadPool.hpp"
+#include "catch2/catch.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace hdbpp_internal;
+
+SCENARIO("ThreadPool parallelFor visits every item exactly once", "[thread-pool]")
+{
+    auto threads = GENERATE(0, 1, 4);
+
+    GIVEN("A ThreadPool with " + to_string(threads) + " workers")
+    {
+        ThreadPool pool(threads);
+        REQUIRE(pool.size() == static_cast<size_t>(threads));
+
+        WHEN("Running a parallelFor over more items than a single range")
+        {
+            vector<atomic<int>> visits(10007);
+            atomic<bool> oversized {false};
+
+            for (auto &visit : visits)
+                visit = 0;
+
+            // catch assertions are not thread safe, so the ranges are checked afterwards
+            pool.parallelFor(visits.size(), 64, [&visits, &oversized](size_t begin, size_t end) {
+                if (end - begin > 64)
+                    oversized = true;
+
+                for (auto i = begin; i < end; i++)
+                    visits[i]++;
+            });
+
+            THEN("Each item is visited once, in ranges no larger than the grain")
+            {
+                REQUIRE(!oversized);
+
+                for (const auto &visit : visits)
+                    REQUIRE(visit == 1);
+            }
+        }
+        WHEN("Running a parallelFor over no items")
+        {
+            auto calls = 0;
+            pool.parallelFor(0, 64, [&calls](size_t, size_t) { calls++; });
+
+            THEN("The function is not called") { REQUIRE(calls == 0); }
+        }
+    }
+}
+
+SCENARIO("ThreadPool parallelFor spreads the work across the workers", "[thread-pool]")
+{
+    GIVEN("A ThreadPool with several workers")
+    {
+        ThreadPool pool(4);
+
+        WHEN("Running ranges that wait for each other")
+        {
+            // each range holds its thread until several ranges are running at once,
+            // which can only happen if the ranges run in parallel
+            atomic<int> running {0};
+            atomic<int> peak {0};
+
+            pool.parallelFor(8, 1, [&running, &peak](size_t, size_t) {
+                auto now = ++running;
+                auto previous = peak.load();
+
+                while (now > previous && !peak.compare_exchange_weak(previous, now))
+                    ;
+
+                for (auto i = 0; i < 1000 && peak < 2; i++)
+                    this_thread::sleep_for(chrono::milliseconds(1));
+
+                running--;
+            });
+
+            THEN("More than one range ran at once") { REQUIRE(peak >= 2); }
+        }
+    }
+}
+
+SCENARIO("ThreadPool parallelFor rethrows an exception from a range", "[thread-pool]")
+{
+    GIVEN("A ThreadPool with several workers")
+    {
+        ThreadPool pool(4);
+        atomic<int> finished {0};
+
+        WHEN("A single range throws")
+        {
+            auto run = [&pool, &finished]() {
+                pool.parallelFor(100, 10, [&finished](size_t begin, size_t) {
+                    if (begin == 50)
+                        throw runtime_error("range failed");
+
+                    finished++;
+                });
+            };
+
+            THEN("The exception reaches the caller, once the other ranges are done")
+            {
+                REQUIRE_THROWS_AS(run(), runtime_error);
+                REQUIRE(finished == 9);
+            }
+            AND_THEN("The pool is still usable")
+            {
+                REQUIRE_THROWS_AS(run(), runtime_error);
+
+                atomic<int> items {0};
+                pool.parallelFor(100, 10, [&items](size_t begin, size_t end) { items += end - begin; });
+                REQUIRE(items == 100);
+            }
+        }
+    }
+}
+
+SCENARIO("ThreadPool can be shared by several callers at once", "[thread-pool]")
+{
+    GIVEN("A ThreadPool and several threads calling parallelFor")
+    {
+        ThreadPool pool(3);
+        vector<atomic<int>> totals(4);
+        vector<thread> callers;
+
+        for (auto &total : totals)
+            total = 0;
+
+        for (size_t caller = 0; caller < totals.size(); caller++)
+        {
+            callers.emplace_back([&pool, &totals, caller]() {
+                for (auto repeat = 0; repeat < 20; repeat++)
+                {
+                    pool.parallelFor(1000, 16, [&totals, caller](size_t begin, size_t end) {
+                        totals[caller] += end - begin;
+                    });
+                }
+            });
+        }
+
+        for (auto &caller : callers)
+            caller.join();
+
+        THEN("Every call completes with all its items")
+        {
+            for (const auto &total : totals)
+                REQUIRE(total == 20 * 1000);
+        }
+    }
+}
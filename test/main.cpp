@@ -20,14 +20,31 @@
 #define CATCH_CONFIG_RUNNER
 
 #include "LibUtils.hpp"
+#include "PostgresFixture.hpp"
 #include "catch2/catch.hpp"
 
+#include <iostream>
+#include <stdexcept>
+
 int main(int argc, char *argv[])
 {
     hdbpp_internal::LogConfigurator::initLogging("tests");
     //hdbpp_internal::LogConfigurator::initConsoleLogging("tests");
     hdbpp_internal::LogConfigurator::setLoggingLevel(spdlog::level::err);
 
+    // run against a private database server when requested
+    std::unique_ptr<hdbpp_test::postgres_fixture::EphemeralPostgres> database;
+
+    try
+    {
+        database = hdbpp_test::postgres_fixture::useEphemeralDatabase();
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
     int result = Catch::Session().run(argc, argv);
 
     hdbpp_internal::LogConfigurator::shutdownLogging("tests");